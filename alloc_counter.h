@@ -0,0 +1,92 @@
+// Счётчик обращений к куче через operator new. Нужен, чтобы проверять, что цикл
+// отрисовки после прогрева не выделяет память: временные данные кадра берутся из арены
+// (frame_memory.h), объекты - из пулов, а контейнеры переиспользуют свою ёмкость.
+//
+// Замена operator new и operator delete должна быть ровно в одной единице трансляции:
+// перед подключением заголовка в ней определяется ALLOCATION_COUNTER_HOOK. Без этого
+// счётчики остаются нулевыми, а allocationCounterInstalled() возвращает false.
+// malloc из библиотек на C (SOIL, драйвер OpenGL) не учитывается.
+
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Все потоки процесса: цикл отрисовки, пулы записи команд и загрузки, запись кадров
+inline std::atomic<long long> heapAllocations(0);
+inline std::atomic<long long> heapAllocatedBytes(0);
+inline std::atomic<bool> heapCounterInstalled(false);
+
+inline bool allocationCounterInstalled() { return heapCounterInstalled.load(std::memory_order_relaxed); }
+
+// Снимок счётчиков: разность двух снимков - выделения за участок программы
+struct AllocationSnapshot
+{
+	long long Allocations = 0, Bytes = 0;
+
+	static AllocationSnapshot Take()
+	{
+		AllocationSnapshot snapshot;
+		snapshot.Allocations = heapAllocations.load(std::memory_order_relaxed);
+		snapshot.Bytes = heapAllocatedBytes.load(std::memory_order_relaxed);
+		return snapshot;
+	}
+};
+
+#ifdef ALLOCATION_COUNTER_HOOK
+
+inline void * countedAllocate(std::size_t size, std::size_t alignment)
+{
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	heapAllocatedBytes.fetch_add((long long)size, std::memory_order_relaxed);
+	if (size == 0)
+		size = 1;
+	if (alignment <= alignof(std::max_align_t))
+		return malloc(size);
+	// aligned_alloc требует размер, кратный выравниванию
+	return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+static const bool heapCounterHooked = (heapCounterInstalled = true);
+
+// Освобождение не встраивается в место вызова: иначе GCC видит free от указателя из
+// operator new и предупреждает о несоответствии (-Wmismatched-new-delete)
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void countedFree(void * pointer) { free(pointer); }
+
+void * operator new(std::size_t size)
+{
+	if (void * pointer = countedAllocate(size, 0))
+		return pointer;
+	throw std::bad_alloc();
+}
+void * operator new[](std::size_t size) { return operator new(size); }
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept { return countedAllocate(size, 0); }
+void * operator new[](std::size_t size, const std::nothrow_t &) noexcept { return countedAllocate(size, 0); }
+void * operator new(std::size_t size, std::align_val_t alignment)
+{
+	if (void * pointer = countedAllocate(size, (std::size_t)alignment))
+		return pointer;
+	throw std::bad_alloc();
+}
+void * operator new[](std::size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+
+void operator delete(void * pointer) noexcept { countedFree(pointer); }
+void operator delete[](void * pointer) noexcept { countedFree(pointer); }
+void operator delete(void * pointer, std::size_t) noexcept { countedFree(pointer); }
+void operator delete[](void * pointer, std::size_t) noexcept { countedFree(pointer); }
+void operator delete(void * pointer, const std::nothrow_t &) noexcept { countedFree(pointer); }
+void operator delete[](void * pointer, const std::nothrow_t &) noexcept { countedFree(pointer); }
+void operator delete(void * pointer, std::align_val_t) noexcept { countedFree(pointer); }
+void operator delete[](void * pointer, std::align_val_t) noexcept { countedFree(pointer); }
+void operator delete(void * pointer, std::size_t, std::align_val_t) noexcept { countedFree(pointer); }
+void operator delete[](void * pointer, std::size_t, std::align_val_t) noexcept { countedFree(pointer); }
+
+#endif // ALLOCATION_COUNTER_HOOK
+
+#endif
@@ -0,0 +1,292 @@
+// Параметры запуска приложения. Окно GLFW ими почти не пользуется, а безоконный
+// (headless) режим получает через них число кадров для замера.
+
+#ifndef APP_OPTIONS_H
+#define APP_OPTIONS_H
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+struct AppOptions
+{
+	// Сколько кадров отрисовать в безоконном режиме
+	int Frames = 1000;
+	// Сколько первых кадров не учитывать в статистике (прогрев драйвера и кешей)
+	int WarmupFrames = 20;
+	// Каталог для бинарников шейдерных программ (пустая строка - только кеш в памяти)
+	std::string ShaderCacheDir = ".shader_cache";
+	// Сколько спрайтов рисовать пакетом поверх четырёхугольника (0 - не рисовать)
+	int Sprites = 0;
+	// Обновление буфера экземпляров спрайтов: "orphan" или "persistent"
+	std::string SpriteStreaming = "orphan";
+	// Сколько частиц рисовать (0 - не рисовать) и способ потоковой загрузки их вершин
+	int Particles = 0;
+	std::string ParticleStreaming = "persistent";
+	// Сколько объектов сцены рисовать (0 - не рисовать) и сколько потоков записывают их
+	// команды (0 - по числу ядер)
+	int Objects = 0;
+	int RecordThreads = 0;
+	// Сторона мира, по которому разбросаны объекты (экран - 2; 0 - все вокруг центра экрана),
+	// и отсечение невидимых: "bvh", "brute" или "off"
+	float WorldSize = 0.0f;
+	std::string Cull = "bvh";
+	// Откуда шейдер объектов берёт данные: "ubo" - uniform-блоки кадра и объекта в общем
+	// буфере, "uniform" - glUniform4f на каждый объект
+	std::string Uniforms = "ubo";
+	// Отсечение и запись команд объектов на GPU (нужен OpenGL 4.3, иначе - путь через CPU)
+	bool GpuDriven = false;
+	// Сетка из файла OBJ, загружаемая в фоне (пустая строка - без сетки)
+	std::string Mesh;
+	// Следить за файлами шейдеров и пересобирать программы на лету
+	bool ShaderReload = true;
+	// Вертикальная синхронизация (в безоконном режиме не на что синхронизироваться)
+	bool Vsync = true;
+	// Предел частоты кадров (0 - без ограничения) и частота шагов симуляции
+	double TargetFps = 0.0;
+	double SimulationHz = 120.0;
+	// Куда выгрузить профиль кадров: Chrome trace JSON и CSV (пустая строка - не выгружать)
+	std::string ProfileTrace;
+	std::string ProfileCsv;
+	// Эталонное изображение последнего кадра (пустая строка - без проверки). С ним каждый
+	// кадр - ровно один шаг симуляции, а текстуры и сетка загружаются до первого кадра,
+	// чтобы картинка не зависела от скорости машины. GoldenUpdate - перезаписать эталон.
+	std::string Golden;
+	bool GoldenUpdate = false;
+	// Пороги сравнения: расхождение канала, доля отличающихся пикселей, минимальный PSNR
+	int GoldenTolerance = 8;
+	double GoldenMaxBad = 0.001;
+	double GoldenPsnr = 40.0;
+	// Запись кадров в YUV 4:2:0 (файл или "|команда"; пустая строка - не записывать) и
+	// через сколько кадров забирается прочитанный кадр
+	std::string Capture;
+	int CaptureDepth = 3;
+	// Завершить прогон ошибкой, если после прогрева кадры обращались к куче
+	bool CheckAllocations = false;
+	// Чем рисовать: "gl" - OpenGL, "soft" - программный растеризатор без контекста OpenGL
+	// (только безоконная сборка; рисуется четырёхугольник с текстурами), и сколько потоков
+	// растеризуют плитки (0 - по числу ядер)
+	std::string Renderer = "gl";
+	int RasterThreads = 0;
+	// Бюджет видеопамяти текстур в мегабайтах: уровни мипмапов подгружаются по размеру на
+	// экране и выгружаются по давности (texture_streaming.h). 0 - грузить текстуры целиком.
+	int TextureBudget = 0;
+	// Процедурные текстуры (test_textures.h) вместо картинок из pics/: для эталонов, которые
+	// не должны зависеть от ассетов
+	bool TestTextures = false;
+};
+
+// Разбор аргументов вида "--frames 500". Неизвестный аргумент - ошибка, чтобы
+// опечатка в скрипте замеров не превратилась в молча испорченный прогон.
+// Значение "" у --shader-cache отключает дисковый кеш шейдеров.
+inline bool parseOptions(int argc, char ** argv, AppOptions & options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const char * arg = argv[i];
+		const char * value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+		if (!strcmp(arg, "--frames") && value)
+		{
+			options.Frames = atoi(value);
+			i++;
+		}
+		else if (!strcmp(arg, "--warmup") && value)
+		{
+			options.WarmupFrames = atoi(value);
+			i++;
+		}
+		else if (!strcmp(arg, "--shader-cache") && value)
+		{
+			options.ShaderCacheDir = value;
+			i++;
+		}
+		else if (!strcmp(arg, "--no-shader-reload"))
+			options.ShaderReload = false;
+		else if (!strcmp(arg, "--vsync") && value && (!strcmp(value, "on") || !strcmp(value, "off")))
+		{
+			options.Vsync = !strcmp(value, "on");
+			i++;
+		}
+		else if (!strcmp(arg, "--target-fps") && value)
+		{
+			options.TargetFps = atof(value);
+			i++;
+		}
+		else if (!strcmp(arg, "--sim-hz") && value)
+		{
+			options.SimulationHz = atof(value);
+			i++;
+		}
+		else if (!strcmp(arg, "--profile-trace") && value)
+		{
+			options.ProfileTrace = value;
+			i++;
+		}
+		else if (!strcmp(arg, "--profile-csv") && value)
+		{
+			options.ProfileCsv = value;
+			i++;
+		}
+		else if (!strcmp(arg, "--sprites") && value)
+		{
+			options.Sprites = atoi(value);
+			i++;
+		}
+		else if (!strcmp(arg, "--sprite-streaming") && value)
+		{
+			options.SpriteStreaming = value;
+			i++;
+		}
+		else if (!strcmp(arg, "--particles") && value)
+		{
+			options.Particles = atoi(value);
+			i++;
+		}
+		else if (!strcmp(arg, "--particle-streaming") && value)
+		{
+			options.ParticleStreaming = value;
+			i++;
+		}
+		else if (!strcmp(arg, "--objects") && value)
+		{
+			options.Objects = atoi(value);
+			i++;
+		}
+		else if (!strcmp(arg, "--record-threads") && value)
+		{
+			options.RecordThreads = atoi(value);
+			i++;
+		}
+		else if (!strcmp(arg, "--world-size") && value)
+		{
+			options.WorldSize = (float)atof(value);
+			i++;
+		}
+		else if (!strcmp(arg, "--cull") && value)
+		{
+			options.Cull = value;
+			i++;
+		}
+		else if (!strcmp(arg, "--uniforms") && value)
+		{
+			options.Uniforms = value;
+			i++;
+		}
+		else if (!strcmp(arg, "--gpu-driven"))
+			options.GpuDriven = true;
+		else if (!strcmp(arg, "--mesh") && value)
+		{
+			options.Mesh = value;
+			i++;
+		}
+		else if (!strcmp(arg, "--golden") && value)
+		{
+			options.Golden = value;
+			i++;
+		}
+		else if (!strcmp(arg, "--golden-update"))
+			options.GoldenUpdate = true;
+		else if (!strcmp(arg, "--golden-tolerance") && value)
+		{
+			options.GoldenTolerance = atoi(value);
+			i++;
+		}
+		else if (!strcmp(arg, "--golden-max-bad") && value)
+		{
+			options.GoldenMaxBad = atof(value);
+			i++;
+		}
+		else if (!strcmp(arg, "--golden-psnr") && value)
+		{
+			options.GoldenPsnr = atof(value);
+			i++;
+		}
+		else if (!strcmp(arg, "--capture") && value)
+		{
+			options.Capture = value;
+			i++;
+		}
+		else if (!strcmp(arg, "--capture-depth") && value)
+		{
+			options.CaptureDepth = atoi(value);
+			i++;
+		}
+		else if (!strcmp(arg, "--check-allocs"))
+			options.CheckAllocations = true;
+		else if (!strcmp(arg, "--renderer") && value)
+		{
+			options.Renderer = value;
+			i++;
+		}
+		else if (!strcmp(arg, "--raster-threads") && value)
+		{
+			options.RasterThreads = atoi(value);
+			i++;
+		}
+		else if (!strcmp(arg, "--texture-budget") && value)
+		{
+			options.TextureBudget = atoi(value);
+			i++;
+		}
+		else if (!strcmp(arg, "--test-textures"))
+			options.TestTextures = true;
+		else
+		{
+			std::cout << "ERROR::OPTIONS::UNKNOWN_ARGUMENT " << arg << std::endl;
+			return false;
+		}
+	}
+	if (options.Frames <= 0 || options.WarmupFrames < 0)
+	{
+		std::cout << "ERROR::OPTIONS::INVALID_FRAME_COUNT" << std::endl;
+		return false;
+	}
+	if (options.TargetFps < 0.0 || options.SimulationHz <= 0.0)
+	{
+		std::cout << "ERROR::OPTIONS::INVALID_PACING" << std::endl;
+		return false;
+	}
+	if (options.Sprites < 0 || (options.SpriteStreaming != "orphan" && options.SpriteStreaming != "persistent"))
+	{
+		std::cout << "ERROR::OPTIONS::INVALID_SPRITES" << std::endl;
+		return false;
+	}
+	if (options.Particles < 0 || (options.ParticleStreaming != "orphan" && options.ParticleStreaming != "persistent"))
+	{
+		std::cout << "ERROR::OPTIONS::INVALID_PARTICLES" << std::endl;
+		return false;
+	}
+	if (options.Objects < 0 || options.RecordThreads < 0 || options.WorldSize < 0.0f ||
+		(options.Cull != "bvh" && options.Cull != "brute" && options.Cull != "off") ||
+		(options.Uniforms != "ubo" && options.Uniforms != "uniform"))
+	{
+		std::cout << "ERROR::OPTIONS::INVALID_OBJECTS" << std::endl;
+		return false;
+	}
+	if ((options.GoldenUpdate && options.Golden.empty()) || options.GoldenTolerance < 0 || options.GoldenTolerance > 255 ||
+		options.GoldenMaxBad < 0.0 || options.GoldenMaxBad > 1.0)
+	{
+		std::cout << "ERROR::OPTIONS::INVALID_GOLDEN" << std::endl;
+		return false;
+	}
+	if (options.CaptureDepth < 1)
+	{
+		std::cout << "ERROR::OPTIONS::INVALID_CAPTURE" << std::endl;
+		return false;
+	}
+	if ((options.Renderer != "gl" && options.Renderer != "soft") || options.RasterThreads < 0)
+	{
+		std::cout << "ERROR::OPTIONS::INVALID_RENDERER" << std::endl;
+		return false;
+	}
+	if (options.TextureBudget < 0)
+	{
+		std::cout << "ERROR::OPTIONS::INVALID_TEXTURE_BUDGET" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,268 @@
+// Окно приложения. В обычной сборке это окно GLFW, а при сборке с -DHEADLESS -
+// безоконный контекст EGL (surfaceless или pbuffer), который рисует в собственный
+// FBO. Так один и тот же код сцены работает и на машине без GPU (Mesa llvmpipe).
+
+#ifndef APP_WINDOW_H
+#define APP_WINDOW_H
+
+#include <iostream>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "app_options.h"
+
+// Инициализация GLEW. Вызывается после того, как контекст стал текущим.
+inline bool initGlew()
+{
+	// glewExperimental = GL_TRUE позволяет GLEW использовать современные техники
+	// получения указателей на функции OpenGL.
+	glewExperimental = GL_TRUE;
+	GLenum result = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	// GLEW, собранный под GLX, после загрузки функций ядра пытается найти дисплей X11.
+	// Под EGL его нет, но сами функции OpenGL к этому моменту уже загружены.
+	if (result == GLEW_ERROR_NO_GLX_DISPLAY)
+		result = GLEW_OK;
+#endif
+	if (result != GLEW_OK)
+	{
+		std::cout << "Failed to initialize GLEW" << std::endl;
+		return false;
+	}
+	// glewInit может оставить GL_INVALID_ENUM от glGetString(GL_EXTENSIONS) в core профиле
+	glGetError();
+	return true;
+}
+
+#ifndef HEADLESS
+
+// GLFW
+#include <GLFW/glfw3.h>
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode);
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode)
+{
+	// Когда пользователь нажимает ESC, мы устанавливаем свойство WindowShouldClose в true,
+	// и после этого приложение закрывается.
+	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+		glfwSetWindowShouldClose(window, GL_TRUE);
+}
+
+class AppWindow
+{
+	public:
+	GLFWwindow * Handle = nullptr;
+	// Размер буфера кадра (может отличаться от размера окна на HiDPI экранах)
+	int Width = 0, Height = 0;
+
+	bool Create(const AppOptions & options, int width, int height, const char * title)
+	{
+		// Инициализация GLFW
+		glfwInit();
+		// Настройка GLFW
+		// Задаётся минимальная требуемая версия OpenGL.
+		// Мажорная
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		// Минорная
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		// Установка профайла, для которого создаётся контекст.
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		// Выключения возможности изменения размера окна.
+		glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+
+		this->Handle = glfwCreateWindow(width, height, title, nullptr, nullptr);
+		if (this->Handle == nullptr)
+		{
+			std::cout << "Failed to create GLFW window." << std::endl;
+			glfwTerminate();
+			return false;
+		}
+		glfwMakeContextCurrent(this->Handle);
+
+		if (!initGlew())
+			return false;
+
+		glfwGetFramebufferSize(this->Handle, &this->Width, &this->Height);
+
+		// Зарегистрировать функцию обратного вызова надо после создания окна и до игрового цикла.
+		glfwSetKeyCallback(this->Handle, key_callback);
+		return true;
+	}
+
+	bool ShouldClose() { return glfwWindowShouldClose(this->Handle); }
+	// Проверяем события и вызываем функции обратного вызова.
+	void PollEvents() { glfwPollEvents(); }
+	// Меняем буферы местами.
+	void SwapBuffers() { glfwSwapBuffers(this->Handle); }
+	// Сколько обновлений экрана ждать перед сменой буферов: 1 - вертикальная синхронизация, 0 - без неё
+	void SetSwapInterval(int interval) { glfwSwapInterval(interval); }
+	void Destroy() { glfwTerminate(); }
+};
+
+#else // HEADLESS
+
+#include <cstring>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+class AppWindow
+{
+	public:
+	int Width = 0, Height = 0;
+	// Сколько кадров отрисовать до "закрытия окна"
+	int FrameLimit = 1;
+	// Внеэкранный буфер кадра, в который идёт вся отрисовка
+	GLuint Framebuffer = 0;
+
+	// Заголовок окну без окна не нужен, параметр оставлен ради общего интерфейса
+	bool Create(const AppOptions & options, int width, int height, const char * /* title */)
+	{
+		this->Width = width;
+		this->Height = height;
+		this->FrameLimit = options.WarmupFrames + options.Frames;
+
+		// Сначала пробуем платформу surfaceless из Mesa: ей не нужен ни X11, ни DRM устройство.
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+		if (getPlatformDisplay)
+			this->display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+#endif
+		if (this->display == EGL_NO_DISPLAY)
+			this->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+		EGLint major, minor;
+		if (this->display == EGL_NO_DISPLAY || !eglInitialize(this->display, &major, &minor))
+		{
+			std::cout << "ERROR::EGL::INITIALIZE_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+			return false;
+		}
+		if (!eglBindAPI(EGL_OPENGL_API))
+		{
+			std::cout << "ERROR::EGL::OPENGL_API_UNAVAILABLE" << std::endl;
+			return false;
+		}
+
+		const char * extensions = eglQueryString(this->display, EGL_EXTENSIONS);
+		bool surfaceless = extensions && strstr(extensions, "EGL_KHR_surfaceless_context");
+
+		const EGLint configAttribs[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+			EGL_NONE
+		};
+		EGLConfig config = nullptr;
+		EGLint configCount = 0;
+		eglChooseConfig(this->display, configAttribs, &config, 1, &configCount);
+		if (configCount == 0)
+		{
+			// Без конфигурации можно обойтись только без поверхности вообще
+			if (!surfaceless || !strstr(extensions, "EGL_KHR_no_config_context"))
+			{
+				std::cout << "ERROR::EGL::NO_PBUFFER_CONFIG" << std::endl;
+				return false;
+			}
+			config = nullptr; // EGL_NO_CONFIG_KHR
+		}
+
+		// Тот же контекст, что запрашивает окно GLFW: OpenGL 3.3 core
+		const EGLint contextAttribs[] = {
+			EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+			EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+			EGL_NONE
+		};
+		this->context = eglCreateContext(this->display, config, EGL_NO_CONTEXT, contextAttribs);
+		if (this->context == EGL_NO_CONTEXT)
+		{
+			std::cout << "ERROR::EGL::CONTEXT_CREATION_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+			return false;
+		}
+
+		// Поверхность нужна только там, где нет surfaceless контекстов. Рисуем всё
+		// равно в FBO, поэтому хватит pbuffer 1x1.
+		if (!surfaceless)
+		{
+			const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+			this->surface = eglCreatePbufferSurface(this->display, config, pbufferAttribs);
+			if (this->surface == EGL_NO_SURFACE)
+			{
+				std::cout << "ERROR::EGL::PBUFFER_CREATION_FAILED" << std::endl;
+				return false;
+			}
+		}
+		if (!eglMakeCurrent(this->display, this->surface, this->surface, this->context))
+		{
+			std::cout << "ERROR::EGL::MAKE_CURRENT_FAILED" << std::endl;
+			return false;
+		}
+
+		if (!initGlew())
+			return false;
+
+		std::cout << "Renderer: " << glGetString(GL_RENDERER) << " | " << glGetString(GL_VERSION) << std::endl;
+		return this->createFramebuffer();
+	}
+
+	bool ShouldClose() { return this->frame >= this->FrameLimit; }
+	// Идёт последний кадр перед "закрытием окна"
+	bool LastFrame() const { return this->frame + 1 >= this->FrameLimit; }
+	void PollEvents() {}
+	// Показывать нечего, поэтому дожидаемся окончания кадра, чтобы время кадра
+	// включало работу растеризатора, а не только постановку команд в очередь.
+	void SwapBuffers()
+	{
+		glFinish();
+		this->frame++;
+	}
+	// Экрана нет, синхронизироваться не с чем: темп задаёт только FramePacer
+	void SetSwapInterval(int) {}
+
+	void Destroy()
+	{
+		glDeleteFramebuffers(1, &this->Framebuffer);
+		glDeleteRenderbuffers(2, this->renderbuffers);
+		eglMakeCurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (this->surface != EGL_NO_SURFACE)
+			eglDestroySurface(this->display, this->surface);
+		eglDestroyContext(this->display, this->context);
+		eglTerminate(this->display);
+	}
+
+	private:
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLContext context = EGL_NO_CONTEXT;
+	EGLSurface surface = EGL_NO_SURFACE;
+	GLuint renderbuffers[2] = { 0, 0 };
+	int frame = 0;
+
+	// FBO с цветом RGBA8 и глубиной/трафаретом. Он остаётся привязанным всё время,
+	// поэтому glClear и glDraw* в коде сцены попадают в него без изменений.
+	bool createFramebuffer()
+	{
+		glGenRenderbuffers(2, this->renderbuffers);
+		glBindRenderbuffer(GL_RENDERBUFFER, this->renderbuffers[0]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, this->Width, this->Height);
+		glBindRenderbuffer(GL_RENDERBUFFER, this->renderbuffers[1]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, this->Width, this->Height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &this->Framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, this->Framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->renderbuffers[0]);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, this->renderbuffers[1]);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "ERROR::FRAMEBUFFER::INCOMPLETE" << std::endl;
+			return false;
+		}
+		return true;
+	}
+};
+
+#endif // HEADLESS
+
+#endif
@@ -0,0 +1,102 @@
+// Сборка текстурного атласа заранее: картинки -> атлас .gtex (rgba8 с мипмапами) и рядом
+// таблица пересчёта UV .atlas (формат - TextureAtlas::WriteRemapTable).
+// atlasgen <выход.gtex> <картинка>... [--packing skyline|maxrects] [--max-size N] [--padding N]
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <SOIL/SOIL.h>
+
+#include "mipmap.h"
+#include "texture_atlas.h"
+#include "texture_file.h"
+
+static int usage()
+{
+	std::cout << "Usage: atlasgen <output.gtex> <image>... [--packing skyline|maxrects] [--max-size N] [--padding N]" << std::endl;
+	return -1;
+}
+
+int main(int argc, char ** argv)
+{
+	if (argc < 3)
+		return usage();
+	std::string output = argv[1];
+	std::vector<std::string> inputs;
+	AtlasPacking packing = AtlasPacking::MaxRects;
+	int maxSize = 4096, padding = 2;
+	for (int i = 2; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (argument == "--packing" && i + 1 < argc)
+		{
+			std::string name = argv[++i];
+			if (name == "skyline") packing = AtlasPacking::Skyline;
+			else if (name == "maxrects") packing = AtlasPacking::MaxRects;
+			else return usage();
+		}
+		else if (argument == "--max-size" && i + 1 < argc)
+			maxSize = atoi(argv[++i]);
+		else if (argument == "--padding" && i + 1 < argc)
+			padding = atoi(argv[++i]);
+		else if (argument.compare(0, 2, "--") == 0)
+			return usage();
+		else
+			inputs.push_back(argument);
+	}
+	if (inputs.empty() || maxSize <= 0 || padding < 0)
+		return usage();
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<unsigned char *> pixels;
+	std::vector<AtlasImage> images;
+	for (const std::string & input : inputs)
+	{
+		int width, height;
+		unsigned char * data = SOIL_load_image(input.c_str(), &width, &height, 0, SOIL_LOAD_RGBA);
+		if (!data)
+		{
+			std::cout << "ERROR::ATLASGEN::LOAD_FAILED " << input << std::endl;
+			for (unsigned char * loaded : pixels)
+				SOIL_free_image_data(loaded);
+			return -1;
+		}
+		pixels.push_back(data);
+		// Имя в таблице - имя файла без каталога и расширения
+		images.push_back({ std::filesystem::path(input).stem().string(), width, height, data });
+	}
+
+	TextureAtlas atlas;
+	bool built = atlas.Build(images, maxSize, packing, padding);
+	for (unsigned char * data : pixels)
+		SOIL_free_image_data(data);
+	if (!built)
+		return -1;
+
+	MipChain chain;
+	buildMipChain(atlas.Pixels.data(), atlas.Width, atlas.Height, MipOptions(), chain);
+	std::vector<TextureFileLevel> levels;
+	std::vector<const unsigned char *> data;
+	for (const MipChain::Level & level : chain.Levels)
+	{
+		levels.push_back({ (uint32_t)level.Width, (uint32_t)level.Height, 0, textureLevelSize(TextureFileFormat::RGBA8, level.Width, level.Height) });
+		data.push_back(chain.Data.data() + level.Offset);
+	}
+	std::string table = std::filesystem::path(output).replace_extension(".atlas").string();
+	if (!writeTextureFile(output, TextureFileFormat::RGBA8, 0, levels, data) || !atlas.WriteRemapTable(table))
+		return -1;
+
+	std::cout << std::fixed << std::setprecision(3)
+			  << "atlasgen output=" << output << " table=" << table
+			  << " packing=" << atlasPackingName(packing)
+			  << " images=" << images.size() << " size=" << atlas.Width << "x" << atlas.Height
+			  << " occupancy=" << atlas.Occupancy
+			  << " ms=" << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+			  << std::endl;
+	return 0;
+}
@@ -0,0 +1,46 @@
+// Микробенчмарки. Собираются безоконно (make bench) и запускаются так:
+// ./gl_bench <имя> [аргументы]
+// Результаты выводятся строками "ключ=значение", как и отчёт hello_window_headless.
+
+#include <cstring>
+#include <iostream>
+
+#include "bench.h"
+
+struct BenchEntry
+{
+	const char * Name;
+	int (*Run)(int argc, char ** argv);
+	const char * Usage;
+};
+
+static const BenchEntry benches[] = {
+	{ "mipmap", benchMipmap, "[size] [repeats] - мипмапы на CPU (scalar/SSE2/AVX2) против glGenerateMipmap" },
+	{ "texfile", benchTexfile, "[image] [repeats] - SOIL + glGenerateMipmap против mmap файлов .gtex (rgba8/bc1/bc3/etc2)" },
+	{ "sprites", benchSprites, "[max_count] [frames] - время кадра пакета спрайтов (orphan/persistent) при росте числа экземпляров" },
+	{ "stream", benchStream, "[max_mb] [frames] - пропускная способность потоковой загрузки вершин (orphan/persistent), МБ/с" },
+	{ "vertex", benchVertex, "[vertices] [frames] - отрисовка с вершинами из 8 float (32 байта) против упакованных (16 байт)" },
+	{ "commands", benchCommands, "[max_objects] [frames] - прежний однопоточный путь против записи команд в пуле потоков с сортировкой" },
+	{ "atlas", benchAtlas, "[sprites] [frames] - вызовы отрисовки за кадр: отдельные текстуры против атласа (skyline/maxrects) и текстурного массива" },
+	{ "mesh", benchMesh, "[path.obj|segments] [frames] - разбор OBJ в потоках, ACMR/ATVR и перерисовка до и после оптимизации, индексы u32 против u16" },
+	{ "cull", benchCull, "[max_objects] [frames] - отсечение по пирамиде видимости: перебор сфер (scalar/SSE2/AVX2) против Bvh, один поток и пул" },
+	{ "indirect", benchIndirect, "[max_objects] [frames] - время CPU и кадра: Bvh + CommandQueue против отсечения на GPU и glMultiDrawElementsIndirect" },
+	{ "uniforms", benchUniforms, "[objects] [frames] - данные объекта: glUniform4fv против блока std140 в общем UBO с glBindBufferRange (orphan/persistent)" },
+	{ "variants", benchVariants, "[repeats] - сборка всех вариантов шейдера: по одному через buildProgram против ShaderVariants (KHR_parallel_shader_compile)" },
+	{ "raster", benchRaster, "[sprites] [frames] - одни и те же сцены через OpenGL и программный растеризатор: время кадра и расхождение картинок" },
+	{ "math", benchMath, "[objects] [repeats] - матрицы моделей и проекция * вид: по одной Mat4 против пакетов SoA (scalar/SSE2/AVX2) и GLM, rand() против xoshiro" },
+	{ "texstream", benchTexstream, "[textures] [frames] [budget_mb] - потоковая загрузка уровней мипмапов в пределах бюджета против загрузки цепочек целиком" },
+};
+
+int main(int argc, char ** argv)
+{
+	if (argc >= 2)
+		for (const BenchEntry & bench : benches)
+			if (!strcmp(argv[1], bench.Name))
+				return bench.Run(argc - 1, argv + 1);
+
+	std::cout << "Usage: gl_bench <name> [args]" << std::endl;
+	for (const BenchEntry & bench : benches)
+		std::cout << "  " << bench.Name << " " << bench.Usage << std::endl;
+	return argc >= 2 ? -1 : 0;
+}
@@ -0,0 +1,63 @@
+// Общие части микробенчмарков gl_bench: замер времени и безоконный контекст OpenGL.
+// Каждый бенчмарк - отдельная функция в своём файле bench_*.cpp, список - в bench.cpp.
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "app_window.h"
+
+// Медиана времени выполнения body (в миллисекундах) по repeats повторам
+inline double medianMs(const std::function<void()> & body, int repeats)
+{
+	std::vector<double> times;
+	for (int i = 0; i < repeats; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		body();
+		times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+// Целочисленный аргумент бенчмарка по номеру или значение по умолчанию
+inline int benchArgument(int argc, char ** argv, int index, int fallback)
+{
+	return index < argc ? atoi(argv[index]) : fallback;
+}
+
+// Безоконный контекст для бенчмарков, которым нужен OpenGL
+inline bool createBenchContext(AppWindow & window, int width = 800, int height = 600)
+{
+	AppOptions options;
+	if (!window.Create(options, width, height, "gl_bench"))
+		return false;
+	glViewport(0, 0, width, height);
+	return true;
+}
+
+int benchMipmap(int argc, char ** argv);
+int benchTexfile(int argc, char ** argv);
+int benchSprites(int argc, char ** argv);
+int benchStream(int argc, char ** argv);
+int benchVertex(int argc, char ** argv);
+int benchCommands(int argc, char ** argv);
+int benchAtlas(int argc, char ** argv);
+int benchMesh(int argc, char ** argv);
+int benchCull(int argc, char ** argv);
+int benchIndirect(int argc, char ** argv);
+int benchUniforms(int argc, char ** argv);
+int benchVariants(int argc, char ** argv);
+int benchRaster(int argc, char ** argv);
+int benchMath(int argc, char ** argv);
+int benchTexstream(int argc, char ** argv);
+
+#endif
@@ -0,0 +1,163 @@
+// Спрайты с разными картинками: отдельные текстуры (новый вызов отрисовки на каждую смену
+// текстуры) против атласа (Skyline и MaxRects) и текстурного массива - одним вызовом.
+
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "frame_stats.h"
+#include "shader.h"
+#include "sprite_batch.h"
+#include "texture_atlas.h"
+
+int benchAtlas(int argc, char ** argv)
+{
+	int count = benchArgument(argc, argv, 1, 4096);
+	int frames = benchArgument(argc, argv, 2, 30);
+	const int imageCount = 32;
+
+	AppWindow window;
+	if (!createBenchContext(window))
+		return -1;
+	GLuint program = buildProgram(spriteVertexShaderSource, spriteFragmentShaderSource);
+	GLuint arrayProgram = buildProgram(spriteVertexShaderSource, spriteArrayFragmentShaderSource);
+	if (!program || !arrayProgram)
+		return -1;
+
+	// Картинки разных размеров (16..128 пикселей) с узором своего цвета
+	std::vector<std::vector<unsigned char>> pixels(imageCount);
+	std::vector<AtlasImage> images;
+	for (int i = 0; i < imageCount; i++)
+	{
+		int width = 16 << (i % 4), height = 16 << ((i / 4) % 4);
+		pixels[i].resize((size_t)width * height * 4);
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+			{
+				unsigned char * pixel = pixels[i].data() + ((size_t)y * width + x) * 4;
+				bool check = ((x / 8) ^ (y / 8)) & 1;
+				pixel[0] = (unsigned char)(i * 37 + (check ? 64 : 0));
+				pixel[1] = (unsigned char)(i * 91);
+				pixel[2] = (unsigned char)(255 - i * 7);
+				pixel[3] = 255;
+			}
+		images.push_back({ "image" + std::to_string(i), width, height, pixels[i].data() });
+	}
+
+	// Картинка спрайта зависит от номера так, что соседние спрайты почти всегда разные
+	std::vector<int> spriteImages(count);
+	for (int i = 0; i < count; i++)
+		spriteImages[i] = (int)(((unsigned int)i * 2654435761u >> 16) % imageCount);
+
+	SpriteBatch batch;
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "atlas sprites=" << count << " images=" << imageCount << " frames=" << frames << std::endl;
+	auto run = [&](const char * label, GLuint spriteProgram, const std::function<void(float)> & frame) {
+		if (!batch.Create(spriteProgram, count, BufferStreaming::Orphan))
+			return false;
+		FrameStats stats;
+		stats.WarmupFrames = 3;
+		stats.Reserve(frames);
+		long long draws = batch.DrawCalls;
+		for (int i = 0; i < stats.WarmupFrames + frames; i++)
+		{
+			if (i == stats.WarmupFrames)
+				draws = batch.DrawCalls;
+			stats.BeginFrame();
+			glClear(GL_COLOR_BUFFER_BIT);
+			frame(i * 0.01f);
+			stats.CountDraw(0);
+			window.SwapBuffers();
+			stats.EndFrame();
+		}
+		std::cout << "atlas path=" << label << " draws_per_frame=" << (double)(batch.DrawCalls - draws) / frames
+				  << " median_ms=" << stats.Percentile(0.5) << " p99_ms=" << stats.Percentile(0.99) << std::endl;
+		batch.Destroy();
+		return true;
+	};
+
+	int columns = (int)ceilf(sqrtf((float)count));
+	float cell = 2.0f / columns;
+	auto position = [&](int i, float & x, float & y) {
+		x = -1.0f + cell * (i % columns + 0.5f);
+		y = -1.0f + cell * (i / columns + 0.5f);
+	};
+	const GLfloat fullRect[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+
+	// До: текстура на картинку, смена текстуры прерывает пакет
+	std::vector<GLuint> textures(imageCount);
+	glGenTextures(imageCount, textures.data());
+	for (int i = 0; i < imageCount; i++)
+	{
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, images[i].Width, images[i].Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, images[i].Rgba);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	}
+	glActiveTexture(GL_TEXTURE0);
+	if (!run("separate", program, [&](float time) {
+		int bound = -1;
+		for (int i = 0; i < count; i++)
+		{
+			if (spriteImages[i] != bound)
+			{
+				batch.Flush(0);
+				bound = spriteImages[i];
+				glBindTexture(GL_TEXTURE_2D, textures[bound]);
+			}
+			float x, y;
+			position(i, x, y);
+			batch.Add(x, y, cell * 0.8f, cell * 0.8f, time, fullRect);
+		}
+		batch.Flush(0);
+	}))
+		return -1;
+	glDeleteTextures(imageCount, textures.data());
+
+	// После: атлас, картинка спрайта - прямоугольник UV из таблицы
+	const AtlasPacking packings[] = { AtlasPacking::Skyline, AtlasPacking::MaxRects };
+	for (AtlasPacking packing : packings)
+	{
+		TextureAtlas atlas;
+		double packMs = medianMs([&] { atlas.Build(images, 4096, packing); }, 5);
+		std::cout << "atlas packing=" << atlasPackingName(packing) << " size=" << atlas.Width << "x" << atlas.Height
+				  << " occupancy=" << atlas.Occupancy << " build_ms=" << packMs << std::endl;
+		GLuint texture = atlas.Upload(true);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		std::string label = std::string("atlas_") + atlasPackingName(packing);
+		bool ok = run(label.c_str(), program, [&](float time) {
+			for (int i = 0; i < count; i++)
+			{
+				float x, y;
+				position(i, x, y);
+				batch.Add(x, y, cell * 0.8f, cell * 0.8f, time, atlas.Entries[spriteImages[i]].UvRect);
+			}
+			batch.Flush(0);
+		});
+		glDeleteTextures(1, &texture);
+		if (!ok)
+			return -1;
+	}
+
+	// После: текстурный массив, картинка спрайта - номер слоя
+	GLuint array = buildTextureArray(images, 64, 64, true);
+	if (!array)
+		return -1;
+	glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+	bool ok = run("array", arrayProgram, [&](float time) {
+		for (int i = 0; i < count; i++)
+		{
+			float x, y;
+			position(i, x, y);
+			batch.Add(x, y, cell * 0.8f, cell * 0.8f, time, fullRect, (float)spriteImages[i]);
+		}
+		batch.Flush(0);
+	});
+	glDeleteTextures(1, &array);
+	if (!ok)
+		return -1;
+
+	glDeleteProgram(program);
+	glDeleteProgram(arrayProgram);
+	window.Destroy();
+	return 0;
+}
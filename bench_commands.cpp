@@ -0,0 +1,133 @@
+// Запись команд в нескольких потоках: время кадра сцены из N объектов при прежнем пути
+// (расчёт и вызовы OpenGL по порядку на одном потоке) и при записи в CommandQueue пулом
+// из 1, 2, 4 ... потоков с сортировкой по ключу и воспроизведением через GlState.
+
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "scene_objects.h"
+#include "shader.h"
+#include "vertex_layout.h"
+
+// Второй вариант программы объектов: другой фрагментный шейдер, чтобы смен программы было больше
+static const GLchar * objectTintFragmentShaderSource = "#version 330 core\n"
+	"in vec2 TexCoord;\n"
+	"out vec4 color;\n"
+	"uniform sampler2D objectTexture;\n"
+	"void main()\n"
+	"{\n"
+	"color = texture(objectTexture, TexCoord) * vec4(1.0, 0.8, 0.6, 1.0);\n"
+	"}\n\0";
+
+int benchCommands(int argc, char ** argv)
+{
+	int maxObjects = benchArgument(argc, argv, 1, 65536);
+	int frames = benchArgument(argc, argv, 2, 15);
+
+	AppWindow window;
+	if (!createBenchContext(window))
+		return -1;
+	std::vector<GLuint> programs = {
+		buildProgram(objectVertexShaderSource, objectFragmentShaderSource),
+		buildProgram(objectVertexShaderSource, objectTintFragmentShaderSource)
+	};
+	std::vector<GLint> locations;
+	for (GLuint program : programs)
+	{
+		if (!program)
+			return -1;
+		locations.push_back(glGetUniformLocation(program, "transform"));
+	}
+
+	// Четыре текстуры 1x1 разных цветов
+	std::vector<GLuint> textures(4);
+	glGenTextures(4, textures.data());
+	for (int i = 0; i < 4; i++)
+	{
+		const unsigned char texel[4] = { (unsigned char)(i * 80), (unsigned char)(255 - i * 60), 128, 255 };
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	}
+
+	// Два VAO с одним и тем же четырёхугольником
+	const Fp32Vertex quad[] = {
+		{ { 0.5f, 0.5f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } },
+		{ { 0.5f, -0.5f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 0.0f } },
+		{ { -0.5f, -0.5f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f } },
+		{ { -0.5f, 0.5f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 1.0f } }
+	};
+	const GLuint indices[] = { 0, 1, 3, 1, 2, 3 };
+	std::vector<GLuint> vertexArrays(2);
+	GLuint buffers[2];
+	glGenVertexArrays(2, vertexArrays.data());
+	glGenBuffers(2, buffers);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+	for (GLuint vertexArray : vertexArrays)
+	{
+		glBindVertexArray(vertexArray);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+		Fp32VertexLayout::Apply();
+	}
+	glBindVertexArray(0);
+
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned> threadCounts;
+	for (unsigned threads = 1; threads < cores; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(cores);
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "commands max_objects=" << maxObjects << " frames=" << frames << " cores=" << cores << std::endl;
+	for (int count = 1024; count <= maxObjects; count *= 4)
+	{
+		SceneObjectPool objectPool;
+		SceneObjectList objects = makeSceneObjects(objectPool, count, programs, locations, textures, vertexArrays, 6);
+		float time = 0.0f;
+
+		double directMs = medianMs([&] {
+			glClear(GL_COLOR_BUFFER_BIT);
+			drawObjectsDirect(objects, time += 0.016f);
+			glFinish();
+		}, frames);
+		std::cout << "commands objects=" << count << " path=direct ms=" << directMs << std::endl;
+
+		for (unsigned threads : threadCounts)
+		{
+			ThreadPool pool(threads);
+			CommandQueue queue(threads);
+			GlState state;
+			auto frame = [&] {
+				state.BeginFrame();
+				glClear(GL_COLOR_BUFFER_BIT);
+				queue.Record(&pool, objects.size(), [&](CommandList & list, size_t begin, size_t end) {
+					recordObjects(list, objects, begin, end, time);
+				});
+				queue.Replay(state);
+				glFinish();
+				time += 0.016f;
+			};
+			// Первый кадр заполняет арены
+			frame();
+			double ms = medianMs(frame, frames);
+			long long issued = 0;
+			for (int call = 0; call < GlState::CallCount; call++)
+				issued += state.FrameIssued[call];
+			std::cout << "commands objects=" << count << " path=queue threads=" << threads << " ms=" << ms
+					  << " speedup=" << directMs / ms << " record_ms=" << queue.RecordMs << " sort_ms=" << queue.SortMs
+					  << " replay_ms=" << queue.ReplayMs << " state_calls=" << issued << std::endl;
+		}
+		destroySceneObjects(objectPool, objects);
+	}
+
+	glDeleteVertexArrays(2, vertexArrays.data());
+	glDeleteBuffers(2, buffers);
+	glDeleteTextures(4, textures.data());
+	for (GLuint program : programs)
+		glDeleteProgram(program);
+	window.Destroy();
+	return 0;
+}
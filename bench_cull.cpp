@@ -0,0 +1,86 @@
+// Отсечение по пирамиде видимости: время на кадр при росте сцены для перебора всех сфер
+// (scalar/SSE2/AVX2, один поток и пул) и для обхода Bvh (один поток и пул). Сцена -
+// сферы, равномерно разбросанные по кубу, камера в центре поворачивается от кадра к кадру.
+// OpenGL не нужен.
+
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "scene_culling.h"
+
+int benchCull(int argc, char ** argv)
+{
+	int maxObjects = benchArgument(argc, argv, 1, 1048576);
+	int frames = benchArgument(argc, argv, 2, 30);
+
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	ThreadPool pool(cores);
+	SimdLevel best = detectSimdLevel();
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "cull max_objects=" << maxObjects << " frames=" << frames << " cores=" << cores
+			  << " simd=" << simdLevelName(best) << std::endl;
+
+	for (int count = 16384; count <= maxObjects; count *= 4)
+	{
+		// Плотность сцены постоянна: куб растёт вместе с числом объектов
+		float side = 4.0f * cbrtf((float)count);
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> position(-0.5f * side, 0.5f * side), radius(0.2f, 1.0f);
+		SceneBounds bounds;
+		bounds.Reserve(count);
+		for (int i = 0; i < count; i++)
+		{
+			float x = position(random), y = position(random), z = position(random);
+			bounds.AddSphere(x, y, z, radius(random));
+		}
+
+		auto frustumAt = [&](int frame) {
+			float angle = frame * 0.2f;
+			const float eye[3] = { 0.0f, 0.0f, 0.0f }, up[3] = { 0.0f, 1.0f, 0.0f };
+			const float forward[3] = { sinf(angle), 0.1f, cosf(angle) };
+			return Frustum::Perspective(eye, forward, up, 1.0472f, 16.0f / 9.0f, 0.1f, side * 0.5f);
+		};
+
+		struct Path
+		{
+			const char * Name;
+			CullMode Mode;
+			SimdLevel Simd;
+			bool Parallel;
+		};
+		const Path paths[] = {
+			{ "brute", CullMode::Brute, SimdLevel::Scalar, false },
+			{ "brute", CullMode::Brute, SimdLevel::SSE2, false },
+			{ "brute", CullMode::Brute, SimdLevel::AVX2, false },
+			{ "brute", CullMode::Brute, best, true },
+			{ "bvh", CullMode::Bvh, best, false },
+			{ "bvh", CullMode::Bvh, best, true }
+		};
+		long long reference = -1;
+		for (const Path & path : paths)
+		{
+			if (path.Simd > best)
+				continue;
+			SceneCuller culler;
+			culler.Mode = path.Mode;
+			culler.Simd = path.Simd;
+			culler.Build(bounds);
+			std::vector<uint32_t> visible;
+			int frame = 0;
+			double ms = medianMs([&] { culler.Cull(frustumAt(frame++), path.Parallel ? &pool : nullptr, visible); }, frames);
+
+			// Все пути должны находить одни и те же объекты
+			long long found = culler.TotalVisible;
+			if (reference < 0)
+				reference = found;
+			std::cout << "cull objects=" << count << " path=" << path.Name << " simd=" << simdLevelName(path.Simd)
+					  << " threads=" << (path.Parallel ? cores : 1) << " ms=" << ms
+					  << " visible=" << (double)found / frames << " culled=" << count - (double)found / frames
+					  << " build_ms=" << culler.BuildMs << (found != reference ? " MISMATCH" : "") << std::endl;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,163 @@
+// GPU-driven отрисовка: время CPU на кадр (до возврата из вызовов OpenGL) и полное время
+// кадра (с glFinish) при росте числа объектов для пути через CPU (Bvh + CommandQueue) и
+// для вычислительного отсечения с glMultiDrawElementsIndirect - с буфером числа команд
+// и без него. Число видимых объектов с GPU сверяется с точным расчётом на CPU.
+
+#include <cmath>
+#include <vector>
+
+#include "bench.h"
+#include "gpu_driven.h"
+#include "scene_objects.h"
+#include "shader.h"
+#include "vertex_layout.h"
+
+int benchIndirect(int argc, char ** argv)
+{
+	int maxObjects = benchArgument(argc, argv, 1, 262144);
+	int frames = benchArgument(argc, argv, 2, 15);
+
+	AppWindow window;
+	if (!createBenchContext(window))
+		return -1;
+	if (!GpuDrivenScene::Supported())
+	{
+		std::cout << "indirect skipped=not_supported" << std::endl;
+		window.Destroy();
+		return 0;
+	}
+	GLuint program = buildProgram(objectVertexShaderSource, objectFragmentShaderSource);
+	if (!program)
+		return -1;
+	GLint location = glGetUniformLocation(program, "transform");
+
+	std::vector<GLuint> textures(2);
+	glGenTextures(2, textures.data());
+	for (int i = 0; i < 2; i++)
+	{
+		const unsigned char texel[4] = { (unsigned char)(i * 200), 128, (unsigned char)(255 - i * 200), 255 };
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	}
+	const Fp32Vertex quad[] = {
+		{ { 0.5f, 0.5f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } },
+		{ { 0.5f, -0.5f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 0.0f } },
+		{ { -0.5f, -0.5f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f } },
+		{ { -0.5f, 0.5f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 1.0f } }
+	};
+	const GLuint indices[] = { 0, 1, 3, 1, 2, 3 };
+	GLuint vertexArray, buffers[2];
+	glGenVertexArrays(1, &vertexArray);
+	glGenBuffers(2, buffers);
+	glBindVertexArray(vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	Fp32VertexLayout::Apply();
+	glBindVertexArray(0);
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "indirect max_objects=" << maxObjects << " frames=" << frames
+			  << " count_buffer=" << (GpuDrivenScene::CountSupported() ? "yes" : "no") << std::endl;
+	for (int count = 4096; count <= maxObjects; count *= 4)
+	{
+		// Плотность постоянна: на экран приходится около 1024 центров объектов
+		float worldSize = 2.0f * sqrtf(count / 1024.0f);
+		SceneObjectPool objectPool;
+		SceneObjectList objects = makeSceneObjects(objectPool, count, { program }, { location }, textures, { vertexArray }, 6);
+		scatterSceneObjects(objects, worldSize);
+		GlState state;
+		float time = 1.0f;
+
+		// Путь через CPU: Bvh по неподвижным границам, запись и воспроизведение команд
+		SceneCuller culler;
+		culler.Build(sceneObjectBounds(objects));
+		CommandQueue queue(1);
+		std::vector<uint32_t> visible;
+		double cpuMs = 0.0;
+		auto cpuFrame = [&] {
+			auto start = std::chrono::steady_clock::now();
+			state.BeginFrame();
+			float cameraX, cameraY;
+			sceneCamera(time, worldSize, cameraX, cameraY);
+			culler.Cull(Frustum::Box(cameraX - 1.0f, cameraX + 1.0f, cameraY - 1.0f, cameraY + 1.0f, -1.0f, 1.0f), nullptr, visible);
+			queue.Record(nullptr, visible.size(), [&](CommandList & list, size_t begin, size_t end) {
+				recordVisibleObjects(list, objects, visible, begin, end, time, cameraX, cameraY);
+			});
+			queue.Replay(state);
+			cpuMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		};
+		glClear(GL_COLOR_BUFFER_BIT);
+		cpuFrame();
+		glFinish();
+		cpuMs = 0.0;
+		double ms = medianMs([&] {
+			glClear(GL_COLOR_BUFFER_BIT);
+			cpuFrame();
+			glFinish();
+			time += 0.016f;
+		}, frames);
+		std::cout << "indirect objects=" << count << " path=cpu cpu_ms=" << cpuMs / frames << " frame_ms=" << ms
+				  << " draws=" << visible.size() << std::endl;
+
+		// Точное число видимых объектов в момент time для сверки с GPU
+		float cameraX, cameraY;
+		sceneCamera(time, worldSize, cameraX, cameraY);
+		size_t exact = 0;
+		for (const SceneObject * object : objects)
+		{
+			GLfloat transform[4];
+			animateObject(*object, time, transform);
+			float reach = 1.0f + object->Size * 0.71f;
+			if (fabsf(transform[0] - cameraX) <= reach && fabsf(transform[1] - cameraY) <= reach)
+				exact++;
+		}
+
+		for (int compact = 1; compact >= 0; compact--)
+		{
+			if (compact && !GpuDrivenScene::CountSupported())
+				continue;
+			GpuDrivenScene scene;
+			if (!scene.Create(objects, textures))
+				return -1;
+			scene.Compact = compact == 1;
+			float gpuTime = 1.0f;
+			auto gpuFrame = [&] {
+				state.BeginFrame();
+				float x, y;
+				sceneCamera(gpuTime, worldSize, x, y);
+				scene.Draw(state, gpuTime, x, y);
+			};
+			glClear(GL_COLOR_BUFFER_BIT);
+			gpuFrame();
+			glFinish();
+			scene.TotalCpuMs = 0.0;
+			scene.Frames = 0;
+			ms = medianMs([&] {
+				glClear(GL_COLOR_BUFFER_BIT);
+				gpuFrame();
+				glFinish();
+				gpuTime += 0.016f;
+			}, frames);
+
+			// Кадр в тот же момент, что и точный расчёт
+			gpuTime = time;
+			gpuFrame();
+			GLuint found = scene.VisibleCount();
+			std::cout << "indirect objects=" << count << " path=gpu count_buffer=" << (compact ? "on" : "off")
+					  << " cpu_ms=" << scene.TotalCpuMs / scene.Frames << " frame_ms=" << ms
+					  << " visible=" << found << " exact=" << exact << (found != exact ? " MISMATCH" : "") << std::endl;
+			scene.Destroy();
+		}
+		destroySceneObjects(objectPool, objects);
+	}
+
+	glDeleteVertexArrays(1, &vertexArray);
+	glDeleteBuffers(2, buffers);
+	glDeleteTextures(2, textures.data());
+	glDeleteProgram(program);
+	window.Destroy();
+	return 0;
+}
@@ -0,0 +1,189 @@
+// Пакетные преобразования vecmath.h и генераторы xoshiro.h. Сборка матриц моделей из
+// положения, поворота и масштаба (compose), умножение готовых матриц на общую (проекция *
+// вид, multiply) и то и другое за один проход (compose_mvp): по одной матрице Mat4 за
+// вызов против пакета структурой массивов (scalar/SSE2/AVX2) и против GLM, если она
+// установлена. Случайные числа: rand() против Xoshiro256 и Xoshiro128x8.
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "vecmath.h"
+#include "xoshiro.h"
+
+#if __has_include(<glm/glm.hpp>)
+#define BENCH_MATH_GLM 1
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#endif
+
+// Наибольшее расхождение матриц пакета с эталоном
+static float maxMatrixError(const MatrixArrays & matrices, const std::vector<Mat4> & reference)
+{
+	float error = 0.0f;
+	for (size_t i = 0; i < reference.size(); i++)
+		for (int k = 0; k < 16; k++)
+			error = std::max(error, fabsf(matrices.Element(k)[i] - reference[i].M[k]));
+	return error;
+}
+
+int benchMath(int argc, char ** argv)
+{
+	int count = benchArgument(argc, argv, 1, 100000);
+	int repeats = benchArgument(argc, argv, 2, 21);
+	if (count <= 0)
+		return -1;
+	size_t objects = (size_t)count;
+
+	// Случайные объекты: положение в кубе, поворот вокруг случайной оси, масштаб 0.5..2
+	Xoshiro128x8 random(5);
+	std::vector<float> numbers(objects * 8);
+	random.Fill(numbers.data(), numbers.size(), -1.0f, 1.0f);
+	TransformArrays transforms;
+	transforms.Resize(objects);
+	std::vector<Vec3> positions(objects), scales(objects);
+	std::vector<Quat> rotations(objects);
+	for (size_t i = 0; i < objects; i++)
+	{
+		const float * n = &numbers[i * 8];
+		positions[i] = { n[0] * 50.0f, n[1] * 50.0f, n[2] * 50.0f };
+		rotations[i] = quatAxisAngle({ n[3], n[4], n[5] + 1.5f }, n[6] * 3.14159265f);
+		float scale = 1.25f + n[7] * 0.75f;
+		scales[i] = { scale, scale, scale };
+		transforms.Set(i, positions[i], rotations[i], scales[i]);
+	}
+	Mat4 viewProjection = mat4Perspective(1.0471976f, 800.0f / 600.0f, 0.1f, 200.0f) *
+						  mat4LookAt({ 0.0f, 20.0f, 90.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+
+	SimdLevel best = detectSimdLevel();
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "math objects=" << objects << " repeats=" << repeats << " simd=" << simdLevelName(best)
+#ifdef BENCH_MATH_GLM
+			  << " glm=1" << std::endl;
+#else
+			  << " glm=0" << std::endl;
+#endif
+
+	auto report = [&](const char * stage, const char * path, double ms, float error) {
+		std::cout << "math stage=" << stage << " path=" << path << " ms=" << ms
+				  << " ns_per_matrix=" << ms * 1e6 / objects << " max_error=" << std::setprecision(6) << error
+				  << std::setprecision(3) << std::endl;
+	};
+
+	// Эталон и путь "по одной матрице": Mat4 подряд в памяти
+	std::vector<Mat4> models(objects), combined(objects);
+	double ms = medianMs([&] {
+		for (size_t i = 0; i < objects; i++)
+			models[i] = mat4Compose(positions[i], rotations[i], scales[i]);
+	}, repeats);
+	report("compose", "mat4", ms, 0.0f);
+	ms = medianMs([&] {
+		for (size_t i = 0; i < objects; i++)
+			combined[i] = viewProjection * models[i];
+	}, repeats);
+	report("multiply", "mat4", ms, 0.0f);
+	std::vector<Mat4> fused(objects);
+	ms = medianMs([&] {
+		for (size_t i = 0; i < objects; i++)
+			fused[i] = viewProjection * mat4Compose(positions[i], rotations[i], scales[i]);
+	}, repeats);
+	report("compose_mvp", "mat4", ms, 0.0f);
+
+#ifdef BENCH_MATH_GLM
+	{
+		std::vector<glm::mat4> glmModels(objects), glmCombined(objects);
+		glm::mat4 glmViewProjection;
+		memcpy(&glmViewProjection, viewProjection.M, sizeof(viewProjection.M));
+		ms = medianMs([&] {
+			for (size_t i = 0; i < objects; i++)
+			{
+				glm::quat rotation(rotations[i].W, rotations[i].X, rotations[i].Y, rotations[i].Z);
+				glmModels[i] = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(positions[i].X, positions[i].Y, positions[i].Z)) *
+										  glm::mat4_cast(rotation), glm::vec3(scales[i].X, scales[i].Y, scales[i].Z));
+			}
+		}, repeats);
+		float error = 0.0f;
+		for (size_t i = 0; i < objects; i++)
+			for (int k = 0; k < 16; k++)
+				error = std::max(error, fabsf(glmModels[i][k / 4][k % 4] - models[i].M[k]));
+		report("compose", "glm", ms, error);
+		ms = medianMs([&] {
+			for (size_t i = 0; i < objects; i++)
+				glmCombined[i] = glmViewProjection * glmModels[i];
+		}, repeats);
+		error = 0.0f;
+		for (size_t i = 0; i < objects; i++)
+			for (int k = 0; k < 16; k++)
+				error = std::max(error, fabsf(glmCombined[i][k / 4][k % 4] - combined[i].M[k]));
+		report("multiply", "glm", ms, error);
+		ms = medianMs([&] {
+			for (size_t i = 0; i < objects; i++)
+			{
+				glm::quat rotation(rotations[i].W, rotations[i].X, rotations[i].Y, rotations[i].Z);
+				glmCombined[i] = glmViewProjection *
+								 glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(positions[i].X, positions[i].Y, positions[i].Z)) *
+											glm::mat4_cast(rotation), glm::vec3(scales[i].X, scales[i].Y, scales[i].Z));
+			}
+		}, repeats);
+		error = 0.0f;
+		for (size_t i = 0; i < objects; i++)
+			for (int k = 0; k < 16; k++)
+				error = std::max(error, fabsf(glmCombined[i][k / 4][k % 4] - combined[i].M[k]));
+		report("compose_mvp", "glm", ms, error);
+	}
+#endif
+
+	// Пакеты: расхождение с эталоном - только от порядка операций (и FMA в AVX2)
+	MatrixArrays matrices, results;
+	matrices.Resize(objects);
+	results.Resize(objects);
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 };
+	for (SimdLevel simd : levels)
+	{
+		if (simd > best)
+			continue;
+		ms = medianMs([&] { composeTransforms(transforms, nullptr, 0, objects, matrices, simd); }, repeats);
+		report("compose", simdLevelName(simd), ms, maxMatrixError(matrices, models));
+		ms = medianMs([&] { multiplyTransforms(viewProjection, matrices, 0, objects, results, simd); }, repeats);
+		report("multiply", simdLevelName(simd), ms, maxMatrixError(results, combined));
+		ms = medianMs([&] { composeTransforms(transforms, &viewProjection, 0, objects, results, simd); }, repeats);
+		report("compose_mvp", simdLevelName(simd), ms, maxMatrixError(results, combined));
+	}
+
+	// Случайные числа: по 16 на объект, как на положение, поворот и масштаб с запасом
+	size_t samples = objects * 16;
+	std::vector<float> values(samples);
+	auto reportRandom = [&](const char * path, double ms) {
+		double sum = 0.0;
+		for (float value : values)
+			sum += value;
+		std::cout << "math stage=random path=" << path << " ms=" << ms << " ns_per_number=" << ms * 1e6 / samples
+				  << " mean=" << sum / samples << std::endl;
+	};
+	srand(1);
+	ms = medianMs([&] {
+		for (float & value : values)
+			value = (float)rand() / RAND_MAX;
+	}, repeats);
+	reportRandom("rand", ms);
+	Xoshiro256 scalar(1);
+	ms = medianMs([&] {
+		for (float & value : values)
+			value = scalar.NextFloat();
+	}, repeats);
+	reportRandom("xoshiro256", ms);
+	for (SimdLevel simd : levels)
+	{
+		if (simd > best)
+			continue;
+		Xoshiro128x8 lanes(1);
+		ms = medianMs([&] { lanes.Fill(values.data(), samples, 0.0f, 1.0f, simd); }, repeats);
+		std::string path = std::string("xoshiro128x8_") + simdLevelName(simd);
+		reportRandom(path.c_str(), ms);
+	}
+	return 0;
+}
@@ -0,0 +1,224 @@
+// Загрузка и оптимизация сеток: время разбора OBJ на 1, 2, 4 ... потоках, ACMR/ATVR в
+// порядке файла, в случайном порядке, после Tipsify и после Tipsify с перестановкой
+// кластеров, перерисовка (фрагментов на закрытый пиксель по GL_SAMPLES_PASSED) и время
+// отрисовки с индексами GL_UNSIGNED_INT против GL_UNSIGNED_SHORT.
+// Без файла сетка - тор из segments x segments/2 четырёхугольников, записанный как OBJ.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "mesh_loader.h"
+#include "shader.h"
+
+// Поворот вокруг осей y и x с глубиной: сетка перекрывает сама себя
+static const GLchar * meshBenchVertexShaderSource = "#version 330 core\n"
+	"layout (location = 0) in vec3 position;\n"
+	"layout (location = 1) in vec3 color;\n"
+	"out vec3 ourColor;\n"
+	"uniform float angle;\n"
+	"void main()\n"
+	"{\n"
+	"float c = cos(angle), s = sin(angle);\n"
+	"vec3 p = vec3(c * position.x + s * position.z, position.y, -s * position.x + c * position.z);\n"
+	"p = vec3(p.x, 0.8 * p.y - 0.6 * p.z, 0.6 * p.y + 0.8 * p.z);\n"
+	"gl_Position = vec4(p.xy * 0.8, p.z * 0.5, 1.0);\n"
+	"ourColor = color;\n"
+	"}\0";
+
+static const GLchar * meshBenchFragmentShaderSource = "#version 330 core\n"
+	"in vec3 ourColor;\n"
+	"out vec4 color;\n"
+	"void main()\n"
+	"{\n"
+	"color = vec4(ourColor, 1.0);\n"
+	"}\n\0";
+
+// Тор в формате OBJ: общие вершины у соседних граней, чтобы было что склеивать
+static std::string torusObj(int segments)
+{
+	int rings = std::max(3, segments / 2);
+	std::ostringstream out;
+	char line[256];
+	for (int i = 0; i < segments; i++)
+		for (int j = 0; j < rings; j++)
+		{
+			float u = 6.2831853f * i / segments, v = 6.2831853f * j / rings;
+			float r = 1.0f + 0.4f * cosf(v);
+			snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvn %.4f %.4f %.4f\nvt %.5f %.5f\n",
+					 r * cosf(u), 0.4f * sinf(v), r * sinf(u), cosf(v) * cosf(u), sinf(v), cosf(v) * sinf(u),
+					 (float)i / segments, (float)j / rings);
+			out << line;
+		}
+	for (int i = 0; i < segments; i++)
+		for (int j = 0; j < rings; j++)
+		{
+			int a = i * rings + j + 1, b = ((i + 1) % segments) * rings + j + 1;
+			int c = ((i + 1) % segments) * rings + (j + 1) % rings + 1, d = i * rings + (j + 1) % rings + 1;
+			snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, c, c, c, d, d, d);
+			out << line;
+		}
+	return out.str();
+}
+
+int benchMesh(int argc, char ** argv)
+{
+	std::string path = argc > 1 ? argv[1] : "";
+	bool generated = path.empty() || path.find_first_not_of("0123456789") == std::string::npos;
+	int frames = benchArgument(argc, argv, 2, 15);
+
+	std::string text;
+	if (generated)
+		text = torusObj(benchArgument(argc, argv, 1, 256));
+	else
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+		{
+			std::cout << "ERROR::BENCH::FILE_NOT_FOUND " << path << std::endl;
+			return -1;
+		}
+		std::stringstream stream;
+		stream << file.rdbuf();
+		text = stream.str();
+	}
+
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "mesh source=" << (generated ? "torus" : path) << " bytes=" << text.size() << " cores=" << cores << std::endl;
+
+	// Разбор и склейка вершин при разном числе потоков
+	MeshOptions options;
+	MeshData mesh;
+	MeshLoadStats stats;
+	for (unsigned threads = 1; threads <= std::max(4u, cores); threads *= 2)
+	{
+		options.ParseThreads = threads;
+		double parseMs = 0.0, dedupMs = 0.0;
+		double ms = medianMs([&] {
+			parseObj(text, options, mesh, stats);
+			parseMs = stats.ParseMs;
+			dedupMs = stats.DedupMs;
+		}, 5);
+		std::cout << "mesh parse threads=" << stats.ParseThreads << " ms=" << ms << " parse_ms=" << parseMs
+				  << " dedup_ms=" << dedupMs << " mb_per_s=" << text.size() / 1048576.0 / (ms / 1000.0) << std::endl;
+	}
+	if (mesh.Indices.empty())
+		return -1;
+	normalizeMesh(mesh);
+	std::cout << "mesh triangles=" << stats.Triangles << " corners=" << stats.Corners << " vertices=" << stats.Vertices << std::endl;
+
+	// Порядки индексов: файл, случайный, Tipsify, Tipsify + кластеры ради перерисовки
+	struct Order
+	{
+		const char * Name;
+		MeshData Mesh;
+	};
+	std::vector<Order> orders(4, { nullptr, mesh });
+	orders[0].Name = "file";
+	orders[1].Name = "shuffled";
+	{
+		size_t triangles = mesh.Indices.size() / 3;
+		std::vector<uint32_t> permutation(triangles);
+		for (size_t i = 0; i < triangles; i++)
+			permutation[i] = (uint32_t)i;
+		std::shuffle(permutation.begin(), permutation.end(), std::mt19937(12345));
+		for (size_t i = 0; i < triangles; i++)
+			for (int k = 0; k < 3; k++)
+				orders[1].Mesh.Indices[i * 3 + k] = mesh.Indices[permutation[i] * 3 + k];
+	}
+	orders[2].Name = "tipsify";
+	orders[3].Name = "tipsify_overdraw";
+	for (int i = 2; i < 4; i++)
+	{
+		options.OptimizeOverdraw = i == 3;
+		double ms = medianMs([&] {
+			orders[i].Mesh = orders[1].Mesh;
+			optimizeMesh(orders[i].Mesh, options, stats);
+		}, 3);
+		std::cout << "mesh optimize=" << orders[i].Name << " ms=" << ms << std::endl;
+	}
+
+	AppWindow window;
+	if (!createBenchContext(window))
+		return -1;
+	GLuint program = buildProgram(meshBenchVertexShaderSource, meshBenchFragmentShaderSource);
+	if (!program)
+		return -1;
+	glUseProgram(program);
+	GLint angleLocation = glGetUniformLocation(program, "angle");
+	glEnable(GL_DEPTH_TEST);
+	GLuint query;
+	glGenQueries(1, &query);
+	auto samples = [&](const GpuMesh & gpu) {
+		GLuint passed = 0;
+		glBeginQuery(GL_SAMPLES_PASSED, query);
+		gpu.Draw(nullptr);
+		glEndQuery(GL_SAMPLES_PASSED);
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT, &passed);
+		return (double)passed;
+	};
+
+	for (Order & order : orders)
+	{
+		VertexCacheStats cache16 = measureVertexCache(order.Mesh.Indices, order.Mesh.Vertices.size(), 16);
+		VertexCacheStats cache32 = measureVertexCache(order.Mesh.Indices, order.Mesh.Vertices.size(), 32);
+
+		// Перерисовка: фрагменты, прошедшие тест глубины, на пиксель, видимый в итоге.
+		// Видимые пиксели - второй проход с GL_EQUAL по готовому буферу глубины.
+		GpuMesh gpu;
+		gpu.Upload(order.Mesh, nullptr);
+		double shaded = 0.0, visible = 0.0;
+		for (int view = 0; view < 8; view++)
+		{
+			glUniform1f(angleLocation, view * 0.785398f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glDepthFunc(GL_LESS);
+			shaded += samples(gpu);
+			glDepthFunc(GL_EQUAL);
+			visible += samples(gpu);
+		}
+		glDepthFunc(GL_LESS);
+
+		// Время отрисовки с 32- и 16-битными индексами
+		double drawMs[2] = { 0.0, 0.0 };
+		size_t indexBytes[2] = { 0, 0 };
+		for (int type = 0; type < 2; type++)
+		{
+			if (type == 1 && gpu.IndexType != GL_UNSIGNED_SHORT)
+				break;
+			GpuMesh indexed;
+			indexed.Upload(order.Mesh, nullptr, type == 0);
+			indexBytes[type] = indexed.IndexBytes();
+			float angle = 0.0f;
+			drawMs[type] = medianMs([&] {
+				glUniform1f(angleLocation, angle += 0.1f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				indexed.Draw(nullptr);
+				glFinish();
+			}, frames);
+			indexed.Destroy();
+		}
+		gpu.Destroy();
+
+		std::cout << "mesh order=" << order.Name << " acmr16=" << cache16.Acmr << " atvr16=" << cache16.Atvr
+				  << " acmr32=" << cache32.Acmr << " atvr32=" << cache32.Atvr
+				  << " overdraw=" << (visible > 0.0 ? shaded / visible : 0.0)
+				  << " u32_bytes=" << indexBytes[0] << " u32_ms=" << drawMs[0];
+		if (indexBytes[1])
+			std::cout << " u16_bytes=" << indexBytes[1] << " u16_ms=" << drawMs[1];
+		std::cout << std::endl;
+	}
+
+	glDeleteQueries(1, &query);
+	glDeleteProgram(program);
+	window.Destroy();
+	return 0;
+}
@@ -0,0 +1,102 @@
+// Построение мипмапов: скалярный код, SSE2 и AVX2 на CPU против glGenerateMipmap.
+
+#include <cstdlib>
+#include <cstring>
+
+#include "bench.h"
+#include "mipmap.h"
+#include "texture_loader.h"
+
+int benchMipmap(int argc, char ** argv)
+{
+	int size = benchArgument(argc, argv, 1, 2048);
+	int repeats = benchArgument(argc, argv, 2, 9);
+
+	// Синтетическое RGB изображение: градиент с шумом, чтобы фильтрам было что усреднять
+	std::vector<unsigned char> rgb((size_t)size * size * 3);
+	srand(1);
+	for (int y = 0; y < size; y++)
+		for (int x = 0; x < size; x++)
+			for (int c = 0; c < 3; c++)
+				rgb[((size_t)y * size + x) * 3 + c] = (unsigned char)((x * (c + 1) + y * (3 - c)) / 8 + rand() % 32);
+
+	std::vector<unsigned char> rgba((size_t)size * size * 4);
+	SimdLevel best = detectSimdLevel();
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "mipmap size=" << size << " repeats=" << repeats << " simd=" << simdLevelName(best) << std::endl;
+
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 };
+	for (SimdLevel simd : levels)
+	{
+		if (simd > best)
+			continue;
+		double ms = medianMs([&] { padRgbToRgba(rgb.data(), rgba.data(), (size_t)size * size, simd); }, repeats);
+		std::cout << "mipmap stage=pad_rgb_rgba simd=" << simdLevelName(simd) << " ms=" << ms << std::endl;
+	}
+
+	// Цепочки от скалярной версии служат эталоном для проверки векторных
+	MipChain reference, chain;
+	struct Variant { MipFilter Filter; bool Srgb; const char * Name; };
+	const Variant variants[] = {
+		{ MipFilter::Box, false, "box" },
+		{ MipFilter::Box, true, "box_srgb" },
+		{ MipFilter::Kaiser, false, "kaiser" },
+		{ MipFilter::Kaiser, true, "kaiser_srgb" },
+	};
+	for (const Variant & variant : variants)
+	{
+		for (SimdLevel simd : levels)
+		{
+			if (simd > best)
+				continue;
+			MipOptions options;
+			options.Filter = variant.Filter;
+			options.Srgb = variant.Srgb;
+			options.Simd = simd;
+			MipChain & target = simd == SimdLevel::Scalar ? reference : chain;
+			double ms = medianMs([&] { buildMipChain(rgba.data(), size, size, options, target); }, repeats);
+
+			int maxError = 0;
+			if (simd != SimdLevel::Scalar)
+				for (size_t i = 0; i < chain.Data.size(); i++)
+					maxError = std::max(maxError, abs((int)chain.Data[i] - (int)reference.Data[i]));
+			std::cout << "mipmap stage=chain filter=" << variant.Name << " simd=" << simdLevelName(simd)
+					  << " ms=" << ms << " max_error_vs_scalar=" << maxError << std::endl;
+		}
+	}
+
+	AppWindow window;
+	if (!createBenchContext(window))
+		return -1;
+
+	// glGenerateMipmap: загрузка базового уровня и построение цепочки драйвером.
+	// glFinish нужен, чтобы в замер попала работа драйвера, а не только постановка в очередь.
+	double driverMs = medianMs([&]
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glFinish();
+		glDeleteTextures(1, &texture);
+	}, repeats);
+	std::cout << "mipmap stage=gl_generate_mipmap ms=" << driverMs << std::endl;
+
+	// Готовая цепочка с CPU: только загрузка уровней
+	MipOptions options;
+	buildMipChain(rgba.data(), size, size, options, chain);
+	double uploadMs = medianMs([&]
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		uploadMipChain(chain, chain.Data.data());
+		glFinish();
+		glDeleteTextures(1, &texture);
+	}, repeats);
+	std::cout << "mipmap stage=gl_upload_cpu_chain levels=" << chain.Levels.size() << " ms=" << uploadMs << std::endl;
+
+	window.Destroy();
+	return 0;
+}
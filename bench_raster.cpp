@@ -0,0 +1,172 @@
+// Одни и те же сцены через GlRenderer (здесь это llvmpipe) и SoftRenderer: время кадра
+// (заливка, отрисовка, ожидание конца кадра) и расхождение картинок. Сцены: четырёхугольник
+// hello_window.cpp с двумя текстурами, пакет из многих маленьких четырёхугольников с цветом
+// вершин и текстурой и плоскость в перспективе с повторяющейся текстурой
+// непрямоугольного размера (проверка перспективной интерполяции и GL_REPEAT).
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "image_compare.h"
+#include "soft_raster.h"
+
+struct RasterScene
+{
+	const char * Name;
+	std::vector<RenderVertex> Vertices;
+	std::vector<GLuint> Indices;
+	unsigned Features;
+	// Номера текстур из makeRasterTextures
+	int Textures[2];
+};
+
+// Четырёхугольник из четырёх вершин с индексами 0-1-3, 1-2-3, как в hello_window.cpp
+static void addQuad(RasterScene & scene, const RenderVertex (&corners)[4])
+{
+	GLuint base = (GLuint)scene.Vertices.size();
+	scene.Vertices.insert(scene.Vertices.end(), corners, corners + 4);
+	for (GLuint index : { 0u, 1u, 3u, 1u, 2u, 3u })
+		scene.Indices.push_back(base + index);
+}
+
+static std::vector<RasterScene> makeRasterScenes(int sprites)
+{
+	std::vector<RasterScene> scenes;
+
+	RasterScene quad = { "quad", {}, {}, FeatureTexture | FeatureTwoTextures, { 0, 1 } };
+	addQuad(quad, { { { 0.5f, 0.5f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f }, { 1.0f, 1.0f } },
+					{ { 0.5f, -0.5f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f } },
+					{ { -0.5f, -0.5f, 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f } },
+					{ { -0.5f, 0.5f, 0.0f, 1.0f }, { 1.0f, 1.0f, 0.0f }, { 0.0f, 1.0f } } });
+	scenes.push_back(quad);
+
+	RasterScene batch = { "sprites", {}, {}, FeatureTexture | FeatureVertexColor, { 0, -1 } };
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> position(-1.0f, 1.0f), size(0.01f, 0.08f), color(0.3f, 1.0f);
+	for (int i = 0; i < sprites; i++)
+	{
+		float x = position(random), y = position(random), half = size(random);
+		float r = color(random), g = color(random), b = color(random);
+		// Кусок текстуры со случайным началом и размером по спрайту: тексель крупнее пикселя.
+		// Без мипмапов уменьшенная текстура зависит от ошибок округления в сотых долях
+		// текселя, и сравнивать было бы нечего.
+		float s = position(random), t = position(random), extent = half * 2.0f;
+		addQuad(batch, { { { x + half, y + half, 0.0f, 1.0f }, { r, g, b }, { s + extent, t + extent } },
+						 { { x + half, y - half, 0.0f, 1.0f }, { r, g, b }, { s + extent, t } },
+						 { { x - half, y - half, 0.0f, 1.0f }, { r, g, b }, { s, t } },
+						 { { x - half, y + half, 0.0f, 1.0f }, { r, g, b }, { s, t + extent } } });
+	}
+	scenes.push_back(batch);
+
+	// Пол y = -1 от z = -1 до z = -8 в перспективе с углом обзора 60 градусов: клиповые
+	// координаты считаются прямо здесь, w = -z. Текстура повторяется трижды поперёк и
+	// остаётся увеличенной до дальнего края.
+	RasterScene floor = { "perspective", {}, {}, FeatureTexture, { 2, -1 } };
+	const float focal = 1.7320508f, aspect = 800.0f / 600.0f;
+	auto floorVertex = [&](float x, float z, float s, float t) {
+		RenderVertex vertex = { { x * focal / aspect, -1.0f * focal, 0.0f, -z }, { 1.0f, 1.0f, 1.0f }, { s, t } };
+		return vertex;
+	};
+	addQuad(floor, { floorVertex(6.0f, -1.0f, 1.5f, 0.0f), floorVertex(6.0f, -8.0f, 1.5f, 0.7f),
+					 floorVertex(-6.0f, -8.0f, -1.5f, 0.7f), floorVertex(-6.0f, -1.0f, -1.5f, 0.0f) });
+	scenes.push_back(floor);
+	return scenes;
+}
+
+// Текстуры сцен: две 256x256 (клетка и градиент) и одна 100x60 для повторения
+static void makeRasterTextures(Renderer & renderer)
+{
+	const int sizes[3][2] = { { 256, 256 }, { 256, 256 }, { 100, 60 } };
+	for (int i = 0; i < 3; i++)
+	{
+		int width = sizes[i][0], height = sizes[i][1];
+		std::vector<unsigned char> rgba((size_t)width * height * 4);
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+			{
+				unsigned char * texel = &rgba[((size_t)y * width + x) * 4];
+				bool checker = ((x / 16) ^ (y / 16)) & 1;
+				texel[0] = (unsigned char)(i == 1 ? x : checker ? 230 : 40);
+				texel[1] = (unsigned char)(i == 1 ? y : (x * 255) / width);
+				texel[2] = (unsigned char)(i == 2 ? (y * 255) / height : checker ? 60 : 200);
+				texel[3] = 255;
+			}
+		renderer.CreateTexture(width, height, rgba.data());
+	}
+}
+
+// Время кадра сцены и сам кадр
+static double drawRasterScene(Renderer & renderer, const RasterScene & scene, int frames, std::vector<unsigned char> & pixels)
+{
+	RenderBatch batch;
+	batch.Vertices = scene.Vertices.data();
+	batch.VertexCount = (int)scene.Vertices.size();
+	batch.Indices = scene.Indices.data();
+	batch.IndexCount = (int)scene.Indices.size();
+	batch.Features = scene.Features;
+	batch.Textures[0] = scene.Textures[0];
+	batch.Textures[1] = scene.Textures[1];
+	const GLfloat clearColor[4] = { 0.2f, 0.3f, 0.3f, 1.0f };
+	auto frame = [&] {
+		renderer.Clear(clearColor);
+		renderer.Draw(batch);
+		renderer.Finish();
+	};
+	// Первый кадр - сборка шейдера и загрузка текстур в драйвере
+	frame();
+	double ms = medianMs(frame, frames);
+	renderer.ReadPixels(pixels);
+	return ms;
+}
+
+int benchRaster(int argc, char ** argv)
+{
+	int sprites = benchArgument(argc, argv, 1, 2000);
+	int frames = benchArgument(argc, argv, 2, 20);
+	const int width = 800, height = 600;
+
+	AppWindow window;
+	if (!createBenchContext(window, width, height))
+		return -1;
+	ShaderCache cache("");
+	ShaderVariants variants(cache);
+	if (!variants.Load(ASSET_ROOT "vertex_shader.vs", ASSET_ROOT "fragment_shader.frag"))
+		return -1;
+
+	std::vector<RasterScene> scenes = makeRasterScenes(sprites);
+	GlRenderer gl(variants);
+	SoftRenderer soft;
+	Renderer * renderers[2] = { &gl, &soft };
+	for (Renderer * renderer : renderers)
+	{
+		if (!renderer->Create(width, height))
+			return -1;
+		makeRasterTextures(*renderer);
+	}
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "raster size=" << width << "x" << height << " sprites=" << sprites << " frames=" << frames
+			  << " threads=" << std::max(1u, std::thread::hardware_concurrency()) << std::endl;
+	for (const RasterScene & scene : scenes)
+	{
+		std::vector<unsigned char> glPixels, softPixels;
+		double glMs = drawRasterScene(gl, scene, frames, glPixels);
+		double softMs = drawRasterScene(soft, scene, frames, softPixels);
+		ImageDifference difference = compareImages(softPixels.data(), glPixels.data(), width, height, 8, nullptr);
+		long long triangles = (long long)scene.Indices.size() / 3;
+		std::cout << "raster scene=" << scene.Name << " triangles=" << triangles << " gl_ms=" << glMs << " soft_ms=" << softMs
+				  << " speedup=" << (softMs > 0.0 ? glMs / softMs : 0.0) << " max_diff=" << difference.MaxDifference
+				  << " bad_fraction=" << std::setprecision(6) << difference.BadFraction << std::setprecision(3)
+				  << " psnr=" << difference.Psnr << std::endl;
+	}
+	soft.Report(std::cout);
+
+	soft.Destroy();
+	gl.Destroy();
+	cache.Release();
+	window.Destroy();
+	return 0;
+}
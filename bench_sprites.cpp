@@ -0,0 +1,64 @@
+// Пакетная отрисовка спрайтов: время кадра при росте числа экземпляров для обоих
+// способов обновления буфера экземпляров (orphan и persistent).
+
+#include "bench.h"
+#include "frame_stats.h"
+#include "shader.h"
+#include "sprite_batch.h"
+
+int benchSprites(int argc, char ** argv)
+{
+	int maxCount = benchArgument(argc, argv, 1, 262144);
+	int frames = benchArgument(argc, argv, 2, 60);
+
+	AppWindow window;
+	if (!createBenchContext(window))
+		return -1;
+	GLuint program = buildProgram(spriteVertexShaderSource, spriteFragmentShaderSource);
+	if (!program)
+		return -1;
+
+	// Текстура 2x2 из четырёх цветов: у каждого спрайта своя четверть
+	const unsigned char texels[] = { 255, 0, 0, 255, 0, 255, 0, 255, 0, 0, 255, 255, 255, 255, 0, 255 };
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	std::cout << "sprites max=" << maxCount << " frames=" << frames << std::endl;
+	const BufferStreaming modes[] = { BufferStreaming::Orphan, BufferStreaming::Persistent };
+	for (BufferStreaming streaming : modes)
+	{
+		for (int count = 1024; count <= maxCount; count *= 4)
+		{
+			SpriteBatch batch;
+			if (!batch.Create(program, count, streaming))
+				return -1;
+			FrameStats stats;
+			stats.WarmupFrames = 5;
+			stats.Reserve(frames);
+			for (int frame = 0; frame < stats.WarmupFrames + frames; frame++)
+			{
+				stats.BeginFrame();
+				glClear(GL_COLOR_BUFFER_BIT);
+				addSpriteGrid(batch, count, frame * 0.01f);
+				batch.Flush(0);
+				stats.CountDraw(2LL * batch.LastCount());
+				window.SwapBuffers();
+				stats.EndFrame();
+			}
+			std::string label = std::string("sprites streaming=") + bufferStreamingName(batch.Streaming) +
+								" count=" + std::to_string(count);
+			stats.Report(std::cout, label.c_str());
+			batch.Destroy();
+		}
+	}
+
+	glDeleteTextures(1, &texture);
+	glDeleteProgram(program);
+	window.Destroy();
+	return 0;
+}
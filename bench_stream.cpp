@@ -0,0 +1,103 @@
+// Потоковая загрузка вершин: сколько мегабайт в секунду проходит через StreamBuffer в
+// режимах orphan и persistent при разном объёме данных за кадр. Вершины рисуются точками
+// с GL_RASTERIZER_DISCARD, чтобы замер не упирался в растеризацию, но GPU (или llvmpipe)
+// всё равно читал каждую вершину.
+
+#include <string>
+
+#include "bench.h"
+#include "frame_stats.h"
+#include "shader.h"
+#include "stream_buffer.h"
+
+static const GLchar * streamVertexShaderSource = "#version 330 core\n"
+	"layout (location = 0) in vec4 position;\n"
+	"void main()\n"
+	"{\n"
+	"gl_Position = position;\n"
+	"gl_PointSize = 1.0;\n"
+	"}\0";
+
+static const GLchar * streamFragmentShaderSource = "#version 330 core\n"
+	"out vec4 color;\n"
+	"void main()\n"
+	"{\n"
+	"color = vec4(1.0);\n"
+	"}\n\0";
+
+int benchStream(int argc, char ** argv)
+{
+	int maxMb = benchArgument(argc, argv, 1, 16);
+	int frames = benchArgument(argc, argv, 2, 60);
+
+	AppWindow window;
+	if (!createBenchContext(window))
+		return -1;
+	GLuint program = buildProgram(streamVertexShaderSource, streamFragmentShaderSource);
+	if (!program)
+		return -1;
+	glUseProgram(program);
+	glEnable(GL_RASTERIZER_DISCARD);
+
+	const GLsizei stride = 4 * sizeof(GLfloat);
+	std::cout << "stream max_mb=" << maxMb << " frames=" << frames << std::endl;
+	const BufferStreaming modes[] = { BufferStreaming::Orphan, BufferStreaming::Persistent };
+	for (BufferStreaming streaming : modes)
+	{
+		for (GLsizeiptr size = 256 * 1024; size <= (GLsizeiptr)maxMb * 1024 * 1024; size *= 2)
+		{
+			StreamBuffer stream;
+			if (!stream.Create(GL_ARRAY_BUFFER, size, streaming))
+				return -1;
+			GLuint vao;
+			glGenVertexArrays(1, &vao);
+			glBindVertexArray(vao);
+			glBindBuffer(GL_ARRAY_BUFFER, stream.Buffer);
+			glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+			glEnableVertexAttribArray(0);
+
+			GLsizei vertices = (GLsizei)(size / stride);
+			FrameStats stats;
+			stats.WarmupFrames = 5;
+			stats.Reserve(frames);
+			for (int frame = 0; frame < stats.WarmupFrames + frames; frame++)
+			{
+				stats.BeginFrame();
+				stream.BeginFrame();
+				StreamBuffer::Allocation allocation = stream.Allocate(size, stride);
+				// Запись по порядку, как при генерации вершин: без чтения из отображённой памяти
+				GLfloat * out = (GLfloat *)allocation.Data;
+				for (GLsizei i = 0; i < vertices; i++, out += 4)
+				{
+					out[0] = (i & 1023) / 512.0f - 1.0f;
+					out[1] = (float)frame;
+					out[2] = 0.0f;
+					out[3] = 1.0f;
+				}
+				stream.Commit();
+				glDrawArrays(GL_POINTS, (GLint)(allocation.Offset / stride), vertices);
+				stream.EndFrame();
+				stats.CountDraw(0);
+				window.SwapBuffers();
+				stats.EndFrame();
+			}
+			double seconds = stats.TotalMs() / 1000.0;
+			double megabytes = (double)size * frames / (1024.0 * 1024.0);
+			std::string label = std::string("stream streaming=") + bufferStreamingName(stream.Streaming) +
+								" frame_kb=" + std::to_string(size / 1024);
+			stats.Report(std::cout, label.c_str());
+			std::cout << std::fixed << std::setprecision(1) << label
+					  << " mb_per_sec=" << (seconds > 0.0 ? megabytes / seconds : 0.0)
+					  << std::setprecision(3) << " fence_wait_ms=" << stream.FenceWaitMs << std::endl;
+
+			glBindVertexArray(0);
+			glDeleteVertexArrays(1, &vao);
+			stream.Destroy();
+		}
+	}
+
+	glDisable(GL_RASTERIZER_DISCARD);
+	glDeleteProgram(program);
+	window.Destroy();
+	return 0;
+}
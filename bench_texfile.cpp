@@ -0,0 +1,118 @@
+// Загрузка текстуры: картинка через SOIL + glGenerateMipmap против готового файла .gtex,
+// отображённого в память. Файл замеряется "тёплым" (страницы уже в кеше ОС) и
+// "холодным" (страницы сброшены через posix_fadvise перед каждым повтором).
+
+#include <cstdio>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "mipmap.h"
+#include "texture_compress.h"
+#include "texture_file.h"
+#include "texture_loader.h"
+
+// Выкидывает страницы файла из кеша ОС
+static void dropFileCache(const std::string & path)
+{
+	int descriptor = open(path.c_str(), O_RDONLY);
+	if (descriptor < 0)
+		return;
+	fdatasync(descriptor);
+	posix_fadvise(descriptor, 0, 0, POSIX_FADV_DONTNEED);
+	close(descriptor);
+}
+
+int benchTexfile(int argc, char ** argv)
+{
+	std::string image = argc > 1 ? argv[1] : ASSET_ROOT "pics/container.jpg";
+	int repeats = benchArgument(argc, argv, 2, 9);
+
+	AppWindow window;
+	if (!createBenchContext(window))
+		return -1;
+	std::cout << std::fixed << std::setprecision(3);
+
+	// Путь без подготовки: декодирование, загрузка базового уровня и мипмапы драйвером
+	int width = 0, height = 0;
+	double soilMs = medianMs([&]
+	{
+		unsigned char * pixels = SOIL_load_image(image.c_str(), &width, &height, 0, SOIL_LOAD_RGBA);
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glFinish();
+		glDeleteTextures(1, &texture);
+		SOIL_free_image_data(pixels);
+	}, repeats);
+	if (!width)
+	{
+		std::cout << "ERROR::BENCH::LOAD_FAILED " << image << std::endl;
+		return -1;
+	}
+	std::cout << "texfile image=" << image << " size=" << width << "x" << height << " repeats=" << repeats << std::endl;
+	std::cout << "texfile path=soil_generate_mipmap ms=" << soilMs << std::endl;
+
+	unsigned char * pixels = SOIL_load_image(image.c_str(), &width, &height, 0, SOIL_LOAD_RGBA);
+	MipChain chain;
+	buildMipChain(pixels, width, height, MipOptions(), chain);
+	SOIL_free_image_data(pixels);
+
+	const TextureFileFormat formats[] = {
+		TextureFileFormat::RGBA8, TextureFileFormat::BC1, TextureFileFormat::BC3, TextureFileFormat::ETC2_RGB8
+	};
+	for (TextureFileFormat format : formats)
+	{
+		if (format == TextureFileFormat::ETC2_RGB8 && !GLEW_VERSION_4_3 && !GLEW_ARB_ES3_compatibility)
+			continue;
+		std::string path = (std::filesystem::temp_directory_path() /
+							(std::string("gl_bench_") + textureFileFormatName(format) + ".gtex")).string();
+
+		// Сжатие входит в подготовку ресурсов, а не в загрузку, но его цену полезно знать
+		std::vector<std::vector<unsigned char>> encoded(chain.Levels.size());
+		std::vector<TextureFileLevel> levels;
+		std::vector<const unsigned char *> data;
+		auto encodeStart = std::chrono::steady_clock::now();
+		for (size_t level = 0; level < chain.Levels.size(); level++)
+		{
+			const MipChain::Level & info = chain.Levels[level];
+			encodeTextureLevel(format, chain.Data.data() + info.Offset, info.Width, info.Height, encoded[level]);
+			levels.push_back({ (uint32_t)info.Width, (uint32_t)info.Height, 0, encoded[level].size() });
+			data.push_back(encoded[level].data());
+		}
+		double encodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - encodeStart).count();
+		if (!writeTextureFile(path, format, 0, levels, data))
+			return -1;
+
+		auto load = [&]
+		{
+			MappedTextureFile file;
+			file.Open(path);
+			file.Prefault();
+			GLuint texture;
+			glGenTextures(1, &texture);
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			uploadTextureFile(file, (int)file.Header->Levels);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			glFinish();
+			glDeleteTextures(1, &texture);
+		};
+		double warmMs = medianMs(load, repeats);
+		double coldMs = medianMs([&] { dropFileCache(path); load(); }, repeats);
+
+		size_t bytes = 0;
+		for (const TextureFileLevel & level : levels)
+			bytes += level.Size;
+		std::cout << "texfile path=gtex format=" << textureFileFormatName(format) << " bytes=" << bytes
+				  << " encode_ms=" << encodeMs << " warm_ms=" << warmMs << " cold_ms=" << coldMs << std::endl;
+		remove(path.c_str());
+	}
+
+	window.Destroy();
+	return 0;
+}
@@ -0,0 +1,187 @@
+// Потоковая загрузка текстур (texture_streaming.h) против загрузки цепочек целиком.
+// Сцена - ряд текстур 1024x1024 RGBA8 в файлах .gtex; камера ездит вдоль ряда туда и
+// обратно, и размер текстуры на экране падает с расстоянием до неё. Полная загрузка держит
+// в видеопамяти все цепочки; поток с бюджетом - хвосты и уровни, нужные видимым текстурам.
+// Оба режима начинают с холодного кеша ОС. Для потока сообщаются занятая память, загрузки
+// и выгрузки уровней, скорость потока, время Pump за кадр и доля касаний, в которых
+// текстуре уже хватало загруженных уровней.
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "mipmap.h"
+#include "texture_file.h"
+#include "texture_loader.h"
+#include "texture_streaming.h"
+
+// Выкидывает страницы файла из кеша ОС
+static void dropStreamFileCache(const std::string & path)
+{
+	int descriptor = open(path.c_str(), O_RDONLY);
+	if (descriptor < 0)
+		return;
+	fdatasync(descriptor);
+	posix_fadvise(descriptor, 0, 0, POSIX_FADV_DONTNEED);
+	close(descriptor);
+}
+
+// Клетка своего цвета у каждой текстуры, чтобы файлы не совпадали
+static bool writeStreamTexture(const std::string & path, int size, int index)
+{
+	std::vector<unsigned char> rgba((size_t)size * size * 4);
+	for (int y = 0; y < size; y++)
+		for (int x = 0; x < size; x++)
+		{
+			unsigned char * texel = &rgba[((size_t)y * size + x) * 4];
+			bool checker = ((x / 32) ^ (y / 32)) & 1;
+			texel[0] = (unsigned char)(checker ? 40 + index * 37 : x);
+			texel[1] = (unsigned char)(checker ? 200 - index * 23 : y);
+			texel[2] = (unsigned char)(index * 71);
+			texel[3] = 255;
+		}
+	MipChain chain;
+	buildMipChain(rgba.data(), size, size, MipOptions(), chain);
+	std::vector<TextureFileLevel> levels;
+	std::vector<const unsigned char *> data;
+	for (int level = 0; level < (int)chain.Levels.size(); level++)
+	{
+		const MipChain::Level & info = chain.Levels[level];
+		levels.push_back({ (uint32_t)info.Width, (uint32_t)info.Height, 0, chain.LevelSize(level) });
+		data.push_back(chain.Pixels(level));
+	}
+	return writeTextureFile(path, TextureFileFormat::RGBA8, 0, levels, data);
+}
+
+int benchTexstream(int argc, char ** argv)
+{
+	int count = benchArgument(argc, argv, 1, 16);
+	int frames = benchArgument(argc, argv, 2, 600);
+	int budgetMb = benchArgument(argc, argv, 3, 16);
+	if (count <= 0 || frames <= 0 || budgetMb <= 0)
+		return -1;
+	const int size = 1024;
+	// Видны текстуры не дальше visibleRange от камеры; ближайшая занимает nearPixels.
+	// Кадры идут с постоянным периодом, иначе камера проезжала бы ряд быстрее чтения с диска.
+	const float visibleRange = 4.0f, nearPixels = 600.0f;
+	const auto framePeriod = std::chrono::milliseconds(5);
+
+	AppWindow window;
+	if (!createBenchContext(window))
+		return -1;
+
+	std::vector<std::string> paths;
+	for (int i = 0; i < count; i++)
+	{
+		paths.push_back((std::filesystem::temp_directory_path() / ("gl_bench_stream_" + std::to_string(i) + ".gtex")).string());
+		if (!writeStreamTexture(paths.back(), size, i))
+			return -1;
+	}
+	auto dropCaches = [&] {
+		for (const std::string & path : paths)
+			dropStreamFileCache(path);
+	};
+
+	const double megabyte = 1024.0 * 1024.0;
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "texstream textures=" << count << " size=" << size << "x" << size << " frames=" << frames
+			  << " budget_mb=" << budgetMb << std::endl;
+
+	// Всё целиком: каждый файл читается и загружается до первого кадра
+	{
+		dropCaches();
+		auto start = std::chrono::steady_clock::now();
+		std::vector<GLuint> textures(count);
+		glGenTextures(count, textures.data());
+		size_t bytes = 0;
+		for (int i = 0; i < count; i++)
+		{
+			MappedTextureFile file;
+			if (!file.Open(paths[i]))
+				return -1;
+			file.Prefault();
+			glBindTexture(GL_TEXTURE_2D, textures[i]);
+			uploadTextureFile(file, (int)file.Header->Levels);
+			for (uint32_t level = 0; level < file.Header->Levels; level++)
+				bytes += file.Levels[level].Size;
+		}
+		glFinish();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		glDeleteTextures(count, textures.data());
+		std::cout << "texstream mode=full resident_mb=" << bytes / megabyte << " load_ms=" << ms
+				  << " mb_per_s=" << (ms > 0.0 ? bytes / megabyte * 1000.0 / ms : 0.0) << std::endl;
+	}
+
+	// Поток: до первого кадра загружаются только хвосты, дальше - по касаниям
+	{
+		dropCaches();
+		TextureStreamer streamer;
+		streamer.BudgetBytes = (size_t)budgetMb << 20;
+		auto start = std::chrono::steady_clock::now();
+		std::vector<GLuint> textures;
+		for (const std::string & path : paths)
+			textures.push_back(streamer.Request(path, SOIL_LOAD_RGBA));
+		while (streamer.Pending() > 0)
+		{
+			streamer.Pump();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		glFinish();
+		double readyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		size_t tailBytes = streamer.ResidentBytes;
+
+		long long touches = 0, sharp = 0;
+		double pumpMs = 0.0, pumpMaxMs = 0.0;
+		start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			auto frameStart = std::chrono::steady_clock::now();
+			// Камера проходит ряд за половину прогона и возвращается
+			float phase = (float)frame / frames * 2.0f;
+			float camera = (phase < 1.0f ? phase : 2.0f - phase) * (count - 1);
+			for (int i = 0; i < count; i++)
+			{
+				float distance = fabsf(i - camera);
+				if (distance > visibleRange)
+					continue;
+				float pixels = nearPixels / (1.0f + distance);
+				streamer.Touch(textures[i], pixels, pixels);
+				int wanted = textureStreamLevel(size, size, mipLevelCount(size, size), pixels, pixels);
+				touches++;
+				sharp += streamer.ResidentLevel(textures[i]) <= wanted;
+			}
+			auto pumpStart = std::chrono::steady_clock::now();
+			streamer.Pump();
+			glFinish();
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pumpStart).count();
+			pumpMs += ms;
+			pumpMaxMs = std::max(pumpMaxMs, ms);
+			std::this_thread::sleep_until(frameStart + framePeriod);
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		double streamedMb = streamer.BytesStreamed / megabyte;
+		std::cout << "texstream mode=stream frame_ms=" << framePeriod.count() << " tail_mb=" << tailBytes / megabyte << " ready_ms=" << readyMs
+				  << " resident_mb=" << streamer.ResidentBytes / megabyte
+				  << " peak_resident_mb=" << streamer.PeakResidentBytes / megabyte
+				  << " full_chain_mb=" << streamer.FullChainBytes() / megabyte
+				  << " levels_loaded=" << streamer.LevelsLoaded << " levels_evicted=" << streamer.LevelsEvicted
+				  << " budget_misses=" << streamer.BudgetMisses << " streamed_mb=" << streamedMb
+				  << " mb_per_s=" << (seconds > 0.0 ? streamedMb / seconds : 0.0)
+				  << " read_mb_per_s=" << (streamer.ReadMs > 0.0 ? streamer.BytesRead / megabyte * 1000.0 / streamer.ReadMs : 0.0)
+				  << " upload_mb_per_s=" << (streamer.UploadMs > 0.0 ? streamedMb * 1000.0 / streamer.UploadMs : 0.0)
+				  << " avg_latency_ms=" << (streamer.LevelsLoaded > 0 ? streamer.LatencyMs / streamer.LevelsLoaded : 0.0)
+				  << " pump_ms=" << pumpMs / frames << " pump_max_ms=" << pumpMaxMs
+				  << " sharp_fraction=" << (touches > 0 ? (double)sharp / touches : 0.0) << std::endl;
+		glDeleteTextures(count, textures.data());
+	}
+
+	for (const std::string & path : paths)
+		remove(path.c_str());
+	window.Destroy();
+	return 0;
+}
@@ -0,0 +1,170 @@
+// Загрузка данных объектов в шейдер: glUniform4fv на каждый объект против блока объекта в
+// общем uniform-буфере (UniformStream, orphan и persistent) с glBindBufferRange перед
+// каждой отрисовкой. Объём данных объекта - один vec4 (как transform у объектов сцены) и
+// шесть vec4 (матрица и два вектора - типичный набор с освещением). cpu_ms - время
+// постановки кадра до возврата из вызовов, frame_ms - вместе с glFinish. Объекты - крошечные
+// четырёхугольники, чтобы замер не упирался в растеризацию.
+
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "gl_state.h"
+#include "shader.h"
+#include "uniform_blocks.h"
+
+// Все векторы объекта участвуют в результате, иначе компилятор выбросит лишние
+static std::string uniformBenchVertexShader(int vectors, bool block)
+{
+	std::string count = std::to_string(vectors);
+	std::string source = "#version 330 core\n"
+		"layout (location = 0) in vec3 position;\n";
+	source += block ? "layout (std140) uniform ObjectBlock { vec4 data[" + count + "]; };\n" : "uniform vec4 data[" + count + "];\n";
+	source += "out vec4 tint;\n"
+		"void main()\n"
+		"{\n"
+		"vec4 sum = vec4(0.0);\n"
+		"for (int i = 1; i < " + count + "; i++)\n"
+		"sum += data[i];\n"
+		"tint = vec4(1.0) + sum * 0.0001;\n"
+		"gl_Position = vec4(position.xy * data[0].z + data[0].xy, 0.0, 1.0);\n"
+		"}\n";
+	return source;
+}
+
+static const GLchar * uniformBenchFragmentShaderSource = "#version 330 core\n"
+	"in vec4 tint;\n"
+	"out vec4 color;\n"
+	"void main()\n"
+	"{\n"
+	"color = tint;\n"
+	"}\n\0";
+
+// Данные объекта i в кадре frame
+static void objectData(int i, int frame, int vectors, GLfloat * out)
+{
+	out[0] = (i % 128) / 64.0f - 1.0f + (frame & 7) * 0.001f;
+	out[1] = (i / 128 % 128) / 64.0f - 1.0f;
+	out[2] = 0.004f;
+	out[3] = 0.0f;
+	for (int k = 4; k < vectors * 4; k++)
+		out[k] = (float)(i + k);
+}
+
+int benchUniforms(int argc, char ** argv)
+{
+	int objects = benchArgument(argc, argv, 1, 16384);
+	int frames = benchArgument(argc, argv, 2, 20);
+
+	AppWindow window;
+	if (!createBenchContext(window))
+		return -1;
+
+	const GLfloat quad[] = { 1.0f, 1.0f, 0.0f, 1.0f, -1.0f, 0.0f, -1.0f, -1.0f, 0.0f, -1.0f, 1.0f, 0.0f };
+	const GLuint indices[] = { 0, 1, 3, 1, 2, 3 };
+	GLuint vertexArray, buffers[2];
+	glGenVertexArrays(1, &vertexArray);
+	glGenBuffers(2, buffers);
+	glBindVertexArray(vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
+	glEnableVertexAttribArray(0);
+
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "uniforms objects=" << objects << " frames=" << frames << " offset_alignment=" << alignment << std::endl;
+
+	struct Path
+	{
+		const char * Name;
+		bool Block;
+		BufferStreaming Streaming;
+	};
+	const Path paths[] = {
+		{ "uniform", false, BufferStreaming::Orphan },
+		{ "ubo", true, BufferStreaming::Orphan },
+		{ "ubo", true, BufferStreaming::Persistent }
+	};
+	const int sizes[] = { 1, 6 };
+	for (int vectors : sizes)
+	{
+		double baseline = 0.0;
+		std::vector<GLfloat> values(vectors * 4);
+		for (const Path & path : paths)
+		{
+			if (path.Streaming == BufferStreaming::Persistent && !bufferStorageSupported())
+				continue;
+			GLuint program = buildProgram(uniformBenchVertexShader(vectors, path.Block).c_str(), uniformBenchFragmentShaderSource);
+			if (!program)
+				return -1;
+			bindUniformBlocks(program);
+			GLint location = glGetUniformLocation(program, "data");
+			GlState state;
+			UniformStream uniforms;
+			if (path.Block && !uniforms.Create(objects, vectors * 4 * sizeof(GLfloat), path.Streaming))
+				return -1;
+
+			int frame = 0;
+			double cpuMs = 0.0;
+			auto draw = [&] {
+				auto start = std::chrono::steady_clock::now();
+				state.BeginFrame();
+				state.UseProgram(program);
+				state.BindVertexArray(vertexArray);
+				if (path.Block)
+				{
+					uniforms.BeginFrame();
+					FrameConstants constants = { { 0.0f, 0.0f, (float)frame, 0.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } };
+					uniforms.SetFrame(constants);
+					UniformStream::Range blocks = uniforms.AllocateBlocks(objects, vectors * 4 * sizeof(GLfloat));
+					for (int i = 0; i < objects; i++)
+						objectData(i, frame, vectors, (GLfloat *)(blocks.Data + (size_t)i * blocks.Stride));
+					uniforms.Commit(state);
+					for (int i = 0; i < objects; i++)
+					{
+						state.BindUniformRange(objectUniformBinding, uniforms.Buffer.Buffer, blocks.Offset + (GLintptr)i * blocks.Stride,
+											   vectors * 4 * sizeof(GLfloat));
+						glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+					}
+					uniforms.EndFrame();
+				}
+				else
+					for (int i = 0; i < objects; i++)
+					{
+						objectData(i, frame, vectors, values.data());
+						glUniform4fv(location, vectors, values.data());
+						glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+					}
+				cpuMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				glFinish();
+				frame++;
+			};
+			glClear(GL_COLOR_BUFFER_BIT);
+			draw();
+			cpuMs = 0.0;
+			double ms = medianMs([&] {
+				glClear(GL_COLOR_BUFFER_BIT);
+				draw();
+			}, frames);
+			cpuMs /= frames;
+			if (!path.Block)
+				baseline = cpuMs;
+			std::cout << "uniforms vec4_per_object=" << vectors << " path=" << path.Name;
+			if (path.Block)
+				std::cout << " streaming=" << bufferStreamingName(uniforms.Buffer.Streaming);
+			std::cout << " cpu_ms=" << cpuMs << " ns_per_object=" << cpuMs * 1e6 / objects << " frame_ms=" << ms
+					  << " cpu_speedup=" << (cpuMs > 0.0 ? baseline / cpuMs : 0.0) << std::endl;
+			uniforms.Destroy();
+			glDeleteProgram(program);
+		}
+	}
+
+	glDeleteVertexArrays(1, &vertexArray);
+	glDeleteBuffers(2, buffers);
+	window.Destroy();
+	return 0;
+}
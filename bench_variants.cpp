@@ -0,0 +1,76 @@
+// Сборка всех вариантов шейдера vertex_shader.vs + fragment_shader.frag: по одному через
+// buildProgram (компиляция, связывание и проверка каждого по очереди) против ShaderVariants
+// (все компиляции и связывания отправлены разом, статусы - в конце). Кеш на диске отключён,
+// а в исходник каждого повтора добавляется свой комментарий, чтобы ни ShaderCache, ни
+// кеш шейдеров драйвера не отдали уже собранную программу.
+
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "shader_variants.h"
+
+int benchVariants(int argc, char ** argv)
+{
+	int repeats = benchArgument(argc, argv, 1, 5);
+
+	AppWindow window;
+	if (!createBenchContext(window))
+		return -1;
+
+	std::string vertexSource, fragmentSource;
+	if (!readShaderFile(ASSET_ROOT "vertex_shader.vs", vertexSource) || !readShaderFile(ASSET_ROOT "fragment_shader.frag", fragmentSource))
+		return -1;
+
+	// Все непротиворечивые маски
+	std::vector<unsigned> masks;
+	for (unsigned features = 0; features < shaderVariantCount; features++)
+		if (normalizeShaderFeatures(features) == features)
+			masks.push_back(features);
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "variants count=" << masks.size() << " repeats=" << repeats
+			  << " khr_parallel=" << (GLEW_KHR_parallel_shader_compile ? 1 : 0)
+			  << " arb_parallel=" << (GLEW_ARB_parallel_shader_compile ? 1 : 0) << std::endl;
+
+	int build = 0;
+	bool failed = false;
+	auto uniqueSource = [&](const std::string & source) { return source + "\n// build " + std::to_string(build) + "\n"; };
+
+	double serialMs = medianMs([&] {
+		build++;
+		std::vector<GLuint> programs;
+		for (unsigned features : masks)
+		{
+			GLuint program = buildProgram(shaderVariantSource(uniqueSource(vertexSource), features).c_str(),
+										  shaderVariantSource(uniqueSource(fragmentSource), features).c_str());
+			failed |= !program;
+			programs.push_back(program);
+		}
+		for (GLuint program : programs)
+			glDeleteProgram(program);
+	}, repeats);
+
+	double submitMs = 0.0;
+	double variantsMs = medianMs([&] {
+		build++;
+		ShaderCache cache("");
+		ShaderVariants variants(cache);
+		variants.SetSource(uniqueSource(vertexSource), uniqueSource(fragmentSource));
+		for (unsigned features : masks)
+			variants.Request(features);
+		variants.Submit();
+		failed |= !variants.Finish();
+		submitMs += variants.SubmitMs;
+		cache.Release();
+	}, repeats);
+	if (failed)
+		return -1;
+
+	std::cout << "variants path=serial total_ms=" << serialMs << " ms_per_variant=" << serialMs / masks.size() << std::endl;
+	std::cout << "variants path=batched total_ms=" << variantsMs << " ms_per_variant=" << variantsMs / masks.size()
+			  << " submit_ms=" << submitMs / repeats << " speedup=" << (variantsMs > 0.0 ? serialMs / variantsMs : 0.0) << std::endl;
+
+	window.Destroy();
+	return 0;
+}
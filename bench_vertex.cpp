@@ -0,0 +1,108 @@
+// Формат вершин: время отрисовки сцены, упирающейся в выборку вершин, с вершинами из 8 float
+// (32 байта) и упакованными (16 байт: half float, unorm8, unorm16). Все треугольники
+// отбрасываются glCullFace(GL_FRONT_AND_BACK) уже после вершинного шейдера, так что замер
+// не зависит от растеризации, но каждая вершина выбирается из буфера и обрабатывается.
+
+#include <cmath>
+#include <vector>
+
+#include "bench.h"
+#include "shader.h"
+#include "vertex_layout.h"
+
+// Все три атрибута участвуют в результате, чтобы компилятор шейдера не выбросил ни один
+static const GLchar * vertexBenchVertexShaderSource = "#version 330 core\n"
+	"layout (location = 0) in vec3 position;\n"
+	"layout (location = 1) in vec3 color;\n"
+	"layout (location = 2) in vec2 texCoord;\n"
+	"out vec3 ourColor;\n"
+	"void main()\n"
+	"{\n"
+	"gl_Position = vec4(position, 1.0);\n"
+	"ourColor = color * texCoord.x + vec3(texCoord.y);\n"
+	"}\0";
+
+static const GLchar * vertexBenchFragmentShaderSource = "#version 330 core\n"
+	"in vec3 ourColor;\n"
+	"out vec4 color;\n"
+	"void main()\n"
+	"{\n"
+	"color = vec4(ourColor, 1.0);\n"
+	"}\n\0";
+
+template <typename Layout, typename Vertex>
+static double drawMs(const std::vector<Vertex> & vertices, int frames, double & uploadMs)
+{
+	GLuint vao, vbo;
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	uploadMs = medianMs([&] {
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+		glFinish();
+	}, 3);
+	Layout::Apply();
+
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+	glFinish();
+	double ms = medianMs([&] {
+		glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+		glFinish();
+	}, frames);
+
+	glBindVertexArray(0);
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vbo);
+	return ms;
+}
+
+int benchVertex(int argc, char ** argv)
+{
+	int count = benchArgument(argc, argv, 1, 3000000) / 3 * 3;
+	int frames = benchArgument(argc, argv, 2, 15);
+
+	AppWindow window;
+	if (!createBenchContext(window))
+		return -1;
+	GLuint program = buildProgram(vertexBenchVertexShaderSource, vertexBenchFragmentShaderSource);
+	if (!program)
+		return -1;
+	glUseProgram(program);
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_FRONT_AND_BACK);
+
+	// Мелкие треугольники по всему экрану с разными цветами и текстурными координатами
+	std::vector<Fp32Vertex> fp32(count);
+	for (int i = 0; i < count; i++)
+	{
+		float t = i * 0.618034f;
+		Fp32Vertex & vertex = fp32[i];
+		vertex.Position[0] = sinf(t * 1.3f) * 0.9f + (i % 3) * 0.01f;
+		vertex.Position[1] = cosf(t * 0.7f) * 0.9f + (i % 3 == 1) * 0.01f;
+		vertex.Position[2] = 0.0f;
+		vertex.Color[0] = (i & 255) / 255.0f;
+		vertex.Color[1] = ((i >> 8) & 255) / 255.0f;
+		vertex.Color[2] = 0.5f;
+		vertex.TexCoord[0] = (i % 3) * 0.5f;
+		vertex.TexCoord[1] = fmodf(t, 1.0f);
+	}
+	std::vector<PackedVertex> packed(count);
+	for (int i = 0; i < count; i++)
+		packed[i] = packVertex(fp32[i]);
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "vertex count=" << count << " frames=" << frames << std::endl;
+	double uploadMs;
+	double ms = drawMs<Fp32VertexLayout>(fp32, frames, uploadMs);
+	std::cout << "vertex format=fp32 stride=" << Fp32VertexLayout::Stride << " mb=" << count * (double)sizeof(Fp32Vertex) / (1024.0 * 1024.0)
+			  << " upload_ms=" << uploadMs << " draw_ms=" << ms << " mvert_per_sec=" << count / ms / 1000.0 << std::endl;
+	ms = drawMs<PackedVertexLayout>(packed, frames, uploadMs);
+	std::cout << "vertex format=packed stride=" << PackedVertexLayout::Stride << " mb=" << count * (double)sizeof(PackedVertex) / (1024.0 * 1024.0)
+			  << " upload_ms=" << uploadMs << " draw_ms=" << ms << " mvert_per_sec=" << count / ms / 1000.0 << std::endl;
+
+	glDisable(GL_CULL_FACE);
+	glDeleteProgram(program);
+	window.Destroy();
+	return 0;
+}
@@ -0,0 +1,189 @@
+// Запись команд отрисовки в нескольких потоках и воспроизведение на одном потоке OpenGL.
+//
+// Рабочие потоки не вызывают OpenGL: каждый пишет пакеты отрисовки (DrawPacket) в свой
+// CommandList, память под пакеты берётся из арены списка (CommandArena). Арена раздаёт
+// память из больших блоков простым сдвигом указателя и в Reset только перематывается,
+// так что со второго кадра запись обходится без обращений к куче и без общих блокировок.
+//
+// Поток OpenGL собирает ключи всех списков, сортирует их по 64-битному ключу и
+// воспроизводит пакеты через GlState. Ключ составлен из программы, текстуры и VAO (в
+// этом порядке значимости, от самой дорогой смены состояния к самой дешёвой), поэтому
+// после сортировки пакеты с одинаковым состоянием идут подряд и трекер пропускает почти
+// все привязки. Сортировка меняет порядок отрисовки - годится для непрозрачной геометрии
+// без смешивания; младшие биты ключа (Depth) задают порядок внутри одинакового состояния.
+
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "frame_memory.h"
+#include "gl_state.h"
+#include "thread_pool.h"
+#include "uniform_blocks.h"
+
+// Арена списка команд - обычная арена кадра: перематывается в начале каждой записи
+typedef FrameArena CommandArena;
+
+// Ключ сортировки: программа (16 бит), текстура (16), VAO (16), порядок внутри состояния (16).
+// Имена объектов OpenGL - небольшие числа, выдаваемые по порядку, поэтому 16 бит хватает.
+inline uint64_t makeSortKey(GLuint program, GLuint texture, GLuint vertexArray, uint16_t depth = 0)
+{
+	return ((uint64_t)(program & 0xffff) << 48) | ((uint64_t)(texture & 0xffff) << 32) |
+		   ((uint64_t)(vertexArray & 0xffff) << 16) | depth;
+}
+
+// Одна отрисовка со всем состоянием, которое ей нужно
+struct DrawPacket
+{
+	GLuint Program;
+	GLuint Texture;
+	GLuint VertexArray;
+	GLenum Mode;
+	GLsizei Count;
+	GLenum IndexType;
+	// Смещение первого индекса в байтах и прибавка к индексам
+	GLintptr IndexOffset;
+	GLint BaseVertex;
+	// Положение uniform vec4 на объект (-1 - нет) и его значение. Положение нужно узнать
+	// заранее на потоке OpenGL (GlState::UniformLocation): рабочие потоки GL не вызывают.
+	GLint UniformLocation;
+	GLfloat Uniform[4];
+	// Блок объекта: диапазон буфера для objectUniformBinding (UniformBuffer == 0 - нет)
+	GLuint UniformBuffer;
+	GLintptr UniformOffset;
+	GLsizeiptr UniformSize;
+};
+
+// Список команд одного потока записи
+class CommandList
+{
+	public:
+	struct Entry
+	{
+		uint64_t Key;
+		const DrawPacket * Packet;
+	};
+
+	CommandArena Arena;
+	std::vector<Entry> Entries;
+
+	// Пакет для заполнения; ключ строится из его состояния при Submit
+	DrawPacket * Draw()
+	{
+		return this->Arena.New<DrawPacket>();
+	}
+
+	void Submit(const DrawPacket * packet, uint16_t depth = 0)
+	{
+		this->Entries.push_back({ makeSortKey(packet->Program, packet->Texture, packet->VertexArray, depth), packet });
+	}
+
+	void Reset()
+	{
+		this->Arena.Reset();
+		this->Entries.clear();
+	}
+};
+
+// Списки команд для пула потоков и воспроизведение их на потоке OpenGL
+class CommandQueue
+{
+	public:
+	// Время этапов последнего кадра и число воспроизведённых пакетов
+	double RecordMs = 0.0, SortMs = 0.0, ReplayMs = 0.0;
+	long long Packets = 0;
+
+	// lists - сколько списков (и задач записи) на кадр; обычно по числу потоков пула
+	explicit CommandQueue(size_t lists) : lists(lists) {}
+
+	size_t ListCount() const { return this->lists.size(); }
+
+	// Память под packets пакетов за кадр заранее: записи не придётся расти посреди кадра
+	void Reserve(size_t packets)
+	{
+		size_t perList = packets / this->lists.size() + 1;
+		for (CommandList & list : this->lists)
+		{
+			list.Entries.reserve(perList);
+			list.Arena.Reserve(perList * sizeof(DrawPacket) + alignof(std::max_align_t));
+		}
+		this->sorted.reserve(packets);
+	}
+
+	// Запись count объектов: диапазон [0, count) делится между списками, record(list, begin, end)
+	// выполняется в пуле (или на этом потоке, если pool == nullptr)
+	template <typename Recorder>
+	void Record(ThreadPool * pool, size_t count, const Recorder & record)
+	{
+		auto start = std::chrono::steady_clock::now();
+		size_t parts = this->lists.size();
+		for (CommandList & list : this->lists)
+			list.Reset();
+		if (pool)
+			pool->ParallelFor(count, parts, [this, &record](size_t part, size_t begin, size_t end) {
+				record(this->lists[part], begin, end);
+			});
+		else
+			for (size_t part = 0; part < parts; part++)
+				record(this->lists[part], count * part / parts, count * (part + 1) / parts);
+		this->RecordMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Поток OpenGL: слияние списков, сортировка по ключу и отрисовка
+	void Replay(GlState & state)
+	{
+		auto start = std::chrono::steady_clock::now();
+		this->sorted.clear();
+		for (const CommandList & list : this->lists)
+			this->sorted.insert(this->sorted.end(), list.Entries.begin(), list.Entries.end());
+		std::sort(this->sorted.begin(), this->sorted.end(),
+				  [](const CommandList::Entry & a, const CommandList::Entry & b) { return a.Key < b.Key; });
+		auto sortedAt = std::chrono::steady_clock::now();
+
+		for (const CommandList::Entry & entry : this->sorted)
+		{
+			const DrawPacket & packet = *entry.Packet;
+			state.UseProgram(packet.Program);
+			state.BindTexture(0, GL_TEXTURE_2D, packet.Texture);
+			state.BindVertexArray(packet.VertexArray);
+			if (packet.UniformBuffer)
+				state.BindUniformRange(objectUniformBinding, packet.UniformBuffer, packet.UniformOffset, packet.UniformSize);
+			if (packet.UniformLocation >= 0)
+				state.Uniform4f(packet.UniformLocation, packet.Uniform[0], packet.Uniform[1], packet.Uniform[2], packet.Uniform[3]);
+			glDrawElementsBaseVertex(packet.Mode, packet.Count, packet.IndexType, (GLvoid*)packet.IndexOffset, packet.BaseVertex);
+		}
+		this->Packets = (long long)this->sorted.size();
+		auto end = std::chrono::steady_clock::now();
+		this->SortMs = std::chrono::duration<double, std::milli>(sortedAt - start).count();
+		this->ReplayMs = std::chrono::duration<double, std::milli>(end - sortedAt).count();
+	}
+
+	void Report(std::ostream & out) const
+	{
+		size_t reserved = 0;
+		for (const CommandList & list : this->lists)
+			reserved += list.Arena.ReservedBytes();
+		out << std::fixed << std::setprecision(3)
+			<< "command_queue lists=" << this->lists.size()
+			<< " packets=" << this->Packets
+			<< " record_ms=" << this->RecordMs
+			<< " sort_ms=" << this->SortMs
+			<< " replay_ms=" << this->ReplayMs
+			<< " arena_bytes=" << reserved << std::endl;
+	}
+
+	private:
+	std::vector<CommandList> lists;
+	std::vector<CommandList::Entry> sorted;
+};
+
+#endif
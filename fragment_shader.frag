@@ -1,11 +1,24 @@
 #version 330 core													
+// Варианты этого шейдера (shader_variants.h) включают возможности через #define:
+// VERTEX_COLOR - цвет из вершин, UNIFORM_COLOR - цвет из формы, TEXTURE - одна текстура,
+// TWO_TEXTURES - смесь двух. Без возможностей фигура просто белая.
+#ifdef VERTEX_COLOR
 in vec3 ourColor;
+#endif
+#ifdef TEXTURE
 in vec2 TexCoord;
 
-out vec4 color;
-
 uniform sampler2D ourTexture1;
+#endif
+#ifdef TWO_TEXTURES
 uniform sampler2D ourTexture2;
+#endif
+#ifdef UNIFORM_COLOR
+// Значение этой переменной устанавливается в коде OpenGL
+uniform vec4 uniformColor;
+#endif
+
+out vec4 color;
 
 // Фрагментный шейдер должен иметь доступ к текстурному объекту, но как передать 
 // его во фрагментный шейдер? GLSL имеет встроенный тип данных для текстурных
@@ -20,9 +33,20 @@ uniform sampler2D ourTexture2;
 
 void main()														
 {
+	color = vec4(1.0f);
+#if defined(TWO_TEXTURES)
+	color = mix(texture(ourTexture1, TexCoord), texture(ourTexture2, TexCoord), 0.2);
+#elif defined(TEXTURE)
+	color = texture(ourTexture1, TexCoord);
+#endif
 	// Для получения более цветастого эффекта можем смешать результирующий цвет текстуры
 	// с вершинным цветом. Для смешивания умножим цвета:
-	color = mix(texture(ourTexture1, TexCoord), texture(ourTexture2, TexCoord), 0.2); // * vec4(ourColor, 1.0f);
+#ifdef VERTEX_COLOR
+	color *= vec4(ourColor, 1.0f);
+#endif
+#ifdef UNIFORM_COLOR
+	color *= uniformColor;
+#endif
 	// Финальный результат - это комбинация двух текстур. В GLSL встроена функция mix, которая
 	// принимает два значения на вход и интерполирует их на основе третьего значения. Если третье
 	// значение 0.0, то эта функция вернёт первый аргумент, если 1.0, то второй. Значение в 0.2 
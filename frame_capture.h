@@ -0,0 +1,228 @@
+// Запись отрисованных кадров (например, для последующего кодирования в видео) без
+// остановки игрового цикла.
+//
+// Кадр копируется в кольцо из Depth буферов PBO (PixelReadback) и забирается через Depth
+// кадров, когда его fence давно сработал и отображение буфера не ждёт GPU. Переводом
+// RGBA в YUV 4:2:0 (I420, BT.601 с ограниченным диапазоном) и записью в файл или канал
+// занимается отдельный рабочий поток; поток OpenGL только копирует строки из PBO.
+// Результат - "сырые" кадры без заголовков, например:
+//   ffmpeg -f rawvideo -pix_fmt yuv420p -s 800x600 -r 60 -i capture.yuv capture.mp4
+// Путь, начинающийся с '|', - команда, которой кадры отдаются через канал (popen).
+//
+// В отчёте: устойчивая частота записи, задержка от отрисовки кадра до его записи (в кадрах
+// и миллисекундах) и время, которое цикл отрисовки потратил на захват.
+
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "pixel_readback.h"
+#include "thread_pool.h"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+// RGBA8 (строки сверху вниз) -> I420: плоскость Y, затем U и V в половинном разрешении.
+// Цветность - среднее по квадрату 2x2. Ширина и высота должны быть чётными.
+inline void convertRgbaToI420(const unsigned char * rgba, int width, int height, unsigned char * yuv)
+{
+	unsigned char * planeY = yuv, * planeU = yuv + width * height, * planeV = planeU + width * height / 4;
+	for (int y = 0; y < height; y += 2)
+		for (int x = 0; x < width; x += 2)
+		{
+			int sumR = 0, sumG = 0, sumB = 0;
+			for (int dy = 0; dy < 2; dy++)
+				for (int dx = 0; dx < 2; dx++)
+				{
+					const unsigned char * p = rgba + ((size_t)(y + dy) * width + x + dx) * 4;
+					int r = p[0], g = p[1], b = p[2];
+					planeY[(y + dy) * width + x + dx] = (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+					sumR += r;
+					sumG += g;
+					sumB += b;
+				}
+			// Суммы по четырём пикселям: сдвиг на 10 вместо 8 делит их на 4
+			int chroma = (y / 2) * (width / 2) + x / 2;
+			planeU[chroma] = (unsigned char)(((-38 * sumR - 74 * sumG + 112 * sumB + 512) >> 10) + 128);
+			planeV[chroma] = (unsigned char)(((112 * sumR - 94 * sumG - 18 * sumB + 512) >> 10) + 128);
+		}
+}
+
+class FrameCapture
+{
+	public:
+	typedef std::chrono::steady_clock Clock;
+	// Через сколько кадров забирается прочитанный кадр (число буферов PBO)
+	int Depth = 3;
+	// Сколько кадров может ждать рабочего потока; дальше цикл отрисовки ждёт запись
+	int MaxQueued = 8;
+	// Статистика
+	long long Frames = 0, Written = 0;
+	double RenderMs = 0.0, WriterWaitMs = 0.0, TotalLatencyMs = 0.0, MaxLatencyMs = 0.0;
+	long long TotalLatencyFrames = 0;
+
+	FrameCapture() : writer(1) {}
+	~FrameCapture() { this->writer.Wait(); this->closeOutput(); }
+
+	// path - файл или "|команда"; width и height - размер буфера кадра
+	bool Create(const std::string & path, int width, int height)
+	{
+		if (width % 2 || height % 2)
+		{
+			std::cout << "ERROR::CAPTURE::ODD_SIZE " << width << "x" << height << std::endl;
+			return false;
+		}
+		this->pipe = !path.empty() && path[0] == '|';
+		this->output = this->pipe ? popen(path.c_str() + 1, "w") : fopen(path.c_str(), "wb");
+		if (!this->output)
+		{
+			std::cout << "ERROR::CAPTURE::OPEN_FAILED " << path << std::endl;
+			return false;
+		}
+		this->frameTimes.assign(this->Depth, Clock::time_point());
+		this->frameNumbers.assign(this->Depth, 0);
+		// Вся память захвата выделяется здесь: цикл отрисовки потом к куче не обращается
+		this->queue.resize(this->MaxQueued);
+		for (QueuedFrame & frame : this->queue)
+			frame.Pixels.resize((size_t)width * height * 4);
+		this->yuv.resize((size_t)width * height * 3 / 2);
+		return this->readback.Create(width, height, this->Depth);
+	}
+
+	// Вызывается после отрисовки кадра, до SwapBuffers: забирает кадр, прочитанный Depth
+	// кадров назад, и ставит в очередь чтение текущего
+	void Capture(long long frameNumber)
+	{
+		Clock::time_point start = Clock::now();
+		if (this->readback.InFlight() == this->Depth)
+			this->collect(frameNumber);
+		int slot = (int)(this->Frames % this->Depth);
+		this->frameTimes[slot] = start;
+		this->frameNumbers[slot] = frameNumber;
+		this->readback.Begin();
+		this->Frames++;
+		if (!this->firstFrame.time_since_epoch().count())
+			this->firstFrame = start;
+		this->RenderMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// Дописать все кадры в очереди и закрыть вывод
+	void Finish(long long frameNumber)
+	{
+		while (this->readback.InFlight() > 0)
+			this->collect(frameNumber);
+		this->writer.Wait();
+		this->closeOutput();
+	}
+
+	void Report(std::ostream & out) const
+	{
+		double seconds = std::chrono::duration<double>(this->lastWrite - this->firstFrame).count();
+		out << std::fixed << std::setprecision(3) << "capture frames=" << this->Frames << " written=" << this->Written
+			<< " depth=" << this->Depth << " fps=" << (seconds > 0.0 ? this->Written / seconds : 0.0)
+			<< " latency_frames=" << (this->Written ? (double)this->TotalLatencyFrames / this->Written : 0.0)
+			<< " latency_ms=" << (this->Written ? this->TotalLatencyMs / this->Written : 0.0)
+			<< " max_latency_ms=" << this->MaxLatencyMs
+			<< " render_ms_per_frame=" << (this->Frames ? this->RenderMs / this->Frames : 0.0)
+			<< " fence_wait_ms=" << this->readback.WaitMs << " writer_wait_ms=" << this->WriterWaitMs << std::endl;
+	}
+
+	// Освобождение буферов OpenGL (до уничтожения контекста)
+	void Destroy() { this->readback.Destroy(); }
+
+	private:
+	PixelReadback readback;
+	ThreadPool writer;
+	FILE * output = nullptr;
+	bool pipe = false;
+	// Когда и в каком кадре начато чтение каждого слота кольца
+	std::vector<Clock::time_point> frameTimes;
+	std::vector<long long> frameNumbers;
+	long long collected = 0;
+	Clock::time_point firstFrame, lastWrite;
+	// Кольцо кадров для рабочего потока: queued штук начиная с queueHead (счётчик - под mutex).
+	// Кадр заполняет только поток OpenGL, а читает только рабочий поток.
+	struct QueuedFrame
+	{
+		std::vector<unsigned char> Pixels;
+		Clock::time_point Rendered;
+		long long LatencyFrames = 0;
+	};
+	std::vector<QueuedFrame> queue;
+	size_t queueHead = 0;
+	int queued = 0;
+	std::mutex mutex;
+	std::condition_variable drained;
+	// Буфер I420 рабочего потока
+	std::vector<unsigned char> yuv;
+
+	void collect(long long frameNumber)
+	{
+		size_t index;
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			if (this->queued >= this->MaxQueued)
+			{
+				Clock::time_point start = Clock::now();
+				this->drained.wait(lock, [this] { return this->queued < this->MaxQueued; });
+				this->WriterWaitMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			}
+			index = (this->queueHead + this->queued) % this->queue.size();
+		}
+		int slot = (int)(this->collected++ % this->Depth);
+		QueuedFrame & frame = this->queue[index];
+		if (!this->readback.Finish(frame.Pixels, true))
+			return;
+		frame.Rendered = this->frameTimes[slot];
+		frame.LatencyFrames = frameNumber - this->frameNumbers[slot];
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->queued++;
+		}
+		this->writer.Submit([this, index] { this->write(this->queue[index]); });
+	}
+
+	// Рабочий поток: перевод в I420 и запись
+	void write(const QueuedFrame & frame)
+	{
+		convertRgbaToI420(frame.Pixels.data(), this->readback.Width, this->readback.Height, this->yuv.data());
+		if (fwrite(this->yuv.data(), 1, this->yuv.size(), this->output) != this->yuv.size())
+			std::cout << "ERROR::CAPTURE::WRITE_FAILED" << std::endl;
+
+		Clock::time_point now = Clock::now();
+		double latency = std::chrono::duration<double, std::milli>(now - frame.Rendered).count();
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->Written++;
+		this->TotalLatencyMs += latency;
+		this->MaxLatencyMs = std::max(this->MaxLatencyMs, latency);
+		this->TotalLatencyFrames += frame.LatencyFrames;
+		this->lastWrite = now;
+		this->queueHead = (this->queueHead + 1) % this->queue.size();
+		this->queued--;
+		this->drained.notify_one();
+	}
+
+	void closeOutput()
+	{
+		if (!this->output)
+			return;
+		if (this->pipe)
+			pclose(this->output);
+		else
+			fclose(this->output);
+		this->output = nullptr;
+	}
+};
+
+#endif
@@ -0,0 +1,188 @@
+// Память для данных, которые живут один кадр или создаются и удаляются часто.
+//
+// FrameArena - линейная арена: память раздаётся из больших блоков сдвигом указателя и
+// освобождается только целиком (Reset в конце кадра). Если кадру не хватило первого блока,
+// при Reset блоки сливаются в один общего размера, так что через кадр-другой арена
+// работает из одного блока и к куче больше не обращается. Деструкторы объектов в арене
+// не вызываются - в ней живут только тривиальные данные (пакеты отрисовки, uniform-блоки).
+//
+// ObjectPool - пул объектов одного типа: блоки по ChunkSize ячеек, свободные ячейки
+// связаны в список прямо внутри себя. Create/Destroy - O(1) без кучи, пока хватает ячеек;
+// адреса объектов не меняются, пока объект жив. Пул не знает, какие ячейки заняты, поэтому
+// живые объекты нужно удалить через Destroy до уничтожения пула.
+//
+// Обе структуры не потокобезопасны: у каждого потока записи своя арена.
+
+#ifndef FRAME_MEMORY_H
+#define FRAME_MEMORY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+class FrameArena
+{
+	public:
+	explicit FrameArena(size_t blockSize = 64 * 1024) : BlockSize(blockSize) {}
+
+	FrameArena(const FrameArena &) = delete;
+	FrameArena & operator=(const FrameArena &) = delete;
+
+	size_t BlockSize;
+	// Наибольший объём, выделенный за один кадр
+	size_t PeakBytes = 0;
+
+	void * Allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+	{
+		for (;;)
+		{
+			if (this->block < this->blocks.size())
+			{
+				Block & current = this->blocks[this->block];
+				size_t start = (this->offset + alignment - 1) / alignment * alignment;
+				if (start + size <= current.Size)
+				{
+					this->offset = start + size;
+					this->used += size;
+					return current.Data.get() + start;
+				}
+				this->block++;
+				this->offset = 0;
+				continue;
+			}
+			// Новый блок: не меньше запрошенного, чтобы крупные выделения тоже помещались
+			size_t blockSize = std::max(this->BlockSize, size + alignment);
+			this->blocks.push_back({ std::unique_ptr<unsigned char[]>(new unsigned char[blockSize]), blockSize });
+		}
+	}
+
+	template <typename T>
+	T * New()
+	{
+		return new (this->Allocate(sizeof(T), alignof(T))) T();
+	}
+
+	// Массив из count неинициализированных элементов тривиального типа
+	template <typename T>
+	T * NewArray(size_t count)
+	{
+		return (T *)this->Allocate(sizeof(T) * count, alignof(T));
+	}
+
+	// Заранее один блок хотя бы на bytes байт (вызывается между кадрами)
+	void Reserve(size_t bytes)
+	{
+		if (this->ReservedBytes() >= bytes && this->blocks.size() == 1)
+			return;
+		bytes = std::max(bytes, this->ReservedBytes());
+		this->blocks.clear();
+		this->blocks.push_back({ std::unique_ptr<unsigned char[]>(new unsigned char[bytes]), bytes });
+		this->block = 0;
+		this->offset = 0;
+		this->used = 0;
+	}
+
+	// Всё выделенное становится недействительным; память остаётся для следующего кадра
+	void Reset()
+	{
+		this->PeakBytes = std::max(this->PeakBytes, this->used);
+		if (this->blocks.size() > 1 && this->block > 0)
+		{
+			// Кадр не поместился в один блок: следующий получит один блок на всё сразу
+			size_t total = this->ReservedBytes();
+			this->blocks.clear();
+			this->blocks.push_back({ std::unique_ptr<unsigned char[]>(new unsigned char[total]), total });
+		}
+		this->block = 0;
+		this->offset = 0;
+		this->used = 0;
+	}
+
+	size_t UsedBytes() const { return this->used; }
+
+	size_t ReservedBytes() const
+	{
+		size_t total = 0;
+		for (const Block & block : this->blocks)
+			total += block.Size;
+		return total;
+	}
+
+	private:
+	struct Block
+	{
+		std::unique_ptr<unsigned char[]> Data;
+		size_t Size;
+	};
+
+	std::vector<Block> blocks;
+	size_t block = 0, offset = 0, used = 0;
+};
+
+template <typename T, size_t ChunkSize = 256>
+class ObjectPool
+{
+	public:
+	ObjectPool() = default;
+	ObjectPool(const ObjectPool &) = delete;
+	ObjectPool & operator=(const ObjectPool &) = delete;
+
+	template <typename... Args>
+	T * Create(Args &&... args)
+	{
+		if (!this->freeList)
+			this->grow();
+		Cell * cell = this->freeList;
+		this->freeList = cell->Next;
+		this->live++;
+		return new (cell->Storage) T(std::forward<Args>(args)...);
+	}
+
+	void Destroy(T * object)
+	{
+		if (!object)
+			return;
+		object->~T();
+		Cell * cell = reinterpret_cast<Cell *>(object);
+		cell->Next = this->freeList;
+		this->freeList = cell;
+		this->live--;
+	}
+
+	// Заранее выделить ячейки хотя бы под count объектов
+	void Reserve(size_t count)
+	{
+		while (this->Capacity() < count)
+			this->grow();
+	}
+
+	size_t Live() const { return this->live; }
+	size_t Capacity() const { return this->chunks.size() * ChunkSize; }
+
+	private:
+	union Cell
+	{
+		Cell * Next;
+		alignas(T) unsigned char Storage[sizeof(T)];
+	};
+
+	std::vector<std::unique_ptr<Cell[]>> chunks;
+	Cell * freeList = nullptr;
+	size_t live = 0;
+
+	void grow()
+	{
+		Cell * chunk = new Cell[ChunkSize];
+		this->chunks.emplace_back(chunk);
+		for (size_t i = ChunkSize; i-- > 0;)
+		{
+			chunk[i].Next = this->freeList;
+			this->freeList = &chunk[i];
+		}
+	}
+};
+
+#endif
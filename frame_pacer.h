@@ -0,0 +1,190 @@
+// Темп кадров и фиксированный шаг симуляции.
+//
+// FramePacer ограничивает частоту кадров (TargetFps) ожиданием "сон, затем активное
+// ожидание": большую часть времени поток спит и не занимает ядро, а последние SpinMs
+// миллисекунд крутится в цикле, потому что планировщик ОС будит поток с опозданием.
+// Вертикальная синхронизация настраивается отдельно (AppWindow::SetSwapInterval) и с
+// ограничением частоты сочетается: например, vsync выключен, а кадры идут ровно по 8.3 мс.
+//
+// Симуляция отвязана от отрисовки: BeginFrame возвращает, сколько шагов длиной StepSeconds
+// накопилось с прошлого кадра, а Alpha - долю следующего шага для интерполяции при отрисовке.
+// Гистограммы интервалов между кадрами и времени ожидания позволяют сравнить режимы
+// (задержка против загрузки CPU) на конкретной машине.
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Гистограмма времён с корзинами фиксированной ширины; всё дальше последней корзины - в неё
+class FrameHistogram
+{
+	public:
+	explicit FrameHistogram(double bucketMs = 0.5, int buckets = 100) : BucketMs(bucketMs), counts(buckets, 0) {}
+
+	double BucketMs;
+
+	void Add(double ms)
+	{
+		int bucket = std::min((int)(ms / this->BucketMs), (int)this->counts.size() - 1);
+		this->counts[std::max(bucket, 0)]++;
+		this->total++;
+	}
+
+	// Перцентиль по верхней границе корзины (p от 0 до 1)
+	double Percentile(double p) const
+	{
+		long long target = (long long)(p * this->total + 0.5), seen = 0;
+		for (size_t bucket = 0; bucket < this->counts.size(); bucket++)
+		{
+			seen += this->counts[bucket];
+			if (seen >= target && seen > 0)
+				return (bucket + 1) * this->BucketMs;
+		}
+		return 0.0;
+	}
+
+	// Непустые корзины в виде "нижняя_граница:число,..."
+	void Report(std::ostream & out, const char * label) const
+	{
+		out << std::fixed << std::setprecision(1) << label << "_hist=";
+		bool first = true;
+		for (size_t bucket = 0; bucket < this->counts.size(); bucket++)
+		{
+			if (!this->counts[bucket])
+				continue;
+			out << (first ? "" : ",") << bucket * this->BucketMs << ":" << this->counts[bucket];
+			first = false;
+		}
+	}
+
+	private:
+	std::vector<long long> counts;
+	long long total = 0;
+};
+
+class FramePacer
+{
+	public:
+	typedef std::chrono::steady_clock Clock;
+
+	// Предел частоты кадров (0 - без ограничения)
+	double TargetFps = 0.0;
+	// Сколько последних миллисекунд ожидания крутиться, а не спать
+	double SpinMs = 1.0;
+	// Шаг симуляции и предел шагов за кадр: после долгой паузы (отладчик, перетаскивание
+	// окна) симуляция не пытается догнать всё пропущенное время разом
+	double StepSeconds = 1.0 / 120.0;
+	int MaxStepsPerFrame = 8;
+	// Ровно один шаг на кадр независимо от прошедшего времени: сцена в N-м кадре одна и та
+	// же на любой машине (сравнение с эталонными изображениями)
+	bool FixedStep = false;
+
+	// Интервалы между началами кадров, время работы кадра и время ожидания
+	FrameHistogram Intervals, Work, Waits;
+	double SleepMs = 0.0, SpinTotalMs = 0.0;
+	long long Frames = 0, Steps = 0, DroppedSteps = 0;
+
+	// Начало кадра: возвращает число шагов симуляции, которые нужно выполнить
+	int BeginFrame()
+	{
+		Clock::time_point now = Clock::now();
+		if (this->Frames > 0)
+		{
+			double interval = std::chrono::duration<double>(now - this->frameStart).count();
+			this->Intervals.Add(interval * 1000.0);
+			this->accumulator += interval;
+		}
+		else
+			this->deadline = now;
+		this->frameStart = now;
+		this->Frames++;
+		if (this->FixedStep)
+		{
+			this->accumulator = 0.0;
+			this->Steps++;
+			return 1;
+		}
+
+		int steps = (int)(this->accumulator / this->StepSeconds);
+		if (steps > this->MaxStepsPerFrame)
+		{
+			this->DroppedSteps += steps - this->MaxStepsPerFrame;
+			this->accumulator -= (steps - this->MaxStepsPerFrame) * this->StepSeconds;
+			steps = this->MaxStepsPerFrame;
+		}
+		this->accumulator -= steps * this->StepSeconds;
+		this->Steps += steps;
+		return steps;
+	}
+
+	// Доля следующего шага, прошедшая к моменту кадра (0..1), для интерполяции состояния
+	double Alpha() const { return this->accumulator / this->StepSeconds; }
+
+	// Конец кадра (после SwapBuffers): ожидание до следующего срока при заданном TargetFps
+	void EndFrame()
+	{
+		Clock::time_point now = Clock::now();
+		this->Work.Add(std::chrono::duration<double, std::milli>(now - this->frameStart).count());
+		if (this->TargetFps <= 0.0)
+		{
+			this->Waits.Add(0.0);
+			return;
+		}
+
+		// Сроки идут от предыдущего срока, а не от "сейчас", чтобы не накапливался дрейф.
+		// Если кадр опоздал больше чем на период, догонять не пытаемся.
+		Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / this->TargetFps));
+		this->deadline += period;
+		if (this->deadline + period < now)
+			this->deadline = now;
+
+		Clock::time_point spinFrom = this->deadline -
+			std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(this->SpinMs));
+		if (now < spinFrom)
+		{
+			std::this_thread::sleep_until(spinFrom);
+			Clock::time_point woke = Clock::now();
+			this->SleepMs += std::chrono::duration<double, std::milli>(woke - now).count();
+		}
+		Clock::time_point spinStart = Clock::now();
+		while (Clock::now() < this->deadline)
+			std::this_thread::yield();
+		Clock::time_point end = Clock::now();
+		if (end > spinStart)
+			this->SpinTotalMs += std::chrono::duration<double, std::milli>(end - spinStart).count();
+		this->Waits.Add(std::chrono::duration<double, std::milli>(end - now).count());
+	}
+
+	void Report(std::ostream & out, const char * mode) const
+	{
+		out << std::fixed << std::setprecision(3)
+			<< "frame_pacer mode=" << mode
+			<< " target_fps=" << this->TargetFps
+			<< " step_hz=" << 1.0 / this->StepSeconds
+			<< " frames=" << this->Frames
+			<< " steps=" << this->Steps
+			<< " dropped_steps=" << this->DroppedSteps
+			<< " interval_p50_ms=" << this->Intervals.Percentile(0.5)
+			<< " interval_p99_ms=" << this->Intervals.Percentile(0.99)
+			<< " sleep_ms=" << this->SleepMs
+			<< " spin_ms=" << this->SpinTotalMs << std::endl;
+		this->Intervals.Report(out, "frame_pacer interval");
+		out << std::endl;
+		this->Work.Report(out, "frame_pacer work");
+		out << std::endl;
+		this->Waits.Report(out, "frame_pacer wait");
+		out << std::endl;
+	}
+
+	private:
+	Clock::time_point frameStart, deadline;
+	double accumulator = 0.0;
+};
+
+#endif
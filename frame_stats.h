@@ -0,0 +1,112 @@
+// Статистика времени кадра: минимум, медиана, 99-й перцентиль, а также
+// количество вызовов отрисовки и треугольников в секунду.
+// Перцентили считаются по кольцевому окну последних кадров (4096 или весь прогон из
+// Reserve), чтобы история не росла без конца в оконной сессии; число кадров, время и
+// вызовы отрисовки копятся за весь прогон.
+
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+class FrameStats
+{
+	public:
+	// Кадры до WarmupFrames не попадают в выборку
+	int WarmupFrames = 0;
+	FrameStats() { this->frameTimes.reserve(this->historyFrames); }
+
+	// Прогон на frames кадров целиком помещается в окно
+	void Reserve(int frames)
+	{
+		this->historyFrames = std::max(this->historyFrames, (size_t)std::max(frames, 0));
+		this->frameTimes.reserve(this->historyFrames);
+	}
+
+	void BeginFrame()
+	{
+		this->frameDrawCalls = 0;
+		this->frameTriangles = 0;
+		this->frameStart = std::chrono::steady_clock::now();
+	}
+
+	// Вызывается после каждого glDraw* в кадре
+	void CountDraw(long long triangles)
+	{
+		this->frameDrawCalls++;
+		this->frameTriangles += triangles;
+	}
+
+	// То же сразу для draws вызовов по trianglesEach треугольников (пакет команд)
+	void CountDraws(long long draws, long long trianglesEach)
+	{
+		this->frameDrawCalls += draws;
+		this->frameTriangles += draws * trianglesEach;
+	}
+
+	void EndFrame()
+	{
+		double ms = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - this->frameStart).count();
+		if (this->frameIndex++ < this->WarmupFrames)
+			return;
+		if (this->frameTimes.size() < this->historyFrames)
+			this->frameTimes.push_back(ms);
+		else
+		{
+			// Окно заполнено: новый кадр занимает место самого старого
+			this->frameTimes[this->oldest] = ms;
+			this->oldest = (this->oldest + 1) % this->frameTimes.size();
+		}
+		this->frames++;
+		this->totalMs += ms;
+		this->totalDrawCalls += this->frameDrawCalls;
+		this->totalTriangles += this->frameTriangles;
+	}
+
+	// Перцентиль по отсортированной копии окна (p от 0 до 1)
+	double Percentile(double p) const
+	{
+		if (this->frameTimes.empty())
+			return 0.0;
+		std::vector<double> sorted(this->frameTimes);
+		std::sort(sorted.begin(), sorted.end());
+		size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+		return sorted[index];
+	}
+
+	double TotalMs() const { return this->totalMs; }
+
+	// Вывод в виде "ключ=значение", чтобы прогоны на разных коммитах было легко сравнивать
+	void Report(std::ostream & out, const char * label) const
+	{
+		double seconds = this->TotalMs() / 1000.0;
+		out << std::fixed << std::setprecision(3)
+			<< label
+			<< " frames=" << this->frames
+			<< " min_ms=" << this->Percentile(0.0)
+			<< " median_ms=" << this->Percentile(0.5)
+			<< " p99_ms=" << this->Percentile(0.99)
+			<< " max_ms=" << this->Percentile(1.0)
+			<< std::setprecision(0)
+			<< " draws_per_sec=" << (seconds > 0.0 ? this->totalDrawCalls / seconds : 0.0)
+			<< " tris_per_sec=" << (seconds > 0.0 ? this->totalTriangles / seconds : 0.0)
+			<< std::endl;
+	}
+
+	private:
+	std::vector<double> frameTimes;
+	size_t historyFrames = 4096, oldest = 0;
+	long long frames = 0;
+	double totalMs = 0.0;
+	std::chrono::steady_clock::time_point frameStart;
+	int frameIndex = 0;
+	long long frameDrawCalls = 0, frameTriangles = 0;
+	long long totalDrawCalls = 0, totalTriangles = 0;
+};
+
+#endif
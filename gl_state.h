@@ -0,0 +1,292 @@
+// Отслеживание состояния OpenGL. Приложение вызывает методы GlState вместо glUseProgram,
+// glActiveTexture, glBindTexture, glBindVertexArray, glBindBufferRange (uniform-блоки) и
+// glUniform*, а GlState помнит, что
+// уже установлено, и не передаёт драйверу вызовы, которые ничего не меняют. Положения
+// uniform-переменных кешируются для каждой программы, так что glGetUniformLocation
+// вызывается один раз на имя. Счётчики показывают, сколько вызовов удалось сэкономить.
+//
+// Если состояние меняет код, который о GlState не знает, после него нужно вызвать
+// Invalidate(): трекер забудет привязки и выставит их заново при следующем обращении.
+// Значения uniform-переменных хранятся в самой программе и от привязок не зависят;
+// их кеш сбрасывается только ForgetProgram (после удаления или пересборки программы).
+
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+
+class GlState
+{
+	public:
+	// Виды отслеживаемых вызовов
+	enum Call { CallUseProgram, CallActiveTexture, CallBindTexture, CallBindVertexArray, CallBindUniformRange, CallUniform, CallUniformLocation, CallCount };
+
+	// Сколько вызовов передано драйверу и сколько пропущено - за текущий кадр и всего
+	long long FrameIssued[CallCount] = {}, FrameAvoided[CallCount] = {};
+	long long TotalIssued[CallCount] = {}, TotalAvoided[CallCount] = {};
+	int Frames = 0;
+
+	GlState() { this->Invalidate(); }
+
+	void BeginFrame()
+	{
+		memset(this->FrameIssued, 0, sizeof(this->FrameIssued));
+		memset(this->FrameAvoided, 0, sizeof(this->FrameAvoided));
+		this->Frames++;
+	}
+
+	// Забыть все привязки (кеш положений и значений uniform остаётся)
+	void Invalidate()
+	{
+		this->program = unknown;
+		this->current = nullptr;
+		this->activeUnit = unknown;
+		this->vertexArray = unknown;
+		for (UniformRange & range : this->uniformRanges)
+			range.Buffer = unknown;
+		for (int unit = 0; unit < maxUnits; unit++)
+			for (int slot = 0; slot < targetCount; slot++)
+				this->textures[unit][slot] = unknown;
+	}
+
+	// Забыть всё о программе: её удалили или пересобрали под тем же идентификатором
+	void ForgetProgram(GLuint program)
+	{
+		this->programs.erase(program);
+		if (this->program == program)
+		{
+			this->program = unknown;
+			this->current = nullptr;
+		}
+	}
+
+	void UseProgram(GLuint program)
+	{
+		if (this->program == program)
+		{
+			this->avoided(CallUseProgram);
+			return;
+		}
+		glUseProgram(program);
+		this->issued(CallUseProgram);
+		this->program = program;
+		this->current = &this->programs[program];
+	}
+
+	void ActiveTexture(GLuint unit)
+	{
+		if (this->activeUnit == unit)
+		{
+			this->avoided(CallActiveTexture);
+			return;
+		}
+		glActiveTexture(GL_TEXTURE0 + unit);
+		this->issued(CallActiveTexture);
+		this->activeUnit = unit;
+	}
+
+	// Привязка текстуры к блоку unit. glActiveTexture вызывается, только если привязка
+	// действительно меняется.
+	void BindTexture(GLuint unit, GLenum target, GLuint texture)
+	{
+		int slot = targetSlot(target);
+		if (unit < (GLuint)maxUnits && slot >= 0 && this->textures[unit][slot] == texture)
+		{
+			this->avoided(CallBindTexture);
+			return;
+		}
+		this->ActiveTexture(unit);
+		glBindTexture(target, texture);
+		this->issued(CallBindTexture);
+		if (unit < (GLuint)maxUnits && slot >= 0)
+			this->textures[unit][slot] = texture;
+	}
+
+	void BindVertexArray(GLuint vertexArray)
+	{
+		if (this->vertexArray == vertexArray)
+		{
+			this->avoided(CallBindVertexArray);
+			return;
+		}
+		glBindVertexArray(vertexArray);
+		this->issued(CallBindVertexArray);
+		this->vertexArray = vertexArray;
+	}
+
+	// Диапазон буфера для uniform-блока в точке привязки binding (glBindBufferRange)
+	void BindUniformRange(GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size)
+	{
+		if (binding < (GLuint)maxUniformBindings)
+		{
+			UniformRange & range = this->uniformRanges[binding];
+			if (range.Buffer == buffer && range.Offset == offset && range.Size == size)
+			{
+				this->avoided(CallBindUniformRange);
+				return;
+			}
+			range = { buffer, offset, size };
+		}
+		glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+		this->issued(CallBindUniformRange);
+	}
+
+	// Положение uniform-переменной из кеша программы
+	GLint UniformLocation(GLuint program, const char * name)
+	{
+		ProgramState & state = this->program == program && this->current ? *this->current : this->programs[program];
+		auto found = state.Locations.find(name);
+		if (found != state.Locations.end())
+		{
+			this->avoided(CallUniformLocation);
+			return found->second;
+		}
+		GLint location = glGetUniformLocation(program, name);
+		this->issued(CallUniformLocation);
+		state.Locations.emplace(name, location);
+		return location;
+	}
+
+	// glUniform* для текущей программы; значение не передаётся, если оно уже такое
+	void Uniform1i(GLint location, GLint value)
+	{
+		uint32_t bits[4] = { (uint32_t)value, 0, 0, 0 };
+		if (this->unchanged(location, bits))
+			return;
+		glUniform1i(location, value);
+	}
+
+	void Uniform1f(GLint location, GLfloat value)
+	{
+		uint32_t bits[4] = { 0, 0, 0, 0 };
+		memcpy(bits, &value, sizeof(value));
+		if (this->unchanged(location, bits))
+			return;
+		glUniform1f(location, value);
+	}
+
+	void Uniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+	{
+		const GLfloat values[4] = { x, y, z, w };
+		uint32_t bits[4];
+		memcpy(bits, values, sizeof(bits));
+		if (this->unchanged(location, bits))
+			return;
+		glUniform4f(location, x, y, z, w);
+	}
+
+	// Средние за кадр числа вызовов: всего переданных, пропущенных и по видам
+	void Report(std::ostream & out) const
+	{
+		static const char * names[CallCount] = {
+			"use_program", "active_texture", "bind_texture", "bind_vertex_array", "bind_uniform_range", "uniform", "uniform_location"
+		};
+		long long issued = 0, avoided = 0;
+		for (int call = 0; call < CallCount; call++)
+		{
+			issued += this->TotalIssued[call];
+			avoided += this->TotalAvoided[call];
+		}
+		double frames = this->Frames > 0 ? this->Frames : 1;
+		out << std::fixed << std::setprecision(2)
+			<< "gl_state frames=" << this->Frames
+			<< " issued_per_frame=" << issued / frames
+			<< " avoided_per_frame=" << avoided / frames;
+		for (int call = 0; call < CallCount; call++)
+			out << " avoided_" << names[call] << "=" << this->TotalAvoided[call] / frames;
+		out << std::endl;
+	}
+
+	private:
+	static const GLuint unknown = ~0u;
+	static const int maxUnits = 16;
+	static const int targetCount = 4;
+	static const int maxUniformBindings = 8;
+
+	struct ProgramState
+	{
+		std::unordered_map<std::string, GLint> Locations;
+		// Последние переданные значения по положению uniform-переменной
+		std::vector<uint32_t> Values;
+		std::vector<bool> Known;
+	};
+
+	GLuint program, activeUnit, vertexArray;
+	GLuint textures[maxUnits][targetCount];
+	struct UniformRange
+	{
+		GLuint Buffer;
+		GLintptr Offset;
+		GLsizeiptr Size;
+	};
+	UniformRange uniformRanges[maxUniformBindings];
+	ProgramState * current = nullptr;
+	std::unordered_map<GLuint, ProgramState> programs;
+
+	static int targetSlot(GLenum target)
+	{
+		switch (target)
+		{
+			case GL_TEXTURE_2D: return 0;
+			case GL_TEXTURE_2D_ARRAY: return 1;
+			case GL_TEXTURE_CUBE_MAP: return 2;
+			case GL_TEXTURE_3D: return 3;
+		}
+		return -1;
+	}
+
+	void issued(Call call)
+	{
+		this->FrameIssued[call]++;
+		this->TotalIssued[call]++;
+	}
+
+	void avoided(Call call)
+	{
+		this->FrameAvoided[call]++;
+		this->TotalAvoided[call]++;
+	}
+
+	// Проверяет кеш значений текущей программы и запоминает новое значение.
+	// Без известной текущей программы кешировать не к чему - вызов передаётся всегда.
+	bool unchanged(GLint location, const uint32_t bits[4])
+	{
+		if (location < 0)
+		{
+			// glUniform с положением -1 ничего не делает
+			this->avoided(CallUniform);
+			return true;
+		}
+		if (!this->current)
+		{
+			this->issued(CallUniform);
+			return false;
+		}
+		ProgramState & state = *this->current;
+		if ((size_t)location >= state.Known.size())
+		{
+			state.Known.resize(location + 1, false);
+			state.Values.resize((location + 1) * 4, 0);
+		}
+		uint32_t * cached = &state.Values[location * 4];
+		if (state.Known[location] && !memcmp(cached, bits, 4 * sizeof(uint32_t)))
+		{
+			this->avoided(CallUniform);
+			return true;
+		}
+		memcpy(cached, bits, 4 * sizeof(uint32_t));
+		state.Known[location] = true;
+		this->issued(CallUniform);
+		return false;
+	}
+};
+
+#endif
@@ -0,0 +1,301 @@
+// Отрисовка объектов сцены силами GPU (GPU-driven rendering). Параметры всех объектов
+// один раз загружаются в буфер хранения (SSBO). Каждый кадр вычислительный шейдер
+// двигает объекты (та же кривая, что animateObject), отсекает невидимые и записывает
+// команды DrawElementsIndirectCommand в буфер. Затем всё рисуется одним
+// glMultiDrawElementsIndirect. Работа CPU за кадр - несколько вызовов OpenGL
+// независимо от числа объектов.
+//
+// С GL_ARB_indirect_parameters (или OpenGL 4.6) видимые команды сжимаются в начало
+// буфера атомарным счётчиком, а число команд берётся из буфера параметров
+// (glMultiDrawElementsIndirectCount). Без него невидимые команды остаются на местах с
+// instanceCount = 0.
+//
+// Нужны OpenGL 4.3 (или вычислительные шейдеры, SSBO и multi draw indirect как
+// расширения). Если их нет, остаётся обычный путь через CommandQueue.
+//
+// Номер объекта попадает в вершинный шейдер через baseInstance: атрибут objectIndex
+// читается с делителем 1 из буфера 0, 1, 2, ..., и для команды i равен i.
+
+#ifndef GPU_DRIVEN_H
+#define GPU_DRIVEN_H
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "gl_state.h"
+#include "scene_objects.h"
+#include "shader.h"
+#include "vertex_layout.h"
+
+inline constexpr const GLchar * gpuCullComputeShaderSource = "#version 430 core\n"
+	"layout (local_size_x = 64) in;\n"
+	"struct Object { vec4 Motion; vec4 Home; };\n"
+	"struct Command { uint Count; uint InstanceCount; uint FirstIndex; int BaseVertex; uint BaseInstance; };\n"
+	"layout (std430, binding = 0) readonly buffer Objects { Object objects[]; };\n"
+	"layout (std430, binding = 1) writeonly buffer Transforms { vec4 transforms[]; };\n"
+	"layout (std430, binding = 2) writeonly buffer Commands { Command commands[]; };\n"
+	"layout (std430, binding = 3) buffer Parameters { uint drawCount; };\n"
+	"uniform uint objectCount;\n"
+	"uniform uint indexCount;\n"
+	"uniform float time;\n"
+	// xy - камера, zw - половина видимой области
+	"uniform vec4 view;\n"
+	"uniform bool compact;\n"
+	"void main()\n"
+	"{\n"
+	"uint i = gl_GlobalInvocationID.x;\n"
+	"if (i >= objectCount)\n"
+	"	return;\n"
+	// Motion = (фаза, скорость, размер, номер текстуры)
+	"vec4 motion = objects[i].Motion;\n"
+	"float t = time * motion.y + motion.x;\n"
+	"vec2 p = vec2(0.0);\n"
+	"for (int harmonic = 1; harmonic <= 8; harmonic++)\n"
+	"{\n"
+	"	float weight = 0.9 / (float(harmonic) * 2.7);\n"
+	"	p.x += weight * sin(t * float(harmonic) + motion.x * 0.5);\n"
+	"	p.y += weight * cos(t * float(harmonic + 1) * 0.7);\n"
+	"}\n"
+	"p += objects[i].Home.xy - view.xy;\n"
+	"transforms[i] = vec4(p, motion.z, t);\n"
+	"bool visible = all(lessThanEqual(abs(p), view.zw + vec2(motion.z * 0.71)));\n"
+	"if (visible)\n"
+	"{\n"
+	"	uint slot = atomicAdd(drawCount, 1u);\n"
+	"	if (compact)\n"
+	"		commands[slot] = Command(indexCount, 1u, 0u, 0, i);\n"
+	"}\n"
+	"if (!compact)\n"
+	"	commands[i] = Command(indexCount, visible ? 1u : 0u, 0u, 0, i);\n"
+	"}\0";
+
+inline constexpr const GLchar * gpuDrivenVertexShaderSource = "#version 430 core\n"
+	"layout (location = 0) in vec3 position;\n"
+	"layout (location = 2) in vec2 texCoord;\n"
+	"layout (location = 3) in uint objectIndex;\n"
+	"struct Object { vec4 Motion; vec4 Home; };\n"
+	"layout (std430, binding = 0) readonly buffer Objects { Object objects[]; };\n"
+	"layout (std430, binding = 1) readonly buffer Transforms { vec4 transforms[]; };\n"
+	"out vec2 TexCoord;\n"
+	"flat out int TextureIndex;\n"
+	"void main()\n"
+	"{\n"
+	"vec4 transform = transforms[objectIndex];\n"
+	"float c = cos(transform.w), s = sin(transform.w);\n"
+	"gl_Position = vec4(mat2(c, s, -s, c) * position.xy * transform.z + transform.xy, 0.0, 1.0);\n"
+	"TexCoord = texCoord;\n"
+	"TextureIndex = int(objects[objectIndex].Motion.w);\n"
+	"}\0";
+
+// Текстура выбирается после выборки из всех четырёх: индекс сэмплера обязан быть
+// одинаковым для всех вызовов шейдера, а TextureIndex меняется от объекта к объекту
+inline constexpr const GLchar * gpuDrivenFragmentShaderSource = "#version 430 core\n"
+	"in vec2 TexCoord;\n"
+	"flat in int TextureIndex;\n"
+	"out vec4 color;\n"
+	"uniform sampler2D objectTextures[4];\n"
+	"void main()\n"
+	"{\n"
+	"vec4 texels[4] = vec4[4](texture(objectTextures[0], TexCoord), texture(objectTextures[1], TexCoord),\n"
+	"						 texture(objectTextures[2], TexCoord), texture(objectTextures[3], TexCoord));\n"
+	"color = texels[TextureIndex];\n"
+	"}\n\0";
+
+class GpuDrivenScene
+{
+	public:
+	static const int MaxTextures = 4;
+
+	// Сжатие команд и число команд из буфера параметров
+	bool Compact = false;
+	// Время CPU на кадр (запуск вычислений и отрисовки) и число видимых объектов
+	// последнего кадра, прочитанное в Report
+	double CpuMs = 0.0, TotalCpuMs = 0.0;
+	long long Frames = 0;
+	GLuint Objects = 0;
+
+	static bool Supported()
+	{
+		return GLEW_VERSION_4_3 ||
+			   (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_multi_draw_indirect);
+	}
+
+	static bool CountSupported()
+	{
+		return GLEW_VERSION_4_6 || GLEW_ARB_indirect_parameters;
+	}
+
+	// Объекты со своими центрами и параметрами движения; текстура объекта - одна из textures
+	// (не больше MaxTextures), по совпадению с SceneObject::Texture
+	bool Create(const SceneObjectList & objects, const std::vector<GLuint> & textures)
+	{
+		if (!Supported())
+		{
+			std::cout << "WARNING::GPU_DRIVEN::NOT_SUPPORTED" << std::endl;
+			return false;
+		}
+		this->cullProgram = buildComputeProgram(gpuCullComputeShaderSource);
+		this->drawProgram = buildProgram(gpuDrivenVertexShaderSource, gpuDrivenFragmentShaderSource);
+		if (!this->cullProgram || !this->drawProgram)
+		{
+			// Удаляем ту программу, что успела собраться: main уйдёт на путь через CPU
+			this->Destroy();
+			return false;
+		}
+		this->Compact = CountSupported();
+		this->Objects = (GLuint)objects.size();
+		this->textures.assign(textures.begin(), textures.begin() + std::min<size_t>(textures.size(), MaxTextures));
+
+		std::vector<GLfloat> parameters;
+		std::vector<GLuint> identity(objects.size());
+		parameters.reserve(objects.size() * 8);
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			const SceneObject & object = *objects[i];
+			size_t texture = std::find(this->textures.begin(), this->textures.end(), object.Texture) - this->textures.begin();
+			const GLfloat values[8] = { object.Phase, object.Speed, object.Size, (GLfloat)(texture % MaxTextures),
+										object.HomeX, object.HomeY, 0.0f, 0.0f };
+			parameters.insert(parameters.end(), values, values + 8);
+			identity[i] = (GLuint)i;
+		}
+
+		glGenBuffers(BufferCount, this->buffers);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->buffers[ObjectBuffer]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, parameters.size() * sizeof(GLfloat), parameters.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->buffers[TransformBuffer]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, objects.size() * 4 * sizeof(GLfloat), NULL, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->buffers[CommandBuffer]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, objects.size() * 5 * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->buffers[ParameterBuffer]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		// Тот же четырёхугольник, что в main, и номер объекта как атрибут экземпляра
+		const Fp32Vertex quad[] = {
+			{ { 0.5f, 0.5f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } },
+			{ { 0.5f, -0.5f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 0.0f } },
+			{ { -0.5f, -0.5f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f } },
+			{ { -0.5f, 0.5f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 1.0f } }
+		};
+		const GLuint indices[] = { 0, 1, 3, 1, 2, 3 };
+		this->indexCount = 6;
+		glGenVertexArrays(1, &this->vertexArray);
+		glBindVertexArray(this->vertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, this->buffers[VertexBuffer]);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->buffers[IndexBuffer]);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+		Fp32VertexLayout::Apply();
+		glBindBuffer(GL_ARRAY_BUFFER, this->buffers[InstanceBuffer]);
+		glBufferData(GL_ARRAY_BUFFER, identity.size() * sizeof(GLuint), identity.data(), GL_STATIC_DRAW);
+		glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(GLuint), (GLvoid*)0);
+		glEnableVertexAttribArray(3);
+		glVertexAttribDivisor(3, 1);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		glUseProgram(this->drawProgram);
+		for (int unit = 0; unit < MaxTextures; unit++)
+		{
+			std::string name = "objectTextures[" + std::to_string(unit) + "]";
+			glUniform1i(glGetUniformLocation(this->drawProgram, name.c_str()), unit);
+		}
+		glUseProgram(this->cullProgram);
+		this->locations[0] = glGetUniformLocation(this->cullProgram, "objectCount");
+		this->locations[1] = glGetUniformLocation(this->cullProgram, "indexCount");
+		this->locations[2] = glGetUniformLocation(this->cullProgram, "time");
+		this->locations[3] = glGetUniformLocation(this->cullProgram, "view");
+		this->locations[4] = glGetUniformLocation(this->cullProgram, "compact");
+		glUseProgram(0);
+		return true;
+	}
+
+	// Кадр: отсечение и запись команд на GPU, затем одна отрисовка всех команд.
+	// Привязки программ, текстур и VAO идут через state, чтобы трекер не терял их.
+	void Draw(GlState & state, float time, float cameraX, float cameraY)
+	{
+		auto start = std::chrono::steady_clock::now();
+		const GLuint zero = 0;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->buffers[ParameterBuffer]);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		for (GLuint binding = 0; binding < 4; binding++)
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, this->buffers[ObjectBuffer + binding]);
+
+		state.UseProgram(this->cullProgram);
+		glUniform1ui(this->locations[0], this->Objects);
+		glUniform1ui(this->locations[1], this->indexCount);
+		glUniform1f(this->locations[2], time);
+		glUniform4f(this->locations[3], cameraX, cameraY, 1.0f, 1.0f);
+		glUniform1i(this->locations[4], this->Compact ? 1 : 0);
+		glDispatchCompute((this->Objects + 63) / 64, 1, 1);
+		// Команды читаются как косвенные аргументы, преобразования - как SSBO, а счётчик
+		// видимых - ещё и через glGetBufferSubData (VisibleCount) и glBufferSubData следующего кадра
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+		state.UseProgram(this->drawProgram);
+		for (size_t unit = 0; unit < this->textures.size(); unit++)
+			state.BindTexture((GLuint)unit, GL_TEXTURE_2D, this->textures[unit]);
+		state.BindVertexArray(this->vertexArray);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->buffers[CommandBuffer]);
+		if (this->Compact)
+		{
+			glBindBuffer(GL_PARAMETER_BUFFER_ARB, this->buffers[ParameterBuffer]);
+			glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, (GLvoid*)0, 0, this->Objects, 0);
+			glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+		}
+		else
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (GLvoid*)0, this->Objects, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+		this->CpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		this->TotalCpuMs += this->CpuMs;
+		this->Frames++;
+	}
+
+	// Число видимых объектов последнего кадра (ожидает GPU)
+	GLuint VisibleCount() const
+	{
+		GLuint count = 0;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->buffers[ParameterBuffer]);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &count);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		return count;
+	}
+
+	void Report(std::ostream & out) const
+	{
+		out << std::fixed << std::setprecision(3)
+			<< "gpu_driven objects=" << this->Objects
+			<< " visible=" << this->VisibleCount()
+			<< " count_buffer=" << (this->Compact ? "on" : "off")
+			<< " cpu_ms=" << this->TotalCpuMs / std::max(1LL, this->Frames) << std::endl;
+	}
+
+	void Destroy()
+	{
+		glDeleteProgram(this->cullProgram);
+		glDeleteProgram(this->drawProgram);
+		glDeleteVertexArrays(1, &this->vertexArray);
+		glDeleteBuffers(BufferCount, this->buffers);
+		this->cullProgram = this->drawProgram = this->vertexArray = 0;
+	}
+
+	private:
+	// Первые четыре идут подряд: их номера совпадают с точками привязки SSBO в шейдерах
+	enum { ObjectBuffer, TransformBuffer, CommandBuffer, ParameterBuffer, VertexBuffer, IndexBuffer, InstanceBuffer, BufferCount };
+
+	GLuint cullProgram = 0, drawProgram = 0, vertexArray = 0;
+	GLuint buffers[BufferCount] = {};
+	GLint locations[5] = {};
+	GLuint indexCount = 0;
+	std::vector<GLuint> textures;
+};
+
+#endif
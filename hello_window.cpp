@@ -2,124 +2,55 @@
 // GLEW
 #include <iostream>
 #include <cmath>
+#include <memory>
 #include <SOIL/SOIL.h>
 
-// Делаем свой класс шейдера
-// Пользуемся директивами ifndef и define, чтобы избежать рекурсивного выполнения директив include
-
-#ifndef SHADER_H
-#define SHADER_H
-
-#include <string>
-#include <fstream>
-#include <sstream>
-#include <iostream>
-
-#include <GL/glew.h> // Подключаем glew для того, чтобы получить все необходимые заголовочные файлы
-
-class Shader
-{
-	public:
-	// Идентификатор программы
-	GLuint Program;
-	// Конструктор считывает и собирает шейдер
-	// Shader(const GLchar * vertexPath, const GLchar * fragmentPath);
-	// Использование программы
-	// void Use();
-
-	// Считывание файла шейдера. Для считывания используем стандартные потоки C++, помещая
-	// результат в строки.
-	Shader(const GLchar * vertexPath, const GLchar * fragmentPath)
-	{
-		// 1. Получаем исходный код шейдера из filePath
-		std::string vertexCode;
-		std::string fragmentCode;
-		std::ifstream vShaderFile;
-		std::ifstream fShaderFile;
-
-		// Удостоверимся, что ifstream объекты могут выкидывать исключения
-		vShaderFile.exceptions(std::ifstream::badbit);
-		fShaderFile.exceptions(std::ifstream::badbit);
-
-		try
-		{
-			// Открываем файлы
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentPath);
-			std::stringstream vShaderStream, fShaderStream;
-			// Считываем данные в потоки
-			vShaderStream << vShaderFile.rdbuf();
-			fShaderStream << fShaderFile.rdbuf();
-			// Закрываем файлы
-			vShaderFile.close();
-			fShaderFile.close();
-			// Преобразовываем потоки в массив GLchar
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
-		}
-		catch(std::ifstream::failure e)
-		{
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-		}
-		const GLchar * vShaderCode = vertexCode.c_str();
-		const GLchar * fShaderCode = fragmentCode.c_str();
-
-		// Теперь нужно скомпилировать и слинковать шейдер.
-		// 2. Сборка шейдеров
-		GLuint vertex, fragment;
-		GLint success;
-		GLchar infoLog[512];
-
-		// Вершинный шейдер
-		vertex = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertex, 1, &vShaderCode, NULL);
-		glCompileShader(vertex);
-		// Если есть ошибки, то вывести их
-		glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-
-		if (!success)
-		{
-			glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-		}
-
-		fragment = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragment, 1, &fShaderCode, NULL);
-		glCompileShader(fragment);
-		glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-
-		if (!success)
-		{
-			glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-		}
-
-		// Шейдерная программа 
-		this->Program = glCreateProgram();
-		glAttachShader(this->Program, vertex);
-		glAttachShader(this->Program, fragment);
-		glLinkProgram(this->Program);
-		
-		// Если есть ошибки, то вывести их
-		glGetProgramiv(this->Program, GL_LINK_STATUS, &success);
-		if (!success)
-		{
-			glGetProgramInfoLog(this->Program, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-		}
-		glDeleteShader(vertex);
-		glDeleteShader(fragment);
-	}
-
-	void Use() { glUseProgram(this->Program); }
-};
-
-#endif
-
-#define GLEW_STATIC
-#include <GL/glew.h>
-// GLFW
-#include <GLFW/glfw3.h>
+// Класс шейдера и кеш шейдерных программ
+#include "shader_cache.h"
+// Варианты шейдера из одного исходника по маске возможностей
+#include "shader_variants.h"
+// Горячая перезагрузка шейдеров
+#include "shader_reload.h"
+// Фоновая загрузка текстур
+#include "texture_loader.h"
+// и потоковая загрузка уровней мипмапов в пределах бюджета видеопамяти
+#include "texture_streaming.h"
+// Процедурные текстуры вместо pics/ для эталонов (--test-textures)
+#include "test_textures.h"
+
+// GLEW и GLFW (или EGL в безоконной сборке) подключаются в app_window.h
+#include "app_window.h"
+#include "frame_stats.h"
+// Темп кадров и фиксированный шаг симуляции
+#include "frame_pacer.h"
+// Таймеры CPU/GPU с выгрузкой в Chrome trace и CSV
+#include "profiler.h"
+// Пакетная отрисовка спрайтов (--sprites N)
+#include "sprite_batch.h"
+// Частицы с потоковой загрузкой вершин (--particles N)
+#include "particles.h"
+// Объекты сцены: команды записываются в пуле потоков (--objects N)
+#include "scene_objects.h"
+// Отсечение и отрисовка объектов на GPU (--gpu-driven)
+#include "gpu_driven.h"
+// Фоновая загрузка и оптимизация сеток OBJ (--mesh path.obj)
+#include "mesh_loader.h"
+// Формат вершин: шаг и смещения атрибутов считаются при компиляции
+#include "vertex_layout.h"
+// Отслеживание состояния OpenGL: лишние привязки и glUniform не доходят до драйвера
+#include "gl_state.h"
+// Сверка последнего кадра с эталонным изображением (--golden path.tga)
+#include "pixel_readback.h"
+#include "image_compare.h"
+// Запись кадров в YUV без остановки цикла (--capture path.yuv)
+#include "frame_capture.h"
+// Программный растеризатор для машин без GPU (--renderer soft)
+#include "soft_raster.h"
+// Генератор случайных чисел xoshiro для fRand
+#include "xoshiro.h"
+// Счётчик выделений памяти: operator new заменяется в этой единице трансляции
+#define ALLOCATION_COUNTER_HOOK
+#include "alloc_counter.h"
 
 // Массив вершин в в нормализованном виде:
 // GLfloat vertices[] = {
@@ -231,19 +162,10 @@ GLuint indices[] = {
 // Перед тем как начать использовать текстуры их необходимо загрузить в приложение. Для загрузки
 // изображений будем пользоваться готовой библиотекой SOIL.
 
-void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode);
-
-void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode)
-{
-	// Когда пользователь нажимает ESC, мы устанавливаем свойство WindowShouldClose в true,
-	// и после этого приложение закрывается.
-	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
-		glfwSetWindowShouldClose(window, GL_TRUE);
-}
-
 double fRand(double fMin, double fMax)
 {
-	double f = (double)rand() / RAND_MAX;
+	static Xoshiro256 random(1);
+	double f = random.NextDouble();
 	return fMin + f * (fMax - fMin);
 }
 
@@ -266,47 +188,24 @@ double fRand(double fMin, double fMax)
 // }
 
 // Изменим шейдеры так, чтобы вершинный шейдер предоставлял цвет для фрагментного шейдера:
-const char * vertexShaderSource =
-
-"#version 330 core													\n"
-"																	\n"
-"layout (location = 0) in vec3 position;							\n" // Устанавливаем позицию переменной с координатами в 0
-"layout (location = 1) in vec3 color;								\n" // А позицию переменной с цветом в 1
-"																	\n"
-"out vec3 ourColor;													\n" // Передаём цвет во фрагментный шейдер
-"																	\n"
-"void main()														\n"
-"{																	\n"
-"	gl_Position = vec4(position, 1.0);								\n" // Напрямую передаём vec3 в vec4
-"	ourColor = color;												\n" // Устанавливаем значение цвета, полученное от вершинных данных
-"}																	\0";
-
-const char * coloredVerticesFragmentShaderSource = 
-
-"#version 330 core													\n"
-"in vec3 ourColor;													\n"
-"out vec4 color;													\n" 
-"																	\n"
-"void main()														\n"
-"{																	\n"
-"	color = vec4(ourColor, 1.0f);									\n"
-"}																	\0";
-
-const char * fragmentShaderSource =
-
-"#version 330 core													\n"
-"in vec4 vertexColor;												\n" // Входная переменная из вершинного шейдера (имеет то же название и тот же тип)
-"																	\n"
-"out vec4 color;													\n"
-"																	\n"
-"void main()														\n"
-"{																	\n"
-"	color = vertexColor;											\n"
-"}																	\0";
-// В этом примере мы объявили выходной вектор из 4-х элементов vertexColor в вершинном шейдере и 
-// идентичный вектор с названием vertexColor, но только как входной во фрагментном шейдере. В 
-// результате выходной vertexColor из вершинного шейдера и входной vertexColor из фрагментного 
-// шейдера были соединены.
+// #version 330 core
+// layout (location = 0) in vec3 position; // Устанавливаем позицию переменной с координатами в 0
+// layout (location = 1) in vec3 color;    // А позицию переменной с цветом в 1
+// out vec3 ourColor;                      // Передаём цвет во фрагментный шейдер
+// void main()
+// {
+// 	gl_Position = vec4(position, 1.0); // Напрямую передаём vec3 в vec4
+// 	ourColor = color;                  // Устанавливаем значение цвета, полученное от вершинных данных
+// }
+// Фрагментный шейдер принимает цвет входной переменной с тем же названием и тем же типом:
+// in vec3 ourColor;
+// out vec4 color;
+// void main()
+// {
+// 	color = vec4(ourColor, 1.0f);
+// }
+// Выходная переменная ourColor вершинного шейдера и входная ourColor фрагментного шейдера
+// были соединены.
 // Но также есть способы передачи информации шейдеру из приложения - Uniforms.
 
 // Uniforms (формы) - это ещё один способ передачи информации от приложения, работающего на CPU, к
@@ -316,65 +215,131 @@ const char * fragmentShaderSource =
 // тех пор, пока оно не будет сброшено или обновлено. Для объявления формы в GLSL используется 
 // спецификатор переменной uniform. После объявления формы её можно использовать в шейдере. 
 // Установить цвет треугольника с использованием формы можно следующим образом: 
-
-const char * uniformFragmentShaderSource = 
-
-"#version 330 core													\n"
-"out vec4 color;													\n" 
-"																	\n"
-"uniform vec4 ourColor;												\n" // Значение этой переменной устанавливается в коде OpenGL
-"																	\n"
-"void main()														\n"
-"{																	\n"
-"	color = ourColor;												\n"
-"}																	\0";
-// Мы объявили переменную формы ourColor в фрагментном шейдере и используем её для установки 
+// out vec4 color;
+// uniform vec4 uniformColor; // Значение этой переменной устанавливается в коде OpenGL
+// void main()
+// {
+// 	color = uniformColor;
+// }
+// Мы объявили переменную формы uniformColor в фрагментном шейдере и используем её для установки 
 // выходного значения фрагментного шейдера. Т.к. форма является глобальной переменной, то её 
 // объявление можно производить в любом шейдере, а это значит, что не нужно передавать что-то
 // из вершинного шейдера во фрагментный, т.е. нет необходимости объявлять форму в вершинном шейдере,
 // т.к. она там не используется. Дальнейшее заполнение формы данными и её использование происходит
-// на строке 373 и дальше. 
+// в игровом цикле.
+
+// Все эти шейдеры и шейдер с текстурами отличаются лишь набором возможностей, поэтому они
+// собраны в один исходник vertex_shader.vs + fragment_shader.frag с блоками #ifdef: цвет из
+// вершин (FeatureVertexColor), цвет из формы (FeatureUniformColor), одна или две текстуры
+// (FeatureTexture, FeatureTwoTextures). Нужный вариант собирается из него через ShaderVariants.
 
 const GLuint WIDTH = 800, HEIGHT = 600;
 
-int main()
+// Каталог с шейдерами и картинками. Безоконная сборка переопределяет его через -DASSET_ROOT.
+#ifndef ASSET_ROOT
+#define ASSET_ROOT "/home/surelye/Desktop/repos/OpenGL/"
+#endif
+
+#ifdef HEADLESS
+// Та же сцена - четырёхугольник с двумя текстурами - через программный растеризатор.
+// Контекст OpenGL не создаётся вовсе, так что прогон не зависит от драйвера.
+static int runSoftRenderer(const AppOptions & options)
 {
-	// Инициализация GLFW
-	glfwInit();
-	// Настройка GLFW
-	// Задаётся минимальная требуемая версия OpenGL.
-	// Мажорная
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	// Минорная 
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	// Установка профайла, для которого создаётся контекст.
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	// Выключения возможности изменения размера окна.
-	glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-		
-	GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "LearnOpenGL", nullptr, nullptr);
-	if (window == nullptr)
-	{
-		std::cout << "Failed to create GLFW window." << std::endl;
-		glfwTerminate();
+	SoftRenderer renderer(options.RasterThreads);
+	if (!renderer.Create(WIDTH, HEIGHT))
 		return -1;
+
+	// Как и в OpenGL: картинки загружаются без альфа-канала (альфа = 1)
+	const char * paths[2] = { ASSET_ROOT "pics/container.jpg", ASSET_ROOT "pics/awesomeface.png" };
+	RenderBatch quad;
+	for (int i = 0; i < 2; i++)
+	{
+		int width, height;
+		std::vector<unsigned char> rgba;
+		if (options.TestTextures)
+			makeTestTexture(i, width, height, rgba);
+		else
+		{
+			unsigned char * image = SOIL_load_image(paths[i], &width, &height, 0, SOIL_LOAD_RGB);
+			if (!image)
+			{
+				std::cout << "ERROR::TEXTURE::LOAD_FAILED " << paths[i] << std::endl;
+				return -1;
+			}
+			rgba.assign((size_t)width * height * 4, 255);
+			for (size_t p = 0; p < (size_t)width * height; p++)
+				memcpy(&rgba[p * 4], image + p * 3, 3);
+			SOIL_free_image_data(image);
+		}
+		quad.Textures[i] = renderer.CreateTexture(width, height, rgba.data());
 	}
-	glfwMakeContextCurrent(window);
 
-	glewExperimental = GL_TRUE;
-	if (glewInit() != GLEW_OK)
+	// vertices[] из начала файла: позиция, цвет, текстурные координаты
+	RenderVertex quadVertices[4];
+	for (int i = 0; i < 4; i++)
 	{
-		std::cout << "Failed to initialize GLEW" << std::endl;
-		return -1;
+		const GLfloat * vertex = vertices + i * 8;
+		quadVertices[i] = { { vertex[0], vertex[1], vertex[2], 1.0f }, { vertex[3], vertex[4], vertex[5] }, { vertex[6], vertex[7] } };
+	}
+	quad.Vertices = quadVertices;
+	quad.VertexCount = 4;
+	quad.Indices = indices;
+	quad.IndexCount = 6;
+	quad.Features = FeatureTexture | FeatureTwoTextures;
+
+	const GLfloat clearColor[4] = { 0.2f, 0.3f, 0.3f, 1.0f };
+	FrameStats stats;
+	stats.WarmupFrames = options.WarmupFrames;
+	stats.Reserve(options.Frames);
+	for (int frame = 0; frame < options.Frames; frame++)
+	{
+		stats.BeginFrame();
+		renderer.Clear(clearColor);
+		renderer.Draw(quad);
+		stats.CountDraw(2);
+		renderer.Finish();
+		stats.EndFrame();
+	}
+	stats.Report(std::cout, "soft_quad");
+	renderer.Report(std::cout);
+
+	bool goldenPassed = true;
+	if (!options.Golden.empty())
+	{
+		ImageThresholds thresholds;
+		thresholds.Tolerance = options.GoldenTolerance;
+		thresholds.MaxBadPixels = options.GoldenMaxBad;
+		thresholds.MinPsnr = options.GoldenPsnr;
+		std::vector<unsigned char> pixels;
+		renderer.ReadPixels(pixels);
+		goldenPassed = checkGoldenImage(std::cout, options.Golden, pixels, WIDTH, HEIGHT, thresholds, options.GoldenUpdate);
 	}
+	renderer.Destroy();
+	return goldenPassed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
 
-	int width, height;
-	glfwGetFramebufferSize(window, &width, &height);
+int main(int argc, char ** argv)
+{
+	AppOptions options;
+	if (!parseOptions(argc, argv, options))
+		return -1;
+	if (options.Renderer == "soft")
+	{
+#ifdef HEADLESS
+		return runSoftRenderer(options);
+#else
+		std::cout << "ERROR::OPTIONS::SOFT_RENDERER_NEEDS_HEADLESS" << std::endl;
+		return -1;
+#endif
+	}
 
-	glViewport(0, 0, width, height);
+	// Создание окна GLFW (или безоконного контекста EGL) и инициализация GLEW
+	AppWindow window;
+	if (!window.Create(options, WIDTH, HEIGHT, "LearnOpenGL"))
+		return -1;
 
-	// Зарегистрировать функцию обратного вызова надо после создания окна и до игрового цикла.
-	glfwSetKeyCallback(window, key_callback);
+	glViewport(0, 0, window.Width, window.Height);
 
 	// Узнать максимальное количество входных переменных-вершин, передаваемых в шейдер
 	GLint nrAttributes;
@@ -439,63 +404,32 @@ int main()
 	// его надо собрать. В начале мы должны создать объект шейдера. Поскольку доступ
 	// к созданным объектам осуществляется через идентификатор, то мы будем хранить 
 	// его в переменной с типом GLuint, а создавать через glCreateShader.
-	GLuint vertexShader;
-	vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	// Во время создания шейдера, необходимо указать его тип. В нашем случае - вершинный шейдер.
-
-	// Далее мы привязываем исходный код шейдера к объекту шейдера и компилируем его.
-	glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-	glCompileShader(vertexShader);
-	// Функция glShaderSource в качестве первого аргумента принимает шейдер, который требуется собрать.
-	// Второй аргумент описывает количество строк. Третий параметр - это исходный код шейдера.
-
-	// Проверка на наличие ошибок при сборке шейдера происходит следующим образом:
-	GLint success; // число для определения успешности сборки
-	GLchar infoLog[512]; // контейнер для хранения ошибок
-	glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success); // проверка успешности сборки
-
-	if (!success)
-	{
-		glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-	}
-
-	// Процесс сборки фрагментного шейдера аналогичен сборке вершинного
-	GLuint fragmentShader;
-	fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &coloredVerticesFragmentShaderSource, NULL);
-	glCompileShader(fragmentShader);
-	glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-
-	if (!success)
-	{
-		glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-		std::cout << "ERROR::UNIFORM_SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-	}
-
-	// Создание шейдерной программы (объект, являющийся результатом комбинации 
-	// нескольких шейдеров)
-	GLuint shaderProgram;
-	shaderProgram = glCreateProgram();
-
-	// Присоединение собранных шейдеров к программе и их связка с помощью функции glLinkProgram
-	glAttachShader(shaderProgram, vertexShader);
-	glAttachShader(shaderProgram, fragmentShader);
-	glLinkProgram(shaderProgram);
-
-	// Также как и со сборкой шейдера, можно получить успешность связывания и сообщение об ошибке
-	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-	if (!success)
-	{
-		glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-	}
-
-	// Каждый вызов шейдера и отрисовочных функций будет использовать наш объект программы
-	// и, соответственно, наши шейдеры. Также после связывания наши шейдеры нам больше не 
-	// понадобятся, поэтому их можно удалить:
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	// Во время создания шейдера (glCreateShader) необходимо указать его тип, затем привязать
+	// к нему исходный код (glShaderSource) и скомпилировать (glCompileShader). Успешность
+	// сборки проверяется через glGetShaderiv с GL_COMPILE_STATUS, а текст ошибок - через
+	// glGetShaderInfoLog. Фрагментный шейдер собирается так же, как вершинный.
+	// Затем создаётся шейдерная программа (объект, являющийся результатом комбинации 
+	// нескольких шейдеров): шейдеры присоединяются к ней и связываются с помощью функции
+	// glLinkProgram. После связывания шейдеры больше не нужны, и их можно удалить.
+	// Все эти шаги собраны в функции buildProgram из shader.h.
+	//
+	// Программы запрашиваются через ShaderCache: одинаковые исходники дают одну и ту же
+	// программу, а собранные бинарники сохраняются на диск и при следующем запуске
+	// загружаются без компиляции.
+	ShaderCache shaderCache(options.ShaderCacheDir);
+	// Варианты отправляются на сборку все сразу, а результат забирается перед первым
+	// использованием: драйвер с GL_KHR_parallel_shader_compile собирает их параллельно,
+	// пока мы настраиваем буферы
+	ShaderVariants shaderVariants(shaderCache);
+	if (!shaderVariants.Load(ASSET_ROOT "vertex_shader.vs", ASSET_ROOT "fragment_shader.frag"))
+		return -1;
+	const unsigned coloredFeatures = FeatureVertexColor;
+	const unsigned uniformColorFeatures = FeatureUniformColor;
+	const unsigned texturedFeatures = FeatureTexture | FeatureTwoTextures;
+	shaderVariants.Request(coloredFeatures);
+	shaderVariants.Request(uniformColorFeatures);
+	shaderVariants.Request(texturedFeatures);
+	shaderVariants.Submit();
 
 	// Вершинный шейдер позволяет указать любые данные в каждый атрибут вершины, но это 
 	// не значит, что нам придётся указывать, какой элемент данных относится к какому атрибуту.
@@ -573,24 +507,27 @@ int main()
 	// отрисовкой объекта. Это должно выглядеть следующим образом:
 	// 1. Привязываем VAO
 	glBindVertexArray(VAO);
-	// 2. Копируем наш массив вершин в буфер для OpenGL
+	// 2. Привязываем буфер с вершинами (данные уже загружены в него выше, второй
+	// glBufferData только заново копировал бы тот же массив)
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 	// 3. Копируем индексы в буфер для OpenGL
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 	// 3. Устанавливаем указатели на вершинные атрибуты
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(0);
+	// glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)0);
+	// glEnableVertexAttribArray(0);
 
 	// Установка указателей на атрибуты цвета
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-	glEnableVertexAttribArray(1);
+	// glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
+	// glEnableVertexAttribArray(1);
 
 	// После добавления дополнительных атрибутов (текстурные координаты) необходимо оповестить OpenGL
 	// о новом формате данных (также скорректировав значение шага прошлых двух атрибутов):
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
-	glEnableVertexAttribArray(2);
+	// glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
+	// glEnableVertexAttribArray(2);
+	// Те же три вызова делает описание формата: шаг и смещения в нём считаются при компиляции
+	static_assert(sizeof(vertices) == 4 * Fp32VertexLayout::Stride, "vertices[] does not match Fp32VertexLayout");
+	Fp32VertexLayout::Apply();
 	// Сначала необходимо создать все указатели на новые элементы в массиве, а только затем 
 	// отвязать VAO.
 
@@ -606,13 +543,57 @@ int main()
 	// шейдере. Получив значение индекса атрибута можно вместить туда необходимые данные. Для 
 	// демонстрации работы этой функции будет менять цвет от времени (реализация в игровом цикле).
 
-	Shader ourShader("/home/surelye/Desktop/repos/OpenGL/vertex_shader.vs", 
-					 "/home/surelye/Desktop/repos/OpenGL/fragment_shader.frag");
+	if (!shaderVariants.Finish())
+		return -1;
+	// Вариант с цветом вершин: glUseProgram(shaderVariants.Get(coloredFeatures));
+	Shader ourShader(shaderVariants.Get(texturedFeatures));
+	// После сохранения файлов шейдеров программа пересобирается и подменяется между кадрами
+	ShaderWatcher shaderWatcher(shaderCache);
+	if (options.ShaderReload)
+	{
+		shaderWatcher.Watch(&ourShader, ASSET_ROOT "vertex_shader.vs", ASSET_ROOT "fragment_shader.frag", texturedFeatures);
+		shaderWatcher.Start();
+	}
 
 	// Также как и на любой другой объект в OpenGL, на текстуры ссылаются идентификаторы. 
+	// Изображения декодируются в фоновых потоках (TextureLoader), а идентификаторы текстур
+	// доступны сразу: пока загрузка не закончилась, в текстуре лежит заглушка, и кадры
+	// рисуются без ожидания. Если рядом с картинкой лежит подготовленный файл .gtex
+	// (make textures), загружается он: готовые мипмапы прямо из отображённого файла.
+	// С бюджетом (--texture-budget) сразу загружаются только мелкие уровни, а крупные
+	// подгружаются, пока четырёхугольник на экране достаточно велик, чтобы они были нужны.
+	// С --test-textures вместо картинок грузятся процедурные текстуры из временных файлов .gtex.
+	std::string texturePaths[2] = { preferTextureFile(ASSET_ROOT "pics/container.jpg"), preferTextureFile(ASSET_ROOT "pics/awesomeface.png") };
+	if (options.TestTextures)
+		for (int i = 0; i < testTextureCount; i++)
+		{
+			if (!writeTestTexture(i))
+				return -1;
+			texturePaths[i] = testTexturePath(i);
+		}
+	TextureLoader textureLoader;
+	std::unique_ptr<TextureStreamer> textureStreamer;
 	GLuint containerTexture, faceTexture;
-	glGenTextures(1, &containerTexture);
-	// Функция glGenTextures принимает в качестве первого аргумента количество текстур для генерации
+	if (options.TextureBudget > 0)
+	{
+		textureStreamer.reset(new TextureStreamer());
+		textureStreamer->BudgetBytes = (size_t)options.TextureBudget << 20;
+		containerTexture = textureStreamer->Request(texturePaths[0], SOIL_LOAD_RGB);
+		faceTexture = textureStreamer->Request(texturePaths[1], SOIL_LOAD_RGB);
+	}
+	else
+	{
+		containerTexture = textureLoader.Request(texturePaths[0], SOIL_LOAD_RGB, true);
+		faceTexture = textureLoader.Request(texturePaths[1], SOIL_LOAD_RGB, true);
+	}
+	// Четырёхугольник занимает половину окна по каждой стороне
+	auto touchStreamedTextures = [&] {
+		if (!textureStreamer)
+			return;
+		textureStreamer->Touch(containerTexture, window.Width * 0.5f, window.Height * 0.5f);
+		textureStreamer->Touch(faceTexture, window.Width * 0.5f, window.Height * 0.5f);
+	};
+	// Внутри TextureLoader::Request вызывается glGenTextures. Функция glGenTextures принимает в качестве первого аргумента количество текстур для генерации
 	// , а в качестве второго аргумента - массив GLuint, в котором будут храниться идентификаторы
 	// этих текстур. Также как любой другой объект мы привяжем его для того, чтобы функции, 
 	// использующие текстуры, знали, какую текстуру использовать.
@@ -642,18 +623,19 @@ int main()
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	// Для загрузки изображения через SOIL будем использовать функцию SOIL_load_image:
-	int picWidth, picHeight;
-	unsigned char * image = SOIL_load_image("/home/surelye/Desktop/repos/OpenGL/pics/container.jpg", &picWidth, &picHeight, 0, SOIL_LOAD_RGB);
+	// Для загрузки изображения через SOIL используется функция SOIL_load_image (её вызывают
+	// рабочие потоки TextureLoader):
+	// unsigned char * image = SOIL_load_image("pics/container.jpg", &picWidth, &picHeight, 0, SOIL_LOAD_RGB);
 	// Первый аргумент - это местоположение файла, второй и третий - это размеры изображения, они 
 	// понадобятся для генерации текстуры. Четвёртый аргумент - это количество каналов изображения.
 	// Последний аргумент сообщает SOIL, как ему загружать изображение: нам нужна только RGB информация.
 	// Результат будет храниться в массиве байтов.	
 
 	// После привязки текстуры мы можем начать генерировать данные текстуры, используя предварительно
-	// загруженное изображение. Текстуры генерируются с помощью glTexImage2D:
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, picWidth, picHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-	glGenerateMipmap(GL_TEXTURE_2D);
+	// загруженное изображение. Текстуры генерируются с помощью glTexImage2D (TextureLoader
+	// вызывает её на потоке OpenGL, когда изображение готово):
+	// glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, picWidth, picHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+	// glGenerateMipmap(GL_TEXTURE_2D);
 	// Первый аргумент описывает текстурную цель. Установив значение GL_TEXTURE_2D мы сообщили
 	// функции, что наша текстура привязана к этой цели (чтобы другие цели GL_TEXTURE_1D и 
 	// GL_TEXTURE_3D не будут задействованы).
@@ -673,49 +655,226 @@ int main()
 	// мипмапов. Или возможен вызов glGenerateMipmap после генерации текстуры. Эта функция 
 	// автоматически сгенерирует все требуемые мипмапы для текущей привязанной текстуры. 
 
-	// После окончания генерации текстуры и мипмапов освободим участок памяти, выделенный под 
-	// загруженное изображение и отвяжем объект текстуры.
-	SOIL_free_image_data(image);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	// После окончания генерации текстуры и мипмапов участок памяти, выделенный под 
+	// загруженное изображение, освобождается (SOIL_free_image_data).
 
-	glGenTextures(1, &faceTexture);
 	glBindTexture(GL_TEXTURE_2D, faceTexture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	image = SOIL_load_image("/home/surelye/Desktop/repos/OpenGL/pics/awesomeface.png", &picWidth, &picHeight, 0, SOIL_LOAD_RGB);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, picWidth, picHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-	glGenerateMipmap(GL_TEXTURE_2D);
-	SOIL_free_image_data(image);
 	glBindTexture(GL_TEXTURE_2D, 0);
 
 	// Далее идёт модификация вершинного и фрагментного шейдера, а затем: 
 	// Осталось только привязать текстуру перед вызовом glDrawElements в игровом цикле, и она 
 	// автоматически будет передана сэмплеру фрагментного шейдера.
 
+	// Дальше привязки и uniform-переменные в цикле идут через трекер состояния. Он
+	// начинает с "неизвестного" состояния, поэтому настройка выше ему не мешает.
+	GlState glState;
+	// Загрузка уровней тоже привязывает текстуры через трекер, а не спрашивает привязку у OpenGL
+	if (textureStreamer)
+		textureStreamer->State = &glState;
+
+	// Спрайты рисуются одним glDrawElementsInstanced на весь пакет
+	SpriteBatch sprites;
+	sprites.State = &glState;
+	if (options.Sprites > 0)
+	{
+		GLuint spriteProgram = shaderCache.GetProgram(spriteVertexShaderSource, spriteFragmentShaderSource);
+		BufferStreaming streaming = options.SpriteStreaming == "persistent" ? BufferStreaming::Persistent
+																				: BufferStreaming::Orphan;
+		if (!spriteProgram || !sprites.Create(spriteProgram, options.Sprites, streaming))
+			return -1;
+	}
+
+	// Частицы: вершины пересчитываются и загружаются каждый кадр через кольцевой буфер
+	ParticleSystem particles;
+	particles.State = &glState;
+	if (options.Particles > 0)
+	{
+		BufferStreaming streaming = options.ParticleStreaming == "persistent" ? BufferStreaming::Persistent
+																				 : BufferStreaming::Orphan;
+		if (!particles.Create(options.Particles, streaming))
+			return -1;
+	}
+
+	// Объекты сцены: расчёт и запись команд идут в пуле потоков, на этом потоке
+	// остаются только сортировка и вызовы OpenGL
+	SceneObjectPool objectPool;
+	SceneObjectList objects;
+	std::unique_ptr<ThreadPool> recordPool;
+	std::unique_ptr<CommandQueue> commands;
+	// Отсечение: границы объектов неподвижны, так что Bvh строится один раз
+	SceneCuller culler;
+	std::vector<uint32_t> visibleObjects;
+	GpuDrivenScene gpuScene;
+	bool gpuDriven = false;
+	// Uniform-блоки: блок кадра общий для всех программ, блоки объектов - ячейки одного буфера
+	UniformStream uniforms;
+	bool uniformBlocks = options.Uniforms == "ubo";
+	if (options.Objects > 0)
+	{
+		GLuint objectProgram = uniformBlocks ? shaderCache.GetProgram(objectBlockVertexShaderSource, objectBlockFragmentShaderSource)
+											 : shaderCache.GetProgram(objectVertexShaderSource, objectFragmentShaderSource);
+		if (!objectProgram)
+			return -1;
+		bindUniformBlocks(objectProgram);
+		GLint transformLocation = glState.UniformLocation(objectProgram, "transform");
+		objects = makeSceneObjects(objectPool, options.Objects, { objectProgram }, { transformLocation }, { containerTexture, faceTexture }, { VAO }, 6);
+		recordPool.reset(new ThreadPool(options.RecordThreads));
+		commands.reset(new CommandQueue(recordPool->Size()));
+		if (options.WorldSize > 0.0f)
+			scatterSceneObjects(objects, options.WorldSize);
+		culler.Mode = options.Cull == "brute" ? CullMode::Brute : CullMode::Bvh;
+		// На контексте без OpenGL 4.3 остаётся путь через CPU
+		if (options.GpuDriven && gpuScene.Create(objects, { containerTexture, faceTexture }))
+			gpuDriven = true;
+		else if (options.Cull != "off")
+			culler.Build(sceneObjectBounds(objects));
+		else
+			for (size_t i = 0; i < objects.size(); i++)
+				visibleObjects.push_back((uint32_t)i);
+		// Видно может оказаться всё сразу: память под это выделяется до первого кадра
+		visibleObjects.reserve(objects.size());
+		commands->Reserve(objects.size());
+		if (uniformBlocks && !gpuDriven &&
+			!uniforms.Create(objects.size(), sizeof(ObjectConstants), bufferStorageSupported() ? BufferStreaming::Persistent : BufferStreaming::Orphan))
+			return -1;
+	}
+
+	// Сетка из файла: разбор, склейка вершин и оптимизация индексов идут в рабочем потоке,
+	// а пока сетка не готова, GpuMesh::Draw ничего не рисует
+	std::unique_ptr<MeshLoader> meshLoader;
+	GpuMesh * mesh = nullptr;
+	GLuint meshProgram = 0;
+	if (!options.Mesh.empty())
+	{
+		meshProgram = shaderCache.GetProgram(objectVertexShaderSource, objectFragmentShaderSource);
+		if (!meshProgram)
+			return -1;
+		meshLoader.reset(new MeshLoader());
+		mesh = meshLoader->Request(options.Mesh);
+	}
+
+	// Время кадров. В безоконном режиме по нему строится отчёт о производительности.
+	FrameStats stats;
+	stats.WarmupFrames = options.WarmupFrames;
+	stats.Reserve(options.Frames);
+
+	// Темп кадров: vsync, предел частоты и шаг симуляции задаются параметрами запуска
+	window.SetSwapInterval(options.Vsync ? 1 : 0);
+	FramePacer pacer;
+	pacer.TargetFps = options.TargetFps;
+	pacer.StepSeconds = 1.0 / options.SimulationHz;
+	// Время симуляции продвигается только фиксированными шагами
+	double simulationTime = 0.0;
+
+	// Сверка с эталоном: кадр N должен быть одинаковым на любой машине, поэтому шаг
+	// симуляции - ровно один на кадр, а все текстуры и сетка загружаются до первого кадра
+	PixelReadback goldenReadback;
+	bool goldenPassed = true, allocationsPassed = true;
+	if (!options.Golden.empty())
+	{
+#ifdef HEADLESS
+		pacer.FixedStep = true;
+		while (textureLoader.Pending() > 0 || (meshLoader && meshLoader->Pending() > 0) ||
+			   (textureStreamer && textureStreamer->Pending() > 0))
+		{
+			textureLoader.Pump();
+			if (meshLoader)
+				meshLoader->Pump(&glState);
+			if (textureStreamer)
+				textureStreamer->Pump();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		// Уровни запрашиваются только по касаниям, поэтому касаемся, пока всё нужное не загрузится
+		if (textureStreamer)
+			do
+			{
+				touchStreamedTextures();
+				textureStreamer->Pump();
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			while (textureStreamer->Pending() > 0);
+		if (!goldenReadback.Create(window.Width, window.Height))
+			return -1;
+#else
+		std::cout << "WARNING::GOLDEN::HEADLESS_ONLY" << std::endl;
+#endif
+	}
+
+	// Запись кадров: чтение через кольцо PBO, перевод в YUV и запись - в рабочем потоке
+	std::unique_ptr<FrameCapture> capture;
+	if (!options.Capture.empty())
+	{
+		capture.reset(new FrameCapture());
+		capture->Depth = options.CaptureDepth;
+		if (!capture->Create(options.Capture, window.Width, window.Height))
+			return -1;
+	}
+
+	// Профилирование участков кадра включается выгрузкой в файл (--profile-trace, --profile-csv)
+	Profiler profiler;
+	if (!options.ProfileTrace.empty() || !options.ProfileCsv.empty())
+	{
+		profiler.Init();
+		profiler.Reserve(options.WarmupFrames + options.Frames, 16);
+	}
+
+	// Выделения памяти после прогрева: в установившемся режиме их быть не должно
+	AllocationSnapshot steadyStart = AllocationSnapshot::Take(), steadyEnd;
+
 	// Игровой цикл.
-	while (!glfwWindowShouldClose(window))
+	while (!window.ShouldClose())
 	{
+		if (pacer.Frames == options.WarmupFrames)
+			steadyStart = AllocationSnapshot::Take();
+		stats.BeginFrame();
+		glState.BeginFrame();
+		profiler.BeginFrame();
+		// Шаги симуляции, накопившиеся с прошлого кадра. Вся "симуляция" сейчас - это время
+		// сцены, но любая логика с фиксированным шагом вызывается здесь же.
+		int steps = pacer.BeginFrame();
+		for (int step = 0; step < steps; step++)
+			simulationTime += pacer.StepSeconds;
 		// Проверяем события и вызываем функции обратного вызова.
-		glfwPollEvents();
+		window.PollEvents();
+		// Загружаем в видеопамять текстуры, которые успели декодироваться
+		int scope = profiler.BeginScope("pump");
+		textureLoader.Pump();
+		if (textureStreamer)
+			textureStreamer->Pump();
+		// и сетки, которые успели разобраться
+		if (meshLoader)
+			meshLoader->Pump(&glState);
+		// Подменяем шейдеры, файлы которых изменились
+		shaderWatcher.Pump(&glState);
+		profiler.EndScope(scope);
 
 		// Ниже будут располагаться команды отрисовки.
 		
+		scope = profiler.BeginScope("clear");
 		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
+		profiler.EndScope(scope);
 
 		// Активируем шейдерную программу
 		// glUseProgram(shaderProgram);
-		ourShader.Use();
-
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, containerTexture);
-		glUniform1i(glGetUniformLocation(ourShader.Program, "ourTexture1"), 0);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, faceTexture);
-		glUniform1i(glGetUniformLocation(ourShader.Program, "ourTexture2"), 1);
+		// ourShader.Use();
+		// Все вызовы ниже идут через glState: начиная со второго кадра программа, привязки
+		// текстур и значения сэмплеров не меняются, и драйвер их больше не получает.
+		scope = profiler.BeginScope("bind");
+		glState.UseProgram(ourShader.Program);
+
+		// glActiveTexture(GL_TEXTURE0);
+		// glBindTexture(GL_TEXTURE_2D, containerTexture);
+		// glUniform1i(glGetUniformLocation(ourShader.Program, "ourTexture1"), 0);
+		glState.BindTexture(0, GL_TEXTURE_2D, containerTexture);
+		glState.Uniform1i(glState.UniformLocation(ourShader.Program, "ourTexture1"), 0);
+		glState.BindTexture(1, GL_TEXTURE_2D, faceTexture);
+		glState.Uniform1i(glState.UniformLocation(ourShader.Program, "ourTexture2"), 1);
+		profiler.EndScope(scope);
 		// glUniform1i используется для того, чтобы установить позицию текстурного блока в uniform
 		// sampler. Устанавливая их через glUniform1i мы будем уверены, что uniform sampler 
 		// соотносится с правильным текстурным блоком. 
@@ -723,28 +882,205 @@ int main()
 		// Обновляем цвет формы
 		// GLfloat timeValue = glfwGetTime();
 		// GLfloat greenValue = (tan(timeValue) / 2) + 0.5;
-		// GLint vertexColorLocation = glGetUniformLocation(shaderProgram, "ourColor");
+		// glUseProgram(shaderVariants.Get(uniformColorFeatures));
+		// GLint vertexColorLocation = glGetUniformLocation(shaderVariants.Get(uniformColorFeatures), "uniformColor");
 		// glUniform4f(vertexColorLocation, 0.0f, greenValue, 0.0f, 1.0f);
 		// Т.к. OpenGL написан на C, в котором нет перегрузки функций, для каждого типа данных
 		// определены свои функции, определяемые постфиксом.
 
 		// Рисуем фигуру 
-		glBindVertexArray(VAO);
+		scope = profiler.BeginScope("draw");
+		glState.BindVertexArray(VAO);
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-		// glDrawElements берёт индексы из текуuniformFragmentShaderSourceщего привязанного к GL_ELEMENT_ARRAY_BUFFER EBO
+		touchStreamedTextures();
+		profiler.EndScope(scope);
+		stats.CountDraw(2);
+		// glDrawElements берёт индексы из текущего привязанного к GL_ELEMENT_ARRAY_BUFFER EBO
 		// Это означает, что мы должны каждый раз привязывать различные EBO. Но VAO умеет 
-		// хранить и EBO. 
-		glBindVertexArray(0);
+		// хранить и EBO. Отвязывать VAO после отрисовки не нужно: следующий кадр привязал бы
+		// его снова, а трекер пропускает повторную привязку.
+
+		if (options.Particles > 0)
+		{
+			ProfileScope particlesScope(profiler, "particles");
+			// Программа и текстуры четырёхугольника всё ещё привязаны
+			double sceneTime = simulationTime + pacer.Alpha() * pacer.StepSeconds;
+			particles.Draw((float)sceneTime);
+			stats.CountDraw(2LL * options.Particles);
+		}
+
+		if (options.Objects > 0)
+		{
+			ProfileScope objectsScope(profiler, "objects");
+			float sceneTime = (float)(simulationTime + pacer.Alpha() * pacer.StepSeconds);
+			// Экран - квадрат [-1, 1] вокруг камеры; в запись идут только видимые объекты
+			float cameraX, cameraY;
+			sceneCamera(sceneTime, options.WorldSize, cameraX, cameraY);
+			if (gpuDriven)
+			{
+				// Сколько объектов видно, знает только GPU; читать это каждый кадр - ждать его
+				gpuScene.Draw(glState, sceneTime, cameraX, cameraY);
+				stats.CountDraw(2LL * options.Objects);
+			}
+			else
+			{
+				if (options.Cull != "off")
+					culler.Cull(Frustum::Box(cameraX - 1.0f, cameraX + 1.0f, cameraY - 1.0f, cameraY + 1.0f, -1.0f, 1.0f),
+								recordPool.get(), visibleObjects);
+				if (uniformBlocks)
+				{
+					// Камера и время - один раз в блок кадра; ячейки блоков объектов заполняют потоки записи
+					uniforms.BeginFrame();
+					FrameConstants frame = { { cameraX, cameraY, sceneTime, 0.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } };
+					uniforms.SetFrame(frame);
+					UniformStream::Range blocks = uniforms.AllocateBlocks(visibleObjects.size(), sizeof(ObjectConstants));
+					commands->Record(recordPool.get(), visibleObjects.size(), [&](CommandList & list, size_t begin, size_t end) {
+						recordVisibleObjectBlocks(list, objects, visibleObjects, begin, end, sceneTime, uniforms.Buffer.Buffer, blocks);
+					});
+					uniforms.Commit(glState);
+				}
+				else
+					commands->Record(recordPool.get(), visibleObjects.size(), [&](CommandList & list, size_t begin, size_t end) {
+						recordVisibleObjects(list, objects, visibleObjects, begin, end, sceneTime, cameraX, cameraY);
+					});
+				commands->Replay(glState);
+				if (uniformBlocks)
+					uniforms.EndFrame();
+				stats.CountDraws((long long)visibleObjects.size(), 2);
+			}
+		}
+
+		if (mesh)
+		{
+			ProfileScope meshScope(profiler, "mesh");
+			float sceneTime = (float)(simulationTime + pacer.Alpha() * pacer.StepSeconds);
+			glState.UseProgram(meshProgram);
+			glState.BindTexture(0, GL_TEXTURE_2D, containerTexture);
+			glState.Uniform4f(glState.UniformLocation(meshProgram, "transform"), 0.0f, 0.0f, 0.5f, sceneTime * 0.5f);
+			mesh->Draw(&glState);
+			stats.CountDraw(mesh->IndexCount / 3);
+		}
+
+		if (options.Sprites > 0)
+		{
+			ProfileScope spritesScope(profiler, "sprites");
+			// Текстура контейнера уже привязана к блоку 0
+			// Между шагами симуляции время интерполируется, чтобы движение было плавным
+			double sceneTime = simulationTime + pacer.Alpha() * pacer.StepSeconds;
+			addSpriteGrid(sprites, options.Sprites, (float)(sceneTime * 0.6));
+			sprites.Flush(0);
+			stats.CountDraw(2LL * sprites.LastCount());
+		}
+
+#ifdef HEADLESS
+		// Последний кадр копируется в PBO; забираем его после цикла, не останавливая конвейер
+		if (!options.Golden.empty() && window.LastFrame())
+			goldenReadback.Begin();
+#endif
+		if (capture)
+		{
+			ProfileScope captureScope(profiler, "capture");
+			capture->Capture(pacer.Frames);
+		}
 
 		// Меняем буферы местами.
-		glfwSwapBuffers(window);
+		scope = profiler.BeginScope("swap");
+		window.SwapBuffers();
+		profiler.EndScope(scope);
+		profiler.EndFrame();
+		stats.EndFrame();
+		// Ожидание до следующего кадра при заданном пределе частоты
+		pacer.EndFrame();
+	}
+	steadyEnd = AllocationSnapshot::Take();
+	// Кадры, которые ещё в кольце PBO и в очереди записи
+	if (capture)
+	{
+		capture->Finish(pacer.Frames);
+		capture->Report(std::cout);
+	}
+#ifdef HEADLESS
+	stats.Report(std::cout, options.Sprites > 0 ? "sprites" : "quad");
+	if (options.Sprites > 0)
+		std::cout << "sprites count=" << options.Sprites << " streaming=" << bufferStreamingName(sprites.Streaming)
+				  << " fence_wait_ms=" << sprites.FenceWaitMs << std::endl;
+	if (options.Particles > 0)
+		particles.Vertices.Report(std::cout, "particles");
+	if (gpuDriven)
+		gpuScene.Report(std::cout);
+	else if (options.Objects > 0)
+	{
+		commands->Report(std::cout);
+		if (uniformBlocks)
+			uniforms.Buffer.Report(std::cout, "uniforms");
+		if (options.Cull != "off")
+			culler.Report(std::cout);
+	}
+	shaderCache.Report(std::cout);
+	shaderVariants.Report(std::cout);
+	textureLoader.Report(std::cout);
+	if (textureStreamer)
+		textureStreamer->Report(std::cout);
+	if (meshLoader)
+		meshLoader->Report(std::cout);
+	glState.Report(std::cout);
+	shaderWatcher.Report(std::cout);
+	pacer.Report(std::cout, options.Vsync ? "vsync_on" : "vsync_off");
+	long long steadyAllocations = steadyEnd.Allocations - steadyStart.Allocations;
+	std::cout << "allocations hooked=" << (allocationCounterInstalled() ? "yes" : "no")
+			  << " steady_frames=" << pacer.Frames - options.WarmupFrames << " count=" << steadyAllocations
+			  << " bytes=" << steadyEnd.Bytes - steadyStart.Bytes << std::endl;
+	if (options.CheckAllocations && steadyAllocations > 0)
+	{
+		std::cout << "ERROR::ALLOC::STEADY_STATE_ALLOCATIONS " << steadyAllocations << std::endl;
+		allocationsPassed = false;
+	}
+	if (!options.Golden.empty())
+	{
+		ImageThresholds thresholds;
+		thresholds.Tolerance = options.GoldenTolerance;
+		thresholds.MaxBadPixels = options.GoldenMaxBad;
+		thresholds.MinPsnr = options.GoldenPsnr;
+		std::vector<unsigned char> pixels;
+		goldenPassed = goldenReadback.Finish(pixels, true) &&
+					   checkGoldenImage(std::cout, options.Golden, pixels, goldenReadback.Width, goldenReadback.Height,
+										thresholds, options.GoldenUpdate);
+	}
+#endif
+	if (profiler.Enabled)
+	{
+		profiler.Finish();
+		profiler.Report(std::cout);
+		if (!options.ProfileTrace.empty())
+			profiler.WriteChromeTrace(options.ProfileTrace);
+		if (!options.ProfileCsv.empty())
+			profiler.WriteCsv(options.ProfileCsv);
+		profiler.Release();
 	}
+	shaderWatcher.Stop();
+	if (options.Sprites > 0)
+		sprites.Destroy();
+	if (options.Particles > 0)
+		particles.Destroy();
+	if (meshLoader)
+		meshLoader->Release();
+	if (gpuDriven)
+		gpuScene.Destroy();
+	destroySceneObjects(objectPool, objects);
+	goldenReadback.Destroy();
+	uniforms.Destroy();
+	if (capture)
+		capture->Destroy();
+	shaderCache.Release();
 	glDeleteVertexArrays(1, &VAO);
 	glDeleteBuffers(1, &VBO);
 	glDeleteBuffers(1, &EBO);
+	if (options.TestTextures)
+		for (int i = 0; i < testTextureCount; i++)
+			remove(testTexturePath(i).c_str());
 	
-	glfwTerminate();
-	return (EXIT_SUCCESS);
+	window.Destroy();
+	return goldenPassed && allocationsPassed ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
  
\ No newline at end of file
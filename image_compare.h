@@ -0,0 +1,164 @@
+// Сравнение отрисованного кадра с эталонным изображением (golden image).
+//
+// Оптимизации (пакетная отрисовка, упакованные вершины, мипмапы на CPU) не должны менять
+// картинку больше, чем на округление. Кадр сравнивается с эталоном попиксельно: пиксель
+// считается отличающимся, если хоть один канал RGB разошёлся больше чем на Tolerance.
+// Проверка проходит, если таких пикселей не больше доли MaxBadPixels, а PSNR по всему
+// кадру не ниже MinPsnr. При провале рядом с эталоном пишутся полученный кадр
+// (<имя>.actual.tga) и карта отличий (<имя>.diff.tga): отличающиеся пиксели красные,
+// остальные - приглушённый эталон.
+//
+// Эталоны хранятся в TGA без сжатия: формат без потерь, и SOIL умеет его и читать, и писать.
+
+#ifndef IMAGE_COMPARE_H
+#define IMAGE_COMPARE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <SOIL/SOIL.h>
+
+struct ImageThresholds
+{
+	// Допустимое расхождение канала (0..255)
+	int Tolerance = 8;
+	// Допустимая доля пикселей с расхождением больше Tolerance
+	double MaxBadPixels = 0.001;
+	// Минимальный PSNR в децибелах
+	double MinPsnr = 40.0;
+};
+
+struct ImageDifference
+{
+	int MaxDifference = 0;
+	long long BadPixels = 0;
+	double BadFraction = 0.0;
+	// Среднеквадратичная ошибка по каналам RGB и PSNR (бесконечность для одинаковых кадров)
+	double Mse = 0.0;
+	double Psnr = std::numeric_limits<double>::infinity();
+};
+
+// Сравнение двух RGBA8 изображений одного размера. diff (если не nullptr) получает карту отличий.
+inline ImageDifference compareImages(const unsigned char * actual, const unsigned char * expected, int width, int height,
+									 int tolerance, std::vector<unsigned char> * diff)
+{
+	ImageDifference result;
+	size_t pixels = (size_t)width * height;
+	if (diff)
+		diff->resize(pixels * 4);
+	double squares = 0.0;
+	for (size_t i = 0; i < pixels; i++)
+	{
+		const unsigned char * a = actual + i * 4, * e = expected + i * 4;
+		int worst = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			int delta = abs((int)a[c] - (int)e[c]);
+			worst = std::max(worst, delta);
+			squares += (double)delta * delta;
+		}
+		result.MaxDifference = std::max(result.MaxDifference, worst);
+		bool bad = worst > tolerance;
+		if (bad)
+			result.BadPixels++;
+		if (diff)
+		{
+			unsigned char * d = &(*diff)[i * 4];
+			if (bad)
+			{
+				// Чем больше расхождение, тем ярче красный
+				d[0] = (unsigned char)std::min(255, 128 + worst);
+				d[1] = d[2] = 0;
+			}
+			else
+				d[0] = d[1] = d[2] = (unsigned char)((e[0] + e[1] + e[2]) / 12);
+			d[3] = 255;
+		}
+	}
+	if (pixels)
+	{
+		result.BadFraction = (double)result.BadPixels / pixels;
+		result.Mse = squares / (pixels * 3.0);
+	}
+	if (result.Mse > 0.0)
+		result.Psnr = 10.0 * log10(255.0 * 255.0 / result.Mse);
+	return result;
+}
+
+inline bool imagePasses(const ImageDifference & difference, const ImageThresholds & thresholds)
+{
+	return difference.BadFraction <= thresholds.MaxBadPixels && difference.Psnr >= thresholds.MinPsnr;
+}
+
+// Путь без расширения: golden/quad.tga -> golden/quad
+inline std::string imageBasePath(const std::string & path)
+{
+	size_t dot = path.find_last_of('.'), slash = path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return path;
+	return path.substr(0, dot);
+}
+
+inline bool saveImageTga(const std::string & path, const unsigned char * pixels, int width, int height)
+{
+	if (!SOIL_save_image(path.c_str(), SOIL_SAVE_TYPE_TGA, width, height, 4, pixels))
+	{
+		std::cout << "ERROR::GOLDEN::SAVE_FAILED " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Проверка кадра (RGBA8, строки сверху вниз) по эталону path. update - записать кадр как
+// новый эталон; эталона ещё нет - тоже записать, но проверку считать не пройденной, чтобы
+// пропавший файл не превращался в молча зелёный прогон. Отчёт - строка golden ... в out.
+inline bool checkGoldenImage(std::ostream & out, const std::string & path, const std::vector<unsigned char> & pixels,
+							 int width, int height, const ImageThresholds & thresholds, bool update)
+{
+	int goldenWidth = 0, goldenHeight = 0, channels = 0;
+	unsigned char * golden = update ? nullptr : SOIL_load_image(path.c_str(), &goldenWidth, &goldenHeight, &channels, SOIL_LOAD_RGBA);
+	if (!golden)
+	{
+		if (!saveImageTga(path, pixels.data(), width, height))
+			return false;
+		out << "golden image=" << path << " result=" << (update ? "updated" : "created") << std::endl;
+		if (!update)
+			std::cout << "WARNING::GOLDEN::CREATED " << path << " - check it and commit it" << std::endl;
+		return update;
+	}
+	if (goldenWidth != width || goldenHeight != height)
+	{
+		SOIL_free_image_data(golden);
+		std::cout << "ERROR::GOLDEN::SIZE_MISMATCH " << path << " " << goldenWidth << "x" << goldenHeight
+				  << " expected " << width << "x" << height << std::endl;
+		saveImageTga(imageBasePath(path) + ".actual.tga", pixels.data(), width, height);
+		return false;
+	}
+
+	std::vector<unsigned char> diff;
+	ImageDifference difference = compareImages(pixels.data(), golden, width, height, thresholds.Tolerance, &diff);
+	SOIL_free_image_data(golden);
+	bool passed = imagePasses(difference, thresholds);
+	out << std::fixed << std::setprecision(3) << "golden image=" << path << " result=" << (passed ? "pass" : "fail")
+		<< " max_diff=" << difference.MaxDifference << " bad_pixels=" << difference.BadPixels
+		<< " bad_fraction=" << std::setprecision(6) << difference.BadFraction << std::setprecision(3)
+		<< " psnr=" << difference.Psnr << " tolerance=" << thresholds.Tolerance
+		<< " max_bad=" << std::setprecision(6) << thresholds.MaxBadPixels << std::setprecision(3)
+		<< " min_psnr=" << thresholds.MinPsnr << std::endl;
+	if (!passed)
+	{
+		std::string base = imageBasePath(path);
+		std::cout << "ERROR::GOLDEN::MISMATCH " << path << " see " << base << ".diff.tga" << std::endl;
+		saveImageTga(base + ".actual.tga", pixels.data(), width, height);
+		saveImageTga(base + ".diff.tga", diff.data(), width, height);
+	}
+	return passed;
+}
+
+#endif
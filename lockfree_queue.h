@@ -0,0 +1,102 @@
+// Ограниченная lock-free очередь (алгоритм Дмитрия Вьюкова для MPMC). Каждая ячейка
+// хранит номер последовательности, по которому писатели и читатели понимают, свободна
+// ли ячейка. Мьютексов нет, поэтому поток OpenGL никогда не ждёт рабочие потоки.
+
+#ifndef LOCKFREE_QUEUE_H
+#define LOCKFREE_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+template <typename T>
+class LockFreeQueue
+{
+	public:
+	// capacity округляется вверх до степени двойки
+	explicit LockFreeQueue(size_t capacity)
+	{
+		size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+		this->mask = size - 1;
+		this->cells.reset(new Cell[size]);
+		for (size_t i = 0; i < size; i++)
+			this->cells[i].Sequence.store(i, std::memory_order_relaxed);
+	}
+
+	LockFreeQueue(const LockFreeQueue &) = delete;
+	LockFreeQueue & operator=(const LockFreeQueue &) = delete;
+
+	bool TryPush(const T & value)
+	{
+		size_t position = this->enqueuePosition.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell & cell = this->cells[position & this->mask];
+			size_t sequence = cell.Sequence.load(std::memory_order_acquire);
+			intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+			if (difference == 0)
+			{
+				if (this->enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					cell.Data = value;
+					cell.Sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0)
+				return false; // Очередь заполнена
+			else
+				position = this->enqueuePosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	// Запись с ожиданием свободного места. Годится для рабочих потоков, но не для потока OpenGL.
+	void Push(const T & value)
+	{
+		while (!this->TryPush(value))
+			std::this_thread::yield();
+	}
+
+	bool TryPop(T & value)
+	{
+		size_t position = this->dequeuePosition.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell & cell = this->cells[position & this->mask];
+			size_t sequence = cell.Sequence.load(std::memory_order_acquire);
+			intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+			if (difference == 0)
+			{
+				if (this->dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					value = cell.Data;
+					cell.Sequence.store(position + this->mask + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0)
+				return false; // Очередь пуста
+			else
+				position = this->dequeuePosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	private:
+	struct Cell
+	{
+		std::atomic<size_t> Sequence;
+		T Data;
+	};
+
+	std::unique_ptr<Cell[]> cells;
+	size_t mask;
+	// Позиции писателей и читателей в разных кеш-линиях, чтобы не мешать друг другу
+	alignas(64) std::atomic<size_t> enqueuePosition { 0 };
+	alignas(64) std::atomic<size_t> dequeuePosition { 0 };
+};
+
+#endif
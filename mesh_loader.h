@@ -0,0 +1,512 @@
+// Загрузка сеток из файлов Wavefront OBJ.
+//
+// Разбор идёт параллельно: текст делится на куски по границам строк, и каждый поток
+// разбирает свой кусок (v/vt/vn/f, многоугольники разбиваются веером на треугольники).
+// Отрицательные (относительные) индексы зависят от числа вершин во всех предыдущих
+// кусках, поэтому они досчитываются после разбора по префиксным суммам. Затем одинаковые
+// тройки (v, vt, vn) склеиваются в одну вершину через хеш-таблицу, индексы
+// переупорядочиваются для кеша вершин и перерисовки (mesh_optimize.h), а в видеопамять
+// индексы уходят как GL_UNSIGNED_SHORT, если вершин не больше 65536.
+//
+// MeshLoader делает всё это в пуле рабочих потоков; поток OpenGL только создаёт буферы
+// в Pump(), как и у TextureLoader.
+
+#ifndef MESH_LOADER_H
+#define MESH_LOADER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "gl_state.h"
+#include "lockfree_queue.h"
+#include "mesh_optimize.h"
+#include "thread_pool.h"
+#include "vertex_layout.h"
+
+struct MeshData
+{
+	std::vector<Fp32Vertex> Vertices;
+	std::vector<uint32_t> Indices;
+};
+
+struct MeshOptions
+{
+	// Потоков разбора текста (0 - по числу ядер)
+	unsigned ParseThreads = 0;
+	// Tipsify и перестановка кластеров ради перерисовки
+	bool OptimizeCache = true;
+	bool OptimizeOverdraw = true;
+	int CacheSize = 16;
+	// Вписать сетку в куб [-1, 1] с центром в начале координат
+	bool Normalize = true;
+};
+
+struct MeshLoadStats
+{
+	double ReadMs = 0.0, ParseMs = 0.0, DedupMs = 0.0, OptimizeMs = 0.0, UploadMs = 0.0, ReadyMs = 0.0;
+	unsigned ParseThreads = 0;
+	size_t Triangles = 0, Corners = 0, Vertices = 0, IndexBytes = 0;
+	// ACMR/ATVR в порядке файла и после оптимизации
+	VertexCacheStats Before, After;
+};
+
+// Индекс OBJ, которого нет в записи грани (например, vt в "f 1//1")
+static const int32_t objMissing = INT32_MIN;
+
+// Разобранный кусок текста OBJ
+struct ObjChunk
+{
+	std::vector<float> Positions, TexCoords, Normals;
+	// Углы треугольников: индексы v, vt, vn. Абсолютные уже переведены в отсчёт от нуля,
+	// относительные хранятся относительно начала куска (бит k в Relative - индекс k).
+	struct Corner
+	{
+		int32_t Index[3];
+		uint8_t Relative;
+	};
+	std::vector<Corner> Corners;
+};
+
+inline bool objSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Разбор строк [begin, end). Строки целиком лежат внутри куска.
+inline void parseObjChunk(const char * begin, const char * end, ObjChunk & chunk)
+{
+	std::vector<ObjChunk::Corner> polygon;
+	const char * line = begin;
+	while (line < end)
+	{
+		const char * lineEnd = std::find(line, end, '\n');
+		const char * p = line;
+		line = lineEnd + 1;
+		while (p < lineEnd && objSpace(*p))
+			p++;
+		// Ключевое слово строки: v, vt, vn, f (остальные - группы, материалы - пропускаются)
+		const char * keyword = p;
+		while (p < lineEnd && !objSpace(*p))
+			p++;
+		size_t length = p - keyword;
+
+		// Чтение до count чисел с плавающей точкой, не выходя за конец строки
+		auto readFloats = [&](const char * from, std::vector<float> & out, int count) {
+			for (int i = 0; i < count; i++)
+			{
+				while (from < lineEnd && objSpace(*from))
+					from++;
+				char * next;
+				float value = from < lineEnd ? strtof(from, &next) : 0.0f;
+				if (from >= lineEnd || next == from)
+					value = 0.0f;
+				else
+					from = next;
+				out.push_back(value);
+			}
+		};
+
+		if (length == 1 && keyword[0] == 'v')
+			readFloats(p, chunk.Positions, 3);
+		else if (length == 2 && keyword[0] == 'v' && keyword[1] == 't')
+			readFloats(p, chunk.TexCoords, 2);
+		else if (length == 2 && keyword[0] == 'v' && keyword[1] == 'n')
+			readFloats(p, chunk.Normals, 3);
+		else if (length == 1 && keyword[0] == 'f')
+		{
+			const size_t counts[3] = { chunk.Positions.size() / 3, chunk.TexCoords.size() / 2, chunk.Normals.size() / 3 };
+			polygon.clear();
+			for (;;)
+			{
+				while (p < lineEnd && objSpace(*p))
+					p++;
+				if (p >= lineEnd)
+					break;
+				ObjChunk::Corner corner = { { objMissing, objMissing, objMissing }, 0 };
+				for (int k = 0; k < 3 && p < lineEnd && !objSpace(*p); k++)
+				{
+					char * next;
+					long value = strtol(p, &next, 10);
+					if (next != p && value > 0)
+						corner.Index[k] = (int32_t)(value - 1);
+					else if (next != p && value < 0)
+					{
+						corner.Index[k] = (int32_t)((long)counts[k] + value);
+						corner.Relative |= 1 << k;
+					}
+					p = next;
+					if (p < lineEnd && *p == '/')
+						p++;
+				}
+				// Мусор в записи угла пропускаем до пробела
+				while (p < lineEnd && !objSpace(*p))
+					p++;
+				polygon.push_back(corner);
+			}
+			for (size_t i = 2; i < polygon.size(); i++)
+			{
+				chunk.Corners.push_back(polygon[0]);
+				chunk.Corners.push_back(polygon[i - 1]);
+				chunk.Corners.push_back(polygon[i]);
+			}
+		}
+	}
+}
+
+// Разбор всего текста OBJ. Цвет вершины - нормаль, сдвинутая в [0, 1] (белый без нормалей).
+inline bool parseObj(const std::string & text, const MeshOptions & options, MeshData & mesh, MeshLoadStats & stats)
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	// Мелкий файл не стоит делить: на каждый поток - хотя бы 64 КБ текста
+	unsigned threads = options.ParseThreads ? options.ParseThreads : std::max(1u, std::thread::hardware_concurrency());
+	threads = (unsigned)std::max<size_t>(1, std::min<size_t>(threads, text.size() / 65536));
+	std::vector<ObjChunk> chunks(threads);
+	std::vector<std::thread> workers;
+	const char * base = text.data();
+	const char * end = base + text.size();
+	const char * chunkBegin = base;
+	for (unsigned i = 0; i < threads; i++)
+	{
+		// Граница куска сдвигается к концу строки
+		const char * newline = std::find(std::max(chunkBegin, base + text.size() * (i + 1) / threads), end, '\n');
+		const char * chunkEnd = i + 1 == threads || newline == end ? end : newline + 1;
+		if (i + 1 == threads)
+			parseObjChunk(chunkBegin, chunkEnd, chunks[i]);
+		else
+			workers.emplace_back(parseObjChunk, chunkBegin, chunkEnd, std::ref(chunks[i]));
+		chunkBegin = chunkEnd;
+	}
+	for (std::thread & worker : workers)
+		worker.join();
+	stats.ParseThreads = threads;
+
+	// Сквозные массивы атрибутов и начала кусков в них
+	std::vector<float> positions, texCoords, normals;
+	std::vector<size_t> firstPosition, firstTexCoord, firstNormal;
+	size_t corners = 0;
+	stats.Triangles = 0;
+	for (ObjChunk & chunk : chunks)
+	{
+		firstPosition.push_back(positions.size() / 3);
+		firstTexCoord.push_back(texCoords.size() / 2);
+		firstNormal.push_back(normals.size() / 3);
+		positions.insert(positions.end(), chunk.Positions.begin(), chunk.Positions.end());
+		texCoords.insert(texCoords.end(), chunk.TexCoords.begin(), chunk.TexCoords.end());
+		normals.insert(normals.end(), chunk.Normals.begin(), chunk.Normals.end());
+		corners += chunk.Corners.size();
+	}
+	stats.ParseMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	start = Clock::now();
+
+	// Склейка одинаковых троек (v, vt, vn)
+	struct Key
+	{
+		int32_t V, T, N;
+		bool operator==(const Key & other) const { return V == other.V && T == other.T && N == other.N; }
+	};
+	struct KeyHash
+	{
+		size_t operator()(const Key & key) const
+		{
+			uint64_t h = (uint32_t)key.V * 0x9E3779B97F4A7C15ull;
+			h ^= ((uint32_t)key.T + 0x7F4A7C15ull + (h << 6) + (h >> 2)) * 0xBF58476D1CE4E5B9ull;
+			h ^= ((uint32_t)key.N + 0x94D049BBull + (h << 6) + (h >> 2)) * 0x94D049BB133111EBull;
+			return (size_t)(h ^ (h >> 31));
+		}
+	};
+	std::unordered_map<Key, uint32_t, KeyHash> unique;
+	unique.reserve(corners / 4);
+	mesh.Vertices.clear();
+	mesh.Indices.clear();
+	mesh.Indices.reserve(corners);
+	const size_t limits[3] = { positions.size() / 3, texCoords.size() / 2, normals.size() / 3 };
+	for (size_t c = 0; c < chunks.size(); c++)
+	{
+		const size_t offsets[3] = { firstPosition[c], firstTexCoord[c], firstNormal[c] };
+		for (const ObjChunk::Corner & corner : chunks[c].Corners)
+		{
+			int32_t index[3];
+			for (int k = 0; k < 3; k++)
+			{
+				index[k] = corner.Index[k];
+				if (index[k] == objMissing)
+					continue;
+				if (corner.Relative & (1 << k))
+					index[k] += (int32_t)offsets[k];
+				if (index[k] < 0 || (size_t)index[k] >= limits[k])
+				{
+					std::cout << "ERROR::MESH::INDEX_OUT_OF_RANGE " << corner.Index[k] << std::endl;
+					return false;
+				}
+			}
+			auto inserted = unique.emplace(Key{ index[0], index[1], index[2] }, (uint32_t)mesh.Vertices.size());
+			if (inserted.second)
+			{
+				if (index[0] == objMissing)
+				{
+					std::cout << "ERROR::MESH::CORNER_WITHOUT_POSITION" << std::endl;
+					return false;
+				}
+				Fp32Vertex vertex = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f } };
+				for (int k = 0; k < 3; k++)
+					vertex.Position[k] = positions[index[0] * 3 + k];
+				if (index[1] != objMissing)
+					for (int k = 0; k < 2; k++)
+						vertex.TexCoord[k] = texCoords[index[1] * 2 + k];
+				if (index[2] != objMissing)
+					for (int k = 0; k < 3; k++)
+						vertex.Color[k] = normals[index[2] * 3 + k] * 0.5f + 0.5f;
+				mesh.Vertices.push_back(vertex);
+			}
+			mesh.Indices.push_back(inserted.first->second);
+		}
+	}
+	for (ObjChunk & chunk : chunks)
+		stats.Triangles += chunk.Corners.size() / 3;
+	stats.Corners = corners;
+	stats.Vertices = mesh.Vertices.size();
+	stats.DedupMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	if (mesh.Indices.empty())
+	{
+		std::cout << "ERROR::MESH::NO_FACES" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Вписать сетку в куб [-1, 1] с сохранением пропорций
+inline void normalizeMesh(MeshData & mesh)
+{
+	float low[3] = { INFINITY, INFINITY, INFINITY }, high[3] = { -INFINITY, -INFINITY, -INFINITY };
+	for (const Fp32Vertex & vertex : mesh.Vertices)
+		for (int k = 0; k < 3; k++)
+		{
+			low[k] = std::min(low[k], vertex.Position[k]);
+			high[k] = std::max(high[k], vertex.Position[k]);
+		}
+	float extent = std::max(high[0] - low[0], std::max(high[1] - low[1], high[2] - low[2]));
+	if (!(extent > 0.0f))
+		return;
+	for (Fp32Vertex & vertex : mesh.Vertices)
+		for (int k = 0; k < 3; k++)
+			vertex.Position[k] = (vertex.Position[k] - (low[k] + high[k]) * 0.5f) * 2.0f / extent;
+}
+
+// Порядок индексов для кеша вершин и перерисовки, затем порядок вершин для выборки
+inline void optimizeMesh(MeshData & mesh, const MeshOptions & options, MeshLoadStats & stats)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	stats.Before = measureVertexCache(mesh.Indices, mesh.Vertices.size(), options.CacheSize);
+	if (options.OptimizeCache)
+	{
+		std::vector<uint32_t> clusters;
+		optimizeVertexCache(mesh.Indices, mesh.Vertices.size(), options.CacheSize, options.OptimizeOverdraw ? &clusters : nullptr);
+		if (options.OptimizeOverdraw)
+			optimizeOverdraw(mesh.Indices, mesh.Vertices[0].Position, sizeof(Fp32Vertex) / sizeof(float), clusters);
+	}
+	optimizeVertexFetch(mesh.Vertices, mesh.Indices);
+	stats.After = measureVertexCache(mesh.Indices, mesh.Vertices.size(), options.CacheSize);
+	stats.OptimizeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Чтение, разбор и оптимизация файла OBJ целиком на вызывающем потоке
+inline bool loadObj(const std::string & path, const MeshOptions & options, MeshData & mesh, MeshLoadStats & stats)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "ERROR::MESH::FILE_NOT_FOUND " << path << std::endl;
+		return false;
+	}
+	std::stringstream text;
+	text << file.rdbuf();
+	stats.ReadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if (!parseObj(text.str(), options, mesh, stats))
+		return false;
+	if (options.Normalize)
+		normalizeMesh(mesh);
+	optimizeMesh(mesh, options, stats);
+	return true;
+}
+
+// Сетка в видеопамяти. Атрибуты - Fp32VertexLayout, как у четырёхугольника.
+struct GpuMesh
+{
+	GLuint VertexArray = 0, VertexBuffer = 0, IndexBuffer = 0;
+	GLenum IndexType = GL_UNSIGNED_INT;
+	GLsizei IndexCount = 0, VertexCount = 0;
+
+	// Индексы укладываются в 16 бит, если вершин не больше 65536 (forceInt - оставить 32 бита).
+	// state - трекер кадра, если загрузка идёт посреди кадра: VAO привязывается через него,
+	// иначе трекер считал бы привязанным прежний VAO.
+	void Upload(const MeshData & mesh, GlState * state, bool forceInt = false)
+	{
+		this->VertexCount = (GLsizei)mesh.Vertices.size();
+		this->IndexCount = (GLsizei)mesh.Indices.size();
+		this->IndexType = mesh.Vertices.size() <= 65536 && !forceInt ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		glGenVertexArrays(1, &this->VertexArray);
+		glGenBuffers(1, &this->VertexBuffer);
+		glGenBuffers(1, &this->IndexBuffer);
+		if (state)
+			state->BindVertexArray(this->VertexArray);
+		else
+			glBindVertexArray(this->VertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, this->VertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, mesh.Vertices.size() * sizeof(Fp32Vertex), mesh.Vertices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->IndexBuffer);
+		if (this->IndexType == GL_UNSIGNED_SHORT)
+		{
+			std::vector<GLushort> shorts(mesh.Indices.begin(), mesh.Indices.end());
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, shorts.size() * sizeof(GLushort), shorts.data(), GL_STATIC_DRAW);
+		}
+		else
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.Indices.size() * sizeof(GLuint), mesh.Indices.data(), GL_STATIC_DRAW);
+		Fp32VertexLayout::Apply();
+		if (!state)
+			glBindVertexArray(0);
+	}
+
+	size_t IndexBytes() const
+	{
+		return (size_t)this->IndexCount * (this->IndexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint));
+	}
+
+	// Ничего не рисует, пока сетка не загружена
+	void Draw(GlState * state) const
+	{
+		if (!this->IndexCount)
+			return;
+		if (state)
+			state->BindVertexArray(this->VertexArray);
+		else
+			glBindVertexArray(this->VertexArray);
+		glDrawElements(GL_TRIANGLES, this->IndexCount, this->IndexType, 0);
+	}
+
+	void Destroy()
+	{
+		glDeleteVertexArrays(1, &this->VertexArray);
+		glDeleteBuffers(1, &this->VertexBuffer);
+		glDeleteBuffers(1, &this->IndexBuffer);
+		this->VertexArray = this->VertexBuffer = this->IndexBuffer = 0;
+		this->IndexCount = this->VertexCount = 0;
+	}
+};
+
+class MeshLoader
+{
+	public:
+	MeshOptions Options;
+
+	explicit MeshLoader(unsigned threads = 1) : pool(threads), events(64) {}
+
+	~MeshLoader()
+	{
+		// Рабочие потоки должны закончить до того, как освободятся задания
+		this->pool.Wait();
+	}
+
+	// Удаление буферов всех сеток; вызывается, пока контекст OpenGL ещё жив
+	void Release()
+	{
+		for (auto & job : this->jobs)
+			job->Mesh.Destroy();
+	}
+
+	// Пустая сетка, которая начнёт рисоваться, когда файл будет разобран и загружен.
+	// Указатель остаётся действительным до уничтожения загрузчика.
+	GpuMesh * Request(const std::string & path)
+	{
+		std::shared_ptr<Job> job = std::make_shared<Job>();
+		job->Path = path;
+		job->Requested = Clock::now();
+		this->jobs.push_back(job);
+		this->pending++;
+		MeshOptions options = this->Options;
+		this->pool.Submit([this, job, options]
+		{
+			job->Failed = !loadObj(job->Path, options, job->Data, job->Stats);
+			this->events.Push(job.get());
+		});
+		return &job->Mesh;
+	}
+
+	// Вызывается потоком OpenGL в начале каждого кадра; state - как в GpuMesh::Upload
+	void Pump(GlState * state = nullptr)
+	{
+		Job * job;
+		while (this->events.TryPop(job))
+		{
+			this->pending--;
+			if (job->Failed)
+			{
+				std::cout << "ERROR::MESH::LOAD_FAILED " << job->Path << std::endl;
+				continue;
+			}
+			Clock::time_point start = Clock::now();
+			job->Mesh.Upload(job->Data, state);
+			job->Stats.IndexBytes = job->Mesh.IndexBytes();
+			job->Data = MeshData();
+			job->Stats.UploadMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			job->Stats.ReadyMs = std::chrono::duration<double, std::milli>(Clock::now() - job->Requested).count();
+		}
+	}
+
+	int Pending() const { return this->pending; }
+
+	void Report(std::ostream & out) const
+	{
+		out << std::fixed << std::setprecision(3);
+		for (auto & job : this->jobs)
+		{
+			const MeshLoadStats & stats = job->Stats;
+			out << "mesh path=" << job->Path
+				<< " triangles=" << stats.Triangles << " corners=" << stats.Corners << " vertices=" << stats.Vertices
+				<< " index_type=" << (job->Mesh.IndexType == GL_UNSIGNED_SHORT ? "u16" : "u32")
+				<< " index_bytes=" << stats.IndexBytes
+				<< " acmr_before=" << stats.Before.Acmr << " acmr_after=" << stats.After.Acmr
+				<< " atvr_before=" << stats.Before.Atvr << " atvr_after=" << stats.After.Atvr
+				<< " parse_threads=" << stats.ParseThreads
+				<< " read_ms=" << stats.ReadMs << " parse_ms=" << stats.ParseMs << " dedup_ms=" << stats.DedupMs
+				<< " optimize_ms=" << stats.OptimizeMs << " upload_ms=" << stats.UploadMs << " ready_ms=" << stats.ReadyMs
+				<< (job->Failed ? " failed" : "") << std::endl;
+		}
+	}
+
+	private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Job
+	{
+		std::string Path;
+		MeshData Data;
+		MeshLoadStats Stats;
+		GpuMesh Mesh;
+		bool Failed = false;
+		Clock::time_point Requested;
+	};
+
+	ThreadPool pool;
+	LockFreeQueue<Job *> events;
+	std::vector<std::shared_ptr<Job>> jobs;
+	int pending = 0;
+};
+
+#endif
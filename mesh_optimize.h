@@ -0,0 +1,212 @@
+// Оптимизация индексированных треугольных сеток для GPU.
+//
+// optimizeVertexCache - алгоритм Tipsify (Sander, Nehab, Barczak, 2007): треугольники
+//     выдаются веерами вокруг вершин, а следующая вершина веера выбирается так, чтобы её
+//     соседи ещё лежали в кеше вершин после преобразования (post-transform cache). Работает
+//     за линейное время и почти не зависит от точного размера кеша.
+// optimizeOverdraw    - кластеры, на которые Tipsify разбивает сетку (границы там, где веер
+//     заходит в тупик), переставляются так, чтобы "выпуклые наружу" части рисовались первыми:
+//     они чаще закрывают остальное, и тест глубины отбрасывает больше фрагментов.
+// optimizeVertexFetch - вершины переупорядочиваются по первому использованию, чтобы выборка
+//     из буфера вершин шла по памяти подряд.
+// measureVertexCache  - ACMR (промахи кеша на треугольник, идеал 0.5) и ATVR (промахи на
+//     вершину, идеал 1.0) на модели FIFO-кеша.
+
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+struct VertexCacheStats
+{
+	double Acmr = 0.0, Atvr = 0.0;
+};
+
+// Промахи FIFO-кеша из cacheSize вершин при отрисовке индексов по порядку
+inline VertexCacheStats measureVertexCache(const std::vector<uint32_t> & indices, size_t vertexCount, int cacheSize = 16)
+{
+	// Момент попадания вершины в кеш: вершина в кеше, если с тех пор в него записано меньше cacheSize
+	std::vector<uint64_t> insertedAt(vertexCount, 0);
+	uint64_t writes = 0, misses = 0;
+	for (uint32_t index : indices)
+	{
+		if (insertedAt[index] && writes - insertedAt[index] < (uint64_t)cacheSize)
+			continue;
+		misses++;
+		insertedAt[index] = ++writes;
+	}
+	VertexCacheStats stats;
+	size_t triangles = indices.size() / 3;
+	stats.Acmr = triangles ? (double)misses / triangles : 0.0;
+	stats.Atvr = vertexCount ? (double)misses / vertexCount : 0.0;
+	return stats;
+}
+
+// Tipsify. clusters (если задан) получает номера первых треугольников кластеров.
+inline void optimizeVertexCache(std::vector<uint32_t> & indices, size_t vertexCount, int cacheSize = 16,
+								std::vector<uint32_t> * clusters = nullptr)
+{
+	size_t triangleCount = indices.size() / 3;
+	// Списки треугольников каждой вершины в одном массиве (offsets - начала списков)
+	std::vector<uint32_t> offsets(vertexCount + 1, 0), adjacency(indices.size());
+	for (uint32_t index : indices)
+		offsets[index + 1]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] += offsets[v];
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++)
+		adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+
+	// live - сколько ещё не выданных треугольников у вершины, stamp - момент попадания в кеш
+	std::vector<uint32_t> live(vertexCount), stamp(vertexCount, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		live[v] = offsets[v + 1] - offsets[v];
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnd, candidates, output;
+	output.reserve(indices.size());
+	deadEnd.reserve(indices.size());
+
+	uint32_t time = cacheSize + 1;
+	size_t cursor = 0;
+	int64_t fan = vertexCount ? 0 : -1;
+	if (clusters)
+		clusters->assign(1, 0);
+	while (fan >= 0)
+	{
+		candidates.clear();
+		for (uint32_t k = offsets[fan]; k < offsets[fan + 1]; k++)
+		{
+			uint32_t triangle = adjacency[k];
+			if (emitted[triangle])
+				continue;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				uint32_t v = indices[triangle * 3 + corner];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - stamp[v] > (uint32_t)cacheSize)
+					stamp[v] = time++;
+			}
+			emitted[triangle] = true;
+		}
+
+		// Следующий веер: кандидат, который дольше всех останется в кеше, пока выдаются его треугольники
+		int64_t next = -1;
+		int best = -1;
+		for (uint32_t v : candidates)
+		{
+			if (!live[v])
+				continue;
+			int priority = 0;
+			if ((int)(time - stamp[v]) + 2 * (int)live[v] <= cacheSize)
+				priority = (int)(time - stamp[v]);
+			if (priority > best)
+			{
+				best = priority;
+				next = v;
+			}
+		}
+		if (next < 0)
+		{
+			// Тупик: недавняя вершина с невыданными треугольниками или любая следующая по номеру
+			while (!deadEnd.empty() && next < 0)
+			{
+				uint32_t v = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[v])
+					next = v;
+			}
+			while (next < 0 && cursor < vertexCount)
+			{
+				if (live[cursor])
+					next = (int64_t)cursor;
+				cursor++;
+			}
+			if (next >= 0 && clusters && output.size() / 3 > clusters->back())
+				clusters->push_back((uint32_t)(output.size() / 3));
+		}
+		fan = next;
+	}
+	indices.swap(output);
+}
+
+// Перестановка кластеров Tipsify ради меньшей перерисовки. positions - xyz с шагом stride
+// (в float) на вершину. Кластеры сортируются по тому, насколько они обращены от центра сетки.
+inline void optimizeOverdraw(std::vector<uint32_t> & indices, const float * positions, size_t stride,
+							 const std::vector<uint32_t> & clusters)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (clusters.size() < 2 || !triangleCount)
+		return;
+	float meshCenter[3] = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t index : indices)
+		for (int c = 0; c < 3; c++)
+			meshCenter[c] += positions[index * stride + c];
+	for (int c = 0; c < 3; c++)
+		meshCenter[c] /= indices.size();
+
+	struct Cluster
+	{
+		uint32_t Begin, End;
+		float Sort;
+	};
+	std::vector<Cluster> sorted;
+	for (size_t i = 0; i < clusters.size(); i++)
+	{
+		Cluster cluster = { clusters[i], i + 1 < clusters.size() ? clusters[i + 1] : (uint32_t)triangleCount, 0.0f };
+		// Центр и сумма нормалей (с весом площади) треугольников кластера
+		float center[3] = { 0.0f, 0.0f, 0.0f }, normal[3] = { 0.0f, 0.0f, 0.0f };
+		for (uint32_t t = cluster.Begin; t < cluster.End; t++)
+		{
+			const float * a = positions + indices[t * 3] * stride;
+			const float * b = positions + indices[t * 3 + 1] * stride;
+			const float * c = positions + indices[t * 3 + 2] * stride;
+			float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+			normal[0] += e1[1] * e2[2] - e1[2] * e2[1];
+			normal[1] += e1[2] * e2[0] - e1[0] * e2[2];
+			normal[2] += e1[0] * e2[1] - e1[1] * e2[0];
+			for (int k = 0; k < 3; k++)
+				center[k] += (a[k] + b[k] + c[k]) / 3.0f;
+		}
+		float count = (float)(cluster.End - cluster.Begin);
+		for (int k = 0; k < 3; k++)
+			cluster.Sort += (center[k] / count - meshCenter[k]) * normal[k];
+		sorted.push_back(cluster);
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster & a, const Cluster & b) { return a.Sort > b.Sort; });
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+	for (const Cluster & cluster : sorted)
+		output.insert(output.end(), indices.begin() + cluster.Begin * 3, indices.begin() + cluster.End * 3);
+	indices.swap(output);
+}
+
+// Перенумерация вершин по первому использованию. Возвращает новое число вершин
+// (неиспользуемые отбрасываются); vertices переставляются на месте.
+template <typename Vertex>
+size_t optimizeVertexFetch(std::vector<Vertex> & vertices, std::vector<uint32_t> & indices)
+{
+	std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+	std::vector<Vertex> ordered;
+	ordered.reserve(vertices.size());
+	for (uint32_t & index : indices)
+	{
+		if (remap[index] == UINT32_MAX)
+		{
+			remap[index] = (uint32_t)ordered.size();
+			ordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(ordered);
+	return vertices.size();
+}
+
+#endif
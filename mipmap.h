@@ -0,0 +1,534 @@
+// Построение мипмапов на CPU. Вместо glGenerateMipmap (на программных растеризаторах
+// это медленно и происходит при каждом запуске) цепочка уровней строится заранее или в
+// рабочем потоке и потом загружается в OpenGL уровень за уровнем.
+// Фильтры: ящичный 2x2 и Кайзера (оконный sinc, 8 отсчётов). Для обоих есть скалярная
+// версия и версии на SSE2/AVX2, выбор - по возможностям процессора во время работы.
+// Для изображений в sRGB усреднение делается в линейном пространстве.
+// Файл не зависит от OpenGL, поэтому годится и для офлайн-утилит.
+
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MIPMAP_X86 1
+#include <immintrin.h>
+#define MIPMAP_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+enum class MipFilter { Box, Kaiser };
+enum class SimdLevel { Scalar, SSE2, AVX2 };
+
+inline const char * simdLevelName(SimdLevel level)
+{
+	return level == SimdLevel::AVX2 ? "avx2" : level == SimdLevel::SSE2 ? "sse2" : "scalar";
+}
+
+// Лучший набор инструкций, доступный на этом процессоре
+inline SimdLevel detectSimdLevel()
+{
+#ifdef MIPMAP_X86
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return SimdLevel::AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return SimdLevel::SSE2;
+#endif
+	return SimdLevel::Scalar;
+}
+
+struct MipOptions
+{
+	MipFilter Filter = MipFilter::Box;
+	// Пиксели закодированы в sRGB: фильтровать в линейном пространстве (альфа всегда линейна)
+	bool Srgb = false;
+	SimdLevel Simd = detectSimdLevel();
+};
+
+// Цепочка мипмапов RGBA8, все уровни подряд в одном буфере. Смещения уровней
+// совпадают со смещениями в PBO, если скопировать Data в него целиком.
+struct MipChain
+{
+	struct Level
+	{
+		int Width, Height;
+		size_t Offset;
+	};
+	std::vector<Level> Levels;
+	std::vector<unsigned char> Data;
+
+	unsigned char * Pixels(int level) { return this->Data.data() + this->Levels[level].Offset; }
+	const unsigned char * Pixels(int level) const { return this->Data.data() + this->Levels[level].Offset; }
+	size_t LevelSize(int level) const { return (size_t)this->Levels[level].Width * this->Levels[level].Height * 4; }
+};
+
+// Число уровней полной цепочки: до 1x1 включительно
+inline int mipLevelCount(int width, int height)
+{
+	int levels = 1;
+	while (width > 1 || height > 1)
+	{
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+		levels++;
+	}
+	return levels;
+}
+
+// ---------------------------------------------------------------------------------------
+// RGB -> RGBA. SOIL_LOAD_RGB даёт строки по width * 3 байт, которые не выровнены по 4 и
+// требуют GL_UNPACK_ALIGNMENT = 1. RGBA8 выровнен всегда и фильтруется по 4 канала сразу.
+
+inline void padRgbToRgbaScalar(const unsigned char * rgb, unsigned char * rgba, size_t pixels)
+{
+	for (size_t i = 0; i < pixels; i++)
+	{
+		rgba[i * 4 + 0] = rgb[i * 3 + 0];
+		rgba[i * 4 + 1] = rgb[i * 3 + 1];
+		rgba[i * 4 + 2] = rgb[i * 3 + 2];
+		rgba[i * 4 + 3] = 255;
+	}
+}
+
+#ifdef MIPMAP_X86
+// pshufb раскладывает 4 пикселя по 3 байта в 4 пикселя по 4 байта за одну инструкцию
+MIPMAP_TARGET_AVX2 inline void padRgbToRgbaAvx2(const unsigned char * rgb, unsigned char * rgba, size_t pixels)
+{
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+	size_t i = 0;
+	// Читаем по 16 байт, а используем 12, поэтому последние пиксели доделывает скалярный код
+	for (; i + 6 <= pixels; i += 4)
+	{
+		__m128i source = _mm_loadu_si128((const __m128i *)(rgb + i * 3));
+		__m128i result = _mm_or_si128(_mm_shuffle_epi8(source, shuffle), alpha);
+		_mm_storeu_si128((__m128i *)(rgba + i * 4), result);
+	}
+	padRgbToRgbaScalar(rgb + i * 3, rgba + i * 4, pixels - i);
+}
+#endif
+
+inline void padRgbToRgba(const unsigned char * rgb, unsigned char * rgba, size_t pixels, SimdLevel simd = detectSimdLevel())
+{
+#ifdef MIPMAP_X86
+	if (simd == SimdLevel::AVX2)
+	{
+		padRgbToRgbaAvx2(rgb, rgba, pixels);
+		return;
+	}
+#endif
+	padRgbToRgbaScalar(rgb, rgba, pixels);
+}
+
+// ---------------------------------------------------------------------------------------
+// Таблицы sRGB. Декодирование - 256 значений, кодирование - по 4096 ступеням линейной яркости.
+
+struct SrgbTables
+{
+	float ToLinear[256];
+	unsigned char FromLinear[4096];
+
+	SrgbTables()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			float c = i / 255.0f;
+			float linear = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+			this->ToLinear[i] = linear * 255.0f;
+		}
+		for (int i = 0; i < 4096; i++)
+		{
+			float linear = i / 4095.0f;
+			float c = linear <= 0.0031308f ? linear * 12.92f : 1.055f * powf(linear, 1.0f / 2.4f) - 0.055f;
+			this->FromLinear[i] = (unsigned char)std::min(255.0f, std::max(0.0f, c * 255.0f + 0.5f));
+		}
+	}
+
+	unsigned char Encode(float linear255) const
+	{
+		int index = (int)(linear255 * (4095.0f / 255.0f) + 0.5f);
+		return this->FromLinear[std::min(4095, std::max(0, index))];
+	}
+};
+
+inline const SrgbTables & srgbTables()
+{
+	static const SrgbTables tables;
+	return tables;
+}
+
+// ---------------------------------------------------------------------------------------
+// Ящичный фильтр 2x2. Размер следующего уровня - max(1, size / 2), как у glGenerateMipmap.
+// Если исходная сторона равна 1, пиксель по этой оси берётся дважды.
+
+inline void boxRowScalar(const unsigned char * row0, const unsigned char * row1, int sourceWidth,
+						 unsigned char * dst, int first, int last)
+{
+	for (int x = first; x < last; x++)
+	{
+		int x0 = 2 * x * 4;
+		int x1 = std::min(2 * x + 1, sourceWidth - 1) * 4;
+		for (int c = 0; c < 4; c++)
+			dst[x * 4 + c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+	}
+}
+
+inline void boxRowSrgb(const unsigned char * row0, const unsigned char * row1, int sourceWidth,
+					   unsigned char * dst, int width)
+{
+	const SrgbTables & srgb = srgbTables();
+	for (int x = 0; x < width; x++)
+	{
+		int x0 = 2 * x * 4;
+		int x1 = std::min(2 * x + 1, sourceWidth - 1) * 4;
+		for (int c = 0; c < 3; c++)
+		{
+			float sum = srgb.ToLinear[row0[x0 + c]] + srgb.ToLinear[row0[x1 + c]] +
+						srgb.ToLinear[row1[x0 + c]] + srgb.ToLinear[row1[x1 + c]];
+			dst[x * 4 + c] = srgb.Encode(sum * 0.25f);
+		}
+		dst[x * 4 + 3] = (unsigned char)((row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3] + 2) >> 2);
+	}
+}
+
+#ifdef MIPMAP_X86
+// 8 исходных пикселей (по 4 из каждой строки пары) -> 4 результирующих.
+// Суммы считаются в 16 битах, поэтому округление точно такое же, как в скалярной версии.
+inline int boxRowSse2(const unsigned char * row0, const unsigned char * row1, unsigned char * dst, int width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i two = _mm_set1_epi16(2);
+	int x = 0;
+	for (; x + 4 <= width; x += 4)
+	{
+		__m128i a0 = _mm_loadu_si128((const __m128i *)(row0 + x * 8));
+		__m128i a1 = _mm_loadu_si128((const __m128i *)(row0 + x * 8 + 16));
+		__m128i b0 = _mm_loadu_si128((const __m128i *)(row1 + x * 8));
+		__m128i b1 = _mm_loadu_si128((const __m128i *)(row1 + x * 8 + 16));
+
+		// Вертикальные суммы: каждая пара пикселей в 16-битных каналах
+		__m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero)); // p0 p1
+		__m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero)); // p2 p3
+		__m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero)); // p4 p5
+		__m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero)); // p6 p7
+
+		// Горизонтальные суммы соседних пикселей
+		__m128i d01 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+		__m128i d23 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3), _mm_unpackhi_epi64(s2, s3));
+		d01 = _mm_srli_epi16(_mm_add_epi16(d01, two), 2);
+		d23 = _mm_srli_epi16(_mm_add_epi16(d23, two), 2);
+		_mm_storeu_si128((__m128i *)(dst + x * 4), _mm_packus_epi16(d01, d23));
+	}
+	return x;
+}
+
+// То же на 256-битных регистрах: 16 исходных пикселей -> 8 результирующих
+MIPMAP_TARGET_AVX2 inline int boxRowAvx2(const unsigned char * row0, const unsigned char * row1, unsigned char * dst, int width)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i two = _mm256_set1_epi16(2);
+	int x = 0;
+	for (; x + 8 <= width; x += 8)
+	{
+		__m256i a0 = _mm256_loadu_si256((const __m256i *)(row0 + x * 8));
+		__m256i a1 = _mm256_loadu_si256((const __m256i *)(row0 + x * 8 + 32));
+		__m256i b0 = _mm256_loadu_si256((const __m256i *)(row1 + x * 8));
+		__m256i b1 = _mm256_loadu_si256((const __m256i *)(row1 + x * 8 + 32));
+
+		// Распаковка идёт внутри 128-битных половин, поэтому порядок восстанавливается в конце
+		__m256i s0 = _mm256_add_epi16(_mm256_unpacklo_epi8(a0, zero), _mm256_unpacklo_epi8(b0, zero));
+		__m256i s1 = _mm256_add_epi16(_mm256_unpackhi_epi8(a0, zero), _mm256_unpackhi_epi8(b0, zero));
+		__m256i s2 = _mm256_add_epi16(_mm256_unpacklo_epi8(a1, zero), _mm256_unpacklo_epi8(b1, zero));
+		__m256i s3 = _mm256_add_epi16(_mm256_unpackhi_epi8(a1, zero), _mm256_unpackhi_epi8(b1, zero));
+
+		__m256i d0 = _mm256_add_epi16(_mm256_unpacklo_epi64(s0, s1), _mm256_unpackhi_epi64(s0, s1)); // d0 d1 | d2 d3
+		__m256i d1 = _mm256_add_epi16(_mm256_unpacklo_epi64(s2, s3), _mm256_unpackhi_epi64(s2, s3)); // d4 d5 | d6 d7
+		d0 = _mm256_srli_epi16(_mm256_add_epi16(d0, two), 2);
+		d1 = _mm256_srli_epi16(_mm256_add_epi16(d1, two), 2);
+		// packus даёт d01 d45 | d23 d67, переставляем 64-битные части по порядку
+		__m256i packed = _mm256_packus_epi16(d0, d1);
+		_mm256_storeu_si256((__m256i *)(dst + x * 4), _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+	return x;
+}
+#endif
+
+inline void downsampleBox(const unsigned char * src, int sourceWidth, int sourceHeight,
+						  unsigned char * dst, int width, int height, const MipOptions & options)
+{
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char * row0 = src + (size_t)(2 * y) * sourceWidth * 4;
+		const unsigned char * row1 = src + (size_t)std::min(2 * y + 1, sourceHeight - 1) * sourceWidth * 4;
+		unsigned char * out = dst + (size_t)y * width * 4;
+
+		if (options.Srgb)
+		{
+			boxRowSrgb(row0, row1, sourceWidth, out, width);
+			continue;
+		}
+
+		// Векторные версии берут только полные пары пикселей
+		int pairs = sourceWidth / 2;
+		int done = 0;
+#ifdef MIPMAP_X86
+		if (options.Simd == SimdLevel::AVX2)
+			done = boxRowAvx2(row0, row1, out, pairs);
+		if (options.Simd != SimdLevel::Scalar)
+			done += boxRowSse2(row0 + done * 8, row1 + done * 8, out + done * 4, pairs - done);
+#endif
+		boxRowScalar(row0, row1, sourceWidth, out, done, width);
+	}
+}
+
+// ---------------------------------------------------------------------------------------
+// Фильтр Кайзера. Уменьшение ровно в 2 раза, поэтому веса одинаковы для всех пикселей:
+// 8 отсчётов с центром между исходными пикселями 2x и 2x + 1. Фильтр разделимый:
+// сначала строки, потом столбцы, промежуточный результат во float.
+
+static const int kaiserTaps = 8;
+
+inline double besselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 32; k++)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+inline const float * kaiserWeights()
+{
+	struct Weights
+	{
+		float Values[kaiserTaps];
+		Weights()
+		{
+			const double pi = 3.14159265358979323846;
+			const double alpha = 4.0;
+			const double radius = kaiserTaps / 2.0;
+			double total = 0.0;
+			for (int k = 0; k < kaiserTaps; k++)
+			{
+				// Расстояние от центра в исходных пикселях и в пикселях нового уровня
+				double t = k - (kaiserTaps - 1) / 2.0;
+				double x = t / 2.0;
+				double sinc = x == 0.0 ? 1.0 : sin(pi * x) / (pi * x);
+				double r = t / radius;
+				double window = besselI0(alpha * sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(alpha);
+				this->Values[k] = (float)(sinc * window);
+				total += this->Values[k];
+			}
+			for (int k = 0; k < kaiserTaps; k++)
+				this->Values[k] = (float)(this->Values[k] / total);
+		}
+	};
+	static const Weights weights;
+	return weights.Values;
+}
+
+// Индексы исходных пикселей для каждого результирующего (с прижатием к краю)
+inline void kaiserIndices(int sourceSize, int size, std::vector<int> & indices)
+{
+	indices.resize((size_t)size * kaiserTaps);
+	for (int x = 0; x < size; x++)
+		for (int k = 0; k < kaiserTaps; k++)
+			indices[x * kaiserTaps + k] = std::min(sourceSize - 1, std::max(0, 2 * x - kaiserTaps / 2 + 1 + k));
+}
+
+// Горизонтальный проход: строка float RGBA -> строка вдвое уже
+inline void kaiserRowScalar(const float * src, const int * indices, float * dst, int width)
+{
+	const float * weights = kaiserWeights();
+	for (int x = 0; x < width; x++)
+	{
+		float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int k = 0; k < kaiserTaps; k++)
+		{
+			const float * pixel = src + indices[x * kaiserTaps + k] * 4;
+			for (int c = 0; c < 4; c++)
+				sum[c] += weights[k] * pixel[c];
+		}
+		memcpy(dst + x * 4, sum, sizeof(sum));
+	}
+}
+
+// Вертикальный проход: взвешенная сумма kaiserTaps строк
+inline void kaiserColumnScalar(const float * const * rows, float * dst, int count)
+{
+	const float * weights = kaiserWeights();
+	for (int i = 0; i < count; i++)
+	{
+		float sum = 0.0f;
+		for (int k = 0; k < kaiserTaps; k++)
+			sum += weights[k] * rows[k][i];
+		dst[i] = sum;
+	}
+}
+
+#ifdef MIPMAP_X86
+// Один пиксель RGBA - ровно один регистр SSE
+inline void kaiserRowSse2(const float * src, const int * indices, float * dst, int width)
+{
+	const float * weights = kaiserWeights();
+	for (int x = 0; x < width; x++)
+	{
+		__m128 sum = _mm_setzero_ps();
+		for (int k = 0; k < kaiserTaps; k++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(src + indices[x * kaiserTaps + k] * 4)));
+		_mm_storeu_ps(dst + x * 4, sum);
+	}
+}
+
+inline int kaiserColumnSse2(const float * const * rows, float * dst, int count)
+{
+	const float * weights = kaiserWeights();
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 sum = _mm_setzero_ps();
+		for (int k = 0; k < kaiserTaps; k++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(rows[k] + i)));
+		_mm_storeu_ps(dst + i, sum);
+	}
+	return i;
+}
+
+// Два результирующих пикселя на регистр AVX
+MIPMAP_TARGET_AVX2 inline void kaiserRowAvx2(const float * src, const int * indices, float * dst, int width)
+{
+	const float * weights = kaiserWeights();
+	int x = 0;
+	for (; x + 2 <= width; x += 2)
+	{
+		__m256 sum = _mm256_setzero_ps();
+		for (int k = 0; k < kaiserTaps; k++)
+		{
+			__m256 pixels = _mm256_insertf128_ps(
+				_mm256_castps128_ps256(_mm_loadu_ps(src + indices[x * kaiserTaps + k] * 4)),
+				_mm_loadu_ps(src + indices[(x + 1) * kaiserTaps + k] * 4), 1);
+			sum = _mm256_fmadd_ps(_mm256_set1_ps(weights[k]), pixels, sum);
+		}
+		_mm256_storeu_ps(dst + x * 4, sum);
+	}
+	kaiserRowSse2(src, indices + x * kaiserTaps, dst + x * 4, width - x);
+}
+
+MIPMAP_TARGET_AVX2 inline int kaiserColumnAvx2(const float * const * rows, float * dst, int count)
+{
+	const float * weights = kaiserWeights();
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 sum = _mm256_setzero_ps();
+		for (int k = 0; k < kaiserTaps; k++)
+			sum = _mm256_fmadd_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(rows[k] + i), sum);
+		_mm256_storeu_ps(dst + i, sum);
+	}
+	return i;
+}
+#endif
+
+inline void downsampleKaiser(const unsigned char * src, int sourceWidth, int sourceHeight,
+							 unsigned char * dst, int width, int height, const MipOptions & options)
+{
+	const SrgbTables & srgb = srgbTables();
+
+	// Исходный уровень во float (в линейном пространстве для sRGB)
+	std::vector<float> source((size_t)sourceWidth * sourceHeight * 4);
+	for (size_t i = 0; i < source.size(); i++)
+		source[i] = (options.Srgb && (i & 3) != 3) ? srgb.ToLinear[src[i]] : (float)src[i];
+
+	std::vector<int> columns, rows;
+	kaiserIndices(sourceWidth, width, columns);
+	kaiserIndices(sourceHeight, height, rows);
+
+	// Горизонтальный проход по всем исходным строкам
+	std::vector<float> horizontal((size_t)sourceHeight * width * 4);
+	for (int y = 0; y < sourceHeight; y++)
+	{
+		const float * in = source.data() + (size_t)y * sourceWidth * 4;
+		float * out = horizontal.data() + (size_t)y * width * 4;
+#ifdef MIPMAP_X86
+		if (options.Simd == SimdLevel::AVX2)
+			kaiserRowAvx2(in, columns.data(), out, width);
+		else if (options.Simd == SimdLevel::SSE2)
+			kaiserRowSse2(in, columns.data(), out, width);
+		else
+#endif
+			kaiserRowScalar(in, columns.data(), out, width);
+	}
+
+	// Вертикальный проход и обратное преобразование в байты
+	int count = width * 4;
+	std::vector<float> line(count);
+	for (int y = 0; y < height; y++)
+	{
+		const float * taps[kaiserTaps];
+		for (int k = 0; k < kaiserTaps; k++)
+			taps[k] = horizontal.data() + (size_t)rows[y * kaiserTaps + k] * count;
+
+		int done = 0;
+#ifdef MIPMAP_X86
+		if (options.Simd == SimdLevel::AVX2)
+			done = kaiserColumnAvx2(taps, line.data(), count);
+		else if (options.Simd == SimdLevel::SSE2)
+			done = kaiserColumnSse2(taps, line.data(), count);
+#endif
+		if (done < count)
+		{
+			const float * rest[kaiserTaps];
+			for (int k = 0; k < kaiserTaps; k++)
+				rest[k] = taps[k] + done;
+			kaiserColumnScalar(rest, line.data() + done, count - done);
+		}
+
+		unsigned char * out = dst + (size_t)y * count;
+		for (int i = 0; i < count; i++)
+		{
+			// У sinc есть отрицательные лепестки, поэтому результат может выйти за [0, 255]
+			float value = std::min(255.0f, std::max(0.0f, line[i]));
+			out[i] = (options.Srgb && (i & 3) != 3) ? srgb.Encode(value) : (unsigned char)(value + 0.5f);
+		}
+	}
+}
+
+// ---------------------------------------------------------------------------------------
+
+// Полная цепочка мипмапов из изображения RGBA8
+inline void buildMipChain(const unsigned char * rgba, int width, int height, const MipOptions & options, MipChain & chain)
+{
+	int levels = mipLevelCount(width, height);
+	chain.Levels.resize(levels);
+	size_t offset = 0;
+	for (int level = 0; level < levels; level++)
+	{
+		chain.Levels[level] = { width, height, offset };
+		offset += (size_t)width * height * 4;
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+	chain.Data.resize(offset);
+	memcpy(chain.Data.data(), rgba, chain.LevelSize(0));
+
+	for (int level = 1; level < levels; level++)
+	{
+		const MipChain::Level & source = chain.Levels[level - 1];
+		const MipChain::Level & target = chain.Levels[level];
+		if (options.Filter == MipFilter::Kaiser)
+			downsampleKaiser(chain.Pixels(level - 1), source.Width, source.Height,
+							 chain.Pixels(level), target.Width, target.Height, options);
+		else
+			downsampleBox(chain.Pixels(level - 1), source.Width, source.Height,
+						  chain.Pixels(level), target.Width, target.Height, options);
+	}
+}
+
+#endif
@@ -0,0 +1,128 @@
+// Частицы: геометрия, которая пересчитывается на CPU и заново загружается каждый кадр.
+// Каждая частица - четырёхугольник с теми же атрибутами, что у вершин hello_window.cpp
+// (позиция, цвет, текстурные координаты), поэтому рисуются они той же программой ourShader.
+// Вершины упакованы в 16 байт (PackedVertex): загружать каждый кадр приходится вдвое меньше.
+//
+// Вершины пишутся прямо в StreamBuffer, без промежуточного массива. Индексы статичны
+// (четырёхугольник i - вершины 4i..4i+3), а смещение кадра в кольцевом буфере передаётся
+// как basevertex в glDrawElementsBaseVertex, так что VAO настраивается один раз.
+
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "gl_state.h"
+#include "stream_buffer.h"
+#include "vertex_layout.h"
+
+class ParticleSystem
+{
+	public:
+	int Count = 0;
+	StreamBuffer Vertices;
+	// Если задан, VAO привязывается через трекер состояния
+	GlState * State = nullptr;
+
+	bool Create(int count, BufferStreaming streaming)
+	{
+		this->Count = count;
+		// Кадр целиком: кратность размера кадра шагу вершины делает смещения областей кратными ему же
+		if (!this->Vertices.Create(GL_ARRAY_BUFFER, (GLsizeiptr)count * 4 * vertexStride, streaming))
+			return false;
+
+		std::vector<GLuint> indices(count * 6);
+		const GLuint quad[] = { 0, 1, 3, 1, 2, 3 };
+		for (int i = 0; i < count; i++)
+			for (int k = 0; k < 6; k++)
+				indices[i * 6 + k] = i * 4 + quad[k];
+
+		glGenVertexArrays(1, &this->vao);
+		glGenBuffers(1, &this->indexBuffer);
+		glBindVertexArray(this->vao);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, this->Vertices.Buffer);
+		PackedVertexLayout::Apply();
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		if (this->State)
+			this->State->Invalidate();
+		return true;
+	}
+
+	void Destroy()
+	{
+		this->Vertices.Destroy();
+		glDeleteVertexArrays(1, &this->vao);
+		glDeleteBuffers(1, &this->indexBuffer);
+		this->vao = this->indexBuffer = 0;
+	}
+
+	// Фонтан частиц в момент time. Положение каждой частицы вычисляется из времени, а не
+	// интегрируется, поэтому состояние между кадрами не хранится.
+	// Программа и текстуры должны быть уже привязаны.
+	void Draw(float time)
+	{
+		this->Vertices.BeginFrame();
+		StreamBuffer::Allocation allocation = this->Vertices.Allocate((GLsizeiptr)this->Count * 4 * vertexStride, vertexStride);
+		if (!allocation.Data)
+		{
+			this->Vertices.EndFrame();
+			return;
+		}
+		PackedVertex * out = (PackedVertex *)allocation.Data;
+		const GLhalf zero = floatToHalf(0.0f), one = floatToHalf(1.0f);
+		for (int i = 0; i < this->Count; i++)
+		{
+			// Направление, скорость и фаза частицы из целочисленного хеша её номера
+			unsigned int hash = (unsigned int)i * 2654435761u;
+			hash ^= hash >> 15;
+			float angle = ((hash & 1023) / 1023.0f - 0.5f) * 0.8f;
+			float speed = 1.6f + ((hash >> 10) & 255) / 255.0f * 0.8f;
+			float phase = ((hash >> 18) & 1023) / 1023.0f;
+			float age = fmodf(time * 0.5f + phase, 1.0f);
+
+			float x = sinf(angle) * speed * age;
+			float y = -0.9f + cosf(angle) * speed * age - 1.5f * age * age;
+			float half = 0.03f * (1.0f - age) + 0.005f;
+			const GLfloat corners[4][4] = {
+				{ x + half, y + half, 1.0f, 1.0f }, { x + half, y - half, 1.0f, 0.0f },
+				{ x - half, y - half, 0.0f, 0.0f }, { x - half, y + half, 0.0f, 1.0f }
+			};
+			GLubyte fade = unorm8(1.0f - age), glow = unorm8(age);
+			for (int k = 0; k < 4; k++, out++)
+			{
+				out->Position[0] = floatToHalf(corners[k][0]);
+				out->Position[1] = floatToHalf(corners[k][1]);
+				out->Position[2] = zero;
+				out->Position[3] = one;
+				out->Color[0] = 255;
+				out->Color[1] = fade;
+				out->Color[2] = glow;
+				out->Color[3] = 255;
+				out->TexCoord[0] = corners[k][2] > 0.0f ? 65535 : 0;
+				out->TexCoord[1] = corners[k][3] > 0.0f ? 65535 : 0;
+			}
+		}
+		this->Vertices.Commit();
+
+		if (this->State)
+			this->State->BindVertexArray(this->vao);
+		else
+			glBindVertexArray(this->vao);
+		glDrawElementsBaseVertex(GL_TRIANGLES, this->Count * 6, GL_UNSIGNED_INT, 0, (GLint)(allocation.Offset / vertexStride));
+		this->Vertices.EndFrame();
+	}
+
+	private:
+	static const GLsizei vertexStride = PackedVertexLayout::Stride;
+
+	GLuint vao = 0, indexBuffer = 0;
+};
+
+#endif
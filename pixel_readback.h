@@ -0,0 +1,129 @@
+// Асинхронное чтение буфера кадра через PBO.
+//
+// glReadPixels в память процесса останавливает CPU до тех пор, пока GPU не дорисует кадр.
+// С привязанным GL_PIXEL_PACK_BUFFER тот же вызов только ставит копирование в очередь и
+// сразу возвращает управление; за копированием ставится fence, и отображать буфер имеет
+// смысл, когда fence сработал - обычно через кадр-другой. Слотов может быть несколько:
+// пока читается один кадр, следующие уже копируются в свои буферы.
+
+#ifndef PIXEL_READBACK_H
+#define PIXEL_READBACK_H
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <GL/glew.h>
+
+class PixelReadback
+{
+	public:
+	int Width = 0, Height = 0;
+	// Статистика: сколько кадров прочитано и сколько CPU ждал fence
+	long long Reads = 0;
+	double WaitMs = 0.0;
+
+	bool Create(int width, int height, int slots = 1)
+	{
+		this->Width = width;
+		this->Height = height;
+		this->slots.resize(slots);
+		for (Slot & slot : this->slots)
+		{
+			glGenBuffers(1, &slot.Buffer);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.Buffer);
+			glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)this->FrameBytes(), NULL, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		return glGetError() == GL_NO_ERROR;
+	}
+
+	size_t FrameBytes() const { return (size_t)this->Width * this->Height * 4; }
+	int InFlight() const { return this->inFlight; }
+
+	// Ставит в очередь копирование текущего GL_READ_FRAMEBUFFER (RGBA8) в свободный слот.
+	// false - все слоты ещё не прочитаны.
+	bool Begin()
+	{
+		if (this->inFlight == (int)this->slots.size())
+			return false;
+		Slot & slot = this->slots[(this->oldest + this->inFlight) % this->slots.size()];
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.Buffer);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadPixels(0, 0, this->Width, this->Height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		this->inFlight++;
+		return true;
+	}
+
+	// Готово ли самое старое чтение (проверка без ожидания)
+	bool Ready()
+	{
+		if (!this->inFlight)
+			return false;
+		GLenum status = glClientWaitSync(this->slots[this->oldest].Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+	}
+
+	// Забирает самое старое чтение в pixels: строки идут сверху вниз, как в файлах
+	// изображений (glReadPixels отдаёт их снизу вверх). wait = false и неготовый кадр - false.
+	bool Finish(std::vector<unsigned char> & pixels, bool wait)
+	{
+		if (!this->inFlight || (!wait && !this->Ready()))
+			return false;
+		Slot & slot = this->slots[this->oldest];
+		auto start = std::chrono::steady_clock::now();
+		GLenum status = glClientWaitSync(slot.Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		while (status == GL_TIMEOUT_EXPIRED)
+			status = glClientWaitSync(slot.Fence, 0, 1000000000);
+		this->WaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		glDeleteSync(slot.Fence);
+		slot.Fence = 0;
+		this->oldest = (this->oldest + 1) % this->slots.size();
+		this->inFlight--;
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.Buffer);
+		const unsigned char * mapped = (const unsigned char *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)this->FrameBytes(), GL_MAP_READ_BIT);
+		if (!mapped)
+		{
+			std::cout << "ERROR::READBACK::MAP_FAILED" << std::endl;
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			return false;
+		}
+		size_t row = (size_t)this->Width * 4;
+		pixels.resize(this->FrameBytes());
+		for (int y = 0; y < this->Height; y++)
+			memcpy(&pixels[y * row], mapped + (this->Height - 1 - y) * row, row);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		this->Reads++;
+		return true;
+	}
+
+	void Destroy()
+	{
+		for (Slot & slot : this->slots)
+		{
+			if (slot.Fence)
+				glDeleteSync(slot.Fence);
+			glDeleteBuffers(1, &slot.Buffer);
+		}
+		this->slots.clear();
+		this->inFlight = 0;
+	}
+
+	private:
+	struct Slot
+	{
+		GLuint Buffer = 0;
+		GLsync Fence = 0;
+	};
+	std::vector<Slot> slots;
+	// Самый старый непрочитанный слот и число слотов в очереди
+	size_t oldest = 0;
+	int inFlight = 0;
+};
+
+#endif
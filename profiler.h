@@ -0,0 +1,372 @@
+// Профилирование кадра на CPU и GPU. Участки кадра размечаются объектами ProfileScope;
+// для каждого участка запоминается время CPU и две метки времени GPU (glQueryCounter с
+// GL_TIMESTAMP - в отличие от GL_TIME_ELAPSED они допускают вложенные участки). Весь кадр
+// дополнительно измеряется запросом GL_TIME_ELAPSED.
+//
+// Запросы лежат в кольце из frameLatency наборов: результаты кадра N читаются в начале
+// кадра N + frameLatency, когда GPU давно их посчитал, поэтому чтение никогда не ждёт GPU.
+// Если результат всё же не готов, кадр пропускается и учитывается в DroppedFrames.
+//
+// Результаты выгружаются в JSON формата Chrome trace event (открывается в chrome://tracing
+// или Perfetto; CPU и GPU - две дорожки) и в CSV с одной строкой на кадр.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+class Profiler
+{
+	public:
+	// Выключенный профайлер не делает ни одного вызова OpenGL
+	bool Enabled = false;
+	// Есть ли таймерные запросы (иначе пишется только время CPU)
+	bool GpuTimers = false;
+	long long DroppedFrames = 0;
+
+	// Завершённый участок кадра; времена в микросекундах от Init
+	struct Record
+	{
+		long long Frame;
+		const char * Name;
+		int Depth;
+		double CpuStartUs, CpuEndUs;
+		double GpuStartUs, GpuEndUs; // отрицательные, если таймеров GPU нет
+	};
+
+	struct FrameRecord
+	{
+		long long Frame;
+		double CpuStartUs, CpuEndUs;
+		double GpuMs;
+	};
+
+	std::vector<Record> Records;
+	std::vector<FrameRecord> Frames;
+
+	bool Init()
+	{
+		this->Enabled = true;
+		this->epoch = Clock::now();
+		this->GpuTimers = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+		if (!this->GpuTimers)
+		{
+			std::cout << "WARNING::PROFILER::NO_TIMER_QUERY cpu only" << std::endl;
+			return true;
+		}
+		for (Slot & slot : this->slots)
+			glGenQueries(1, &slot.FrameQuery);
+		// Первый запрос GL_TIME_ELAPSED с настоящей работой внутри на части драйверов (llvmpipe)
+		// возвращает время от старта системы вместо длительности; тратим его на пробный замер.
+		// Init вызывается до первого кадра, так что очистка буфера кадра здесь ничего не портит.
+		GLuint64 discarded;
+		glBeginQuery(GL_TIME_ELAPSED, this->slots[0].FrameQuery);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glEndQuery(GL_TIME_ELAPSED);
+		glGetQueryObjectui64v(this->slots[0].FrameQuery, GL_QUERY_RESULT, &discarded);
+
+		// Сдвиг между часами GPU и CPU, чтобы дорожки в трассе совпадали по времени
+		GLint64 gpuNow = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+		this->gpuOffsetUs = this->nowUs() - gpuNow / 1000.0;
+		return true;
+	}
+
+	// Место под записи frames кадров заранее, чтобы рост Records и Frames не попадал в кадры
+	void Reserve(long long frames, int scopesPerFrame)
+	{
+		this->Frames.reserve(frames);
+		this->Records.reserve(frames * scopesPerFrame);
+	}
+
+	void BeginFrame()
+	{
+		if (!this->Enabled)
+			return;
+		Slot & slot = this->slots[this->frame % frameLatency];
+		this->collect(slot, false);
+		slot.Frame = this->frame;
+		slot.CpuStartUs = this->nowUs();
+		slot.Scopes.clear();
+		slot.QueriesUsed = 0;
+		if (this->GpuTimers)
+			glBeginQuery(GL_TIME_ELAPSED, slot.FrameQuery);
+		this->depth = 0;
+	}
+
+	void EndFrame()
+	{
+		if (!this->Enabled)
+			return;
+		Slot & slot = this->slots[this->frame % frameLatency];
+		slot.CpuEndUs = this->nowUs();
+		if (this->GpuTimers)
+			glEndQuery(GL_TIME_ELAPSED);
+		this->frame++;
+	}
+
+	// Начало участка; возвращает его номер для EndScope
+	int BeginScope(const char * name)
+	{
+		if (!this->Enabled)
+			return -1;
+		Slot & slot = this->slots[this->frame % frameLatency];
+		PendingScope scope = { name, this->depth++, this->nowUs(), 0.0, { 0, 0 } };
+		if (this->GpuTimers)
+		{
+			scope.Queries[0] = this->query(slot);
+			glQueryCounter(scope.Queries[0], GL_TIMESTAMP);
+		}
+		slot.Scopes.push_back(scope);
+		return (int)slot.Scopes.size() - 1;
+	}
+
+	void EndScope(int index)
+	{
+		if (!this->Enabled || index < 0)
+			return;
+		Slot & slot = this->slots[this->frame % frameLatency];
+		PendingScope & scope = slot.Scopes[index];
+		if (this->GpuTimers)
+		{
+			scope.Queries[1] = this->query(slot);
+			glQueryCounter(scope.Queries[1], GL_TIMESTAMP);
+		}
+		scope.CpuEndUs = this->nowUs();
+		this->depth--;
+	}
+
+	// Забрать результаты всех оставшихся кадров. Здесь ждать GPU можно: вызывается в конце.
+	void Finish()
+	{
+		if (!this->Enabled)
+			return;
+		for (long long i = 0; i < frameLatency; i++)
+			this->collect(this->slots[(this->frame + i) % frameLatency], true);
+	}
+
+	// Средние по каждому имени участка
+	void Report(std::ostream & out) const
+	{
+		std::vector<const char *> names = this->scopeNames();
+		out << std::fixed << std::setprecision(3);
+		double frameGpu = 0.0;
+		for (const FrameRecord & frame : this->Frames)
+			frameGpu += frame.GpuMs;
+		out << "profile frames=" << this->Frames.size() << " dropped=" << this->DroppedFrames
+			<< " gpu_timers=" << (this->GpuTimers ? 1 : 0)
+			<< " frame_gpu_ms=" << (this->Frames.empty() ? 0.0 : frameGpu / this->Frames.size()) << std::endl;
+		for (const char * name : names)
+		{
+			double cpu = 0.0, gpu = 0.0;
+			for (const Record & record : this->Records)
+				if (record.Name == name)
+				{
+					cpu += (record.CpuEndUs - record.CpuStartUs) / 1000.0;
+					gpu += (record.GpuEndUs - record.GpuStartUs) / 1000.0;
+				}
+			double frames = this->Frames.empty() ? 1.0 : (double)this->Frames.size();
+			out << "profile scope=" << name << " cpu_ms=" << cpu / frames;
+			if (this->GpuTimers)
+				out << " gpu_ms=" << gpu / frames;
+			out << std::endl;
+		}
+	}
+
+	// Chrome trace event JSON: события "X" (начало + длительность) на дорожках CPU и GPU
+	bool WriteChromeTrace(const std::string & path) const
+	{
+		std::ofstream file(path);
+		if (!file)
+		{
+			std::cout << "ERROR::PROFILER::WRITE_FAILED " << path << std::endl;
+			return false;
+		}
+		file << std::fixed << std::setprecision(3);
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+		for (const FrameRecord & frame : this->Frames)
+			file << ",\n{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << frame.CpuStartUs
+				 << ",\"dur\":" << frame.CpuEndUs - frame.CpuStartUs << ",\"args\":{\"frame\":" << frame.Frame << "}}";
+		for (const Record & record : this->Records)
+		{
+			file << ",\n{\"name\":\"" << record.Name << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+				 << record.CpuStartUs << ",\"dur\":" << record.CpuEndUs - record.CpuStartUs
+				 << ",\"args\":{\"frame\":" << record.Frame << "}}";
+			if (record.GpuStartUs >= 0.0)
+				file << ",\n{\"name\":\"" << record.Name << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":"
+					 << record.GpuStartUs << ",\"dur\":" << record.GpuEndUs - record.GpuStartUs
+					 << ",\"args\":{\"frame\":" << record.Frame << "}}";
+		}
+		file << "\n]}\n";
+		return (bool)file;
+	}
+
+	// CSV: кадр, время кадра на CPU и GPU, затем по паре столбцов на каждый участок
+	bool WriteCsv(const std::string & path) const
+	{
+		std::ofstream file(path);
+		if (!file)
+		{
+			std::cout << "ERROR::PROFILER::WRITE_FAILED " << path << std::endl;
+			return false;
+		}
+		std::vector<const char *> names = this->scopeNames();
+		file << "frame,cpu_ms,gpu_ms";
+		for (const char * name : names)
+			file << "," << name << "_cpu_ms," << name << "_gpu_ms";
+		file << "\n" << std::fixed << std::setprecision(4);
+
+		size_t next = 0;
+		std::vector<double> cpu(names.size()), gpu(names.size());
+		for (const FrameRecord & frame : this->Frames)
+		{
+			std::fill(cpu.begin(), cpu.end(), 0.0);
+			std::fill(gpu.begin(), gpu.end(), 0.0);
+			// Records и Frames идут в одном порядке кадров
+			for (; next < this->Records.size() && this->Records[next].Frame == frame.Frame; next++)
+			{
+				const Record & record = this->Records[next];
+				size_t column = std::find(names.begin(), names.end(), record.Name) - names.begin();
+				cpu[column] += (record.CpuEndUs - record.CpuStartUs) / 1000.0;
+				gpu[column] += (record.GpuEndUs - record.GpuStartUs) / 1000.0;
+			}
+			file << frame.Frame << "," << (frame.CpuEndUs - frame.CpuStartUs) / 1000.0 << "," << frame.GpuMs;
+			for (size_t column = 0; column < names.size(); column++)
+				file << "," << cpu[column] << "," << gpu[column];
+			file << "\n";
+		}
+		return (bool)file;
+	}
+
+	// Удаление запросов. Вызывается, пока контекст OpenGL ещё жив.
+	void Release()
+	{
+		if (!this->Enabled || !this->GpuTimers)
+			return;
+		for (Slot & slot : this->slots)
+		{
+			glDeleteQueries(1, &slot.FrameQuery);
+			if (!slot.Queries.empty())
+				glDeleteQueries((GLsizei)slot.Queries.size(), slot.Queries.data());
+			slot.Queries.clear();
+		}
+		this->Enabled = false;
+	}
+
+	private:
+	typedef std::chrono::steady_clock Clock;
+	static const int frameLatency = 3;
+
+	struct PendingScope
+	{
+		const char * Name;
+		int Depth;
+		double CpuStartUs, CpuEndUs;
+		GLuint Queries[2];
+	};
+
+	// Запросы одного кадра в кольце
+	struct Slot
+	{
+		long long Frame = -1;
+		double CpuStartUs = 0.0, CpuEndUs = 0.0;
+		GLuint FrameQuery = 0;
+		std::vector<PendingScope> Scopes;
+		std::vector<GLuint> Queries;
+		size_t QueriesUsed = 0;
+	};
+
+	Slot slots[frameLatency];
+	long long frame = 0;
+	int depth = 0;
+	Clock::time_point epoch;
+	double gpuOffsetUs = 0.0;
+
+	double nowUs() const { return std::chrono::duration<double, std::micro>(Clock::now() - this->epoch).count(); }
+
+	// Запрос из пула кадра; пул растёт, пока не наберёт нужное число запросов
+	GLuint query(Slot & slot)
+	{
+		if (slot.QueriesUsed == slot.Queries.size())
+		{
+			GLuint created;
+			glGenQueries(1, &created);
+			slot.Queries.push_back(created);
+		}
+		return slot.Queries[slot.QueriesUsed++];
+	}
+
+	void collect(Slot & slot, bool wait)
+	{
+		if (slot.Frame < 0)
+			return;
+		long long frame = slot.Frame;
+		slot.Frame = -1;
+		double frameGpuMs = 0.0;
+		if (this->GpuTimers)
+		{
+			// Запрос кадра закончился последним: если он готов, готовы и метки участков
+			GLuint available = GL_TRUE;
+			if (!wait)
+				glGetQueryObjectuiv(slot.FrameQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+			{
+				this->DroppedFrames++;
+				return;
+			}
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(slot.FrameQuery, GL_QUERY_RESULT, &elapsed);
+			frameGpuMs = elapsed / 1e6;
+		}
+		this->Frames.push_back({ frame, slot.CpuStartUs, slot.CpuEndUs, frameGpuMs });
+		for (const PendingScope & scope : slot.Scopes)
+		{
+			Record record = { frame, scope.Name, scope.Depth, scope.CpuStartUs, scope.CpuEndUs, -1.0, -1.0 };
+			if (this->GpuTimers)
+			{
+				GLuint64 start = 0, end = 0;
+				glGetQueryObjectui64v(scope.Queries[0], GL_QUERY_RESULT, &start);
+				glGetQueryObjectui64v(scope.Queries[1], GL_QUERY_RESULT, &end);
+				record.GpuStartUs = start / 1000.0 + this->gpuOffsetUs;
+				record.GpuEndUs = end / 1000.0 + this->gpuOffsetUs;
+			}
+			this->Records.push_back(record);
+		}
+	}
+
+	std::vector<const char *> scopeNames() const
+	{
+		std::vector<const char *> names;
+		for (const Record & record : this->Records)
+			if (std::find(names.begin(), names.end(), record.Name) == names.end())
+				names.push_back(record.Name);
+		return names;
+	}
+};
+
+// Участок кадра на время жизни объекта
+class ProfileScope
+{
+	public:
+	ProfileScope(Profiler & profiler, const char * name) : profiler(profiler), index(profiler.BeginScope(name)) {}
+	~ProfileScope() { this->profiler.EndScope(this->index); }
+	ProfileScope(const ProfileScope &) = delete;
+	ProfileScope & operator=(const ProfileScope &) = delete;
+
+	private:
+	Profiler & profiler;
+	int index;
+};
+
+#endif
@@ -0,0 +1,176 @@
+// Общий интерфейс отрисовки для OpenGL и программного растеризатора (soft_raster.h).
+//
+// Сцена описывается одинаково для обоих: пакет индексированных треугольников с вершинами в
+// пространстве отсечения (позиция уже умножена на все матрицы), цветом и текстурными
+// координатами, маска возможностей фрагментного шейдера (ShaderFeature) и до двух текстур.
+// Смысл возможностей тот же, что в fragment_shader.frag: текстура (или смесь двух 80/20),
+// умноженная на цвет вершин и на uniformColor. Текстуры - RGBA8 с фильтрацией GL_LINEAR без
+// мипмапов и повторением GL_REPEAT; смешивания и теста глубины нет, треугольники рисуются по
+// порядку и перекрывают друг друга.
+//
+// GlRenderer собирает варианты шейдера через ShaderVariants из vertex_shader.vs +
+// fragment_shader.frag по мере того, как встречаются новые маски.
+
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "shader_variants.h"
+#include "vertex_layout.h"
+
+struct RenderVertex
+{
+	// Позиция в пространстве отсечения (x, y, z, w)
+	GLfloat Position[4];
+	GLfloat Color[3];
+	GLfloat TexCoord[2];
+};
+
+typedef VertexLayout<VertexAttrib<0, 4, GL_FLOAT>, VertexAttrib<1, 3, GL_FLOAT>, VertexAttrib<2, 2, GL_FLOAT>> RenderVertexLayout;
+static_assert(sizeof(RenderVertex) == RenderVertexLayout::Stride, "RenderVertex does not match its layout");
+
+struct RenderBatch
+{
+	const RenderVertex * Vertices = nullptr;
+	int VertexCount = 0;
+	const GLuint * Indices = nullptr;
+	int IndexCount = 0;
+	// Маска ShaderFeature
+	unsigned Features = 0;
+	// Номера текстур из CreateTexture для ourTexture1 и ourTexture2 (-1 - нет)
+	int Textures[2] = { -1, -1 };
+	GLfloat UniformColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+};
+
+class Renderer
+{
+	public:
+	virtual ~Renderer() {}
+
+	virtual const char * Name() const = 0;
+	// Кадр width x height; для OpenGL контекст уже создан и текущий
+	virtual bool Create(int width, int height) = 0;
+	// Текстура RGBA8; первая строка в памяти соответствует t = 0, как в glTexImage2D.
+	// Возвращает номер текстуры для RenderBatch::Textures или -1.
+	virtual int CreateTexture(int width, int height, const unsigned char * rgba) = 0;
+	virtual void Clear(const GLfloat color[4]) = 0;
+	virtual void Draw(const RenderBatch & batch) = 0;
+	// Дождаться, пока кадр будет полностью нарисован
+	virtual void Finish() = 0;
+	// Кадр в RGBA8, строки сверху вниз
+	virtual void ReadPixels(std::vector<unsigned char> & pixels) = 0;
+	// Статистика в виде строки key=value; без своей статистики - только имя
+	virtual void Report(std::ostream & out) const { out << "renderer name=" << this->Name() << std::endl; }
+	virtual void Destroy() = 0;
+};
+
+class GlRenderer : public Renderer
+{
+	public:
+	explicit GlRenderer(ShaderVariants & variants) : variants(variants) {}
+
+	const char * Name() const override { return "gl"; }
+
+	bool Create(int width, int height) override
+	{
+		this->width = width;
+		this->height = height;
+		glViewport(0, 0, width, height);
+		glGenVertexArrays(1, &this->vertexArray);
+		glGenBuffers(2, this->buffers);
+		glBindVertexArray(this->vertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, this->buffers[0]);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->buffers[1]);
+		RenderVertexLayout::Apply();
+		glBindVertexArray(0);
+		return true;
+	}
+
+	int CreateTexture(int width, int height, const unsigned char * rgba) override
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		this->textures.push_back(texture);
+		return (int)this->textures.size() - 1;
+	}
+
+	void Clear(const GLfloat color[4]) override
+	{
+		glClearColor(color[0], color[1], color[2], color[3]);
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+
+	void Draw(const RenderBatch & batch) override
+	{
+		GLuint program = this->variants.Get(batch.Features);
+		if (!program)
+		{
+			// Новая маска: собираем её вариант сейчас (первый кадр с ней будет дольше)
+			this->variants.Request(batch.Features);
+			this->variants.Submit();
+			if (!this->variants.Finish() || !(program = this->variants.Get(batch.Features)))
+				return;
+		}
+		glUseProgram(program);
+		glUniform1i(glGetUniformLocation(program, "ourTexture1"), 0);
+		glUniform1i(glGetUniformLocation(program, "ourTexture2"), 1);
+		glUniform4fv(glGetUniformLocation(program, "uniformColor"), 1, batch.UniformColor);
+		for (int unit = 0; unit < 2; unit++)
+		{
+			glActiveTexture(GL_TEXTURE0 + unit);
+			int texture = batch.Textures[unit];
+			glBindTexture(GL_TEXTURE_2D, texture >= 0 && texture < (int)this->textures.size() ? this->textures[texture] : 0);
+		}
+		glBindVertexArray(this->vertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, this->buffers[0]);
+		glBufferData(GL_ARRAY_BUFFER, batch.VertexCount * sizeof(RenderVertex), batch.Vertices, GL_STREAM_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, batch.IndexCount * sizeof(GLuint), batch.Indices, GL_STREAM_DRAW);
+		glDrawElements(GL_TRIANGLES, batch.IndexCount, GL_UNSIGNED_INT, 0);
+		glBindVertexArray(0);
+	}
+
+	void Finish() override { glFinish(); }
+
+	void ReadPixels(std::vector<unsigned char> & pixels) override
+	{
+		size_t row = (size_t)this->width * 4;
+		pixels.resize(row * this->height);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, this->width, this->height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		// glReadPixels отдаёт строки снизу вверх
+		for (int y = 0; y < this->height / 2; y++)
+			std::swap_ranges(pixels.begin() + y * row, pixels.begin() + (y + 1) * row, pixels.begin() + (this->height - 1 - y) * row);
+	}
+
+	void Destroy() override
+	{
+		if (!this->textures.empty())
+			glDeleteTextures((GLsizei)this->textures.size(), this->textures.data());
+		this->textures.clear();
+		glDeleteVertexArrays(1, &this->vertexArray);
+		glDeleteBuffers(2, this->buffers);
+		this->vertexArray = this->buffers[0] = this->buffers[1] = 0;
+	}
+
+	private:
+	ShaderVariants & variants;
+	int width = 0, height = 0;
+	GLuint vertexArray = 0, buffers[2] = { 0, 0 };
+	std::vector<GLuint> textures;
+};
+
+#endif
@@ -0,0 +1,499 @@
+// Отсечение невидимых объектов по пирамиде видимости (frustum culling).
+//
+// Границы объектов хранятся в виде структуры массивов (SceneBounds): центры и радиусы
+// сфер и углы AABB лежат в отдельных массивах, так что проверка сфер идёт по 4 (SSE) или
+// 8 (AVX2) объектов за раз без перестановок данных.
+//
+// Для больших сцен есть иерархия ограничивающих объёмов (Bvh): узел целиком вне пирамиды
+// отбрасывает все свои объекты разом, узел целиком внутри - принимает без проверок, а
+// сферы проверяются только в листьях, пересекающих границу. Объекты в листьях лежат
+// подряд (копия SceneBounds в порядке листьев), поэтому проверка листа - тот же
+// векторный цикл.
+//
+// SceneCuller выбирает перебор всех объектов или Bvh и делит работу между потоками пула
+// через ThreadPool::ParallelFor.
+
+#ifndef SCENE_CULLING_H
+#define SCENE_CULLING_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "mipmap.h"
+#include "thread_pool.h"
+
+#ifdef MIPMAP_X86
+#define CULL_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+// Границы объектов: сфера и AABB на объект, каждое поле - отдельный массив
+struct SceneBounds
+{
+	std::vector<float> CenterX, CenterY, CenterZ, Radius;
+	std::vector<float> MinX, MinY, MinZ, MaxX, MaxY, MaxZ;
+
+	size_t Size() const { return this->Radius.size(); }
+
+	void Clear()
+	{
+		for (std::vector<float> * field : this->fields())
+			field->clear();
+	}
+
+	void Reserve(size_t count)
+	{
+		for (std::vector<float> * field : this->fields())
+			field->reserve(count);
+	}
+
+	// Сфера; AABB - описанный около неё куб
+	void AddSphere(float x, float y, float z, float radius)
+	{
+		this->push(x, y, z, radius, x - radius, y - radius, z - radius, x + radius, y + radius, z + radius);
+	}
+
+	// AABB; сфера - описанная около него
+	void AddBox(const float low[3], const float high[3])
+	{
+		float extent[3] = { high[0] - low[0], high[1] - low[1], high[2] - low[2] };
+		float radius = 0.5f * sqrtf(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]);
+		this->push((low[0] + high[0]) * 0.5f, (low[1] + high[1]) * 0.5f, (low[2] + high[2]) * 0.5f, radius,
+				   low[0], low[1], low[2], high[0], high[1], high[2]);
+	}
+
+	// Копия объекта index из other в конец
+	void AddFrom(const SceneBounds & other, size_t index)
+	{
+		this->push(other.CenterX[index], other.CenterY[index], other.CenterZ[index], other.Radius[index],
+				   other.MinX[index], other.MinY[index], other.MinZ[index], other.MaxX[index], other.MaxY[index], other.MaxZ[index]);
+	}
+
+	private:
+	std::vector<std::vector<float> *> fields()
+	{
+		return { &this->CenterX, &this->CenterY, &this->CenterZ, &this->Radius,
+				 &this->MinX, &this->MinY, &this->MinZ, &this->MaxX, &this->MaxY, &this->MaxZ };
+	}
+
+	void push(float x, float y, float z, float radius, float lowX, float lowY, float lowZ, float highX, float highY, float highZ)
+	{
+		this->CenterX.push_back(x);
+		this->CenterY.push_back(y);
+		this->CenterZ.push_back(z);
+		this->Radius.push_back(radius);
+		this->MinX.push_back(lowX);
+		this->MinY.push_back(lowY);
+		this->MinZ.push_back(lowZ);
+		this->MaxX.push_back(highX);
+		this->MaxY.push_back(highY);
+		this->MaxZ.push_back(highZ);
+	}
+};
+
+// Шесть плоскостей (a, b, c, d) с нормалями внутрь: точка внутри, если a*x + b*y + c*z + d >= 0
+struct Frustum
+{
+	float Planes[6][4];
+
+	// Ортографическая пирамида - просто коробка
+	static Frustum Box(float left, float right, float bottom, float top, float nearZ, float farZ)
+	{
+		Frustum frustum = { { { 1.0f, 0.0f, 0.0f, -left }, { -1.0f, 0.0f, 0.0f, right },
+							  { 0.0f, 1.0f, 0.0f, -bottom }, { 0.0f, -1.0f, 0.0f, top },
+							  { 0.0f, 0.0f, 1.0f, -nearZ }, { 0.0f, 0.0f, -1.0f, farZ } } };
+		return frustum;
+	}
+
+	// Перспективная камера в точке eye, смотрящая по forward. fovY - в радианах.
+	static Frustum Perspective(const float eye[3], const float forward[3], const float up[3],
+							   float fovY, float aspect, float nearZ, float farZ)
+	{
+		float f[3], r[3], u[3];
+		normalize(forward, f);
+		float side[3] = { f[1] * up[2] - f[2] * up[1], f[2] * up[0] - f[0] * up[2], f[0] * up[1] - f[1] * up[0] };
+		normalize(side, r);
+		u[0] = r[1] * f[2] - r[2] * f[1];
+		u[1] = r[2] * f[0] - r[0] * f[2];
+		u[2] = r[0] * f[1] - r[1] * f[0];
+		float tanY = tanf(fovY * 0.5f), tanX = tanY * aspect;
+
+		// Нормаль боковой плоскости - ось экрана, наклонённая к направлению взгляда
+		Frustum frustum;
+		for (int k = 0; k < 3; k++)
+		{
+			frustum.Planes[0][k] = r[k] + f[k] * tanX;
+			frustum.Planes[1][k] = -r[k] + f[k] * tanX;
+			frustum.Planes[2][k] = u[k] + f[k] * tanY;
+			frustum.Planes[3][k] = -u[k] + f[k] * tanY;
+			frustum.Planes[4][k] = f[k];
+			frustum.Planes[5][k] = -f[k];
+		}
+		for (int plane = 0; plane < 4; plane++)
+		{
+			float normal[3];
+			normalize(frustum.Planes[plane], normal);
+			for (int k = 0; k < 3; k++)
+				frustum.Planes[plane][k] = normal[k];
+			frustum.Planes[plane][3] = -(normal[0] * eye[0] + normal[1] * eye[1] + normal[2] * eye[2]);
+		}
+		float eyeDepth = f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2];
+		frustum.Planes[4][3] = -(eyeDepth + nearZ);
+		frustum.Planes[5][3] = eyeDepth + farZ;
+		return frustum;
+	}
+
+	bool SphereVisible(float x, float y, float z, float radius) const
+	{
+		for (const float * plane : this->Planes)
+			if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < -radius)
+				return false;
+		return true;
+	}
+
+	private:
+	static void normalize(const float v[3], float out[3])
+	{
+		float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		for (int k = 0; k < 3; k++)
+			out[k] = length > 0.0f ? v[k] / length : 0.0f;
+	}
+};
+
+// ---------------------------------------------------------------------------------------
+// Проверка сфер [begin, end). Номера видимых дописываются в visible: сам номер или
+// remap[номер], если задан (так Bvh возвращает исходные номера объектов).
+
+inline void cullSpheresScalar(const SceneBounds & bounds, size_t begin, size_t end, const Frustum & frustum,
+							  std::vector<uint32_t> & visible, const uint32_t * remap)
+{
+	for (size_t i = begin; i < end; i++)
+		if (frustum.SphereVisible(bounds.CenterX[i], bounds.CenterY[i], bounds.CenterZ[i], bounds.Radius[i]))
+			visible.push_back(remap ? remap[i] : (uint32_t)i);
+}
+
+#ifdef MIPMAP_X86
+inline void cullSpheresSse(const SceneBounds & bounds, size_t begin, size_t end, const Frustum & frustum,
+						   std::vector<uint32_t> & visible, const uint32_t * remap)
+{
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&bounds.CenterX[i]), y = _mm_loadu_ps(&bounds.CenterY[i]);
+		__m128 z = _mm_loadu_ps(&bounds.CenterZ[i]);
+		__m128 negative = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&bounds.Radius[i]));
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (const float * plane : frustum.Planes)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane[0])), _mm_mul_ps(y, _mm_set1_ps(plane[1]))),
+										 _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane[2])), _mm_set1_ps(plane[3])));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negative));
+		}
+		for (int mask = _mm_movemask_ps(inside); mask; mask &= mask - 1)
+		{
+			size_t index = i + __builtin_ctz(mask);
+			visible.push_back(remap ? remap[index] : (uint32_t)index);
+		}
+	}
+	cullSpheresScalar(bounds, i, end, frustum, visible, remap);
+}
+
+CULL_TARGET_AVX2 inline void cullSpheresAvx2(const SceneBounds & bounds, size_t begin, size_t end, const Frustum & frustum,
+											 std::vector<uint32_t> & visible, const uint32_t * remap)
+{
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(&bounds.CenterX[i]), y = _mm256_loadu_ps(&bounds.CenterY[i]);
+		__m256 z = _mm256_loadu_ps(&bounds.CenterZ[i]);
+		__m256 negative = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&bounds.Radius[i]));
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (const float * plane : frustum.Planes)
+		{
+			__m256 distance = _mm256_fmadd_ps(x, _mm256_set1_ps(plane[0]),
+											  _mm256_fmadd_ps(y, _mm256_set1_ps(plane[1]),
+															  _mm256_fmadd_ps(z, _mm256_set1_ps(plane[2]), _mm256_set1_ps(plane[3]))));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negative, _CMP_GE_OQ));
+		}
+		for (int mask = _mm256_movemask_ps(inside); mask; mask &= mask - 1)
+		{
+			size_t index = i + __builtin_ctz(mask);
+			visible.push_back(remap ? remap[index] : (uint32_t)index);
+		}
+	}
+	cullSpheresSse(bounds, i, end, frustum, visible, remap);
+}
+#endif
+
+inline void cullSpheres(const SceneBounds & bounds, size_t begin, size_t end, const Frustum & frustum,
+						std::vector<uint32_t> & visible, SimdLevel simd = detectSimdLevel(), const uint32_t * remap = nullptr)
+{
+#ifdef MIPMAP_X86
+	if (simd == SimdLevel::AVX2)
+	{
+		cullSpheresAvx2(bounds, begin, end, frustum, visible, remap);
+		return;
+	}
+	if (simd == SimdLevel::SSE2)
+	{
+		cullSpheresSse(bounds, begin, end, frustum, visible, remap);
+		return;
+	}
+#endif
+	cullSpheresScalar(bounds, begin, end, frustum, visible, remap);
+}
+
+// ---------------------------------------------------------------------------------------
+// Иерархия AABB. Узлы лежат в массиве в порядке обхода в глубину: левый потомок идёт сразу
+// за родителем, номер правого хранится в узле. Объекты поддерева занимают в Leaves и Order
+// непрерывный диапазон [First, First + Count).
+
+class Bvh
+{
+	public:
+	struct Node
+	{
+		float Min[3], Max[3];
+		uint32_t First, Count;
+		// Номер правого потомка; 0 - лист
+		uint32_t Right;
+	};
+
+	// Объектов в листе: лист проверяется векторным циклом целиком
+	size_t LeafSize = 16;
+	std::vector<Node> Nodes;
+	// Границы в порядке листьев и исходные номера объектов
+	SceneBounds Leaves;
+	std::vector<uint32_t> Order;
+	// Поддеревья, которые обходятся независимо (по одному на кусок ParallelFor)
+	std::vector<uint32_t> Roots;
+
+	// Разбиение по медиане центров вдоль самой длинной оси; roots - сколько поддеревьев
+	// выделить для параллельного обхода
+	void Build(const SceneBounds & bounds, size_t roots = 64)
+	{
+		this->Nodes.clear();
+		this->Leaves.Clear();
+		this->Roots.clear();
+		this->Order.resize(bounds.Size());
+		for (size_t i = 0; i < bounds.Size(); i++)
+			this->Order[i] = (uint32_t)i;
+		if (!bounds.Size())
+			return;
+		// Построение переставляет копии границ, лежащие подряд, а не номера объектов:
+		// выборка медианы по номерам - это случайные обращения к памяти на каждом уровне
+		std::vector<Item> items(bounds.Size());
+		for (size_t i = 0; i < bounds.Size(); i++)
+			items[i] = { { bounds.CenterX[i], bounds.CenterY[i], bounds.CenterZ[i] },
+						 { bounds.MinX[i], bounds.MinY[i], bounds.MinZ[i] },
+						 { bounds.MaxX[i], bounds.MaxY[i], bounds.MaxZ[i] }, (uint32_t)i };
+		this->Nodes.reserve(bounds.Size() / this->LeafSize * 2 + 1);
+		this->build(items, 0, (uint32_t)bounds.Size());
+		for (size_t i = 0; i < items.size(); i++)
+			this->Order[i] = items[i].Index;
+		this->Leaves.Reserve(bounds.Size());
+		for (uint32_t index : this->Order)
+			this->Leaves.AddFrom(bounds, index);
+
+		// Фронт обхода в ширину, пока поддеревьев не станет достаточно
+		this->Roots.push_back(0);
+		bool split = true;
+		while (split && this->Roots.size() < roots)
+		{
+			split = false;
+			std::vector<uint32_t> next;
+			for (uint32_t node : this->Roots)
+			{
+				if (this->Nodes[node].Right)
+				{
+					next.push_back(node + 1);
+					next.push_back(this->Nodes[node].Right);
+					split = true;
+				}
+				else
+					next.push_back(node);
+			}
+			this->Roots.swap(next);
+		}
+	}
+
+	// Обход поддеревьев Roots[begin, end). Плоскости, относительно которых узел уже целиком
+	// внутри, в потомках не проверяются.
+	void Cull(const Frustum & frustum, size_t begin, size_t end, std::vector<uint32_t> & visible,
+			  SimdLevel simd = detectSimdLevel()) const
+	{
+		struct Visit
+		{
+			uint32_t Node;
+			uint32_t Planes;
+		};
+		Visit stack[64];
+		for (size_t root = begin; root < end; root++)
+		{
+			int top = 0;
+			stack[top++] = { this->Roots[root], 0x3f };
+			while (top)
+			{
+				Visit item = stack[--top];
+				const Node & node = this->Nodes[item.Node];
+				bool outside = false;
+				for (int plane = 0; plane < 6 && !outside; plane++)
+				{
+					if (!(item.Planes & (1 << plane)))
+						continue;
+					const float * p = frustum.Planes[plane];
+					float distance = p[3], radius = 0.0f;
+					for (int k = 0; k < 3; k++)
+					{
+						distance += p[k] * (node.Min[k] + node.Max[k]) * 0.5f;
+						radius += fabsf(p[k]) * (node.Max[k] - node.Min[k]) * 0.5f;
+					}
+					if (distance < -radius)
+						outside = true;
+					else if (distance >= radius)
+						item.Planes &= ~(1u << plane);
+				}
+				if (outside)
+					continue;
+				if (!item.Planes)
+					visible.insert(visible.end(), this->Order.begin() + node.First, this->Order.begin() + node.First + node.Count);
+				else if (!node.Right)
+					cullSpheres(this->Leaves, node.First, node.First + node.Count, frustum, visible, simd, this->Order.data());
+				else
+				{
+					stack[top++] = { node.Right, item.Planes };
+					stack[top++] = { item.Node + 1, item.Planes };
+				}
+			}
+		}
+	}
+
+	private:
+	struct Item
+	{
+		float Center[3], Min[3], Max[3];
+		uint32_t Index;
+	};
+
+	uint32_t build(std::vector<Item> & items, uint32_t first, uint32_t count)
+	{
+		uint32_t index = (uint32_t)this->Nodes.size();
+		this->Nodes.push_back(Node());
+		Node node = { { INFINITY, INFINITY, INFINITY }, { -INFINITY, -INFINITY, -INFINITY }, first, count, 0 };
+		float low[3] = { INFINITY, INFINITY, INFINITY }, high[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			const Item & item = items[i];
+			for (int k = 0; k < 3; k++)
+			{
+				node.Min[k] = std::min(node.Min[k], item.Min[k]);
+				node.Max[k] = std::max(node.Max[k], item.Max[k]);
+				low[k] = std::min(low[k], item.Center[k]);
+				high[k] = std::max(high[k], item.Center[k]);
+			}
+		}
+		if (count > this->LeafSize)
+		{
+			int axis = 0;
+			for (int k = 1; k < 3; k++)
+				if (high[k] - low[k] > high[axis] - low[axis])
+					axis = k;
+			uint32_t half = count / 2;
+			std::nth_element(items.begin() + first, items.begin() + first + half, items.begin() + first + count,
+							 [axis](const Item & a, const Item & b) { return a.Center[axis] < b.Center[axis]; });
+			this->build(items, first, half);
+			node.Right = this->build(items, first + half, count - half);
+		}
+		this->Nodes[index] = node;
+		return index;
+	}
+};
+
+// ---------------------------------------------------------------------------------------
+
+enum class CullMode { Brute, Bvh };
+
+inline const char * cullModeName(CullMode mode)
+{
+	return mode == CullMode::Bvh ? "bvh" : "brute";
+}
+
+class SceneCuller
+{
+	public:
+	CullMode Mode = CullMode::Bvh;
+	SimdLevel Simd = detectSimdLevel();
+	// Время построения Bvh, время и результат последнего отсечения
+	double BuildMs = 0.0, CullMs = 0.0;
+	size_t Objects = 0, Visible = 0;
+	// Суммы по всем кадрам для отчёта
+	double TotalCullMs = 0.0;
+	long long Frames = 0, TotalVisible = 0;
+
+	void Build(const SceneBounds & bounds)
+	{
+		auto start = std::chrono::steady_clock::now();
+		this->bounds = bounds;
+		this->Objects = bounds.Size();
+		if (this->Mode == CullMode::Bvh)
+			this->bvh.Build(bounds);
+		this->BuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Номера видимых объектов. pool == nullptr - на вызывающем потоке.
+	void Cull(const Frustum & frustum, ThreadPool * pool, std::vector<uint32_t> & visible)
+	{
+		auto start = std::chrono::steady_clock::now();
+		size_t count = this->Mode == CullMode::Bvh ? this->bvh.Roots.size() : this->Objects;
+		// Кусков больше, чем потоков: поддеревья и диапазоны сильно различаются по работе
+		size_t parts = pool ? pool->Size() * 4 : 1;
+		if (this->parts.size() < parts)
+			this->parts.resize(parts);
+		auto body = [this, &frustum](size_t part, size_t begin, size_t end) {
+			std::vector<uint32_t> & out = this->parts[part];
+			out.clear();
+			if (this->Mode == CullMode::Bvh)
+				this->bvh.Cull(frustum, begin, end, out, this->Simd);
+			else
+				cullSpheres(this->bounds, begin, end, frustum, out, this->Simd);
+		};
+		if (pool)
+			pool->ParallelFor(count, parts, body);
+		else
+			body(0, 0, count);
+
+		visible.clear();
+		for (size_t part = 0; part < std::min(parts, std::max<size_t>(1, count)); part++)
+			visible.insert(visible.end(), this->parts[part].begin(), this->parts[part].end());
+		this->Visible = visible.size();
+		this->CullMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		this->TotalCullMs += this->CullMs;
+		this->TotalVisible += (long long)this->Visible;
+		this->Frames++;
+	}
+
+	void Report(std::ostream & out) const
+	{
+		double frames = (double)std::max(1LL, this->Frames);
+		out << std::fixed << std::setprecision(3)
+			<< "cull mode=" << cullModeName(this->Mode)
+			<< " simd=" << simdLevelName(this->Simd)
+			<< " objects=" << this->Objects
+			<< " visible_per_frame=" << this->TotalVisible / frames
+			<< " culled_per_frame=" << this->Objects - this->TotalVisible / frames
+			<< " cull_ms=" << this->TotalCullMs / frames
+			<< " build_ms=" << this->BuildMs
+			<< " nodes=" << this->bvh.Nodes.size() << std::endl;
+	}
+
+	private:
+	SceneBounds bounds;
+	Bvh bvh;
+	std::vector<std::vector<uint32_t>> parts;
+};
+
+#endif
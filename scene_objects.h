@@ -0,0 +1,276 @@
+// Сцена из множества небольших объектов (--objects N): каждый объект - четырёхугольник со
+// своей программой, текстурой и VAO, положение которого каждый кадр вычисляется на CPU.
+// Кадр можно построить двумя путями:
+//   drawObjectsDirect - как раньше: объекты по порядку, вызовы OpenGL прямо из цикла;
+//   recordObjects     - запись пакетов в CommandList (на любом потоке) для CommandQueue.
+// Объекты можно разбросать по миру больше экрана (scatterSceneObjects); тогда по границам
+// из sceneObjectBounds отсекаются невидимые, и записываются только оставшиеся.
+// recordVisibleObjectBlocks вместо glUniform4f на объект пишет блок объекта в общий
+// uniform-буфер (uniform_blocks.h), а камеру шейдер берёт из блока кадра.
+// Сами объекты создаются в пуле (SceneObjectPool), а сцена - список указателей на них.
+
+#ifndef SCENE_OBJECTS_H
+#define SCENE_OBJECTS_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "command_buffer.h"
+#include "frame_memory.h"
+#include "scene_culling.h"
+#include "uniform_blocks.h"
+
+// Вершинный шейдер объектов: transform = (смещение x, смещение y, масштаб, угол поворота)
+inline constexpr const GLchar * objectVertexShaderSource = "#version 330 core\n"
+	"layout (location = 0) in vec3 position;\n"
+	"layout (location = 2) in vec2 texCoord;\n"
+	"uniform vec4 transform;\n"
+	"out vec2 TexCoord;\n"
+	"void main()\n"
+	"{\n"
+	"float c = cos(transform.w), s = sin(transform.w);\n"
+	"gl_Position = vec4(mat2(c, s, -s, c) * position.xy * transform.z + transform.xy, 0.0, 1.0);\n"
+	"TexCoord = texCoord;\n"
+	"}\0";
+
+inline constexpr const GLchar * objectFragmentShaderSource = "#version 330 core\n"
+	"in vec2 TexCoord;\n"
+	"out vec4 color;\n"
+	"uniform sampler2D objectTexture;\n"
+	"void main()\n"
+	"{\n"
+	"color = texture(objectTexture, TexCoord);\n"
+	"}\n\0";
+
+// Те же шейдеры с входными данными из uniform-блоков: transform - из блока объекта, камера
+// и общий цвет - из блока кадра
+inline constexpr const GLchar * objectBlockVertexShaderSource = "#version 330 core\n"
+	"layout (location = 0) in vec3 position;\n"
+	"layout (location = 2) in vec2 texCoord;\n"
+	FRAME_BLOCK_GLSL
+	OBJECT_BLOCK_GLSL
+	"out vec2 TexCoord;\n"
+	"void main()\n"
+	"{\n"
+	"float c = cos(transform.w), s = sin(transform.w);\n"
+	"gl_Position = vec4(mat2(c, s, -s, c) * position.xy * transform.z + (transform.xy - camera.xy), 0.0, 1.0);\n"
+	"TexCoord = texCoord;\n"
+	"}\0";
+
+inline constexpr const GLchar * objectBlockFragmentShaderSource = "#version 330 core\n"
+	FRAME_BLOCK_GLSL
+	"in vec2 TexCoord;\n"
+	"out vec4 color;\n"
+	"uniform sampler2D objectTexture;\n"
+	"void main()\n"
+	"{\n"
+	"color = texture(objectTexture, TexCoord) * tint;\n"
+	"}\n\0";
+
+struct SceneObject
+{
+	GLuint Program;
+	GLint TransformLocation;
+	GLuint Texture;
+	GLuint VertexArray;
+	// Индексы четырёхугольника в VAO
+	GLsizei IndexCount;
+	// Параметры движения
+	float Phase, Speed, Size;
+	// Центр, вокруг которого движется объект (в мире больше экрана)
+	float HomeX = 0.0f, HomeY = 0.0f;
+};
+
+// Пул объектов сцены: адреса объектов не меняются, а создание и удаление объектов
+// посреди работы не обращается к куче, пока в пуле есть свободные ячейки
+typedef ObjectPool<SceneObject> SceneObjectPool;
+typedef std::vector<SceneObject *> SceneObjectList;
+
+// Объекты с состоянием из перечисленных вариантов. Варианты чередуются от объекта к
+// объекту, так что в исходном порядке почти каждая отрисовка меняет состояние.
+// locations[i] - положение transform в programs[i]. Объекты создаются в pool.
+inline SceneObjectList makeSceneObjects(SceneObjectPool & pool, size_t count, const std::vector<GLuint> & programs, const std::vector<GLint> & locations,
+										const std::vector<GLuint> & textures, const std::vector<GLuint> & vertexArrays, GLsizei indexCount)
+{
+	SceneObjectList objects(count);
+	pool.Reserve(pool.Live() + count);
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned int hash = (unsigned int)i * 2654435761u;
+		hash ^= hash >> 13;
+		SceneObject & object = *(objects[i] = pool.Create());
+		size_t program = hash % programs.size();
+		object.Program = programs[program];
+		object.TransformLocation = locations[program];
+		object.Texture = textures[(hash >> 4) % textures.size()];
+		object.VertexArray = vertexArrays[(hash >> 8) % vertexArrays.size()];
+		object.IndexCount = indexCount;
+		object.Phase = (hash & 0xffff) / 65535.0f * 6.2831853f;
+		object.Speed = 0.2f + ((hash >> 16) & 255) / 255.0f;
+		object.Size = 0.02f + ((hash >> 24) & 15) / 15.0f * 0.03f;
+	}
+	return objects;
+}
+
+// Возвращает объекты в пул; список становится пустым
+inline void destroySceneObjects(SceneObjectPool & pool, SceneObjectList & objects)
+{
+	for (SceneObject * object : objects)
+		pool.Destroy(object);
+	objects.clear();
+}
+
+// Положение объекта в момент time: кривая Лиссажу из нескольких гармоник. Это и есть
+// "работа по построению сцены", которую распределяют между потоками.
+inline void animateObject(const SceneObject & object, float time, GLfloat transform[4])
+{
+	float t = time * object.Speed + object.Phase;
+	float x = 0.0f, y = 0.0f;
+	for (int harmonic = 1; harmonic <= 8; harmonic++)
+	{
+		float weight = 0.9f / (harmonic * 2.7f);
+		x += weight * sinf(t * harmonic + object.Phase * 0.5f);
+		y += weight * cosf(t * (harmonic + 1) * 0.7f);
+	}
+	transform[0] = object.HomeX + x;
+	transform[1] = object.HomeY + y;
+	transform[2] = object.Size;
+	transform[3] = t;
+}
+
+// Насколько объект удаляется от центра: сумма амплитуд гармоник из animateObject
+inline float objectOrbitRadius()
+{
+	float radius = 0.0f;
+	for (int harmonic = 1; harmonic <= 8; harmonic++)
+		radius += 0.9f / (harmonic * 2.7f);
+	return radius;
+}
+
+// Центры объектов равномерно по квадрату worldSize x worldSize с центром в начале координат
+inline void scatterSceneObjects(SceneObjectList & objects, float worldSize)
+{
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		unsigned int hash = (unsigned int)i * 0x9E3779B1u;
+		hash ^= hash >> 15;
+		hash *= 0x85EBCA77u;
+		hash ^= hash >> 13;
+		objects[i]->HomeX = ((hash & 0xffff) / 65535.0f - 0.5f) * worldSize;
+		objects[i]->HomeY = ((hash >> 16) / 65535.0f - 0.5f) * worldSize;
+	}
+}
+
+// Камера медленно обходит мир по кривой Лиссажу, не выходя за его края
+inline void sceneCamera(float time, float worldSize, float & cameraX, float & cameraY)
+{
+	float range = std::max(0.0f, worldSize - 2.0f) * 0.5f;
+	cameraX = range * sinf(time * 0.05f);
+	cameraY = range * cosf(time * 0.037f);
+}
+
+// Неподвижные границы: сфера вокруг центра охватывает всю траекторию объекта, поэтому
+// отсекать можно без пересчёта границ каждый кадр. Половина диагонали четырёхугольника
+// со стороной Size - Size * 0.71.
+inline SceneBounds sceneObjectBounds(const SceneObjectList & objects)
+{
+	SceneBounds bounds;
+	bounds.Reserve(objects.size());
+	float orbit = objectOrbitRadius();
+	for (const SceneObject * object : objects)
+		bounds.AddSphere(object->HomeX, object->HomeY, 0.0f, orbit + object->Size * 0.71f);
+	return bounds;
+}
+
+// Прежний путь: расчёт и вызовы OpenGL по порядку объектов на потоке OpenGL
+inline void drawObjectsDirect(const SceneObjectList & objects, float time)
+{
+	for (const SceneObject * object : objects)
+	{
+		GLfloat transform[4];
+		animateObject(*object, time, transform);
+		glUseProgram(object->Program);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, object->Texture);
+		glBindVertexArray(object->VertexArray);
+		glUniform4f(object->TransformLocation, transform[0], transform[1], transform[2], transform[3]);
+		glDrawElements(GL_TRIANGLES, object->IndexCount, GL_UNSIGNED_INT, 0);
+	}
+}
+
+// Запись объектов [begin, end) в список команд; OpenGL не вызывается
+inline void recordObjects(CommandList & list, const SceneObjectList & objects, size_t begin, size_t end, float time)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		const SceneObject & object = *objects[i];
+		DrawPacket * packet = list.Draw();
+		packet->Program = object.Program;
+		packet->Texture = object.Texture;
+		packet->VertexArray = object.VertexArray;
+		packet->Mode = GL_TRIANGLES;
+		packet->Count = object.IndexCount;
+		packet->IndexType = GL_UNSIGNED_INT;
+		packet->IndexOffset = 0;
+		packet->BaseVertex = 0;
+		packet->UniformLocation = object.TransformLocation;
+		animateObject(object, time, packet->Uniform);
+		list.Submit(packet, (uint16_t)i);
+	}
+}
+
+// Запись видимых объектов visible[begin, end) при камере в (cameraX, cameraY)
+inline void recordVisibleObjects(CommandList & list, const SceneObjectList & objects, const std::vector<uint32_t> & visible,
+								 size_t begin, size_t end, float time, float cameraX, float cameraY)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		const SceneObject & object = *objects[visible[i]];
+		DrawPacket * packet = list.Draw();
+		packet->Program = object.Program;
+		packet->Texture = object.Texture;
+		packet->VertexArray = object.VertexArray;
+		packet->Mode = GL_TRIANGLES;
+		packet->Count = object.IndexCount;
+		packet->IndexType = GL_UNSIGNED_INT;
+		packet->IndexOffset = 0;
+		packet->BaseVertex = 0;
+		packet->UniformLocation = object.TransformLocation;
+		animateObject(object, time, packet->Uniform);
+		packet->Uniform[0] -= cameraX;
+		packet->Uniform[1] -= cameraY;
+		list.Submit(packet, (uint16_t)visible[i]);
+	}
+}
+
+// То же для программ из objectBlock*ShaderSource: блок объекта visible[i] пишется в ячейку i
+// куска blocks буфера buffer, выделенного на весь кадр (UniformStream::AllocateBlocks)
+inline void recordVisibleObjectBlocks(CommandList & list, const SceneObjectList & objects, const std::vector<uint32_t> & visible,
+									  size_t begin, size_t end, float time, GLuint buffer, const UniformStream::Range & blocks)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		const SceneObject & object = *objects[visible[i]];
+		ObjectConstants * constants = (ObjectConstants *)(blocks.Data + i * blocks.Stride);
+		animateObject(object, time, constants->Transform);
+		DrawPacket * packet = list.Draw();
+		packet->Program = object.Program;
+		packet->Texture = object.Texture;
+		packet->VertexArray = object.VertexArray;
+		packet->Mode = GL_TRIANGLES;
+		packet->Count = object.IndexCount;
+		packet->IndexType = GL_UNSIGNED_INT;
+		packet->IndexOffset = 0;
+		packet->BaseVertex = 0;
+		packet->UniformLocation = -1;
+		packet->UniformBuffer = buffer;
+		packet->UniformOffset = blocks.Offset + (GLintptr)i * blocks.Stride;
+		packet->UniformSize = sizeof(ObjectConstants);
+		list.Submit(packet, (uint16_t)visible[i]);
+	}
+}
+
+#endif
@@ -0,0 +1,174 @@
+// Делаем свой класс шейдера
+// Пользуемся директивами ifndef и define, чтобы избежать рекурсивного выполнения директив include
+
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include <GL/glew.h> // Подключаем glew для того, чтобы получить все необходимые заголовочные файлы
+
+// Считывание файла шейдера. Для считывания используем стандартные потоки C++, помещая
+// результат в строку.
+inline bool readShaderFile(const GLchar * path, std::string & code)
+{
+	std::ifstream shaderFile;
+	// Удостоверимся, что ifstream объекты могут выкидывать исключения
+	shaderFile.exceptions(std::ifstream::badbit);
+	try
+	{
+		shaderFile.open(path);
+		if (!shaderFile.is_open())
+		{
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+			return false;
+		}
+		std::stringstream shaderStream;
+		// Считываем данные в поток
+		shaderStream << shaderFile.rdbuf();
+		shaderFile.close();
+		// Преобразовываем поток в строку
+		code = shaderStream.str();
+	}
+	catch(std::ifstream::failure & e)
+	{
+		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Проверка результата компиляции шейдера; при ошибке выводит журнал компилятора.
+// Запрос статуса ждёт окончания компиляции, поэтому при параллельной сборке его
+// откладывают до момента, когда программа действительно нужна.
+inline bool checkShader(GLuint shader, GLenum type)
+{
+	GLint success;
+	GLchar infoLog[512];
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		glGetShaderInfoLog(shader, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::" << (type == GL_VERTEX_SHADER ? "VERTEX" : type == GL_COMPUTE_SHADER ? "COMPUTE" : "FRAGMENT")
+				  << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Проверка результата связывания программы
+inline bool checkProgram(GLuint program)
+{
+	GLint success;
+	GLchar infoLog[512];
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glGetProgramInfoLog(program, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Сборка одного шейдера. Возвращает 0, если есть ошибки, и выводит их.
+inline GLuint compileShader(GLenum type, const GLchar * source)
+{
+	// Во время создания шейдера необходимо указать его тип
+	GLuint shader = glCreateShader(type);
+	// Далее мы привязываем исходный код шейдера к объекту шейдера и компилируем его.
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+	// Если есть ошибки, то вывести их
+	if (!checkShader(shader, type))
+	{
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+// Сборка шейдерной программы из исходников вершинного и фрагментного шейдеров.
+// retrievable - попросить драйвер сохранить бинарник программы для glGetProgramBinary.
+// Возвращает 0, если сборка или связывание не удались.
+inline GLuint buildProgram(const GLchar * vertexSource, const GLchar * fragmentSource, bool retrievable = false)
+{
+	GLuint vertex = compileShader(GL_VERTEX_SHADER, vertexSource);
+	GLuint fragment = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+	if (!vertex || !fragment)
+	{
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+		return 0;
+	}
+
+	// Шейдерная программа
+	GLuint program = glCreateProgram();
+	if (retrievable)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glAttachShader(program, vertex);
+	glAttachShader(program, fragment);
+	glLinkProgram(program);
+
+	// После связывания шейдеры больше не нужны
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+
+	// Если есть ошибки, то вывести их
+	if (!checkProgram(program))
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+// Сборка вычислительной программы (OpenGL 4.3 или GL_ARB_compute_shader)
+inline GLuint buildComputeProgram(const GLchar * computeSource)
+{
+	GLuint compute = compileShader(GL_COMPUTE_SHADER, computeSource);
+	if (!compute)
+		return 0;
+	GLuint program = glCreateProgram();
+	glAttachShader(program, compute);
+	glLinkProgram(program);
+	glDeleteShader(compute);
+
+	if (!checkProgram(program))
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+class Shader
+{
+	public:
+	// Идентификатор программы
+	GLuint Program = 0;
+
+	// Обёртка над уже собранной программой (например, взятой из ShaderCache)
+	explicit Shader(GLuint program) : Program(program) {}
+
+	// Конструктор считывает и собирает шейдер
+	Shader(const GLchar * vertexPath, const GLchar * fragmentPath)
+	{
+		// 1. Получаем исходный код шейдера из filePath
+		std::string vertexCode;
+		std::string fragmentCode;
+		if (!readShaderFile(vertexPath, vertexCode) || !readShaderFile(fragmentPath, fragmentCode))
+			return;
+
+		// 2. Сборка шейдеров
+		this->Program = buildProgram(vertexCode.c_str(), fragmentCode.c_str());
+	}
+
+	// Использование программы
+	void Use() { glUseProgram(this->Program); }
+};
+
+#endif
@@ -0,0 +1,251 @@
+// Кеш шейдерных программ. Ключ - хеш исходного кода шейдеров. Повторный запрос тех же
+// исходников возвращает уже собранную программу, а собранные программы сохраняются на
+// диск через glGetProgramBinary и при следующем запуске загружаются через
+// glProgramBinary без компиляции. Если драйвер не поддерживает ни одного формата
+// бинарников, кеш работает только в памяти.
+
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "shader.h"
+
+// 64-битный FNV-1a. Криптостойкость не нужна, нужна скорость и стабильность между запусками.
+inline uint64_t hashBytes(const void * data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	const unsigned char * bytes = (const unsigned char *)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+class ShaderCache
+{
+	public:
+	// Статистика за время жизни кеша
+	int MemoryHits = 0, DiskHits = 0, Compiles = 0;
+	double BuildMs = 0.0;
+
+	// directory - каталог для бинарников программ. Пустая строка отключает диск.
+	explicit ShaderCache(const std::string & directory) : directory(directory) {}
+
+	// Программа из исходного кода вершинного и фрагментного шейдеров
+	GLuint GetProgram(const std::string & vertexSource, const std::string & fragmentSource)
+	{
+		GLuint program = this->Find(vertexSource, fragmentSource);
+		if (program)
+			return program;
+
+		auto start = std::chrono::steady_clock::now();
+		program = buildProgram(vertexSource.c_str(), fragmentSource.c_str(), this->BinaryRetrievable());
+		if (!program)
+			return 0; // Ошибки уже выведены, неудачную сборку не кешируем
+		this->Insert(vertexSource, fragmentSource, program);
+		this->BuildMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return program;
+	}
+
+	// Уже собранная программа: из памяти или из бинарника на диске. 0 - её нужно собрать.
+	GLuint Find(const std::string & vertexSource, const std::string & fragmentSource)
+	{
+		uint64_t key = sourceKey(vertexSource, fragmentSource);
+		auto found = this->programs.find(key);
+		if (found != this->programs.end())
+		{
+			this->MemoryHits++;
+			return found->second;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		this->queryBinarySupport();
+		GLuint program = this->loadBinary(key);
+		if (!program)
+			return 0;
+		this->DiskHits++;
+		this->programs[key] = program;
+		this->BuildMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return program;
+	}
+
+	// Программа, собранная в обход GetProgram (например, параллельно с другими): кеш
+	// запоминает её под ключом исходников и сохраняет бинарник на диск
+	void Insert(const std::string & vertexSource, const std::string & fragmentSource, GLuint program)
+	{
+		uint64_t key = sourceKey(vertexSource, fragmentSource);
+		this->Compiles++;
+		this->saveBinary(key, program);
+		this->programs[key] = program;
+	}
+
+	// Нужно ли просить драйвер сохранить бинарник (GL_PROGRAM_BINARY_RETRIEVABLE_HINT)
+	bool BinaryRetrievable()
+	{
+		this->queryBinarySupport();
+		return this->binaryFormats > 0;
+	}
+
+	// Замена конструктора Shader(vertexPath, fragmentPath), проходящая через кеш
+	Shader LoadShader(const GLchar * vertexPath, const GLchar * fragmentPath)
+	{
+		std::string vertexCode, fragmentCode;
+		if (!readShaderFile(vertexPath, vertexCode) || !readShaderFile(fragmentPath, fragmentCode))
+			return Shader(0);
+		return Shader(this->GetProgram(vertexCode, fragmentCode));
+	}
+
+	// Удаление всех программ кеша. Вызывается, пока контекст OpenGL ещё жив.
+	void Release()
+	{
+		for (auto & entry : this->programs)
+			glDeleteProgram(entry.second);
+		this->programs.clear();
+	}
+
+	void Report(std::ostream & out) const
+	{
+		out << std::fixed << std::setprecision(3)
+			<< "shader_cache memory_hits=" << this->MemoryHits
+			<< " disk_hits=" << this->DiskHits
+			<< " compiles=" << this->Compiles
+			<< " binary_formats=" << this->binaryFormats
+			<< " build_ms=" << this->BuildMs << std::endl;
+	}
+
+	private:
+	// Заголовок файла с бинарником программы
+	struct BinaryHeader
+	{
+		char Magic[4];
+		uint32_t Version;
+		uint64_t SourceHash;
+		// Бинарники действительны только для того же драйвера
+		uint64_t DriverHash;
+		uint32_t Format;
+		uint32_t Length;
+	};
+	static const uint32_t binaryVersion = 1;
+
+	std::string directory;
+	std::unordered_map<uint64_t, GLuint> programs;
+	// -1 - ещё не спрашивали драйвер
+	GLint binaryFormats = -1;
+	uint64_t driverHash = 0;
+
+	// Разделитель не даёт паре ("ab", "c") совпасть по хешу с парой ("a", "bc")
+	static uint64_t sourceKey(const std::string & vertexSource, const std::string & fragmentSource)
+	{
+		uint64_t key = hashBytes(vertexSource.data(), vertexSource.size());
+		key = hashBytes("\0", 1, key);
+		return hashBytes(fragmentSource.data(), fragmentSource.size(), key);
+	}
+
+	void queryBinarySupport()
+	{
+		if (this->binaryFormats >= 0)
+			return;
+		this->binaryFormats = 0;
+		if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &this->binaryFormats);
+
+		const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+		for (GLenum name : strings)
+		{
+			const char * value = (const char *)glGetString(name);
+			if (value)
+				this->driverHash = hashBytes(value, strlen(value), this->driverHash);
+		}
+
+		if (this->binaryFormats > 0 && !this->directory.empty())
+		{
+			std::error_code error;
+			std::filesystem::create_directories(this->directory, error);
+			if (error)
+			{
+				std::cout << "ERROR::SHADER_CACHE::DIRECTORY_NOT_CREATED " << this->directory << std::endl;
+				this->directory.clear();
+			}
+		}
+	}
+
+	std::string binaryPath(uint64_t key) const
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+		return this->directory + "/" + name;
+	}
+
+	GLuint loadBinary(uint64_t key)
+	{
+		if (this->binaryFormats <= 0 || this->directory.empty())
+			return 0;
+
+		std::ifstream file(this->binaryPath(key), std::ios::binary);
+		if (!file)
+			return 0;
+		BinaryHeader header;
+		if (!file.read((char *)&header, sizeof(header)) || memcmp(header.Magic, "GLPB", 4) != 0 ||
+			header.Version != binaryVersion || header.SourceHash != key || header.DriverHash != this->driverHash)
+			return 0;
+		std::vector<char> binary(header.Length);
+		if (!file.read(binary.data(), header.Length))
+			return 0;
+
+		GLuint program = glCreateProgram();
+		glProgramBinary(program, header.Format, binary.data(), header.Length);
+		GLint success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			// Драйвер отверг бинарник (например, после обновления) - соберём заново и перезапишем
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+
+	void saveBinary(uint64_t key, GLuint program)
+	{
+		if (this->binaryFormats <= 0 || this->directory.empty())
+			return;
+
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+		std::vector<char> binary(length);
+		GLenum format = 0;
+		glGetProgramBinary(program, length, &length, &format, binary.data());
+
+		BinaryHeader header = { { 'G', 'L', 'P', 'B' }, binaryVersion, key, this->driverHash, format, (uint32_t)length };
+		// Пишем во временный файл и переименовываем, чтобы параллельный запуск не прочитал половину файла
+		std::string path = this->binaryPath(key);
+		std::string temporary = path + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			file.write((const char *)&header, sizeof(header));
+			file.write(binary.data(), length);
+			if (!file)
+			{
+				std::cout << "ERROR::SHADER_CACHE::WRITE_FAILED " << temporary << std::endl;
+				return;
+			}
+		}
+		std::error_code error;
+		std::filesystem::rename(temporary, path, error);
+	}
+};
+
+#endif
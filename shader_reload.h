@@ -0,0 +1,239 @@
+// Горячая перезагрузка шейдеров. Фоновый поток следит за файлами шейдеров через inotify
+// и, когда файл меняется, сам перечитывает исходники и передаёт их потоку OpenGL через
+// lock-free очередь. Поток OpenGL в начале кадра (Pump) собирает новую программу и
+// подменяет Shader::Program - между кадрами, так что кадр никогда не рисуется наполовину
+// старой, наполовину новой программой. Если сборка не удалась, ошибки выводятся, а
+// старая программа остаётся на месте.
+//
+// Следим за каталогами, а не за самими файлами: редакторы часто сохраняют файл через
+// запись во временный и переименование, и наблюдение за старым inode такое пропустит.
+
+#ifndef SHADER_RELOAD_H
+#define SHADER_RELOAD_H
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "gl_state.h"
+#include "lockfree_queue.h"
+#include "shader_variants.h"
+
+class ShaderWatcher
+{
+	public:
+	// Сколько программ подменено, сколько сборок не удалось и самая долгая сборка на потоке OpenGL
+	int Reloads = 0, Failures = 0;
+	double MaxReloadMs = 0.0;
+
+	explicit ShaderWatcher(ShaderCache & cache) : cache(cache), reloads(64) {}
+
+	~ShaderWatcher()
+	{
+		this->Stop();
+		Reload * reload;
+		while (this->reloads.TryPop(reload))
+			delete reload;
+	}
+
+	ShaderWatcher(const ShaderWatcher &) = delete;
+	ShaderWatcher & operator=(const ShaderWatcher &) = delete;
+
+	// Следить за файлами шейдера. Вызывается до Start. features - вариант общего исходника
+	// (shader_variants.h), который собирается из файлов; 0 - файлы собираются как есть.
+	void Watch(Shader * shader, const std::string & vertexPath, const std::string & fragmentPath, unsigned features = 0)
+	{
+		this->entries.push_back({ shader, vertexPath, fragmentPath, features });
+	}
+
+	bool Start()
+	{
+		this->notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		this->wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (this->notify < 0 || this->wakeup < 0)
+		{
+			std::cout << "ERROR::SHADER_RELOAD::INOTIFY_INIT_FAILED" << std::endl;
+			this->closeDescriptors();
+			return false;
+		}
+		for (const Entry & entry : this->entries)
+			for (const std::string & path : { entry.VertexPath, entry.FragmentPath })
+			{
+				std::string directory = std::filesystem::path(path).parent_path().string();
+				if (directory.empty())
+					directory = ".";
+				int watch = inotify_add_watch(this->notify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+				if (watch < 0)
+				{
+					std::cout << "ERROR::SHADER_RELOAD::WATCH_FAILED " << directory << std::endl;
+					continue;
+				}
+				this->directories[watch] = directory;
+			}
+		this->running = true;
+		this->thread = std::thread([this] { this->run(); });
+		return true;
+	}
+
+	void Stop()
+	{
+		if (this->running.exchange(false))
+		{
+			uint64_t one = 1;
+			if (write(this->wakeup, &one, sizeof(one)) < 0)
+				std::cout << "ERROR::SHADER_RELOAD::WAKEUP_FAILED" << std::endl;
+			this->thread.join();
+		}
+		this->closeDescriptors();
+	}
+
+	// Поток OpenGL, граница кадра: сборка и подмена программ, исходники которых изменились.
+	// За кадр подменяется не больше одной программы, чтобы сборка не растягивала кадр.
+	// state - трекер состояния, если программа в нём кешируется.
+	void Pump(GlState * state = nullptr)
+	{
+		Reload * popped;
+		if (!this->reloads.TryPop(popped))
+			return;
+		std::unique_ptr<Reload> reload(popped);
+		Entry & entry = this->entries[reload->Index];
+
+		auto start = std::chrono::steady_clock::now();
+		// Через кеш: откат к уже встречавшемуся варианту исходников не требует сборки
+		GLuint program = this->cache.GetProgram(shaderVariantSource(reload->VertexSource, entry.Features),
+												shaderVariantSource(reload->FragmentSource, entry.Features));
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		this->MaxReloadMs = std::max(this->MaxReloadMs, ms);
+		if (!program)
+		{
+			this->Failures++;
+			std::cout << "ERROR::SHADER_RELOAD::BUILD_FAILED keeping previous program for "
+					  << entry.VertexPath << " + " << entry.FragmentPath << std::endl;
+			return;
+		}
+		if (program == entry.Target->Program)
+			return;
+		// Старую программу не удаляем: она принадлежит кешу
+		if (state)
+			state->ForgetProgram(entry.Target->Program);
+		entry.Target->Program = program;
+		this->Reloads++;
+		std::cout << std::fixed << std::setprecision(3) << "shader_reload program=" << program << " vertex=" << entry.VertexPath
+				  << " fragment=" << entry.FragmentPath << " build_ms=" << ms << std::endl;
+	}
+
+	void Report(std::ostream & out) const
+	{
+		out << std::fixed << std::setprecision(3)
+			<< "shader_reload reloads=" << this->Reloads
+			<< " failures=" << this->Failures
+			<< " max_reload_ms=" << this->MaxReloadMs << std::endl;
+	}
+
+	private:
+	struct Entry
+	{
+		Shader * Target;
+		std::string VertexPath, FragmentPath;
+		unsigned Features;
+	};
+
+	// Исходники, прочитанные фоновым потоком
+	struct Reload
+	{
+		size_t Index;
+		std::string VertexSource, FragmentSource;
+	};
+
+	ShaderCache & cache;
+	std::vector<Entry> entries;
+	LockFreeQueue<Reload *> reloads;
+	std::unordered_map<int, std::string> directories;
+	int notify = -1, wakeup = -1;
+	std::atomic<bool> running{ false };
+	std::thread thread;
+
+	void closeDescriptors()
+	{
+		if (this->notify >= 0)
+			close(this->notify);
+		if (this->wakeup >= 0)
+			close(this->wakeup);
+		this->notify = this->wakeup = -1;
+	}
+
+	static bool samePath(const std::string & a, const std::string & b)
+	{
+		return std::filesystem::path(a).lexically_normal() == std::filesystem::path(b).lexically_normal();
+	}
+
+	// Фоновый поток: ждём событий inotify, пока не разбудят через eventfd
+	void run()
+	{
+		std::vector<bool> changed(this->entries.size());
+		alignas(struct inotify_event) char buffer[4096];
+		while (this->running)
+		{
+			pollfd descriptors[2] = { { this->notify, POLLIN, 0 }, { this->wakeup, POLLIN, 0 } };
+			if (poll(descriptors, 2, -1) < 0 || (descriptors[1].revents & POLLIN))
+				continue;
+
+			// Сохранение файла порождает несколько событий подряд (запись, переименование,
+			// второй файл пары) - собираем их все, пока поток событий не затихнет
+			std::fill(changed.begin(), changed.end(), false);
+			bool any = false;
+			do
+			{
+				ssize_t length;
+				while ((length = read(this->notify, buffer, sizeof(buffer))) > 0)
+					for (char * cursor = buffer; cursor < buffer + length;)
+					{
+						const inotify_event * event = (const inotify_event *)cursor;
+						cursor += sizeof(inotify_event) + event->len;
+						if (!event->len || !this->directories.count(event->wd))
+							continue;
+						std::string path = this->directories[event->wd] + "/" + event->name;
+						for (size_t i = 0; i < this->entries.size(); i++)
+							if (samePath(path, this->entries[i].VertexPath) || samePath(path, this->entries[i].FragmentPath))
+							{
+								changed[i] = true;
+								any = true;
+							}
+					}
+				descriptors[0].revents = 0;
+			}
+			while (poll(descriptors, 1, 50) > 0);
+			if (!any)
+				continue;
+
+			for (size_t i = 0; i < this->entries.size(); i++)
+			{
+				if (!changed[i])
+					continue;
+				std::unique_ptr<Reload> reload(new Reload());
+				reload->Index = i;
+				if (!readShaderFile(this->entries[i].VertexPath.c_str(), reload->VertexSource) ||
+					!readShaderFile(this->entries[i].FragmentPath.c_str(), reload->FragmentSource))
+					continue;
+				if (this->reloads.TryPush(reload.get()))
+					reload.release();
+				else
+					std::cout << "ERROR::SHADER_RELOAD::QUEUE_FULL" << std::endl;
+			}
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,262 @@
+// Варианты шейдера из одного исходника. Почти одинаковые шейдеры (цвет из вершин,
+// цвет из uniform, одна текстура или смесь двух) - это один исходник с блоками #ifdef:
+// вариант получается вставкой строк #define после #version, и в собранном шейдере нет
+// ни ветвлений по флагам, ни неиспользуемых входов.
+//
+// Все запрошенные варианты отправляются драйверу разом (Submit): сначала компиляция всех
+// шейдеров, затем связывание всех программ, и ни одного запроса статуса между ними - такой
+// запрос заставил бы ждать окончания сборки. С GL_KHR_parallel_shader_compile (или
+// ARB-версией) драйвер собирает их в своих потоках, а Poll без ожидания забирает готовые;
+// без расширения сборка идёт внутри тех же вызовов, но порядок вызовов тот же. Finish
+// дожидается всех, проверяет ошибки и отдаёт программы в ShaderCache, так что при следующем
+// запуске варианты загружаются с диска без компиляции.
+//
+// На отрисовке вариант ищется по маске возможностей индексом в массиве (Get).
+
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "shader_cache.h"
+
+// Возможности варианта - биты маски и имена макросов в GLSL
+enum ShaderFeature
+{
+	// Цвет из вершинного атрибута 1 (ourColor)
+	FeatureVertexColor = 1 << 0,
+	// Множитель цвета uniform vec4 uniformColor
+	FeatureUniformColor = 1 << 1,
+	// Текстура ourTexture1 по координатам из атрибута 2
+	FeatureTexture = 1 << 2,
+	// Смесь с второй текстурой ourTexture2 (включает FeatureTexture)
+	FeatureTwoTextures = 1 << 3
+};
+
+const int shaderFeatureCount = 4;
+const unsigned shaderVariantCount = 1u << shaderFeatureCount;
+static const char * const shaderFeatureDefines[shaderFeatureCount] = { "VERTEX_COLOR", "UNIFORM_COLOR", "TEXTURE", "TWO_TEXTURES" };
+
+// Маска без противоречий: вторая текстура невозможна без первой
+inline unsigned normalizeShaderFeatures(unsigned features)
+{
+	features &= shaderVariantCount - 1;
+	if (features & FeatureTwoTextures)
+		features |= FeatureTexture;
+	return features;
+}
+
+// Исходник варианта: #define после строки #version (она обязана быть первой), затем #line,
+// чтобы номера строк в ошибках совпадали с файлом. Без возможностей исходник не меняется.
+inline std::string shaderVariantSource(const std::string & source, unsigned features)
+{
+	if (!features)
+		return source;
+	size_t body = source.find('\n');
+	body = body == std::string::npos ? source.size() : body + 1;
+	std::string result = source.substr(0, body);
+	for (int i = 0; i < shaderFeatureCount; i++)
+		if (features & (1u << i))
+			result += std::string("#define ") + shaderFeatureDefines[i] + "\n";
+	result += "#line 2\n";
+	result += source.substr(body);
+	return result;
+}
+
+class ShaderVariants
+{
+	public:
+	// Статистика: сколько вариантов взято из кеша и сколько собрано, поддержка параллельной
+	// сборки, время отправки и время ожидания готовности
+	int CacheHits = 0, Compiled = 0, Failures = 0;
+	bool Parallel = false;
+	double SubmitMs = 0.0, WaitMs = 0.0;
+
+	explicit ShaderVariants(ShaderCache & cache) : cache(cache)
+	{
+		this->programs.assign(shaderVariantCount, 0);
+		this->building.assign(shaderVariantCount, false);
+	}
+
+	ShaderVariants(const ShaderVariants &) = delete;
+	ShaderVariants & operator=(const ShaderVariants &) = delete;
+
+	// Общий исходник всех вариантов
+	void SetSource(const std::string & vertexSource, const std::string & fragmentSource)
+	{
+		this->vertexSource = vertexSource;
+		this->fragmentSource = fragmentSource;
+	}
+
+	bool Load(const GLchar * vertexPath, const GLchar * fragmentPath)
+	{
+		return readShaderFile(vertexPath, this->vertexSource) && readShaderFile(fragmentPath, this->fragmentSource);
+	}
+
+	// Запомнить вариант для следующего Submit
+	void Request(unsigned features)
+	{
+		features = normalizeShaderFeatures(features);
+		for (unsigned requested : this->requested)
+			if (requested == features)
+				return;
+		this->requested.push_back(features);
+	}
+
+	// Отправить драйверу сборку всех запрошенных вариантов, которых нет в кеше, не дожидаясь её
+	void Submit()
+	{
+		auto start = std::chrono::steady_clock::now();
+		this->Parallel = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+		// 0xFFFFFFFF - столько потоков, сколько драйвер сочтёт нужным
+		if (GLEW_KHR_parallel_shader_compile)
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		else if (GLEW_ARB_parallel_shader_compile)
+			glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		bool retrievable = this->cache.BinaryRetrievable();
+
+		size_t first = this->pending.size();
+		for (unsigned features : this->requested)
+		{
+			// Уже собран или ещё собирается с прошлого Submit - вторая сборка не нужна
+			if (this->programs[features] || this->building[features])
+				continue;
+			Pending build;
+			build.Features = features;
+			build.VertexSource = shaderVariantSource(this->vertexSource, features);
+			build.FragmentSource = shaderVariantSource(this->fragmentSource, features);
+			GLuint program = this->cache.Find(build.VertexSource, build.FragmentSource);
+			if (program)
+			{
+				this->programs[features] = program;
+				this->CacheHits++;
+				continue;
+			}
+			build.Vertex = this->startShader(GL_VERTEX_SHADER, build.VertexSource);
+			build.Fragment = this->startShader(GL_FRAGMENT_SHADER, build.FragmentSource);
+			this->building[features] = true;
+			this->pending.push_back(std::move(build));
+		}
+		this->requested.clear();
+		// Связывание после всех компиляций: пока одни шейдеры собираются, другие программы
+		// уже стоят в очереди драйвера
+		for (size_t i = first; i < this->pending.size(); i++)
+		{
+			Pending & build = this->pending[i];
+			build.Program = glCreateProgram();
+			if (retrievable)
+				glProgramParameteri(build.Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			glAttachShader(build.Program, build.Vertex);
+			glAttachShader(build.Program, build.Fragment);
+			glLinkProgram(build.Program);
+		}
+		this->SubmitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Забрать готовые варианты без ожидания; возвращает, сколько ещё собирается.
+	// Без параллельной сборки драйвер не сообщает о готовности, и Poll ничего не забирает.
+	size_t Poll()
+	{
+		if (!this->Parallel)
+			return this->pending.size();
+		for (size_t i = 0; i < this->pending.size();)
+		{
+			GLint complete = GL_FALSE;
+			glGetProgramiv(this->pending[i].Program, GL_COMPLETION_STATUS_KHR, &complete);
+			if (!complete)
+			{
+				i++;
+				continue;
+			}
+			this->finish(this->pending[i]);
+			this->pending.erase(this->pending.begin() + i);
+		}
+		return this->pending.size();
+	}
+
+	// Дождаться всех вариантов. false - хотя бы один не собрался (ошибки выведены).
+	bool Finish()
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (Pending & build : this->pending)
+			this->finish(build);
+		this->pending.clear();
+		this->WaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return this->Failures == 0;
+	}
+
+	// Программа варианта; 0, если он не запрашивался, ещё собирается или не собрался
+	GLuint Get(unsigned features) const { return this->programs[normalizeShaderFeatures(features)]; }
+
+	void Report(std::ostream & out) const
+	{
+		int variants = 0;
+		for (GLuint program : this->programs)
+			variants += program != 0;
+		out << std::fixed << std::setprecision(3)
+			<< "shader_variants variants=" << variants
+			<< " cache_hits=" << this->CacheHits
+			<< " compiled=" << this->Compiled
+			<< " failures=" << this->Failures
+			<< " parallel=" << this->Parallel
+			<< " submit_ms=" << this->SubmitMs
+			<< " wait_ms=" << this->WaitMs << std::endl;
+	}
+
+	private:
+	struct Pending
+	{
+		unsigned Features = 0;
+		std::string VertexSource, FragmentSource;
+		GLuint Vertex = 0, Fragment = 0, Program = 0;
+	};
+
+	ShaderCache & cache;
+	std::string vertexSource, fragmentSource;
+	std::vector<unsigned> requested;
+	std::vector<Pending> pending;
+	// Программы по нормализованной маске; принадлежат кешу
+	std::vector<GLuint> programs;
+	// Маски, которые сейчас в pending
+	std::vector<bool> building;
+
+	GLuint startShader(GLenum type, const std::string & source)
+	{
+		const GLchar * text = source.c_str();
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 1, &text, NULL);
+		glCompileShader(shader);
+		return shader;
+	}
+
+	// Проверка собранного варианта; запросы статуса здесь ждут окончания сборки
+	void finish(Pending & build)
+	{
+		this->building[build.Features] = false;
+		bool linked = checkProgram(build.Program);
+		if (!linked)
+		{
+			// Связывание не удалось из-за ошибок компиляции - выводим и их
+			checkShader(build.Vertex, GL_VERTEX_SHADER);
+			checkShader(build.Fragment, GL_FRAGMENT_SHADER);
+		}
+		glDeleteShader(build.Vertex);
+		glDeleteShader(build.Fragment);
+		if (!linked)
+		{
+			std::cout << "ERROR::SHADER_VARIANTS::BUILD_FAILED features=" << build.Features << std::endl;
+			glDeleteProgram(build.Program);
+			this->Failures++;
+			return;
+		}
+		this->cache.Insert(build.VertexSource, build.FragmentSource, build.Program);
+		this->programs[build.Features] = build.Program;
+		this->Compiled++;
+	}
+};
+
+#endif
@@ -0,0 +1,615 @@
+// Программный растеризатор для машин без GPU: те же пакеты RenderBatch, что и у GlRenderer,
+// но вся отрисовка на CPU, без драйвера OpenGL.
+//
+// Кадр делится на плитки TileSize x TileSize. Draw сразу, на вызывающем потоке, готовит
+// треугольники (деление на w, перевод в пиксели с фиксированной точкой 1/256 пикселя, как у llvmpipe,
+// плоскости атрибутов) и раскладывает их по корзинам плиток, которые они задевают. Flush
+// растеризует плитки в пуле потоков: каждую плитку целиком обрабатывает один поток, и
+// треугольники в ней идут в порядке отрисовки, так что синхронизация не нужна.
+//
+// Внутри плитки пиксели обходятся по четыре (SSE2). Функции рёбер - целые, с правилом
+// заполнения top-left, как у GPU: общее ребро двух треугольников закрашивается ровно один
+// раз. В 32 бита они при такой точности не помещаются, поэтому дорожки - double, где
+// целые до 2^53 точны. Ребро, которое целиком покрывает плитку, в ней не проверяется. Атрибуты
+// интерполируются с учётом перспективы: линейно по экрану идут 1/w и атрибут/w. Выборка
+// текстуры - билинейная, с центрами текселей и повторением, как GL_LINEAR + GL_REPEAT; цвет
+// пишется в 8 бит с округлением, как в GL_RGBA8.
+//
+// Функция растеризации специализирована по маске возможностей (шаблон по Features), так
+// что во внутреннем цикле нет ветвлений по ним - как у вариантов шейдера.
+//
+// Отсечения по ближней плоскости нет: треугольник с вершиной при w <= 0 отбрасывается, как
+// и треугольник, вышедший за защитную полосу guardBand пикселей вокруг кадра (дальше
+// функции рёбер перестали бы быть точными).
+
+#ifndef SOFT_RASTER_H
+#define SOFT_RASTER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <emmintrin.h>
+
+#include "renderer.h"
+#include "thread_pool.h"
+
+struct SoftTexture
+{
+	int Width = 0, Height = 0;
+	// RGBA8: тексель - uint32_t с R в младшем байте, строки в порядке памяти (t = 0 - первая)
+	std::vector<uint32_t> Texels;
+};
+
+class SoftRasterizer
+{
+	public:
+	// Сторона плитки в пикселях (кратна 4)
+	static const int TileSize = 64;
+	int Width = 0, Height = 0;
+	// Статистика с начала работы
+	long long Frames = 0, Triangles = 0, Dropped = 0, BinEntries = 0, FullTiles = 0;
+	double SetupMs = 0.0, RasterMs = 0.0;
+
+	// pool - потоки растеризации плиток; nullptr - растеризация на вызывающем потоке
+	bool Create(int width, int height, ThreadPool * pool)
+	{
+		if (width <= 0 || height <= 0 || width > maxSize || height > maxSize)
+		{
+			std::cout << "ERROR::SOFT_RASTER::INVALID_SIZE " << width << "x" << height << std::endl;
+			return false;
+		}
+		this->Width = width;
+		this->Height = height;
+		this->pitch = (width + 3) & ~3;
+		this->pixels.assign((size_t)this->pitch * height, 0);
+		this->tilesX = (width + TileSize - 1) / TileSize;
+		this->tilesY = (height + TileSize - 1) / TileSize;
+		this->bins.assign((size_t)this->tilesX * this->tilesY, std::vector<uint32_t>());
+		this->pool = pool;
+		return true;
+	}
+
+	// Заливка кадра. Всё нарисованное до неё и ещё не растеризованное она бы закрасила,
+	// поэтому оно просто отбрасывается.
+	void Clear(const GLfloat color[4])
+	{
+		__m128i packed = packColor(_mm_set1_ps(color[0]), _mm_set1_ps(color[1]), _mm_set1_ps(color[2]), _mm_set1_ps(color[3]));
+		this->clearValue = (uint32_t)_mm_cvtsi128_si32(packed);
+		this->clearPending = true;
+		this->triangles.clear();
+		this->shadings.clear();
+		for (std::vector<uint32_t> & bin : this->bins)
+			bin.clear();
+	}
+
+	// Подготовка и раскладка треугольников пакета. Текстуры должны жить до Flush;
+	// nullptr вместо нужной текстуры читается как чёрная, как пустой текстурный блок в OpenGL.
+	void Draw(const RenderBatch & batch, const SoftTexture * texture0, const SoftTexture * texture1)
+	{
+		auto start = std::chrono::steady_clock::now();
+		Shading shading;
+		shading.Features = normalizeShaderFeatures(batch.Features);
+		shading.Textures[0] = texture0 ? texture0 : &blackTexture();
+		shading.Textures[1] = texture1 ? texture1 : &blackTexture();
+		memcpy(shading.UniformColor, batch.UniformColor, sizeof(shading.UniformColor));
+		this->shadings.push_back(shading);
+		uint32_t index = (uint32_t)this->shadings.size() - 1;
+
+		for (int i = 0; i + 2 < batch.IndexCount; i += 3)
+		{
+			GLuint a = batch.Indices[i], b = batch.Indices[i + 1], c = batch.Indices[i + 2];
+			if (a >= (GLuint)batch.VertexCount || b >= (GLuint)batch.VertexCount || c >= (GLuint)batch.VertexCount)
+			{
+				this->Dropped++;
+				continue;
+			}
+			this->setup(batch.Vertices[a], batch.Vertices[b], batch.Vertices[c], index);
+		}
+		this->SetupMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Растеризация всего, что нарисовано с прошлого Flush
+	void Flush()
+	{
+		auto start = std::chrono::steady_clock::now();
+		size_t tiles = this->bins.size();
+		// Плитки раздаются через одну: в середине кадра работы обычно больше, чем по краям
+		auto body = [this, tiles](size_t part, size_t, size_t) {
+			size_t parts = this->rasterParts;
+			for (size_t tile = part; tile < tiles; tile += parts)
+				this->rasterTile(tile);
+		};
+		this->rasterParts = this->pool ? std::min<size_t>(tiles, (size_t)this->pool->Size() * 4) : 1;
+		if (this->pool)
+			this->pool->ParallelFor(this->rasterParts, this->rasterParts, body);
+		else
+			body(0, 0, tiles);
+
+		this->clearPending = false;
+		this->triangles.clear();
+		this->shadings.clear();
+		for (std::vector<uint32_t> & bin : this->bins)
+			bin.clear();
+		this->Frames++;
+		this->RasterMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Кадр в RGBA8, строки сверху вниз
+	void ReadPixels(std::vector<unsigned char> & out) const
+	{
+		out.resize((size_t)this->Width * this->Height * 4);
+		for (int y = 0; y < this->Height; y++)
+			memcpy(out.data() + (size_t)y * this->Width * 4, this->pixels.data() + (size_t)y * this->pitch, (size_t)this->Width * 4);
+	}
+
+	void Report(std::ostream & out) const
+	{
+		double frames = this->Frames ? (double)this->Frames : 1.0;
+		out << std::fixed << std::setprecision(3)
+			<< "soft_raster size=" << this->Width << "x" << this->Height
+			<< " tile=" << TileSize
+			<< " threads=" << (this->pool ? this->pool->Size() : 0)
+			<< " frames=" << this->Frames
+			<< " triangles=" << this->Triangles
+			<< " dropped=" << this->Dropped
+			<< " bin_entries_per_frame=" << this->BinEntries / frames
+			<< " full_tiles_per_frame=" << this->FullTiles / frames
+			<< " setup_ms_per_frame=" << this->SetupMs / frames
+			<< " raster_ms_per_frame=" << this->RasterMs / frames << std::endl;
+	}
+
+	private:
+	// Размер кадра и защитная полоса ограничены так, чтобы функции рёбер (до 2^46)
+	// точно представлялись в double
+	static const int maxSize = 4096;
+	static const int guardBand = 8192;
+	// Точность вершин на экране: 1/256 пикселя
+	static const int subPixelBits = 8;
+	static const int64_t subPixelScale = 1 << subPixelBits, subPixelHalf = subPixelScale / 2;
+	// Плоскости: 1/w, цвет/w (3), текстурные координаты/w (2)
+	static const int planeCount = 6;
+
+	struct Shading
+	{
+		unsigned Features;
+		const SoftTexture * Textures[2];
+		float UniformColor[4];
+	};
+
+	struct Triangle
+	{
+		// Функции рёбер E = A * x + B * y + C от центра пикселя в 1/256 пикселя;
+		// пиксель внутри, если E + Bias >= 0 для всех трёх рёбер
+		int64_t A[3], B[3], C[3];
+		int32_t Bias[3];
+		// Пиксели, которые может задеть треугольник (включительно)
+		int MinX, MinY, MaxX, MaxY;
+		// Плоскость: значение в центре пикселя (0, 0) и приращения на пиксель по x и y
+		double Base[planeCount];
+		float Dx[planeCount], Dy[planeCount];
+		uint32_t Shading;
+	};
+
+	typedef void (SoftRasterizer::*RasterFunction)(const Triangle &, const Shading &, unsigned, int, int, int, int);
+
+	ThreadPool * pool = nullptr;
+	int pitch = 0, tilesX = 0, tilesY = 0;
+	size_t rasterParts = 1;
+	std::vector<uint32_t> pixels;
+	std::vector<Triangle> triangles;
+	std::vector<Shading> shadings;
+	// Корзины плиток: номер треугольника << 3 | рёбра, целиком покрывающие плитку (биты 0-2)
+	std::vector<std::vector<uint32_t>> bins;
+	uint32_t clearValue = 0;
+	bool clearPending = false;
+
+	static const SoftTexture & blackTexture()
+	{
+		static const SoftTexture texture = { 1, 1, { 0xFF000000u } };
+		return texture;
+	}
+
+	void setup(const RenderVertex & a, const RenderVertex & b, const RenderVertex & c, uint32_t shading)
+	{
+		const RenderVertex * v[3] = { &a, &b, &c };
+		double sx[3], sy[3], q[3];
+		int64_t X[3], Y[3];
+		for (int i = 0; i < 3; i++)
+		{
+			float w = v[i]->Position[3];
+			if (!(w > 1e-6f))
+			{
+				this->Dropped++;
+				return;
+			}
+			q[i] = 1.0 / w;
+			sx[i] = (v[i]->Position[0] * q[i] + 1.0) * 0.5 * this->Width;
+			// Экран сверху вниз: строка 0 - верх кадра, как у прочитанного кадра OpenGL после переворота
+			sy[i] = (1.0 - v[i]->Position[1] * q[i]) * 0.5 * this->Height;
+			if (!(sx[i] > -guardBand && sx[i] < this->Width + guardBand && sy[i] > -guardBand && sy[i] < this->Height + guardBand))
+			{
+				this->Dropped++;
+				return;
+			}
+			X[i] = (int64_t)std::llround(sx[i] * subPixelScale);
+			Y[i] = (int64_t)std::llround(sy[i] * subPixelScale);
+		}
+		int64_t area = (X[1] - X[0]) * (Y[2] - Y[0]) - (X[2] - X[0]) * (Y[1] - Y[0]);
+		if (area == 0)
+			return;
+		// Отсечения нелицевых граней нет (как glDisable(GL_CULL_FACE)): обход выравнивается
+		if (area < 0)
+		{
+			std::swap(v[1], v[2]);
+			std::swap(X[1], X[2]);
+			std::swap(Y[1], Y[2]);
+			std::swap(q[1], q[2]);
+		}
+
+		Triangle triangle;
+		triangle.MinX = std::max(0, (int)((std::min({ X[0], X[1], X[2] }) + subPixelHalf - 1) >> subPixelBits));
+		triangle.MinY = std::max(0, (int)((std::min({ Y[0], Y[1], Y[2] }) + subPixelHalf - 1) >> subPixelBits));
+		triangle.MaxX = std::min(this->Width - 1, (int)((std::max({ X[0], X[1], X[2] }) - subPixelHalf) >> subPixelBits));
+		triangle.MaxY = std::min(this->Height - 1, (int)((std::max({ Y[0], Y[1], Y[2] }) - subPixelHalf) >> subPixelBits));
+		// Между центрами пикселей
+		if (triangle.MinX > triangle.MaxX || triangle.MinY > triangle.MaxY)
+			return;
+
+		for (int e = 0; e < 3; e++)
+		{
+			int next = (e + 1) % 3;
+			int64_t dx = X[next] - X[e], dy = Y[next] - Y[e];
+			triangle.A[e] = -dy;
+			triangle.B[e] = dx;
+			triangle.C[e] = dy * X[e] - dx * Y[e];
+			// Левое ребро или верхнее горизонтальное (экран сверху вниз)
+			bool topLeft = dy < 0 || (dy == 0 && dx > 0);
+			triangle.Bias[e] = topLeft ? 0 : -1;
+		}
+
+		// Плоскости атрибутов по вершинам, округлённым так же, как для покрытия
+		double values[planeCount][3];
+		for (int i = 0; i < 3; i++)
+		{
+			values[0][i] = q[i];
+			for (int k = 0; k < 3; k++)
+				values[1 + k][i] = v[i]->Color[k] * q[i];
+			values[4][i] = v[i]->TexCoord[0] * q[i];
+			values[5][i] = v[i]->TexCoord[1] * q[i];
+		}
+		const double scale = 1.0 / subPixelScale;
+		double x0 = X[0] * scale, y0 = Y[0] * scale;
+		double x1 = X[1] * scale - x0, y1 = Y[1] * scale - y0, x2 = X[2] * scale - x0, y2 = Y[2] * scale - y0;
+		double determinant = x1 * y2 - x2 * y1;
+		for (int k = 0; k < planeCount; k++)
+		{
+			double f1 = values[k][1] - values[k][0], f2 = values[k][2] - values[k][0];
+			double dx = (f1 * y2 - f2 * y1) / determinant;
+			double dy = (f2 * x1 - f1 * x2) / determinant;
+			triangle.Base[k] = values[k][0] + dx * (0.5 - x0) + dy * (0.5 - y0);
+			triangle.Dx[k] = (float)dx;
+			triangle.Dy[k] = (float)dy;
+		}
+		triangle.Shading = shading;
+
+		uint32_t index = (uint32_t)this->triangles.size();
+		this->triangles.push_back(triangle);
+		this->Triangles++;
+		this->bin(triangle, index);
+	}
+
+	// Раскладка по плиткам: плитка, которую треугольник не задевает, пропускается, а для
+	// остальных запоминаются рёбра, покрывающие плитку целиком
+	void bin(const Triangle & triangle, uint32_t index)
+	{
+		for (int ty = triangle.MinY / TileSize; ty <= triangle.MaxY / TileSize; ty++)
+			for (int tx = triangle.MinX / TileSize; tx <= triangle.MaxX / TileSize; tx++)
+			{
+				int x0 = std::max(tx * TileSize, triangle.MinX), x1 = std::min(tx * TileSize + TileSize - 1, triangle.MaxX);
+				int y0 = std::max(ty * TileSize, triangle.MinY), y1 = std::min(ty * TileSize + TileSize - 1, triangle.MaxY);
+				unsigned accepted = 0;
+				bool outside = false;
+				for (int e = 0; e < 3 && !outside; e++)
+				{
+					int64_t corners[4] = { edgeAt(triangle, e, x0, y0), edgeAt(triangle, e, x1, y0),
+										   edgeAt(triangle, e, x0, y1), edgeAt(triangle, e, x1, y1) };
+					int64_t low = std::min({ corners[0], corners[1], corners[2], corners[3] }) + triangle.Bias[e];
+					int64_t high = std::max({ corners[0], corners[1], corners[2], corners[3] }) + triangle.Bias[e];
+					if (high < 0)
+						outside = true;
+					else if (low >= 0)
+						accepted |= 1u << e;
+				}
+				if (outside)
+					continue;
+				this->bins[(size_t)ty * this->tilesX + tx].push_back(index << 3 | accepted);
+				this->BinEntries++;
+				if (accepted == 7)
+					this->FullTiles++;
+			}
+	}
+
+	static int64_t edgeAt(const Triangle & triangle, int e, int x, int y)
+	{
+		return triangle.A[e] * (x * subPixelScale + subPixelHalf) + triangle.B[e] * (y * subPixelScale + subPixelHalf) + triangle.C[e];
+	}
+
+	void rasterTile(size_t tile)
+	{
+		int tx = (int)(tile % this->tilesX), ty = (int)(tile / this->tilesX);
+		int x0 = tx * TileSize, y0 = ty * TileSize;
+		int x1 = std::min(x0 + TileSize, this->Width) - 1, y1 = std::min(y0 + TileSize, this->Height) - 1;
+		if (this->clearPending)
+			for (int y = y0; y <= y1; y++)
+				std::fill_n(this->pixels.data() + (size_t)y * this->pitch + x0, x1 - x0 + 1, this->clearValue);
+
+		static const RasterFunction functions[shaderVariantCount] = {
+			&SoftRasterizer::rasterTriangle<0>, &SoftRasterizer::rasterTriangle<1>, &SoftRasterizer::rasterTriangle<2>,
+			&SoftRasterizer::rasterTriangle<3>, &SoftRasterizer::rasterTriangle<4>, &SoftRasterizer::rasterTriangle<5>,
+			&SoftRasterizer::rasterTriangle<6>, &SoftRasterizer::rasterTriangle<7>, &SoftRasterizer::rasterTriangle<8>,
+			&SoftRasterizer::rasterTriangle<9>, &SoftRasterizer::rasterTriangle<10>, &SoftRasterizer::rasterTriangle<11>,
+			&SoftRasterizer::rasterTriangle<12>, &SoftRasterizer::rasterTriangle<13>, &SoftRasterizer::rasterTriangle<14>,
+			&SoftRasterizer::rasterTriangle<15>
+		};
+		for (uint32_t entry : this->bins[tile])
+		{
+			const Triangle & triangle = this->triangles[entry >> 3];
+			const Shading & shading = this->shadings[triangle.Shading];
+			(this->*functions[shading.Features])(triangle, shading, entry & 7, std::max(x0, triangle.MinX), std::max(y0, triangle.MinY),
+												 std::min(x1, triangle.MaxX), std::min(y1, triangle.MaxY));
+		}
+	}
+
+	// Треугольник в прямоугольнике [x0, x1] x [y0, y1] одной плитки; accepted - рёбра,
+	// которые проверять не нужно
+	template <unsigned Features>
+	void rasterTriangle(const Triangle & triangle, const Shading & shading, unsigned accepted, int x0, int y0, int x1, int y1)
+	{
+		// Начало плитки кратно 4, поэтому четвёрки выровнены по ней и не выходят за pitch
+		int startX = x0 & ~3;
+		const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+		const __m128 laneOffsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+		const __m128i minX = _mm_set1_epi32(x0 - 1), maxX = _mm_set1_epi32(x1 + 1);
+
+		// Рёбра, которые нужно проверять: шаг функции на 4 пикселя и смещения дорожек
+		// (пиксели 0-1 и 2-3 четвёрки)
+		int tested[3], testedCount = 0;
+		__m128d edgeLanes[3][2], edgeSteps[3];
+		for (int e = 0; e < 3; e++)
+			if (!(accepted & (1u << e)))
+			{
+				double step = (double)(triangle.A[e] * subPixelScale);
+				edgeLanes[testedCount][0] = _mm_setr_pd(0.0, step);
+				edgeLanes[testedCount][1] = _mm_setr_pd(step * 2.0, step * 3.0);
+				edgeSteps[testedCount] = _mm_set1_pd(step * 4.0);
+				tested[testedCount++] = e;
+			}
+		__m128 planeLanes[planeCount], planeSteps[planeCount];
+		for (int k = 0; k < planeCount; k++)
+		{
+			planeLanes[k] = _mm_mul_ps(_mm_set1_ps(triangle.Dx[k]), laneOffsets);
+			planeSteps[k] = _mm_set1_ps(triangle.Dx[k] * 4.0f);
+		}
+
+		for (int y = y0; y <= y1; y++)
+		{
+			uint32_t * row = this->pixels.data() + (size_t)y * this->pitch;
+			__m128d edges[3][2];
+			for (int i = 0; i < testedCount; i++)
+			{
+				__m128d start = _mm_set1_pd((double)(edgeAt(triangle, tested[i], startX, y) + triangle.Bias[tested[i]]));
+				edges[i][0] = _mm_add_pd(start, edgeLanes[i][0]);
+				edges[i][1] = _mm_add_pd(start, edgeLanes[i][1]);
+			}
+			__m128 planes[planeCount];
+			for (int k = 0; k < planeCount; k++)
+			{
+				float start = (float)(triangle.Base[k] + (double)triangle.Dx[k] * startX + (double)triangle.Dy[k] * y);
+				planes[k] = _mm_add_ps(_mm_set1_ps(start), planeLanes[k]);
+			}
+			__m128i xs = _mm_add_epi32(_mm_set1_epi32(startX), lanes);
+			const __m128i four = _mm_set1_epi32(4);
+
+			for (int x = startX; x <= x1; x += 4)
+			{
+				__m128i mask = _mm_and_si128(_mm_cmpgt_epi32(xs, minX), _mm_cmplt_epi32(xs, maxX));
+				for (int i = 0; i < testedCount; i++)
+				{
+					// Маски двух пар по 64 бита сжимаются в четыре по 32
+					__m128d low = _mm_cmpge_pd(edges[i][0], _mm_setzero_pd()), high = _mm_cmpge_pd(edges[i][1], _mm_setzero_pd());
+					__m128 inside = _mm_shuffle_ps(_mm_castpd_ps(low), _mm_castpd_ps(high), _MM_SHUFFLE(2, 0, 2, 0));
+					mask = _mm_and_si128(mask, _mm_castps_si128(inside));
+					edges[i][0] = _mm_add_pd(edges[i][0], edgeSteps[i]);
+					edges[i][1] = _mm_add_pd(edges[i][1], edgeSteps[i]);
+				}
+				if (_mm_movemask_epi8(mask))
+				{
+					__m128i color = shade<Features>(planes, shading);
+					__m128i * target = (__m128i *)(row + x);
+					__m128i old = _mm_loadu_si128(target);
+					_mm_storeu_si128(target, _mm_or_si128(_mm_and_si128(mask, color), _mm_andnot_si128(mask, old)));
+				}
+				for (int k = 0; k < planeCount; k++)
+					planes[k] = _mm_add_ps(planes[k], planeSteps[k]);
+				xs = _mm_add_epi32(xs, four);
+			}
+		}
+	}
+
+	// Фрагментный шейдер fragment_shader.frag для четырёх пикселей
+	template <unsigned Features>
+	static __m128i shade(const __m128 * planes, const Shading & shading)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		__m128 w = _mm_div_ps(one, planes[0]);
+		__m128 r = one, g = one, b = one, a = one;
+		if constexpr ((Features & FeatureTexture) != 0)
+		{
+			__m128 s = _mm_mul_ps(planes[4], w), t = _mm_mul_ps(planes[5], w);
+			sample(*shading.Textures[0], s, t, r, g, b, a);
+			if constexpr ((Features & FeatureTwoTextures) != 0)
+			{
+				// mix(first, second, 0.2)
+				__m128 r2, g2, b2, a2;
+				sample(*shading.Textures[1], s, t, r2, g2, b2, a2);
+				const __m128 amount = _mm_set1_ps(0.2f);
+				r = _mm_add_ps(r, _mm_mul_ps(_mm_sub_ps(r2, r), amount));
+				g = _mm_add_ps(g, _mm_mul_ps(_mm_sub_ps(g2, g), amount));
+				b = _mm_add_ps(b, _mm_mul_ps(_mm_sub_ps(b2, b), amount));
+				a = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(a2, a), amount));
+			}
+		}
+		if constexpr ((Features & FeatureVertexColor) != 0)
+		{
+			r = _mm_mul_ps(r, _mm_mul_ps(planes[1], w));
+			g = _mm_mul_ps(g, _mm_mul_ps(planes[2], w));
+			b = _mm_mul_ps(b, _mm_mul_ps(planes[3], w));
+		}
+		if constexpr ((Features & FeatureUniformColor) != 0)
+		{
+			r = _mm_mul_ps(r, _mm_set1_ps(shading.UniformColor[0]));
+			g = _mm_mul_ps(g, _mm_set1_ps(shading.UniformColor[1]));
+			b = _mm_mul_ps(b, _mm_set1_ps(shading.UniformColor[2]));
+			a = _mm_mul_ps(a, _mm_set1_ps(shading.UniformColor[3]));
+		}
+		return packColor(r, g, b, a);
+	}
+
+	// floor для четырёх float (в SSE2 есть только отбрасывание дробной части)
+	static __m128i floorInt(__m128 value)
+	{
+		__m128i truncated = _mm_cvttps_epi32(value);
+		__m128 back = _mm_cvtepi32_ps(truncated);
+		// Для отрицательных с дробной частью отбрасывание дало число на 1 больше
+		return _mm_add_epi32(truncated, _mm_castps_si128(_mm_cmpgt_ps(back, value)));
+	}
+
+	// Билинейная выборка с повторением (GL_LINEAR + GL_REPEAT), результат в [0, 1]
+	static void sample(const SoftTexture & texture, __m128 s, __m128 t, __m128 & r, __m128 & g, __m128 & b, __m128 & a)
+	{
+		// Повторение - дробная часть координаты; ограничение держит floor в пределах int
+		const __m128 limit = _mm_set1_ps(4194304.0f);
+		s = _mm_min_ps(_mm_max_ps(s, _mm_sub_ps(_mm_setzero_ps(), limit)), limit);
+		t = _mm_min_ps(_mm_max_ps(t, _mm_sub_ps(_mm_setzero_ps(), limit)), limit);
+		s = _mm_sub_ps(s, _mm_cvtepi32_ps(floorInt(s)));
+		t = _mm_sub_ps(t, _mm_cvtepi32_ps(floorInt(t)));
+		// Центры текселей: тексель i покрывает [i, i + 1), его центр - i + 0.5
+		__m128 u = _mm_sub_ps(_mm_mul_ps(s, _mm_set1_ps((float)texture.Width)), _mm_set1_ps(0.5f));
+		__m128 v = _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps((float)texture.Height)), _mm_set1_ps(0.5f));
+		__m128i u0 = floorInt(u), v0 = floorInt(v);
+		__m128 fu = _mm_sub_ps(u, _mm_cvtepi32_ps(u0)), fv = _mm_sub_ps(v, _mm_cvtepi32_ps(v0));
+		// Соседи за краем - с другой стороны текстуры
+		__m128i width = _mm_set1_epi32(texture.Width), height = _mm_set1_epi32(texture.Height);
+		__m128i u1 = _mm_add_epi32(u0, _mm_set1_epi32(1)), v1 = _mm_add_epi32(v0, _mm_set1_epi32(1));
+		u0 = _mm_add_epi32(u0, _mm_and_si128(_mm_cmplt_epi32(u0, _mm_setzero_si128()), width));
+		v0 = _mm_add_epi32(v0, _mm_and_si128(_mm_cmplt_epi32(v0, _mm_setzero_si128()), height));
+		u1 = _mm_sub_epi32(u1, _mm_and_si128(_mm_cmplt_epi32(_mm_sub_epi32(width, _mm_set1_epi32(1)), u1), width));
+		v1 = _mm_sub_epi32(v1, _mm_and_si128(_mm_cmplt_epi32(_mm_sub_epi32(height, _mm_set1_epi32(1)), v1), height));
+
+		// Выборка текселей - по одному, в SSE2 нет gather
+		alignas(16) int32_t x0[4], x1[4], y0[4], y1[4];
+		alignas(16) uint32_t c00[4], c10[4], c01[4], c11[4];
+		_mm_store_si128((__m128i *)x0, u0);
+		_mm_store_si128((__m128i *)x1, u1);
+		_mm_store_si128((__m128i *)y0, v0);
+		_mm_store_si128((__m128i *)y1, v1);
+		const uint32_t * texels = texture.Texels.data();
+		for (int lane = 0; lane < 4; lane++)
+		{
+			const uint32_t * row0 = texels + (size_t)y0[lane] * texture.Width;
+			const uint32_t * row1 = texels + (size_t)y1[lane] * texture.Width;
+			c00[lane] = row0[x0[lane]];
+			c10[lane] = row0[x1[lane]];
+			c01[lane] = row1[x0[lane]];
+			c11[lane] = row1[x1[lane]];
+		}
+		__m128i t00 = _mm_load_si128((const __m128i *)c00), t10 = _mm_load_si128((const __m128i *)c10);
+		__m128i t01 = _mm_load_si128((const __m128i *)c01), t11 = _mm_load_si128((const __m128i *)c11);
+		__m128 * channels[4] = { &r, &g, &b, &a };
+		const __m128i byte = _mm_set1_epi32(0xFF);
+		const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+		for (int channel = 0; channel < 4; channel++)
+		{
+			__m128 p00 = _mm_cvtepi32_ps(_mm_and_si128(t00, byte)), p10 = _mm_cvtepi32_ps(_mm_and_si128(t10, byte));
+			__m128 p01 = _mm_cvtepi32_ps(_mm_and_si128(t01, byte)), p11 = _mm_cvtepi32_ps(_mm_and_si128(t11, byte));
+			__m128 top = _mm_add_ps(p00, _mm_mul_ps(_mm_sub_ps(p10, p00), fu));
+			__m128 bottom = _mm_add_ps(p01, _mm_mul_ps(_mm_sub_ps(p11, p01), fu));
+			*channels[channel] = _mm_mul_ps(_mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), fv)), scale);
+			t00 = _mm_srli_epi32(t00, 8);
+			t10 = _mm_srli_epi32(t10, 8);
+			t01 = _mm_srli_epi32(t01, 8);
+			t11 = _mm_srli_epi32(t11, 8);
+		}
+	}
+
+	// Как при записи в GL_RGBA8: ограничение [0, 1] и округление до ближайшего
+	static __m128i packColor(__m128 r, __m128 g, __m128 b, __m128 a)
+	{
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), scale = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+		__m128i channels[4];
+		const __m128 values[4] = { r, g, b, a };
+		for (int i = 0; i < 4; i++)
+		{
+			__m128 clamped = _mm_min_ps(_mm_max_ps(values[i], zero), one);
+			channels[i] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, scale), half));
+		}
+		return _mm_or_si128(_mm_or_si128(channels[0], _mm_slli_epi32(channels[1], 8)),
+							_mm_or_si128(_mm_slli_epi32(channels[2], 16), _mm_slli_epi32(channels[3], 24)));
+	}
+};
+
+class SoftRenderer : public Renderer
+{
+	public:
+	SoftRasterizer Raster;
+
+	// threads - потоки растеризации (0 - по числу ядер)
+	explicit SoftRenderer(unsigned threads = 0) : pool(threads) {}
+
+	const char * Name() const override { return "soft"; }
+
+	bool Create(int width, int height) override { return this->Raster.Create(width, height, &this->pool); }
+
+	int CreateTexture(int width, int height, const unsigned char * rgba) override
+	{
+		if (width <= 0 || height <= 0 || !rgba)
+			return -1;
+		SoftTexture texture;
+		texture.Width = width;
+		texture.Height = height;
+		texture.Texels.resize((size_t)width * height);
+		memcpy(texture.Texels.data(), rgba, texture.Texels.size() * 4);
+		this->textures.push_back(std::move(texture));
+		return (int)this->textures.size() - 1;
+	}
+
+	void Clear(const GLfloat color[4]) override { this->Raster.Clear(color); }
+
+	void Draw(const RenderBatch & batch) override
+	{
+		this->Raster.Draw(batch, this->texture(batch.Textures[0]), this->texture(batch.Textures[1]));
+	}
+
+	void Finish() override { this->Raster.Flush(); }
+	void ReadPixels(std::vector<unsigned char> & pixels) override { this->Raster.ReadPixels(pixels); }
+	void Report(std::ostream & out) const override { this->Raster.Report(out); }
+	void Destroy() override { this->textures.clear(); }
+
+	private:
+	ThreadPool pool;
+	// Текстуры создаются до отрисовки кадра: Draw запоминает указатели на них до Flush
+	std::vector<SoftTexture> textures;
+
+	const SoftTexture * texture(int index) const
+	{
+		return index >= 0 && index < (int)this->textures.size() ? &this->textures[index] : nullptr;
+	}
+};
+
+#endif
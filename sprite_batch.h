@@ -0,0 +1,269 @@
+// Пакетная отрисовка спрайтов: один четырёхугольник (тот же формат вершин, что и в
+// hello_window.cpp: позиция, цвет, текстурные координаты) рисуется glDrawElementsInstanced
+// столько раз, сколько спрайтов в пакете. Всё, что отличает спрайты друг от друга -
+// преобразование и прямоугольник в текстуре - лежит в буфере экземпляров (instance buffer)
+// с делителем атрибутов 1, поэтому сотни тысяч спрайтов обходятся одним вызовом отрисовки.
+//
+// Буфер экземпляров - StreamBuffer (stream_buffer.h), кадр которого равен одному пакету:
+//   Orphan     - glBufferData(NULL) отдаёт драйверу старое хранилище ("сиротство"), а
+//                пакет загружается из памяти процесса, не дожидаясь GPU;
+//   Persistent - хранилище из glBufferStorage отображено один раз навсегда и разбито на
+//                три области; перед записью в область ждём её fence (OpenGL 4.4 или
+//                GL_ARB_buffer_storage, иначе используется Orphan).
+
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include <cmath>
+#include <iostream>
+
+#include <GL/glew.h>
+
+#include "gl_state.h"
+#include "stream_buffer.h"
+#include "vertex_layout.h"
+
+// Данные одного спрайта в буфере экземпляров
+struct SpriteInstance
+{
+	// Столбцы матрицы 2x2: поворот и масштаб четырёхугольника
+	GLfloat Axis[4];
+	// Центр спрайта в нормализованных координатах
+	GLfloat Position[2];
+	// Прямоугольник в текстуре: u0, v0, u1, v1
+	GLfloat UvRect[4];
+	// Слой текстурного массива (только для spriteArrayFragmentShaderSource)
+	GLfloat Layer;
+};
+
+typedef VertexLayout<VertexAttrib<3, 4, GL_FLOAT>, VertexAttrib<4, 2, GL_FLOAT>, VertexAttrib<5, 4, GL_FLOAT>,
+					 VertexAttrib<6, 1, GL_FLOAT>> SpriteInstanceLayout;
+static_assert(sizeof(SpriteInstance) == SpriteInstanceLayout::Stride, "SpriteInstance does not match its layout");
+
+// Шейдеры спрайтов. Атрибуты 0-2 совпадают с vertex_shader.vs, 3-6 - данные экземпляра.
+inline constexpr const GLchar * spriteVertexShaderSource = "#version 330 core\n"
+	"layout (location = 0) in vec3 position;\n"
+	"layout (location = 1) in vec3 color;\n"
+	"layout (location = 2) in vec2 texCoord;\n"
+	"layout (location = 3) in vec4 axis;\n"
+	"layout (location = 4) in vec2 offset;\n"
+	"layout (location = 5) in vec4 uvRect;\n"
+	"layout (location = 6) in float layer;\n"
+	"out vec3 ourColor;\n"
+	"out vec3 TexCoord;\n"
+	"void main()\n"
+	"{\n"
+	"gl_Position = vec4(mat2(axis.xy, axis.zw) * position.xy + offset, position.z, 1.0);\n"
+	"ourColor = color;\n"
+	"TexCoord = vec3(mix(uvRect.xy, uvRect.zw, texCoord), layer);\n"
+	"}\0";
+
+inline constexpr const GLchar * spriteFragmentShaderSource = "#version 330 core\n"
+	"in vec3 ourColor;\n"
+	"in vec3 TexCoord;\n"
+	"out vec4 color;\n"
+	"uniform sampler2D spriteTexture;\n"
+	"void main()\n"
+	"{\n"
+	"color = texture(spriteTexture, TexCoord.xy);\n"
+	"}\n\0";
+
+// Вариант для текстурного массива (texture_atlas.h): картинка спрайта - слой SpriteInstance::Layer
+inline constexpr const GLchar * spriteArrayFragmentShaderSource = "#version 330 core\n"
+	"in vec3 ourColor;\n"
+	"in vec3 TexCoord;\n"
+	"out vec4 color;\n"
+	"uniform sampler2DArray spriteTexture;\n"
+	"void main()\n"
+	"{\n"
+	"color = texture(spriteTexture, TexCoord);\n"
+	"}\n\0";
+
+class SpriteBatch
+{
+	public:
+	// Сколько спрайтов помещается в пакет; при переполнении Add сам вызывает Flush
+	int Capacity = 0;
+	BufferStreaming Streaming = BufferStreaming::Orphan;
+	// Счётчики с момента создания: вызовы отрисовки, спрайты и время ожидания fence
+	long long DrawCalls = 0, Instances = 0;
+	double FenceWaitMs = 0.0;
+	// Если задан, программа, VAO и uniform выставляются через трекер состояния
+	GlState * State = nullptr;
+
+	// program - программа из spriteVertexShaderSource/spriteFragmentShaderSource
+	bool Create(GLuint program, int capacity, BufferStreaming streaming)
+	{
+		this->program = program;
+		this->Capacity = capacity;
+		// Кадр потокового буфера - один пакет: каждый Flush закрывает его и ставит fence
+		GLsizeiptr packetSize = (GLsizeiptr)capacity * sizeof(SpriteInstance);
+		if (!this->instanceBuffer.Create(GL_ARRAY_BUFFER, packetSize, streaming))
+			return false;
+		this->Streaming = this->instanceBuffer.Streaming;
+		int regions = this->Streaming == BufferStreaming::Persistent ? regionCount : 1;
+
+		// Единичный четырёхугольник в формате вершин hello_window.cpp
+		const GLfloat quad[] = {
+			0.5f,  0.5f, 0.0f,		1.0f, 1.0f, 1.0f,		1.0f, 1.0f,
+			0.5f, -0.5f, 0.0f,		1.0f, 1.0f, 1.0f,		1.0f, 0.0f,
+		   -0.5f, -0.5f, 0.0f,		1.0f, 1.0f, 1.0f,		0.0f, 0.0f,
+		   -0.5f,  0.5f, 0.0f,		1.0f, 1.0f, 1.0f,		0.0f, 1.0f
+		};
+		const GLuint quadIndices[] = { 0, 1, 3, 1, 2, 3 };
+		glGenBuffers(1, &this->quadBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, this->quadBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+
+		// По VAO на каждую область буфера: смещение экземпляров зашито в указатели
+		// атрибутов, и переключение области - это просто другой glBindVertexArray
+		glGenVertexArrays(regions, this->vertexArrays);
+		glGenBuffers(1, &this->indexBuffer);
+		for (int region = 0; region < regions; region++)
+		{
+			glBindVertexArray(this->vertexArrays[region]);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->indexBuffer);
+			if (region == 0)
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quadIndices), quadIndices, GL_STATIC_DRAW);
+
+			glBindBuffer(GL_ARRAY_BUFFER, this->quadBuffer);
+			Fp32VertexLayout::Apply();
+
+			glBindBuffer(GL_ARRAY_BUFFER, this->instanceBuffer.Buffer);
+			SpriteInstanceLayout::Apply((GLintptr)region * packetSize);
+			// Атрибуты экземпляра меняются раз на экземпляр, а не раз на вершину
+			for (GLuint attribute = 3; attribute <= 6; attribute++)
+				glVertexAttribDivisor(attribute, 1);
+		}
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		if (this->State)
+			this->State->Invalidate();
+
+		this->textureLocation = glGetUniformLocation(program, "spriteTexture");
+		return true;
+	}
+
+	void Destroy()
+	{
+		int regions = this->Streaming == BufferStreaming::Persistent ? regionCount : 1;
+		if (this->vertexArrays[0])
+			glDeleteVertexArrays(regions, this->vertexArrays);
+		glDeleteBuffers(1, &this->quadBuffer);
+		glDeleteBuffers(1, &this->indexBuffer);
+		this->instanceBuffer.Destroy();
+		for (GLuint & vertexArray : this->vertexArrays)
+			vertexArray = 0;
+		this->quadBuffer = this->indexBuffer = 0;
+		this->mapped = nullptr;
+		this->count = 0;
+	}
+
+	// Добавляет спрайт. Запись идёт прямо в отображённую память буфера (Persistent)
+	// или в его копию в памяти процесса (Orphan).
+	void Add(const SpriteInstance & sprite)
+	{
+		if (!this->mapped && !this->beginPacket())
+			return;
+		this->mapped[this->count++] = sprite;
+		if (this->count == this->Capacity)
+			this->Flush();
+	}
+
+	// Спрайт с поворотом angle (радианы) и размером width x height в нормализованных координатах
+	void Add(float x, float y, float width, float height, float angle, const GLfloat uvRect[4], float layer = 0.0f)
+	{
+		float c = cosf(angle), s = sinf(angle);
+		SpriteInstance sprite = { { c * width, s * width, -s * height, c * height }, { x, y },
+								  { uvRect[0], uvRect[1], uvRect[2], uvRect[3] }, layer };
+		this->Add(sprite);
+	}
+
+	// Рисует накопленные спрайты текстурой из текстурного блока unit
+	void Flush(GLint unit = 0)
+	{
+		if (!this->mapped)
+			return;
+		// Commit (glBufferSubData для Orphan) только заполненной части и до отрисовки, fence - после
+		this->instanceBuffer.Shrink((GLsizeiptr)(this->Capacity - this->count) * sizeof(SpriteInstance));
+		this->instanceBuffer.Commit();
+		if (this->count > 0)
+		{
+			if (this->State)
+			{
+				this->State->UseProgram(this->program);
+				this->State->Uniform1i(this->textureLocation, unit);
+				this->State->BindVertexArray(this->vertexArrays[this->region]);
+				glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, this->count);
+			}
+			else
+			{
+				glUseProgram(this->program);
+				glUniform1i(this->textureLocation, unit);
+				glBindVertexArray(this->vertexArrays[this->region]);
+				glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, this->count);
+				glBindVertexArray(0);
+			}
+			this->DrawCalls++;
+			this->Instances += this->count;
+		}
+		this->instanceBuffer.EndFrame();
+		this->lastCount = this->count;
+		this->mapped = nullptr;
+		this->count = 0;
+	}
+
+	// Сколько спрайтов нарисовал последний Flush (для FrameStats::CountDraw)
+	int LastCount() const { return this->lastCount; }
+
+	private:
+	// Столько же областей, сколько у StreamBuffer в режиме Persistent
+	static const int regionCount = 3;
+
+	GLuint program = 0;
+	GLint textureLocation = -1;
+	GLuint quadBuffer = 0, indexBuffer = 0;
+	StreamBuffer instanceBuffer;
+	GLuint vertexArrays[regionCount] = { 0, 0, 0 };
+	SpriteInstance * mapped = nullptr;
+	int region = 0, count = 0, lastCount = 0;
+
+	// Начало пакета: StreamBuffer ждёт fence области (Persistent) или отдаёт хранилище
+	// драйверу (Orphan), и весь пакет выделяется одним куском
+	bool beginPacket()
+	{
+		this->instanceBuffer.BeginFrame();
+		this->FenceWaitMs = this->instanceBuffer.FenceWaitMs;
+		GLsizeiptr packetSize = this->instanceBuffer.FrameSize;
+		StreamBuffer::Allocation allocation = this->instanceBuffer.Allocate(packetSize, alignof(SpriteInstance));
+		if (!allocation.Data)
+		{
+			std::cout << "ERROR::SPRITE_BATCH::MAP_FAILED" << std::endl;
+			return false;
+		}
+		// Смещение куска выбирает область, а значит и VAO с нужными указателями атрибутов
+		this->region = (int)(allocation.Offset / packetSize);
+		this->mapped = (SpriteInstance *)allocation.Data;
+		return true;
+	}
+};
+
+// Тестовая сцена: count вращающихся спрайтов сеткой на весь экран. Каждый берёт одну
+// из четвертей текстуры, чтобы было видно, что прямоугольники в текстуре работают.
+inline void addSpriteGrid(SpriteBatch & batch, int count, float time)
+{
+	int columns = (int)ceilf(sqrtf((float)count));
+	float cell = 2.0f / columns;
+	const GLfloat quarters[4][4] = {
+		{ 0.0f, 0.0f, 0.5f, 0.5f }, { 0.5f, 0.0f, 1.0f, 0.5f },
+		{ 0.0f, 0.5f, 0.5f, 1.0f }, { 0.5f, 0.5f, 1.0f, 1.0f }
+	};
+	for (int i = 0; i < count; i++)
+	{
+		float x = -1.0f + cell * (i % columns + 0.5f);
+		float y = -1.0f + cell * (i / columns + 0.5f);
+		batch.Add(x, y, cell * 0.7f, cell * 0.7f, time + i * 0.01f, quarters[i & 3]);
+	}
+}
+
+#endif
@@ -0,0 +1,213 @@
+// Потоковый буфер для геометрии, которая меняется каждый кадр (частицы, интерфейс).
+// Кольцевой распределитель: Allocate отдаёт кусок памяти под данные текущего кадра и
+// смещение этого куска в буфере OpenGL, из которого потом рисуют.
+//
+// Persistent - хранилище glBufferStorage отображено один раз (PERSISTENT | COHERENT) и
+//              разбито на три области по кадрам. В конце кадра на область ставится fence,
+//              и перед повторным использованием области через два кадра CPU ждёт его, так что
+//              данные, которые GPU ещё читает, никогда не перезаписываются.
+// Orphan     - запасной путь без OpenGL 4.4 / GL_ARB_buffer_storage. Кадр пишется в память
+//              процесса, а Commit загружает написанное через glBufferSubData; в начале кадра
+//              glBufferData(NULL) отдаёт старое хранилище драйверу ("сиротство"), поэтому
+//              ожидания GPU нет и здесь.
+//
+// Перед отрисовкой из выделенных кусков нужно вызвать Commit (для Persistent он ничего не делает).
+
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <GL/glew.h>
+
+enum class BufferStreaming { Orphan, Persistent };
+
+inline const char * bufferStreamingName(BufferStreaming streaming)
+{
+	return streaming == BufferStreaming::Persistent ? "persistent" : "orphan";
+}
+
+inline bool bufferStorageSupported()
+{
+	return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+class StreamBuffer
+{
+	public:
+	// Кусок буфера, выделенный в текущем кадре
+	struct Allocation
+	{
+		void * Data;
+		// Смещение в буфере OpenGL (для glVertexAttribPointer, glDrawArrays и т.п.)
+		GLintptr Offset;
+	};
+
+	BufferStreaming Streaming = BufferStreaming::Orphan;
+	GLuint Buffer = 0;
+	// Сколько байт можно выделить за кадр
+	GLsizeiptr FrameSize = 0;
+	// Статистика: байты за последний кадр и всего, время ожидания fence, неудачные выделения
+	GLsizeiptr FrameBytes = 0;
+	long long TotalBytes = 0, Overflows = 0;
+	double FenceWaitMs = 0.0;
+
+	bool Create(GLenum target, GLsizeiptr frameSize, BufferStreaming streaming)
+	{
+		this->target = target;
+		this->FrameSize = frameSize;
+		this->Streaming = streaming;
+		if (streaming == BufferStreaming::Persistent && !bufferStorageSupported())
+		{
+			std::cout << "WARNING::STREAM_BUFFER::NO_BUFFER_STORAGE falling back to orphan" << std::endl;
+			this->Streaming = BufferStreaming::Orphan;
+		}
+
+		glGenBuffers(1, &this->Buffer);
+		glBindBuffer(target, this->Buffer);
+		if (this->Streaming == BufferStreaming::Persistent)
+		{
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(target, frameSize * regionCount, NULL, flags);
+			this->mapped = (unsigned char *)glMapBufferRange(target, 0, frameSize * regionCount, flags);
+			if (!this->mapped)
+			{
+				std::cout << "ERROR::STREAM_BUFFER::PERSISTENT_MAP_FAILED" << std::endl;
+				glBindBuffer(target, 0);
+				this->Destroy();
+				return false;
+			}
+		}
+		else
+		{
+			glBufferData(target, frameSize, NULL, GL_STREAM_DRAW);
+			this->staging.resize(frameSize);
+		}
+		glBindBuffer(target, 0);
+		return true;
+	}
+
+	void Destroy()
+	{
+		if (this->mapped)
+		{
+			glBindBuffer(this->target, this->Buffer);
+			glUnmapBuffer(this->target);
+			glBindBuffer(this->target, 0);
+			this->mapped = nullptr;
+		}
+		for (GLsync & fence : this->fences)
+		{
+			if (fence)
+				glDeleteSync(fence);
+			fence = 0;
+		}
+		glDeleteBuffers(1, &this->Buffer);
+		this->Buffer = 0;
+		std::vector<unsigned char>().swap(this->staging);
+	}
+
+	// Начало кадра: ожидание области (Persistent) или сиротство хранилища (Orphan)
+	void BeginFrame()
+	{
+		this->cursor = 0;
+		this->committed = 0;
+		this->FrameBytes = 0;
+		if (this->Streaming == BufferStreaming::Persistent)
+		{
+			GLsync & fence = this->fences[this->region];
+			if (fence)
+			{
+				auto start = std::chrono::steady_clock::now();
+				GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+				while (status == GL_TIMEOUT_EXPIRED)
+					status = glClientWaitSync(fence, 0, 1000000000);
+				glDeleteSync(fence);
+				fence = 0;
+				this->FenceWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			}
+			return;
+		}
+		glBindBuffer(this->target, this->Buffer);
+		glBufferData(this->target, this->FrameSize, NULL, GL_STREAM_DRAW);
+		glBindBuffer(this->target, 0);
+	}
+
+	// Кусок из size байт с началом, кратным alignment. Data == nullptr, если место в кадре кончилось.
+	Allocation Allocate(GLsizeiptr size, GLsizeiptr alignment = 4)
+	{
+		GLsizeiptr start = (this->cursor + alignment - 1) / alignment * alignment;
+		if (start + size > this->FrameSize)
+		{
+			this->Overflows++;
+			return { nullptr, 0 };
+		}
+		this->cursor = start + size;
+		this->FrameBytes += size;
+		this->TotalBytes += size;
+		if (this->Streaming == BufferStreaming::Persistent)
+		{
+			GLintptr offset = (GLintptr)this->region * this->FrameSize + start;
+			return { this->mapped + offset, offset };
+		}
+		return { this->staging.data() + start, (GLintptr)start };
+	}
+
+	// Возвращает неиспользованный хвост последнего выделения (кусок выделен с запасом,
+	// а заполнен не до конца): Commit не будет его загружать
+	void Shrink(GLsizeiptr bytes)
+	{
+		bytes = std::min(bytes, this->cursor - this->committed);
+		this->cursor -= bytes;
+		this->FrameBytes -= bytes;
+		this->TotalBytes -= bytes;
+	}
+
+	// Делает выделенные с прошлого Commit данные видимыми для GPU
+	void Commit()
+	{
+		if (this->Streaming == BufferStreaming::Orphan && this->cursor > this->committed)
+		{
+			glBindBuffer(this->target, this->Buffer);
+			glBufferSubData(this->target, this->committed, this->cursor - this->committed, this->staging.data() + this->committed);
+			glBindBuffer(this->target, 0);
+		}
+		this->committed = this->cursor;
+	}
+
+	// Конец кадра: fence на область, которую будут читать команды этого кадра
+	void EndFrame()
+	{
+		this->Commit();
+		if (this->Streaming != BufferStreaming::Persistent)
+			return;
+		this->fences[this->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		this->region = (this->region + 1) % regionCount;
+	}
+
+	void Report(std::ostream & out, const char * label) const
+	{
+		out << std::fixed << std::setprecision(3)
+			<< label << " streaming=" << bufferStreamingName(this->Streaming)
+			<< " frame_size=" << this->FrameSize
+			<< " total_bytes=" << this->TotalBytes
+			<< " overflows=" << this->Overflows
+			<< " fence_wait_ms=" << this->FenceWaitMs << std::endl;
+	}
+
+	private:
+	static const int regionCount = 3;
+
+	GLenum target = GL_ARRAY_BUFFER;
+	unsigned char * mapped = nullptr;
+	std::vector<unsigned char> staging;
+	GLsync fences[regionCount] = { 0, 0, 0 };
+	int region = 0;
+	GLsizeiptr cursor = 0, committed = 0;
+};
+
+#endif
@@ -0,0 +1,76 @@
+// Процедурные текстуры для сверки с эталонами (--test-textures, make test): вместо
+// pics/container.jpg - клетка с градиентом и сеткой в один тексель, вместо
+// pics/awesomeface.png - цветные кольца. Тонкие детали выдают ошибки выборки и мипмапов,
+// а картинка не зависит от того, есть ли pics/ и что в нём лежит.
+// Для OpenGL текстуры пишутся во временные файлы .gtex с готовой цепочкой мипмапов и
+// загружаются тем же путём, что подготовленные make textures картинки.
+
+#ifndef TEST_TEXTURES_H
+#define TEST_TEXTURES_H
+
+#include <cmath>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "mipmap.h"
+#include "texture_file.h"
+
+static const int testTextureCount = 2;
+
+// Пиксели RGBA8 текстуры index: 0 - вместо контейнера (1024x1024), 1 - вместо смайлика (512x512)
+inline void makeTestTexture(int index, int & width, int & height, std::vector<unsigned char> & rgba)
+{
+	width = height = index == 0 ? 1024 : 512;
+	rgba.resize((size_t)width * height * 4);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+		{
+			unsigned char * texel = &rgba[((size_t)y * width + x) * 4];
+			if (index == 0)
+			{
+				bool checker = ((x / 64) ^ (y / 64)) & 1;
+				bool line = x % 128 == 0 || y % 128 == 0;
+				texel[0] = (unsigned char)(line ? 255 : checker ? 200 : 60 + x / 8);
+				texel[1] = (unsigned char)(line ? 255 : checker ? 140 : 30 + y / 8);
+				texel[2] = (unsigned char)(line ? 255 : checker ? 60 : 40);
+			}
+			else
+			{
+				float dx = x - width * 0.5f, dy = y - height * 0.5f;
+				int ring = (int)(sqrtf(dx * dx + dy * dy) / 24.0f);
+				bool stripe = ((x + y) / 16) & 1;
+				texel[0] = (unsigned char)(ring & 1 ? 240 : 30);
+				texel[1] = (unsigned char)(ring & 2 ? 200 : 70);
+				texel[2] = (unsigned char)(stripe ? 220 : 90);
+			}
+			texel[3] = 255;
+		}
+}
+
+// Путь, по которому writeTestTexture пишет текстуру index
+inline std::string testTexturePath(int index)
+{
+	return (std::filesystem::temp_directory_path() / ("hello_window_test_" + std::to_string(index) + ".gtex")).string();
+}
+
+// Текстура index с мипмапами в файл testTexturePath(index)
+inline bool writeTestTexture(int index)
+{
+	int width, height;
+	std::vector<unsigned char> rgba;
+	makeTestTexture(index, width, height, rgba);
+	MipChain chain;
+	buildMipChain(rgba.data(), width, height, MipOptions(), chain);
+	std::vector<TextureFileLevel> levels;
+	std::vector<const unsigned char *> data;
+	for (int level = 0; level < (int)chain.Levels.size(); level++)
+	{
+		const MipChain::Level & info = chain.Levels[level];
+		levels.push_back({ (uint32_t)info.Width, (uint32_t)info.Height, 0, chain.LevelSize(level) });
+		data.push_back(chain.Pixels(level));
+	}
+	return writeTextureFile(testTexturePath(index), TextureFileFormat::RGBA8, 0, levels, data);
+}
+
+#endif
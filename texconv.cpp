@@ -0,0 +1,92 @@
+// Подготовка текстур заранее: картинка -> файл .gtex с готовой цепочкой мипмапов,
+// при желании сжатой в BC1/BC3/ETC2. Загрузчик (texture_loader.h) отображает такой
+// файл в память и отдаёт уровни драйверу без декодирования.
+// texconv <картинка> <выход.gtex> [--format rgba8|bc1|bc3|etc2] [--filter box|kaiser] [--srgb]
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <SOIL/SOIL.h>
+
+#include "mipmap.h"
+#include "texture_compress.h"
+#include "texture_file.h"
+
+static int usage()
+{
+	std::cout << "Usage: texconv <image> <output.gtex> [--format rgba8|bc1|bc3|etc2] [--filter box|kaiser] [--srgb]" << std::endl;
+	return -1;
+}
+
+int main(int argc, char ** argv)
+{
+	if (argc < 3)
+		return usage();
+	std::string input = argv[1], output = argv[2];
+	TextureFileFormat format = TextureFileFormat::RGBA8;
+	MipOptions options;
+	for (int i = 3; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (argument == "--format" && i + 1 < argc)
+		{
+			std::string name = argv[++i];
+			if (name == "rgba8") format = TextureFileFormat::RGBA8;
+			else if (name == "bc1") format = TextureFileFormat::BC1;
+			else if (name == "bc3") format = TextureFileFormat::BC3;
+			else if (name == "etc2") format = TextureFileFormat::ETC2_RGB8;
+			else return usage();
+		}
+		else if (argument == "--filter" && i + 1 < argc)
+		{
+			std::string name = argv[++i];
+			if (name == "box") options.Filter = MipFilter::Box;
+			else if (name == "kaiser") options.Filter = MipFilter::Kaiser;
+			else return usage();
+		}
+		else if (argument == "--srgb")
+			options.Srgb = true;
+		else
+			return usage();
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	int width, height;
+	unsigned char * pixels = SOIL_load_image(input.c_str(), &width, &height, 0, SOIL_LOAD_RGBA);
+	if (!pixels)
+	{
+		std::cout << "ERROR::TEXCONV::LOAD_FAILED " << input << std::endl;
+		return -1;
+	}
+	MipChain chain;
+	buildMipChain(pixels, width, height, options, chain);
+	SOIL_free_image_data(pixels);
+
+	std::vector<std::vector<unsigned char>> encoded(chain.Levels.size());
+	std::vector<TextureFileLevel> levels;
+	std::vector<const unsigned char *> data;
+	for (size_t level = 0; level < chain.Levels.size(); level++)
+	{
+		const MipChain::Level & info = chain.Levels[level];
+		encodeTextureLevel(format, chain.Data.data() + info.Offset, info.Width, info.Height, encoded[level]);
+		levels.push_back({ (uint32_t)info.Width, (uint32_t)info.Height, 0, encoded[level].size() });
+		data.push_back(encoded[level].data());
+	}
+	if (!writeTextureFile(output, format, options.Srgb ? textureFileSrgbFiltered : 0, levels, data))
+		return -1;
+
+	size_t bytes = 0;
+	for (const TextureFileLevel & level : levels)
+		bytes += level.Size;
+	std::cout << std::fixed << std::setprecision(3)
+			  << "texconv input=" << input << " output=" << output
+			  << " format=" << textureFileFormatName(format)
+			  << " size=" << width << "x" << height << " levels=" << levels.size() << " bytes=" << bytes
+			  << " ms=" << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+			  << std::endl;
+	return 0;
+}
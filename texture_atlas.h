@@ -0,0 +1,462 @@
+// Текстурный атлас и текстурный массив: два способа рисовать спрайты с разными картинками
+// одним вызовом отрисовки вместо смены текстуры на каждую картинку.
+//
+// Атлас - картинки, разложенные по одной большой текстуре. Раскладку делает AtlasPacker
+// одним из двух алгоритмов:
+//   Skyline  - "линия горизонта": прямоугольник ставится как можно ниже на верхнюю границу
+//              уже занятого; быстро, но под выступами остаются пустоты;
+//   MaxRects - список максимальных свободных прямоугольников, выбор по наименьшему
+//              остатку короткой стороны (Best Short Side Fit); плотнее, но медленнее.
+// Вокруг картинок оставляется поле (padding), заполненное крайними пикселями: иначе
+// билинейная фильтрация и мипмапы подмешивают соседние картинки. Таблица пересчёта UV
+// (имя -> прямоугольник в атласе) сохраняется рядом с атласом в текстовом файле .atlas.
+//
+// Текстурный массив (GL_TEXTURE_2D_ARRAY) - слои одного размера; картинки приводятся к
+// нему билинейной интерполяцией. Полей и пересчёта UV не нужно, номер слоя идёт в спрайт.
+
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+enum class AtlasPacking { Skyline, MaxRects };
+
+inline const char * atlasPackingName(AtlasPacking packing)
+{
+	return packing == AtlasPacking::MaxRects ? "maxrects" : "skyline";
+}
+
+struct AtlasRect
+{
+	int X, Y, Width, Height;
+};
+
+// Раскладка прямоугольников в области Width x Height
+class AtlasPacker
+{
+	public:
+	int Width = 0, Height = 0;
+	AtlasPacking Packing = AtlasPacking::Skyline;
+	// Площадь, занятая вставленными прямоугольниками
+	long long UsedArea = 0;
+
+	void Init(int width, int height, AtlasPacking packing)
+	{
+		this->Width = width;
+		this->Height = height;
+		this->Packing = packing;
+		this->UsedArea = 0;
+		this->skyline.assign(1, { 0, 0, width });
+		this->freeRects.assign(1, { 0, 0, width, height });
+	}
+
+	// Место под прямоугольник width x height; false, если он не помещается
+	bool Insert(int width, int height, AtlasRect & placed)
+	{
+		bool found = this->Packing == AtlasPacking::MaxRects ? this->insertMaxRects(width, height, placed)
+															  : this->insertSkyline(width, height, placed);
+		if (found)
+			this->UsedArea += (long long)width * height;
+		return found;
+	}
+
+	double Occupancy() const
+	{
+		return this->Width && this->Height ? (double)this->UsedArea / ((double)this->Width * this->Height) : 0.0;
+	}
+
+	private:
+	struct SkylineNode
+	{
+		int X, Y, Width;
+	};
+
+	std::vector<SkylineNode> skyline;
+	std::vector<AtlasRect> freeRects;
+
+	// Высота, на которую встанет прямоугольник шириной width, если его левый край - узел index
+	int skylineFit(size_t index, int width, int height) const
+	{
+		int x = this->skyline[index].X;
+		if (x + width > this->Width)
+			return -1;
+		int y = 0, remaining = width;
+		for (size_t i = index; remaining > 0; i++)
+		{
+			if (i == this->skyline.size())
+				return -1;
+			y = std::max(y, this->skyline[i].Y);
+			if (y + height > this->Height)
+				return -1;
+			remaining -= this->skyline[i].Width;
+		}
+		return y;
+	}
+
+	bool insertSkyline(int width, int height, AtlasRect & placed)
+	{
+		// Самое низкое положение, при равенстве - самый узкий узел
+		int bestY = INT_MAX, bestWidth = INT_MAX;
+		size_t bestIndex = 0;
+		for (size_t i = 0; i < this->skyline.size(); i++)
+		{
+			int y = this->skylineFit(i, width, height);
+			if (y < 0)
+				continue;
+			if (y + height < bestY || (y + height == bestY && this->skyline[i].Width < bestWidth))
+			{
+				bestY = y + height;
+				bestWidth = this->skyline[i].Width;
+				bestIndex = i;
+			}
+		}
+		if (bestY == INT_MAX)
+			return false;
+		placed = { this->skyline[bestIndex].X, bestY - height, width, height };
+
+		// Новый узел над прямоугольником; узлы под ним укорачиваются или исчезают
+		this->skyline.insert(this->skyline.begin() + bestIndex, { placed.X, bestY, width });
+		for (size_t i = bestIndex + 1; i < this->skyline.size();)
+		{
+			SkylineNode & node = this->skyline[i];
+			int covered = placed.X + width - node.X;
+			if (covered <= 0)
+				break;
+			if (covered < node.Width)
+			{
+				node.X += covered;
+				node.Width -= covered;
+				break;
+			}
+			this->skyline.erase(this->skyline.begin() + i);
+		}
+		// Соседние узлы одной высоты сливаются
+		for (size_t i = 0; i + 1 < this->skyline.size();)
+		{
+			if (this->skyline[i].Y == this->skyline[i + 1].Y)
+			{
+				this->skyline[i].Width += this->skyline[i + 1].Width;
+				this->skyline.erase(this->skyline.begin() + i + 1);
+			}
+			else
+				i++;
+		}
+		return true;
+	}
+
+	bool insertMaxRects(int width, int height, AtlasRect & placed)
+	{
+		int bestShort = INT_MAX, bestLong = INT_MAX;
+		for (const AtlasRect & free : this->freeRects)
+		{
+			if (free.Width < width || free.Height < height)
+				continue;
+			int leftoverX = free.Width - width, leftoverY = free.Height - height;
+			int shortSide = std::min(leftoverX, leftoverY), longSide = std::max(leftoverX, leftoverY);
+			if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong))
+			{
+				bestShort = shortSide;
+				bestLong = longSide;
+				placed = { free.X, free.Y, width, height };
+			}
+		}
+		if (bestShort == INT_MAX)
+			return false;
+
+		// Каждый свободный прямоугольник, задетый новым, распадается на до четырёх частей
+		std::vector<AtlasRect> split;
+		for (size_t i = 0; i < this->freeRects.size();)
+		{
+			AtlasRect free = this->freeRects[i];
+			if (placed.X >= free.X + free.Width || placed.X + placed.Width <= free.X ||
+				placed.Y >= free.Y + free.Height || placed.Y + placed.Height <= free.Y)
+			{
+				i++;
+				continue;
+			}
+			if (placed.X > free.X)
+				split.push_back({ free.X, free.Y, placed.X - free.X, free.Height });
+			if (placed.X + placed.Width < free.X + free.Width)
+				split.push_back({ placed.X + placed.Width, free.Y, free.X + free.Width - placed.X - placed.Width, free.Height });
+			if (placed.Y > free.Y)
+				split.push_back({ free.X, free.Y, free.Width, placed.Y - free.Y });
+			if (placed.Y + placed.Height < free.Y + free.Height)
+				split.push_back({ free.X, placed.Y + placed.Height, free.Width, free.Y + free.Height - placed.Y - placed.Height });
+			this->freeRects[i] = this->freeRects.back();
+			this->freeRects.pop_back();
+		}
+		this->freeRects.insert(this->freeRects.end(), split.begin(), split.end());
+
+		// Прямоугольники, целиком лежащие внутри других, не нужны
+		for (size_t i = 0; i < this->freeRects.size(); i++)
+			for (size_t j = i + 1; j < this->freeRects.size(); j++)
+			{
+				if (contains(this->freeRects[j], this->freeRects[i]))
+				{
+					this->freeRects.erase(this->freeRects.begin() + i);
+					i--;
+					break;
+				}
+				if (contains(this->freeRects[i], this->freeRects[j]))
+				{
+					this->freeRects.erase(this->freeRects.begin() + j);
+					j--;
+				}
+			}
+		return true;
+	}
+
+	static bool contains(const AtlasRect & outer, const AtlasRect & inner)
+	{
+		return inner.X >= outer.X && inner.Y >= outer.Y && inner.X + inner.Width <= outer.X + outer.Width &&
+			   inner.Y + inner.Height <= outer.Y + outer.Height;
+	}
+};
+
+// Картинка для атласа или массива: RGBA, строки подряд (порядок строк сохраняется как есть)
+struct AtlasImage
+{
+	std::string Name;
+	int Width, Height;
+	const unsigned char * Rgba;
+};
+
+// Место картинки в атласе: прямоугольник в пикселях и он же в текстурных координатах
+struct AtlasEntry
+{
+	std::string Name;
+	AtlasRect Rect;
+	GLfloat UvRect[4];
+};
+
+class TextureAtlas
+{
+	public:
+	int Width = 0, Height = 0;
+	double Occupancy = 0.0;
+	std::vector<unsigned char> Pixels;
+	// В порядке исходных картинок
+	std::vector<AtlasEntry> Entries;
+
+	// Раскладка картинок в атлас со сторонами степени двойки (ширина равна высоте или вдвое
+	// больше), не больше maxSize. Размер подбирается от наименьшего, в который может
+	// поместиться суммарная площадь.
+	bool Build(const std::vector<AtlasImage> & images, int maxSize, AtlasPacking packing, int padding = 2)
+	{
+		// Высокие картинки первыми: оба алгоритма раскладывают так плотнее
+		std::vector<size_t> order(images.size());
+		long long area = 0;
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			order[i] = i;
+			area += (long long)(images[i].Width + 2 * padding) * (images[i].Height + 2 * padding);
+		}
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+			return std::max(images[a].Width, images[a].Height) > std::max(images[b].Width, images[b].Height);
+		});
+
+		// Кандидаты по возрастанию площади: w x w/2, затем w x w
+		int width = 1, height = 1;
+		while ((long long)width * width < area)
+			width *= 2;
+		height = std::max(width / 2, 1);
+		AtlasPacker packer;
+		std::vector<AtlasRect> rects(images.size());
+		bool fits = false;
+		while (!fits && width <= maxSize)
+		{
+			packer.Init(width, height, packing);
+			fits = true;
+			for (size_t index : order)
+				if (!packer.Insert(images[index].Width + 2 * padding, images[index].Height + 2 * padding, rects[index]))
+				{
+					fits = false;
+					break;
+				}
+			if (fits)
+				break;
+			if (height < width)
+				height = width;
+			else
+			{
+				width *= 2;
+				height = width / 2;
+			}
+		}
+		if (!fits)
+		{
+			std::cout << "ERROR::TEXTURE_ATLAS::DOES_NOT_FIT max_size=" << maxSize << std::endl;
+			return false;
+		}
+
+		this->Width = width;
+		this->Height = height;
+		this->Occupancy = packer.Occupancy();
+		this->Pixels.assign((size_t)width * height * 4, 0);
+		this->Entries.resize(images.size());
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			const AtlasImage & image = images[i];
+			AtlasRect rect = { rects[i].X + padding, rects[i].Y + padding, image.Width, image.Height };
+			// Поле заполняется ближайшими пикселями картинки
+			for (int y = -padding; y < image.Height + padding; y++)
+			{
+				int sourceY = std::min(std::max(y, 0), image.Height - 1);
+				for (int x = -padding; x < image.Width + padding; x++)
+				{
+					int sourceX = std::min(std::max(x, 0), image.Width - 1);
+					const unsigned char * source = image.Rgba + ((size_t)sourceY * image.Width + sourceX) * 4;
+					unsigned char * target = this->Pixels.data() + ((size_t)(rect.Y + y) * width + rect.X + x) * 4;
+					std::copy(source, source + 4, target);
+				}
+			}
+			AtlasEntry & entry = this->Entries[i];
+			entry.Name = image.Name;
+			entry.Rect = rect;
+			entry.UvRect[0] = (GLfloat)rect.X / width;
+			entry.UvRect[1] = (GLfloat)rect.Y / height;
+			entry.UvRect[2] = (GLfloat)(rect.X + rect.Width) / width;
+			entry.UvRect[3] = (GLfloat)(rect.Y + rect.Height) / height;
+		}
+		return true;
+	}
+
+	const AtlasEntry * Find(const std::string & name) const
+	{
+		for (const AtlasEntry & entry : this->Entries)
+			if (entry.Name == name)
+				return &entry;
+		return nullptr;
+	}
+
+	// Таблица пересчёта UV: первая строка "atlas ширина высота", затем
+	// "имя x y ширина высота u0 v0 u1 v1" на картинку (имена без пробелов)
+	bool WriteRemapTable(const std::string & path) const
+	{
+		std::ofstream file(path);
+		if (!file)
+		{
+			std::cout << "ERROR::TEXTURE_ATLAS::WRITE_FAILED " << path << std::endl;
+			return false;
+		}
+		file << "atlas " << this->Width << " " << this->Height << "\n";
+		file.precision(9);
+		for (const AtlasEntry & entry : this->Entries)
+			file << entry.Name << " " << entry.Rect.X << " " << entry.Rect.Y << " " << entry.Rect.Width << " " << entry.Rect.Height
+				 << " " << entry.UvRect[0] << " " << entry.UvRect[1] << " " << entry.UvRect[2] << " " << entry.UvRect[3] << "\n";
+		return (bool)file;
+	}
+
+	// Чтение таблицы для атласа, собранного заранее (пиксели грузятся отдельно, из .gtex)
+	bool ReadRemapTable(const std::string & path)
+	{
+		std::ifstream file(path);
+		std::string header;
+		if (!(file >> header >> this->Width >> this->Height) || header != "atlas")
+		{
+			std::cout << "ERROR::TEXTURE_ATLAS::BAD_REMAP_TABLE " << path << std::endl;
+			return false;
+		}
+		this->Entries.clear();
+		AtlasEntry entry;
+		while (file >> entry.Name >> entry.Rect.X >> entry.Rect.Y >> entry.Rect.Width >> entry.Rect.Height
+					>> entry.UvRect[0] >> entry.UvRect[1] >> entry.UvRect[2] >> entry.UvRect[3])
+			this->Entries.push_back(entry);
+		return true;
+	}
+
+	// Текстура из Pixels; у мипмапов поле тоже уменьшается, так что на мелких уровнях
+	// соседние картинки всё же начинают смешиваться - число уровней стоит ограничивать
+	GLuint Upload(bool mipmaps) const
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, this->Width, this->Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, this->Pixels.data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		if (mipmaps)
+		{
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		}
+		else
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return texture;
+	}
+};
+
+// Билинейное приведение RGBA картинки к размеру width x height
+inline void resampleRgba(const AtlasImage & image, int width, int height, unsigned char * out)
+{
+	for (int y = 0; y < height; y++)
+	{
+		float sourceY = std::max((y + 0.5f) * image.Height / height - 0.5f, 0.0f);
+		int y0 = std::min((int)sourceY, image.Height - 1), y1 = std::min(y0 + 1, image.Height - 1);
+		float fy = sourceY - y0;
+		for (int x = 0; x < width; x++)
+		{
+			float sourceX = std::max((x + 0.5f) * image.Width / width - 0.5f, 0.0f);
+			int x0 = std::min((int)sourceX, image.Width - 1), x1 = std::min(x0 + 1, image.Width - 1);
+			float fx = sourceX - x0;
+			const unsigned char * p00 = image.Rgba + ((size_t)y0 * image.Width + x0) * 4;
+			const unsigned char * p01 = image.Rgba + ((size_t)y0 * image.Width + x1) * 4;
+			const unsigned char * p10 = image.Rgba + ((size_t)y1 * image.Width + x0) * 4;
+			const unsigned char * p11 = image.Rgba + ((size_t)y1 * image.Width + x1) * 4;
+			for (int c = 0; c < 4; c++)
+			{
+				float top = p00[c] + (p01[c] - p00[c]) * fx;
+				float bottom = p10[c] + (p11[c] - p10[c]) * fx;
+				out[((size_t)y * width + x) * 4 + c] = (unsigned char)lrintf(top + (bottom - top) * fy);
+			}
+		}
+	}
+}
+
+// Текстурный массив из картинок: слой i - картинка i, приведённая к layerWidth x layerHeight.
+// Возвращает 0, если слоёв больше, чем позволяет реализация.
+inline GLuint buildTextureArray(const std::vector<AtlasImage> & images, int layerWidth, int layerHeight, bool mipmaps)
+{
+	GLint maxLayers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	if ((GLint)images.size() > maxLayers)
+	{
+		std::cout << "ERROR::TEXTURE_ATLAS::TOO_MANY_LAYERS " << images.size() << " > " << maxLayers << std::endl;
+		return 0;
+	}
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, layerWidth, layerHeight, (GLsizei)images.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	std::vector<unsigned char> layer((size_t)layerWidth * layerHeight * 4);
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		const unsigned char * pixels = images[i].Rgba;
+		if (images[i].Width != layerWidth || images[i].Height != layerHeight)
+		{
+			resampleRgba(images[i], layerWidth, layerHeight, layer.data());
+			pixels = layer.data();
+		}
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)i, layerWidth, layerHeight, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (mipmaps)
+	{
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	}
+	else
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	return texture;
+}
+
+#endif
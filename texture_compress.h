@@ -0,0 +1,394 @@
+// Блочное сжатие текстур для утилиты texconv: BC1 (DXT1), BC3 (DXT5) и ETC2 RGB8.
+// Кодировщики простые, но быстрые: конечные точки BC ищутся по главной оси цветов
+// блока, а для ETC2 используются режимы individual/differential (это подмножество
+// ETC1, которое любой декодер ETC2 читает одинаково). Декодеры BC1/BC3 нужны
+// загрузчику на драйверах без GL_EXT_texture_compression_s3tc.
+
+#ifndef TEXTURE_COMPRESS_H
+#define TEXTURE_COMPRESS_H
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "texture_file.h"
+
+// ---------------------------------------------------------------------------------------
+// BC1 / BC3
+
+inline uint16_t packRgb565(const float color[3])
+{
+	int r = (int)(std::min(255.0f, std::max(0.0f, color[0])) * 31.0f / 255.0f + 0.5f);
+	int g = (int)(std::min(255.0f, std::max(0.0f, color[1])) * 63.0f / 255.0f + 0.5f);
+	int b = (int)(std::min(255.0f, std::max(0.0f, color[2])) * 31.0f / 255.0f + 0.5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+inline void unpackRgb565(uint16_t packed, int color[3])
+{
+	int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+// Цветовая часть блока BC1/BC3 (8 байт). block - 16 пикселей RGBA8 построчно.
+// Всегда используется режим четырёх цветов (color0 > color1).
+inline void encodeBcColorBlock(const unsigned char * block, unsigned char * out)
+{
+	// Среднее и ковариация цветов блока
+	float mean[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 3; c++)
+			mean[c] += block[i * 4 + c] / 16.0f;
+	float covariance[6] = { 0, 0, 0, 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		float d[3] = { block[i * 4] - mean[0], block[i * 4 + 1] - mean[1], block[i * 4 + 2] - mean[2] };
+		covariance[0] += d[0] * d[0]; covariance[1] += d[0] * d[1]; covariance[2] += d[0] * d[2];
+		covariance[3] += d[1] * d[1]; covariance[4] += d[1] * d[2]; covariance[5] += d[2] * d[2];
+	}
+
+	// Главная ось - степенным методом
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[3] = {
+			covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+			covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+			covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2] };
+		float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+		if (length < 1e-6f)
+			break;
+		for (int c = 0; c < 3; c++)
+			axis[c] = next[c] / length;
+	}
+
+	// Крайние проекции на ось задают конечные точки
+	float low = 0.0f, high = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+		for (int c = 0; c < 3; c++)
+			t += (block[i * 4 + c] - mean[c]) * axis[c];
+		low = std::min(low, t);
+		high = std::max(high, t);
+	}
+	float end0[3], end1[3];
+	for (int c = 0; c < 3; c++)
+	{
+		end0[c] = mean[c] + axis[c] * high;
+		end1[c] = mean[c] + axis[c] * low;
+	}
+	uint16_t color0 = packRgb565(end0), color1 = packRgb565(end1);
+	if (color0 < color1)
+		std::swap(color0, color1);
+
+	uint32_t indices = 0;
+	if (color0 != color1)
+	{
+		int palette[4][3];
+		unpackRgb565(color0, palette[0]);
+		unpackRgb565(color1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, bestError = INT_MAX;
+			for (int p = 0; p < 4; p++)
+			{
+				int error = 0;
+				for (int c = 0; c < 3; c++)
+					error += (block[i * 4 + c] - palette[p][c]) * (block[i * 4 + c] - palette[p][c]);
+				if (error < bestError)
+				{
+					bestError = error;
+					best = p;
+				}
+			}
+			indices |= (uint32_t)best << (2 * i);
+		}
+	}
+
+	out[0] = color0 & 0xFF; out[1] = color0 >> 8;
+	out[2] = color1 & 0xFF; out[3] = color1 >> 8;
+	for (int i = 0; i < 4; i++)
+		out[4 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+// Альфа-часть блока BC3 (8 байт): две опорные альфы и 3-битные индексы
+inline void encodeBc3AlphaBlock(const unsigned char * block, unsigned char * out)
+{
+	int alpha0 = 0, alpha1 = 255;
+	for (int i = 0; i < 16; i++)
+	{
+		alpha0 = std::max(alpha0, (int)block[i * 4 + 3]);
+		alpha1 = std::min(alpha1, (int)block[i * 4 + 3]);
+	}
+	uint64_t indices = 0;
+	if (alpha0 != alpha1)
+	{
+		// При alpha0 > alpha1 палитра из 8 значений: опорные и 6 промежуточных
+		int palette[8] = { alpha0, alpha1 };
+		for (int p = 1; p < 7; p++)
+			palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0;
+			for (int p = 1; p < 8; p++)
+				if (abs(block[i * 4 + 3] - palette[p]) < abs(block[i * 4 + 3] - palette[best]))
+					best = p;
+			indices |= (uint64_t)best << (3 * i);
+		}
+	}
+	out[0] = (unsigned char)alpha0;
+	out[1] = (unsigned char)alpha1;
+	for (int i = 0; i < 6; i++)
+		out[2 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+inline void decodeBcColorBlock(const unsigned char * in, unsigned char * block, bool allowThreeColor)
+{
+	uint16_t color0 = in[0] | (in[1] << 8), color1 = in[2] | (in[3] << 8);
+	uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t)in[7] << 24);
+	int palette[4][4];
+	unpackRgb565(color0, palette[0]);
+	unpackRgb565(color1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+	for (int c = 0; c < 3; c++)
+	{
+		if (color0 > color1 || !allowThreeColor)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	if (color0 <= color1 && allowThreeColor)
+		palette[3][3] = 0;
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 4; c++)
+			block[i * 4 + c] = (unsigned char)palette[(indices >> (2 * i)) & 3][c];
+}
+
+inline void decodeBc3AlphaBlock(const unsigned char * in, unsigned char * block)
+{
+	int alpha0 = in[0], alpha1 = in[1];
+	int palette[8] = { alpha0, alpha1 };
+	for (int p = 1; p < 7; p++)
+		palette[p + 1] = alpha0 > alpha1 ? ((7 - p) * alpha0 + p * alpha1) / 7 : 0;
+	if (alpha0 <= alpha1)
+	{
+		for (int p = 1; p < 5; p++)
+			palette[p + 1] = ((5 - p) * alpha0 + p * alpha1) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+	uint64_t indices = 0;
+	for (int i = 0; i < 6; i++)
+		indices |= (uint64_t)in[2 + i] << (8 * i);
+	for (int i = 0; i < 16; i++)
+		block[i * 4 + 3] = (unsigned char)palette[(indices >> (3 * i)) & 7];
+}
+
+// ---------------------------------------------------------------------------------------
+// ETC2 RGB8 (режимы ETC1)
+
+static const int etcModifiers[8][2] = {
+	{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+};
+
+// Лучшая таблица модификаторов для подблока с базовым цветом base.
+// Возвращает ошибку, таблицу и 2-битные селекторы пикселей.
+inline int etcFitSubblock(const unsigned char * block, const int * pixels, const int base[3],
+						  int & table, int selectors[8])
+{
+	int bestError = INT_MAX;
+	for (int t = 0; t < 8; t++)
+	{
+		// Селектор: 0 -> +a, 1 -> +b, 2 -> -a, 3 -> -b
+		const int modifiers[4] = { etcModifiers[t][0], etcModifiers[t][1], -etcModifiers[t][0], -etcModifiers[t][1] };
+		int error = 0, chosen[8];
+		for (int i = 0; i < 8; i++)
+		{
+			const unsigned char * pixel = block + pixels[i] * 4;
+			int bestPixel = INT_MAX;
+			for (int s = 0; s < 4; s++)
+			{
+				int pixelError = 0;
+				for (int c = 0; c < 3; c++)
+				{
+					int value = std::min(255, std::max(0, base[c] + modifiers[s]));
+					pixelError += (value - pixel[c]) * (value - pixel[c]);
+				}
+				if (pixelError < bestPixel)
+				{
+					bestPixel = pixelError;
+					chosen[i] = s;
+				}
+			}
+			error += bestPixel;
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			table = t;
+			std::copy(chosen, chosen + 8, selectors);
+		}
+	}
+	return bestError;
+}
+
+inline void encodeEtc2Block(const unsigned char * block, unsigned char * out)
+{
+	int bestError = INT_MAX;
+	for (int flip = 0; flip < 2; flip++)
+	{
+		// Пиксели подблоков: без flip - левая и правая половины 2x4, с flip - верхняя и нижняя 4x2
+		int pixels[2][8], counts[2] = { 0, 0 };
+		float average[2][3] = { { 0, 0, 0 }, { 0, 0, 0 } };
+		for (int y = 0; y < 4; y++)
+			for (int x = 0; x < 4; x++)
+			{
+				int sub = flip ? (y >= 2) : (x >= 2);
+				int index = y * 4 + x;
+				pixels[sub][counts[sub]++] = index;
+				for (int c = 0; c < 3; c++)
+					average[sub][c] += block[index * 4 + c] / 8.0f;
+			}
+
+		for (int differential = 1; differential >= 0; differential--)
+		{
+			int quantized[2][3], base[2][3];
+			bool representable = true;
+			for (int s = 0; s < 2; s++)
+				for (int c = 0; c < 3; c++)
+				{
+					if (differential)
+					{
+						quantized[s][c] = (int)(average[s][c] * 31.0f / 255.0f + 0.5f);
+						base[s][c] = (quantized[s][c] << 3) | (quantized[s][c] >> 2);
+					}
+					else
+					{
+						quantized[s][c] = (int)(average[s][c] * 15.0f / 255.0f + 0.5f);
+						base[s][c] = (quantized[s][c] << 4) | quantized[s][c];
+					}
+				}
+			// Разность базовых цветов в differential режиме должна укладываться в 3 бита со знаком
+			if (differential)
+				for (int c = 0; c < 3; c++)
+					if (quantized[1][c] - quantized[0][c] < -4 || quantized[1][c] - quantized[0][c] > 3)
+						representable = false;
+			if (!representable)
+				continue;
+
+			int tables[2] = { 0, 0 }, selectors[2][8] = {};
+			int error = etcFitSubblock(block, pixels[0], base[0], tables[0], selectors[0]) +
+						etcFitSubblock(block, pixels[1], base[1], tables[1], selectors[1]);
+			if (error >= bestError)
+				continue;
+			bestError = error;
+
+			for (int c = 0; c < 3; c++)
+				out[c] = differential
+					? (unsigned char)((quantized[0][c] << 3) | ((quantized[1][c] - quantized[0][c]) & 7))
+					: (unsigned char)((quantized[0][c] << 4) | quantized[1][c]);
+			out[3] = (unsigned char)((tables[0] << 5) | (tables[1] << 2) | (differential << 1) | flip);
+
+			// Индексы пикселей нумеруются по столбцам: x * 4 + y. Старшие биты селекторов
+			// идут в первые 16 бит, младшие - во вторые, всё в big-endian.
+			uint32_t msb = 0, lsb = 0;
+			for (int s = 0; s < 2; s++)
+				for (int i = 0; i < 8; i++)
+				{
+					int index = pixels[s][i];
+					int bit = (index % 4) * 4 + index / 4;
+					msb |= (uint32_t)(selectors[s][i] >> 1) << bit;
+					lsb |= (uint32_t)(selectors[s][i] & 1) << bit;
+				}
+			out[4] = (unsigned char)(msb >> 8); out[5] = (unsigned char)msb;
+			out[6] = (unsigned char)(lsb >> 8); out[7] = (unsigned char)lsb;
+		}
+	}
+}
+
+// ---------------------------------------------------------------------------------------
+
+// Блок 4x4 из уровня RGBA8 с повтором крайних пикселей для уровней меньше 4x4
+inline void fetchBlock(const unsigned char * rgba, int width, int height, int blockX, int blockY, unsigned char * block)
+{
+	for (int y = 0; y < 4; y++)
+		for (int x = 0; x < 4; x++)
+		{
+			int sx = std::min(blockX * 4 + x, width - 1);
+			int sy = std::min(blockY * 4 + y, height - 1);
+			memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+		}
+}
+
+// Сжатие уровня RGBA8 в формат format
+inline void encodeTextureLevel(TextureFileFormat format, const unsigned char * rgba, int width, int height,
+							   std::vector<unsigned char> & out)
+{
+	out.resize(textureLevelSize(format, width, height));
+	if (format == TextureFileFormat::RGBA8)
+	{
+		memcpy(out.data(), rgba, out.size());
+		return;
+	}
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	size_t blockSize = format == TextureFileFormat::BC3 ? 16 : 8;
+	unsigned char block[64];
+	for (int by = 0; by < blocksY; by++)
+		for (int bx = 0; bx < blocksX; bx++)
+		{
+			fetchBlock(rgba, width, height, bx, by, block);
+			unsigned char * target = out.data() + ((size_t)by * blocksX + bx) * blockSize;
+			if (format == TextureFileFormat::BC1)
+				encodeBcColorBlock(block, target);
+			else if (format == TextureFileFormat::BC3)
+			{
+				encodeBc3AlphaBlock(block, target);
+				encodeBcColorBlock(block, target + 8);
+			}
+			else
+				encodeEtc2Block(block, target);
+		}
+}
+
+// Распаковка уровня BC1/BC3 в RGBA8 (для драйверов без поддержки S3TC)
+inline void decodeBcLevel(TextureFileFormat format, const unsigned char * data, int width, int height,
+						  std::vector<unsigned char> & rgba)
+{
+	rgba.resize((size_t)width * height * 4);
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	size_t blockSize = format == TextureFileFormat::BC3 ? 16 : 8;
+	unsigned char block[64];
+	for (int by = 0; by < blocksY; by++)
+		for (int bx = 0; bx < blocksX; bx++)
+		{
+			const unsigned char * source = data + ((size_t)by * blocksX + bx) * blockSize;
+			if (format == TextureFileFormat::BC3)
+			{
+				decodeBcColorBlock(source + 8, block, false);
+				decodeBc3AlphaBlock(source, block);
+			}
+			else
+				decodeBcColorBlock(source, block, true);
+			for (int y = 0; y < 4 && by * 4 + y < height; y++)
+				for (int x = 0; x < 4 && bx * 4 + x < width; x++)
+					memcpy(rgba.data() + ((size_t)(by * 4 + y) * width + bx * 4 + x) * 4, block + (y * 4 + x) * 4, 4);
+		}
+}
+
+#endif
@@ -0,0 +1,252 @@
+// Собственный формат текстур (.gtex): заголовок, таблица уровней и сами уровни
+// мипмапов подряд. Данные уровней хранятся ровно в том виде, в котором их принимает
+// glTexImage2D / glCompressedTexImage2D, поэтому загрузчик отображает файл в память
+// (mmap) и передаёт драйверу указатели прямо на страницы файла, без копий и декодирования.
+// Файлы готовит утилита texconv. Файл не зависит от OpenGL.
+
+#ifndef TEXTURE_FILE_H
+#define TEXTURE_FILE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum class TextureFileFormat : uint32_t
+{
+	RGBA8 = 0,
+	BC1 = 1,       // DXT1, 8 байт на блок 4x4, без альфы
+	BC3 = 2,       // DXT5, 16 байт на блок 4x4
+	ETC2_RGB8 = 3  // 8 байт на блок 4x4
+};
+
+inline const char * textureFileFormatName(TextureFileFormat format)
+{
+	switch (format)
+	{
+		case TextureFileFormat::RGBA8: return "rgba8";
+		case TextureFileFormat::BC1: return "bc1";
+		case TextureFileFormat::BC3: return "bc3";
+		case TextureFileFormat::ETC2_RGB8: return "etc2";
+	}
+	return "unknown";
+}
+
+// Размер уровня в байтах: для сжатых форматов - число блоков 4x4 на размер блока
+inline size_t textureLevelSize(TextureFileFormat format, int width, int height)
+{
+	size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+	switch (format)
+	{
+		case TextureFileFormat::RGBA8: return (size_t)width * height * 4;
+		case TextureFileFormat::BC1: return blocks * 8;
+		case TextureFileFormat::BC3: return blocks * 16;
+		case TextureFileFormat::ETC2_RGB8: return blocks * 8;
+	}
+	return 0;
+}
+
+static const uint32_t textureFileVersion = 1;
+// Мипмапы построены с усреднением в линейном пространстве (исходник в sRGB)
+static const uint32_t textureFileSrgbFiltered = 1;
+
+struct TextureFileHeader
+{
+	char Magic[4];            // "GTEX"
+	uint32_t Version;
+	TextureFileFormat Format;
+	uint32_t Width, Height;
+	uint32_t Levels;
+	uint32_t Flags;
+	uint32_t Reserved;
+};
+
+struct TextureFileLevel
+{
+	uint32_t Width, Height;
+	// Смещение от начала файла, кратное textureFileAlignment
+	uint64_t Offset;
+	uint64_t Size;
+};
+
+static const uint64_t textureFileAlignment = 16;
+
+// Запись файла. levels[i] - данные i-го уровня в формате format.
+inline bool writeTextureFile(const std::string & path, TextureFileFormat format, uint32_t flags,
+							 const std::vector<TextureFileLevel> & levels,
+							 const std::vector<const unsigned char *> & data)
+{
+	TextureFileHeader header = { { 'G', 'T', 'E', 'X' }, textureFileVersion, format,
+								 levels[0].Width, levels[0].Height, (uint32_t)levels.size(), flags, 0 };
+	std::vector<TextureFileLevel> table(levels);
+	uint64_t offset = sizeof(header) + sizeof(TextureFileLevel) * table.size();
+	for (TextureFileLevel & level : table)
+	{
+		offset = (offset + textureFileAlignment - 1) & ~(textureFileAlignment - 1);
+		level.Offset = offset;
+		offset += level.Size;
+	}
+
+	FILE * file = fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		std::cout << "ERROR::TEXTURE_FILE::OPEN_FAILED " << path << std::endl;
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+			  fwrite(table.data(), sizeof(TextureFileLevel), table.size(), file) == table.size();
+	static const unsigned char padding[textureFileAlignment] = {};
+	uint64_t position = sizeof(header) + sizeof(TextureFileLevel) * table.size();
+	for (size_t i = 0; ok && i < table.size(); i++)
+	{
+		ok = fwrite(padding, 1, table[i].Offset - position, file) == table[i].Offset - position &&
+			 fwrite(data[i], 1, table[i].Size, file) == table[i].Size;
+		position = table[i].Offset + table[i].Size;
+	}
+	ok = (fclose(file) == 0) && ok;
+	if (!ok)
+		std::cout << "ERROR::TEXTURE_FILE::WRITE_FAILED " << path << std::endl;
+	return ok;
+}
+
+// Файл текстуры, отображённый в память только для чтения
+class MappedTextureFile
+{
+	public:
+	const TextureFileHeader * Header = nullptr;
+	const TextureFileLevel * Levels = nullptr;
+
+	MappedTextureFile() {}
+	~MappedTextureFile() { this->Close(); }
+	MappedTextureFile(const MappedTextureFile &) = delete;
+	MappedTextureFile & operator=(const MappedTextureFile &) = delete;
+
+	// readAhead - файл будет прочитан целиком и подряд. Потоковой загрузке
+	// (texture_streaming.h) нужны отдельные уровни, и чтение вперёд ей только мешает.
+	bool Open(const std::string & path, bool readAhead = true)
+	{
+		this->Close();
+		int descriptor = open(path.c_str(), O_RDONLY);
+		if (descriptor < 0)
+		{
+			std::cout << "ERROR::TEXTURE_FILE::OPEN_FAILED " << path << std::endl;
+			return false;
+		}
+		struct stat info;
+		if (fstat(descriptor, &info) != 0 || (size_t)info.st_size < sizeof(TextureFileHeader))
+		{
+			close(descriptor);
+			std::cout << "ERROR::TEXTURE_FILE::TOO_SMALL " << path << std::endl;
+			return false;
+		}
+		this->size = (size_t)info.st_size;
+		void * mapping = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		// После mmap дескриптор больше не нужен: отображение держит файл само
+		close(descriptor);
+		if (mapping == MAP_FAILED)
+		{
+			std::cout << "ERROR::TEXTURE_FILE::MMAP_FAILED " << path << std::endl;
+			return false;
+		}
+		this->base = (const unsigned char *)mapping;
+		// Уровни читаются один раз и подряд - подсказываем ядру читать вперёд
+		if (readAhead)
+		{
+			madvise(mapping, this->size, MADV_SEQUENTIAL);
+			madvise(mapping, this->size, MADV_WILLNEED);
+		}
+		else
+			madvise(mapping, this->size, MADV_RANDOM);
+
+		this->Header = (const TextureFileHeader *)this->base;
+		this->Levels = (const TextureFileLevel *)(this->base + sizeof(TextureFileHeader));
+		if (!this->validate())
+		{
+			std::cout << "ERROR::TEXTURE_FILE::INVALID " << path << std::endl;
+			this->Close();
+			return false;
+		}
+		return true;
+	}
+
+	void Close()
+	{
+		if (this->base)
+			munmap((void *)this->base, this->size);
+		this->base = nullptr;
+		this->Header = nullptr;
+		this->Levels = nullptr;
+		this->size = 0;
+	}
+
+	bool IsOpen() const { return this->base != nullptr; }
+
+	// Указатель на данные уровня внутри отображения
+	const unsigned char * LevelData(int level) const { return this->base + this->Levels[level].Offset; }
+
+	// Чтение по одному байту с каждой страницы: подкачивает файл с диска, ничего не копируя.
+	// Вызывается в рабочем потоке, чтобы поток OpenGL не ждал ввода-вывода.
+	void Prefault() const { this->prefault(0, this->size); }
+
+	// То же для одного уровня
+	void PrefaultLevel(int level) const
+	{
+		const TextureFileLevel & info = this->Levels[level];
+		size_t page = (size_t)sysconf(_SC_PAGESIZE);
+		size_t begin = (size_t)info.Offset & ~(page - 1), end = (size_t)(info.Offset + info.Size);
+		// Запрос на весь уровень сразу, а не по странице на каждое обращение
+		madvise((void *)(this->base + begin), end - begin, MADV_WILLNEED);
+		this->prefault((size_t)info.Offset, end);
+	}
+
+	private:
+	const unsigned char * base = nullptr;
+	size_t size = 0;
+
+	void prefault(size_t begin, size_t end) const
+	{
+		volatile unsigned char sink = 0;
+		size_t page = (size_t)sysconf(_SC_PAGESIZE);
+		for (size_t offset = begin & ~(page - 1); offset < end; offset += page)
+			sink += this->base[std::max(offset, begin)];
+		(void)sink;
+	}
+
+	bool validate() const
+	{
+		const TextureFileHeader & header = *this->Header;
+		if (memcmp(header.Magic, "GTEX", 4) != 0 || header.Version != textureFileVersion ||
+			header.Levels == 0 || header.Levels > 32 ||
+			(uint32_t)header.Format > (uint32_t)TextureFileFormat::ETC2_RGB8 ||
+			sizeof(TextureFileHeader) + sizeof(TextureFileLevel) * header.Levels > this->size)
+			return false;
+		for (uint32_t i = 0; i < header.Levels; i++)
+		{
+			const TextureFileLevel & level = this->Levels[i];
+			if (level.Offset + level.Size > this->size ||
+				level.Size != textureLevelSize(header.Format, level.Width, level.Height))
+				return false;
+		}
+		return true;
+	}
+};
+
+// Путь к скомпилированной версии картинки ("pics/a.jpg" -> "pics/a.gtex"), если она есть
+inline std::string preferTextureFile(const std::string & path)
+{
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos)
+		return path;
+	std::string compiled = path.substr(0, dot) + ".gtex";
+	return access(compiled.c_str(), R_OK) == 0 ? compiled : path;
+}
+
+#endif
@@ -0,0 +1,401 @@
+// Асинхронная загрузка текстур. Картинки декодируются через SOIL в пуле рабочих потоков,
+// а готовые пиксели передаются потоку OpenGL через lock-free очередь. Поток OpenGL
+// выделяет и отображает (map) буфер распаковки пикселей (PBO), копирование в него снова
+// делает рабочий поток, и только после этого поток OpenGL вызывает glTexImage2D из PBO.
+// Пока текстура не готова, в ней лежит однотексельная заглушка, и кадры рисуются дальше.
+// Мипмапы по умолчанию тоже строит рабочий поток (mipmap.h), а не glGenerateMipmap.
+// Файлы .gtex (texture_file.h) уже содержат готовую цепочку: рабочий поток только
+// отображает их в память и подкачивает страницы, а поток OpenGL загружает уровни прямо
+// из отображения - без декодирования, мипмапов и промежуточных копий.
+
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <SOIL/SOIL.h>
+
+#include "lockfree_queue.h"
+#include "mipmap.h"
+#include "texture_compress.h"
+#include "texture_file.h"
+#include "thread_pool.h"
+
+// Загрузка готовой цепочки мипмапов уровень за уровнем в привязанную GL_TEXTURE_2D.
+// base - указатель на данные цепочки или nullptr, если она лежит в привязанном PBO.
+inline void uploadMipChain(const MipChain & chain, const unsigned char * base)
+{
+	for (int level = 0; level < (int)chain.Levels.size(); level++)
+	{
+		const MipChain::Level & info = chain.Levels[level];
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, info.Width, info.Height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+					 (const GLvoid *)((uintptr_t)base + info.Offset));
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)chain.Levels.size() - 1);
+}
+
+// Как загружать уровни файла .gtex: internalFormat для glCompressedTexImage2D или
+// compressed = false, если уровни идут через glTexImage2D как RGBA8 (сам RGBA8 или
+// BC1/BC3, распакованные на CPU без GL_EXT_texture_compression_s3tc). ETC2 требует
+// OpenGL 4.3 или GL_ARB_ES3_compatibility.
+inline bool textureFileUploadFormat(TextureFileFormat format, GLenum & internalFormat, bool & compressed)
+{
+	internalFormat = GL_RGBA;
+	compressed = format != TextureFileFormat::RGBA8;
+	if (format == TextureFileFormat::BC1 || format == TextureFileFormat::BC3)
+	{
+		internalFormat = format == TextureFileFormat::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		compressed = GLEW_EXT_texture_compression_s3tc;
+	}
+	else if (format == TextureFileFormat::ETC2_RGB8)
+	{
+		if (!GLEW_VERSION_4_3 && !GLEW_ARB_ES3_compatibility)
+		{
+			std::cout << "ERROR::TEXTURE::ETC2_NOT_SUPPORTED" << std::endl;
+			return false;
+		}
+		internalFormat = GL_COMPRESSED_RGB8_ETC2;
+	}
+	return true;
+}
+
+// Загрузка одного уровня файла в привязанную GL_TEXTURE_2D. decoded - уже распакованный
+// уровень BC (распаковка в рабочем потоке) или пустой буфер, в который он распакуется здесь.
+inline void uploadTextureFileLevel(const MappedTextureFile & file, int level, GLenum internalFormat, bool compressed,
+								   std::vector<unsigned char> & decoded)
+{
+	TextureFileFormat format = file.Header->Format;
+	const TextureFileLevel & info = file.Levels[level];
+	if (compressed)
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, info.Width, info.Height, 0,
+							   (GLsizei)info.Size, file.LevelData(level));
+	else if (format == TextureFileFormat::RGBA8)
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, info.Width, info.Height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+					 file.LevelData(level));
+	else
+	{
+		if (decoded.empty())
+			decodeBcLevel(format, file.LevelData(level), info.Width, info.Height, decoded);
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, info.Width, info.Height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+					 decoded.data());
+	}
+}
+
+// Загрузка первых levels уровней файла .gtex в привязанную GL_TEXTURE_2D прямо из отображения
+inline bool uploadTextureFile(const MappedTextureFile & file, int levels)
+{
+	GLenum internalFormat;
+	bool compressed;
+	if (!textureFileUploadFormat(file.Header->Format, internalFormat, compressed))
+		return false;
+
+	levels = std::min(levels, (int)file.Header->Levels);
+	std::vector<unsigned char> decoded;
+	for (int level = 0; level < levels; level++)
+	{
+		decoded.clear();
+		uploadTextureFileLevel(file, level, internalFormat, compressed, decoded);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	return true;
+}
+
+class TextureLoader
+{
+	public:
+	// Сколько загрузок в видеопамять делать за один кадр. Ограничение не даёт
+	// одному кадру растянуться, когда готово сразу много текстур.
+	int MaxUploadsPerFrame = 1;
+	// Строить мипмапы в рабочем потоке (иначе - glGenerateMipmap на потоке OpenGL)
+	bool CpuMipmaps = true;
+	MipOptions Mipmaps;
+
+	explicit TextureLoader(unsigned threads = 0) : pool(threads), events(256) {}
+
+	~TextureLoader()
+	{
+		// Рабочие потоки должны закончить до того, как освободятся задания
+		this->pool.Wait();
+		for (auto & job : this->jobs)
+			if (job->Pixels)
+				SOIL_free_image_data(job->Pixels);
+	}
+
+	// Создаёт текстуру с заглушкой и ставит файл в очередь на декодирование.
+	// Возвращаемый идентификатор не меняется, когда настоящее изображение будет загружено.
+	// channels - SOIL_LOAD_RGB или SOIL_LOAD_RGBA.
+	GLuint Request(const std::string & path, int channels, bool mipmaps)
+	{
+		std::shared_ptr<Job> job = std::make_shared<Job>();
+		job->Path = path;
+		job->Channels = channels;
+		job->Mipmaps = mipmaps;
+		job->Requested = Clock::now();
+
+		// Серая заглушка размером 1x1, чтобы сэмплер возвращал осмысленный цвет
+		const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+		GLint previous;
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+		glGenTextures(1, &job->Texture);
+		glBindTexture(GL_TEXTURE_2D, job->Texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+		glBindTexture(GL_TEXTURE_2D, previous);
+
+		this->jobs.push_back(job);
+		this->pending++;
+		this->pool.Submit([this, job] { this->decode(job.get()); });
+		return job->Texture;
+	}
+
+	// Вызывается потоком OpenGL в начале каждого кадра
+	void Pump()
+	{
+		int uploads = 0;
+		Job * job;
+		while (uploads < this->MaxUploadsPerFrame && this->events.TryPop(job))
+		{
+			// Отображённому файлу PBO не нужен: драйвер читает уровни прямо из него
+			if (job->State == Stage::Decoded && !job->File)
+				this->mapPixelBuffer(job);
+			else
+			{
+				this->upload(job);
+				uploads++;
+			}
+		}
+	}
+
+	// Сколько текстур ещё не готово
+	int Pending() const { return this->pending; }
+
+	// Задержки по каждой текстуре: декодирование, копирование в PBO, загрузка в
+	// видеопамять на потоке OpenGL и полное время от запроса до готовности.
+	void Report(std::ostream & out) const
+	{
+		out << std::fixed << std::setprecision(3);
+		for (auto & job : this->jobs)
+			out << "texture path=" << job->Path
+				<< " size=" << job->Width << "x" << job->Height
+				<< " decode_ms=" << job->DecodeMs
+				<< " mipmap_ms=" << job->MipmapMs
+				<< " copy_ms=" << job->CopyMs
+				<< " upload_ms=" << job->UploadMs
+				<< " ready_ms=" << job->ReadyMs
+				<< (job->State == Stage::Failed ? " failed" : "") << std::endl;
+	}
+
+	private:
+	typedef std::chrono::steady_clock Clock;
+
+	enum class Stage { Queued, Decoded, Copied, Ready, Failed };
+
+	struct Job
+	{
+		std::string Path;
+		GLuint Texture = 0;
+		int Channels = SOIL_LOAD_RGB;
+		bool Mipmaps = true;
+		Stage State = Stage::Queued;
+
+		unsigned char * Pixels = nullptr;
+		int Width = 0, Height = 0;
+		// Цепочка мипмапов RGBA8, если её строил рабочий поток (тогда Pixels уже освобождены)
+		MipChain Chain;
+		// Отображённый файл .gtex вместо декодированной картинки
+		std::unique_ptr<MappedTextureFile> File;
+		GLuint PixelBuffer = 0;
+		void * Mapped = nullptr;
+
+		Clock::time_point Requested;
+		double DecodeMs = 0.0, MipmapMs = 0.0, CopyMs = 0.0, UploadMs = 0.0, ReadyMs = 0.0;
+	};
+
+	ThreadPool pool;
+	LockFreeQueue<Job *> events;
+	std::vector<std::shared_ptr<Job>> jobs;
+	int pending = 0;
+
+	static double since(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	static bool isTextureFile(const std::string & path)
+	{
+		return path.size() > 5 && path.compare(path.size() - 5, 5, ".gtex") == 0;
+	}
+
+	// Рабочий поток: декодирование файла
+	void decode(Job * job)
+	{
+		Clock::time_point start = Clock::now();
+		if (isTextureFile(job->Path))
+		{
+			// Декодировать нечего: отображаем файл и заранее подкачиваем страницы,
+			// чтобы поток OpenGL не ждал диска внутри glCompressedTexImage2D
+			job->File.reset(new MappedTextureFile());
+			if (job->File->Open(job->Path))
+			{
+				job->File->Prefault();
+				job->Width = (int)job->File->Header->Width;
+				job->Height = (int)job->File->Header->Height;
+			}
+			else
+				job->File.reset();
+			job->DecodeMs = since(start);
+			job->State = Stage::Decoded;
+			this->events.Push(job);
+			return;
+		}
+		// SOIL хранит текст последней ошибки в общей переменной, но сам декодер
+		// работает только с локальным состоянием, поэтому вызывать его из разных потоков можно.
+		job->Pixels = SOIL_load_image(job->Path.c_str(), &job->Width, &job->Height, 0, job->Channels);
+		job->DecodeMs = since(start);
+
+		if (job->Pixels && job->Mipmaps && this->CpuMipmaps)
+		{
+			start = Clock::now();
+			size_t pixels = (size_t)job->Width * job->Height;
+			std::vector<unsigned char> rgba;
+			const unsigned char * source = job->Pixels;
+			if (job->Channels == SOIL_LOAD_RGB)
+			{
+				rgba.resize(pixels * 4);
+				padRgbToRgba(job->Pixels, rgba.data(), pixels, this->Mipmaps.Simd);
+				source = rgba.data();
+			}
+			buildMipChain(source, job->Width, job->Height, this->Mipmaps, job->Chain);
+			SOIL_free_image_data(job->Pixels);
+			job->Pixels = nullptr;
+			job->MipmapMs = since(start);
+		}
+		job->State = Stage::Decoded;
+		this->events.Push(job);
+	}
+
+	// Поток OpenGL: выделение PBO под декодированное изображение
+	void mapPixelBuffer(Job * job)
+	{
+		if (!job->Pixels && job->Chain.Data.empty())
+		{
+			std::cout << "ERROR::TEXTURE::LOAD_FAILED " << job->Path << std::endl;
+			job->State = Stage::Failed;
+			this->pending--;
+			return;
+		}
+
+		Clock::time_point start = Clock::now();
+		GLsizeiptr size = job->Chain.Data.empty() ? (GLsizeiptr)job->Width * job->Height * job->Channels
+												  : (GLsizeiptr)job->Chain.Data.size();
+		glGenBuffers(1, &job->PixelBuffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job->PixelBuffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+		job->Mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		job->UploadMs += since(start);
+
+		if (!job->Mapped)
+		{
+			// Без отображения буфера загружаем прямо из памяти процесса
+			glDeleteBuffers(1, &job->PixelBuffer);
+			job->PixelBuffer = 0;
+			this->upload(job);
+			return;
+		}
+
+		// Копирование в отображённую память тоже уводим с потока OpenGL
+		this->pool.Submit([this, job, size]
+		{
+			Clock::time_point copyStart = Clock::now();
+			if (job->Chain.Data.empty())
+			{
+				memcpy(job->Mapped, job->Pixels, size);
+				SOIL_free_image_data(job->Pixels);
+				job->Pixels = nullptr;
+			}
+			else
+			{
+				memcpy(job->Mapped, job->Chain.Data.data(), size);
+				std::vector<unsigned char>().swap(job->Chain.Data);
+			}
+			job->CopyMs = since(copyStart);
+			job->State = Stage::Copied;
+			this->events.Push(job);
+		});
+	}
+
+	// Поток OpenGL: загрузка в текстуру (из PBO, если он есть)
+	void upload(Job * job)
+	{
+		Clock::time_point start = Clock::now();
+		GLint previous;
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+		glBindTexture(GL_TEXTURE_2D, job->Texture);
+
+		GLenum format = job->Channels == SOIL_LOAD_RGBA ? GL_RGBA : GL_RGB;
+		// Строки RGB занимают width * 3 байт и не обязаны быть выровнены по 4
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		bool ok = true;
+		if (job->File)
+		{
+			ok = uploadTextureFile(*job->File, job->Mipmaps ? (int)job->File->Header->Levels : 1);
+			job->File.reset();
+		}
+		else if (!job->Chain.Levels.empty())
+		{
+			// Уровни готовы, остаётся загрузить их по одному
+			if (job->PixelBuffer)
+			{
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job->PixelBuffer);
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+				uploadMipChain(job->Chain, nullptr);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				glDeleteBuffers(1, &job->PixelBuffer);
+				job->PixelBuffer = 0;
+				job->Mapped = nullptr;
+			}
+			else
+				uploadMipChain(job->Chain, job->Chain.Data.data());
+			job->Chain = MipChain();
+		}
+		else if (job->PixelBuffer)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job->PixelBuffer);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			// Последний аргумент - смещение в PBO, а не указатель
+			glTexImage2D(GL_TEXTURE_2D, 0, format, job->Width, job->Height, 0, format, GL_UNSIGNED_BYTE, (GLvoid *)0);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			// Буфер освободится, когда драйвер закончит с ним работать
+			glDeleteBuffers(1, &job->PixelBuffer);
+			job->PixelBuffer = 0;
+			job->Mapped = nullptr;
+		}
+		else
+		{
+			glTexImage2D(GL_TEXTURE_2D, 0, format, job->Width, job->Height, 0, format, GL_UNSIGNED_BYTE, job->Pixels);
+			SOIL_free_image_data(job->Pixels);
+			job->Pixels = nullptr;
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		if (job->Mipmaps && !this->CpuMipmaps && !isTextureFile(job->Path))
+			glGenerateMipmap(GL_TEXTURE_2D);
+
+		glBindTexture(GL_TEXTURE_2D, previous);
+		job->UploadMs += since(start);
+		job->ReadyMs = since(job->Requested);
+		job->State = ok ? Stage::Ready : Stage::Failed;
+		this->pending--;
+	}
+};
+
+#endif
@@ -0,0 +1,550 @@
+// Потоковая загрузка текстур в пределах бюджета видеопамяти. Сначала загружается только
+// хвост цепочки мипмапов (уровни не больше TailSize по большей стороне) - текстура сразу
+// рисуется, хоть и размыто. Более крупные уровни читаются рабочими потоками по одному,
+// начиная с ближайшего к уже загруженным, и только пока текстура на экране настолько
+// велика, что они нужны (Touch с размером на экране). Видимая часть цепочки задаётся
+// GL_TEXTURE_BASE_LEVEL: драйвер никогда не видит дыр, и уровни можно добавлять и
+// выбрасывать, не пересоздавая текстуру.
+//
+// Когда новый уровень не помещается в бюджет, выгружается самый давно не нужный уровень
+// какой-нибудь текстуры (LRU по кадрам): BASE_LEVEL поднимается на единицу, а сам уровень
+// заменяется пустым изображением 0x0, чтобы драйвер освободил память. Уровни, нужные в
+// прошлом кадре, и хвосты не выгружаются никогда; если освободить нечего, уровень ждёт.
+//
+// Источник уровней - файл .gtex (texture_file.h): он отображается в память без чтения
+// вперёд, и рабочий поток подкачивает страницы только запрошенного уровня. Обычные
+// картинки декодируются через SOIL целиком, и цепочка (mipmap.h) держится в памяти
+// процесса - экономится только видеопамять.
+
+#ifndef TEXTURE_STREAMING_H
+#define TEXTURE_STREAMING_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+#include <SOIL/SOIL.h>
+
+#include "frame_memory.h"
+#include "gl_state.h"
+#include "lockfree_queue.h"
+#include "mipmap.h"
+#include "texture_compress.h"
+#include "texture_file.h"
+#include "texture_loader.h"
+#include "thread_pool.h"
+
+// Первый уровень, которого хватает текстуре width x height, занимающей на экране
+// screenWidth x screenHeight пикселей: на пиксель приходится не больше одного текселя
+inline int textureStreamLevel(int width, int height, int levels, float screenWidth, float screenHeight)
+{
+	float ratio = std::max(width / std::max(screenWidth, 1.0f), height / std::max(screenHeight, 1.0f));
+	int level = ratio > 1.0f ? (int)floorf(log2f(ratio)) : 0;
+	return std::min(level, levels - 1);
+}
+
+class TextureStreamer
+{
+	public:
+	// Бюджет видеопамяти на все уровни всех текстур, включая хвосты
+	size_t BudgetBytes = 64u << 20;
+	// Уровни не больше этого размера по большей стороне загружаются сразу и не выгружаются
+	int TailSize = 64;
+	// Сколько прочитанных уровней загружать в видеопамять за один кадр
+	int MaxUploadsPerFrame = 2;
+	// Сколько уровней может читаться одновременно
+	int MaxInFlight = 4;
+	MipOptions Mipmaps;
+	// Если задан, текстуры привязываются через трекер состояния, и прежняя привязка не
+	// восстанавливается: трекер сам знает, что теперь привязано. Без него прежняя привязка
+	// запрашивается у OpenGL и возвращается на место после загрузки.
+	GlState * State = nullptr;
+
+	// Статистика
+	size_t ResidentBytes = 0, PeakResidentBytes = 0;
+	long long LevelsLoaded = 0, LevelsEvicted = 0, BudgetMisses = 0;
+	// BytesRead - только уровни из файлов: цепочки картинок уже лежат в памяти
+	double BytesStreamed = 0.0, BytesRead = 0.0, BytesEvicted = 0.0;
+	double ReadMs = 0.0, UploadMs = 0.0, LatencyMs = 0.0;
+
+	// threads - потоки ввода-вывода: чтение уровней больше ждёт диска, чем считает
+	explicit TextureStreamer(unsigned threads = 2) : pool(threads), opened(256), completed(256) {}
+
+	~TextureStreamer()
+	{
+		// Рабочие потоки должны закончить до того, как освободятся текстуры и запросы
+		this->pool.Wait();
+		// Прочитанные, но не загруженные уровни: пул требует вернуть живые запросы до своего
+		// уничтожения, иначе не освободятся их буферы Decoded
+		LevelRead * read;
+		while (this->completed.TryPop(read))
+			this->reads.Destroy(read);
+	}
+
+	// Создаёт текстуру с заглушкой и ставит файл в очередь на открытие.
+	// channels - SOIL_LOAD_RGB или SOIL_LOAD_RGBA (для файлов .gtex не важен).
+	GLuint Request(const std::string & path, int channels)
+	{
+		std::unique_ptr<Entry> entry(new Entry());
+		entry->Path = path;
+		entry->Channels = channels;
+		entry->Requested = Clock::now();
+
+		const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+		glGenTextures(1, &entry->Texture);
+		GLint previous = this->bind(entry->Texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+		this->unbind(previous);
+
+		Entry * raw = entry.get();
+		this->byTexture[raw->Texture] = raw;
+		this->entries.push_back(std::move(entry));
+		this->opening++;
+		this->pool.Submit([this, raw] { this->open(raw); });
+		return raw->Texture;
+	}
+
+	// Текстура нарисована в этом кадре размером примерно screenWidth x screenHeight
+	// пикселей (вся текстура, без повторения). Несколько вызовов за кадр - берётся больший.
+	void Touch(GLuint texture, float screenWidth, float screenHeight)
+	{
+		auto found = this->byTexture.find(texture);
+		if (found == this->byTexture.end() || found->second->State != Stage::Ready)
+			return;
+		Entry & entry = *found->second;
+		int level = textureStreamLevel(entry.Width, entry.Height, entry.Levels, screenWidth, screenHeight);
+		if (entry.TouchedFrame != this->frame)
+		{
+			entry.TouchedFrame = this->frame;
+			entry.Wanted = level;
+		}
+		else
+			entry.Wanted = std::min(entry.Wanted, level);
+		for (int i = level; i < entry.Levels; i++)
+			entry.LevelUsed[i] = this->frame;
+	}
+
+	// Вызывается потоком OpenGL в начале каждого кадра: загружает хвосты открытых текстур
+	// и прочитанные уровни, затем по касаниям прошлого кадра ставит в чтение следующие
+	// уровни, освобождая под них место.
+	void Pump()
+	{
+		Entry * entry;
+		while (this->opened.TryPop(entry))
+			this->finishOpen(entry);
+		int uploads = 0;
+		LevelRead * read;
+		while (uploads < this->MaxUploadsPerFrame && this->completed.TryPop(read))
+		{
+			this->finishRead(read);
+			uploads++;
+		}
+		this->plan();
+		this->frame++;
+	}
+
+	// Первый загруженный уровень текстуры (её BASE_LEVEL) или -1, пока она не открыта
+	int ResidentLevel(GLuint texture) const
+	{
+		auto found = this->byTexture.find(texture);
+		if (found == this->byTexture.end() || found->second->State != Stage::Ready)
+			return -1;
+		return found->second->Base;
+	}
+
+	// Сколько текстур открывается и уровней читается или ждёт очереди (но не бюджета)
+	int Pending() const { return this->opening + this->inFlight + this->waiting; }
+
+	// Видеопамять, которую заняли бы полные цепочки всех текстур
+	size_t FullChainBytes() const
+	{
+		size_t total = 0;
+		for (auto & entry : this->entries)
+			for (size_t bytes : entry->LevelBytes)
+				total += bytes;
+		return total;
+	}
+
+	// Итоги: занятая память, загрузки и выгрузки уровней, скорость потока (чтение и
+	// загрузка в видеопамять - каждая по своему суммарному времени, средняя задержка от
+	// запроса уровня до его появления в текстуре) и состояние каждой текстуры.
+	void Report(std::ostream & out) const
+	{
+		const double megabyte = 1024.0 * 1024.0;
+		double streamedMb = this->BytesStreamed / megabyte;
+		out << std::fixed << std::setprecision(3);
+		out << "texture_streaming textures=" << this->entries.size()
+			<< " budget_mb=" << this->BudgetBytes / megabyte
+			<< " resident_mb=" << this->ResidentBytes / megabyte
+			<< " peak_resident_mb=" << this->PeakResidentBytes / megabyte
+			<< " full_chain_mb=" << this->FullChainBytes() / megabyte
+			<< " levels_loaded=" << this->LevelsLoaded
+			<< " levels_evicted=" << this->LevelsEvicted
+			<< " evicted_mb=" << this->BytesEvicted / megabyte
+			<< " budget_misses=" << this->BudgetMisses
+			<< " streamed_mb=" << streamedMb
+			<< " read_ms=" << this->ReadMs
+			<< " upload_ms=" << this->UploadMs
+			<< " read_mb=" << this->BytesRead / megabyte
+			<< " read_mb_per_s=" << (this->ReadMs > 0.0 ? this->BytesRead / megabyte * 1000.0 / this->ReadMs : 0.0)
+			<< " upload_mb_per_s=" << (this->UploadMs > 0.0 ? streamedMb * 1000.0 / this->UploadMs : 0.0)
+			<< " avg_latency_ms=" << (this->LevelsLoaded > 0 ? this->LatencyMs / this->LevelsLoaded : 0.0) << std::endl;
+		for (auto & entry : this->entries)
+		{
+			size_t resident = 0;
+			for (int level = entry->Base; level < (int)entry->LevelBytes.size(); level++)
+				resident += entry->LevelBytes[level];
+			out << "texture_stream path=" << entry->Path
+				<< " size=" << entry->Width << "x" << entry->Height
+				<< " levels=" << entry->Levels
+				<< " tail=" << entry->Tail
+				<< " base=" << entry->Base
+				<< " wanted=" << entry->Wanted
+				<< " resident_kb=" << resident / 1024.0
+				<< " open_ms=" << entry->OpenMs
+				<< " ready_ms=" << entry->ReadyMs
+				<< (entry->State == Stage::Failed ? " failed" : "") << std::endl;
+		}
+	}
+
+	private:
+	typedef std::chrono::steady_clock Clock;
+
+	enum class Stage { Opening, Ready, Failed };
+
+	struct Entry
+	{
+		std::string Path;
+		GLuint Texture = 0;
+		int Channels = SOIL_LOAD_RGB;
+		Stage State = Stage::Opening;
+
+		// Источник уровней: отображённый файл или цепочка в памяти
+		std::unique_ptr<MappedTextureFile> File;
+		MipChain Chain;
+		GLenum InternalFormat = GL_RGBA;
+		bool Compressed = false;
+		// BC без поддержки драйвером: уровни распаковывает рабочий поток при чтении
+		bool DecodeOnRead = false;
+
+		int Width = 0, Height = 0, Levels = 0;
+		// Первый уровень хвоста, первый загруженный уровень (BASE_LEVEL) и первый нужный
+		int Tail = 0, Base = 0, Wanted = 0;
+		// Читается уровень Base - 1
+		bool Loading = false;
+		uint64_t TouchedFrame = 0;
+		// Кадр, в котором уровень был нужен последний раз
+		std::vector<uint64_t> LevelUsed;
+		// Размер уровня в видеопамяти
+		std::vector<size_t> LevelBytes;
+
+		Clock::time_point Requested;
+		double OpenMs = 0.0, ReadyMs = 0.0;
+	};
+
+	struct LevelRead
+	{
+		Entry * Texture = nullptr;
+		int Level = 0;
+		std::vector<unsigned char> Decoded;
+		Clock::time_point Requested;
+		double ReadMs = 0.0;
+	};
+
+	ThreadPool pool;
+	LockFreeQueue<Entry *> opened;
+	LockFreeQueue<LevelRead *> completed;
+	std::vector<std::unique_ptr<Entry>> entries;
+	std::unordered_map<GLuint, Entry *> byTexture;
+	// Запросы живут только на потоке OpenGL: создаются в plan, удаляются в finishRead
+	ObjectPool<LevelRead, 32> reads;
+	std::vector<Entry *> candidates;
+	std::vector<unsigned char> decoded;
+	// 0 - "никогда", поэтому кадры считаются с единицы
+	uint64_t frame = 1;
+	int opening = 0, inFlight = 0, waiting = 0;
+	// Бюджет, обещанный читающимся уровням
+	size_t reserved = 0;
+
+	// Привязывает texture для загрузки уровней: через State - к блоку 0, без него - к текущему.
+	// Возвращает, что вернуть на место в unbind: прежнюю привязку без State и -1 с ним
+	GLint bind(GLuint texture)
+	{
+		if (this->State)
+		{
+			this->State->BindTexture(0, GL_TEXTURE_2D, texture);
+			return -1;
+		}
+		GLint previous;
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		return previous;
+	}
+
+	void unbind(GLint previous)
+	{
+		if (previous >= 0)
+			glBindTexture(GL_TEXTURE_2D, previous);
+	}
+
+	static double since(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	static bool isTextureFile(const std::string & path)
+	{
+		return path.size() > 5 && path.compare(path.size() - 5, 5, ".gtex") == 0;
+	}
+
+	// Рабочий поток: открытие файла и подкачка хвоста
+	void open(Entry * entry)
+	{
+		Clock::time_point start = Clock::now();
+		if (isTextureFile(entry->Path))
+		{
+			entry->File.reset(new MappedTextureFile());
+			if (entry->File->Open(entry->Path, false))
+			{
+				entry->Width = (int)entry->File->Header->Width;
+				entry->Height = (int)entry->File->Header->Height;
+				entry->Levels = (int)entry->File->Header->Levels;
+				entry->Tail = this->tailLevel(*entry);
+				for (int level = entry->Tail; level < entry->Levels; level++)
+					entry->File->PrefaultLevel(level);
+			}
+			else
+				entry->File.reset();
+		}
+		else
+		{
+			int width, height;
+			unsigned char * pixels = SOIL_load_image(entry->Path.c_str(), &width, &height, 0, entry->Channels);
+			if (pixels)
+			{
+				size_t count = (size_t)width * height;
+				std::vector<unsigned char> rgba;
+				const unsigned char * source = pixels;
+				if (entry->Channels == SOIL_LOAD_RGB)
+				{
+					rgba.resize(count * 4);
+					padRgbToRgba(pixels, rgba.data(), count, this->Mipmaps.Simd);
+					source = rgba.data();
+				}
+				buildMipChain(source, width, height, this->Mipmaps, entry->Chain);
+				SOIL_free_image_data(pixels);
+				entry->Width = width;
+				entry->Height = height;
+				entry->Levels = (int)entry->Chain.Levels.size();
+				entry->Tail = this->tailLevel(*entry);
+			}
+		}
+		entry->OpenMs = since(start);
+		this->opened.Push(entry);
+	}
+
+	// Первый уровень, не больший TailSize по большей стороне
+	int tailLevel(const Entry & entry) const
+	{
+		int level = 0;
+		while (level < entry.Levels - 1 && std::max(entry.Width >> level, entry.Height >> level) > this->TailSize)
+			level++;
+		return level;
+	}
+
+	// Рабочий поток: чтение уровня (подкачка страниц и распаковка BC, если она нужна)
+	void readLevel(LevelRead * read)
+	{
+		Clock::time_point start = Clock::now();
+		Entry * entry = read->Texture;
+		if (entry->File)
+		{
+			entry->File->PrefaultLevel(read->Level);
+			if (entry->DecodeOnRead)
+			{
+				const TextureFileLevel & info = entry->File->Levels[read->Level];
+				decodeBcLevel(entry->File->Header->Format, entry->File->LevelData(read->Level), info.Width, info.Height,
+							  read->Decoded);
+			}
+		}
+		read->ReadMs = since(start);
+		this->completed.Push(read);
+	}
+
+	// Поток OpenGL: загрузка одного уровня в привязанную текстуру
+	void uploadLevel(Entry & entry, int level, std::vector<unsigned char> & decoded)
+	{
+		if (entry.File)
+			uploadTextureFileLevel(*entry.File, level, entry.InternalFormat, entry.Compressed, decoded);
+		else
+		{
+			const MipChain::Level & info = entry.Chain.Levels[level];
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, info.Width, info.Height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+						 entry.Chain.Pixels(level));
+		}
+	}
+
+	// Поток OpenGL: текстура открыта - загружаем хвост и открываем её для Touch
+	void finishOpen(Entry * entry)
+	{
+		this->opening--;
+		bool ok = entry->File || !entry->Chain.Levels.empty();
+		if (ok && entry->File)
+			ok = textureFileUploadFormat(entry->File->Header->Format, entry->InternalFormat, entry->Compressed);
+		if (!ok)
+		{
+			std::cout << "ERROR::TEXTURE_STREAMING::LOAD_FAILED " << entry->Path << std::endl;
+			entry->State = Stage::Failed;
+			entry->File.reset();
+			return;
+		}
+		entry->DecodeOnRead = entry->File && !entry->Compressed && entry->File->Header->Format != TextureFileFormat::RGBA8;
+
+		entry->LevelUsed.assign(entry->Levels, 0);
+		entry->LevelBytes.resize(entry->Levels);
+		for (int level = 0; level < entry->Levels; level++)
+		{
+			int width = std::max(1, entry->Width >> level), height = std::max(1, entry->Height >> level);
+			entry->LevelBytes[level] = entry->Compressed ? (size_t)entry->File->Levels[level].Size : (size_t)width * height * 4;
+		}
+
+		// Время хвоста входит в ready_ms текстуры, а не в upload_ms потока уровней
+		GLint previous = this->bind(entry->Texture);
+		for (int level = entry->Tail; level < entry->Levels; level++)
+		{
+			this->decoded.clear();
+			this->uploadLevel(*entry, level, this->decoded);
+			this->ResidentBytes += entry->LevelBytes[level];
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry->Tail);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, entry->Levels - 1);
+		// Заглушка в нулевом уровне больше не видна - освобождаем её
+		if (entry->Tail > 0)
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		this->unbind(previous);
+
+		this->PeakResidentBytes = std::max(this->PeakResidentBytes, this->ResidentBytes);
+		entry->Base = entry->Tail;
+		entry->Wanted = entry->Tail;
+		entry->ReadyMs = since(entry->Requested);
+		entry->State = Stage::Ready;
+	}
+
+	// Поток OpenGL: уровень прочитан - загружаем его и опускаем BASE_LEVEL
+	void finishRead(LevelRead * read)
+	{
+		Entry & entry = *read->Texture;
+		int level = read->Level;
+		size_t bytes = entry.LevelBytes[level];
+
+		Clock::time_point start = Clock::now();
+		GLint previous = this->bind(entry.Texture);
+		this->uploadLevel(entry, level, read->Decoded);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+		this->unbind(previous);
+		this->UploadMs += since(start);
+
+		entry.Base = level;
+		entry.Loading = false;
+		this->reserved -= bytes;
+		this->ResidentBytes += bytes;
+		this->PeakResidentBytes = std::max(this->PeakResidentBytes, this->ResidentBytes);
+		this->LevelsLoaded++;
+		this->BytesStreamed += (double)bytes;
+		if (entry.File)
+			this->BytesRead += (double)entry.File->Levels[level].Size;
+		this->ReadMs += read->ReadMs;
+		this->LatencyMs += since(read->Requested);
+		this->inFlight--;
+		this->reads.Destroy(read);
+	}
+
+	// Поток OpenGL: какие уровни читать дальше. Первыми идут текстуры, которым не хватает
+	// больше всего уровней, при равенстве - с меньшим следующим уровнем.
+	void plan()
+	{
+		this->candidates.clear();
+		for (auto & entry : this->entries)
+			if (entry->State == Stage::Ready && !entry->Loading && entry->TouchedFrame == this->frame &&
+				entry->Base > entry->Wanted)
+				this->candidates.push_back(entry.get());
+		std::sort(this->candidates.begin(), this->candidates.end(), [](const Entry * a, const Entry * b) {
+			int missingA = a->Base - a->Wanted, missingB = b->Base - b->Wanted;
+			if (missingA != missingB)
+				return missingA > missingB;
+			return a->LevelBytes[a->Base - 1] < b->LevelBytes[b->Base - 1];
+		});
+
+		this->waiting = 0;
+		for (Entry * entry : this->candidates)
+		{
+			if (this->inFlight >= this->MaxInFlight)
+			{
+				this->waiting++;
+				continue;
+			}
+			size_t bytes = entry->LevelBytes[entry->Base - 1];
+			if (!this->makeRoom(bytes))
+			{
+				this->BudgetMisses++;
+				continue;
+			}
+			this->reserved += bytes;
+			LevelRead * read = this->reads.Create();
+			read->Texture = entry;
+			read->Level = entry->Base - 1;
+			read->Decoded.clear();
+			read->Requested = Clock::now();
+			entry->Loading = true;
+			this->inFlight++;
+			this->pool.Submit([this, read] { this->readLevel(read); });
+		}
+	}
+
+	// Выгрузка давно не нужных уровней, пока bytes не поместятся в бюджет. Кандидат у
+	// каждой текстуры один - её BASE_LEVEL, поэтому перебор идёт по текстурам, а не по уровням.
+	bool makeRoom(size_t bytes)
+	{
+		while (this->ResidentBytes + this->reserved + bytes > this->BudgetBytes)
+		{
+			Entry * victim = nullptr;
+			for (auto & entry : this->entries)
+			{
+				Entry * candidate = entry.get();
+				if (candidate->State != Stage::Ready || candidate->Loading || candidate->Base >= candidate->Tail ||
+					candidate->LevelUsed[candidate->Base] >= this->frame)
+					continue;
+				if (!victim || candidate->LevelUsed[candidate->Base] < victim->LevelUsed[victim->Base] ||
+					(candidate->LevelUsed[candidate->Base] == victim->LevelUsed[victim->Base] &&
+					 candidate->LevelBytes[candidate->Base] > victim->LevelBytes[victim->Base]))
+					victim = candidate;
+			}
+			if (!victim)
+				return false;
+			this->evict(*victim);
+		}
+		return true;
+	}
+
+	void evict(Entry & entry)
+	{
+		int level = entry.Base++;
+		GLint previous = this->bind(entry.Texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.Base);
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		this->unbind(previous);
+		this->ResidentBytes -= entry.LevelBytes[level];
+		this->BytesEvicted += (double)entry.LevelBytes[level];
+		this->LevelsEvicted++;
+	}
+};
+
+#endif
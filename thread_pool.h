@@ -0,0 +1,132 @@
+// Простой пул рабочих потоков. Задачи ставятся в очередь под мьютексом: постановка
+// задач - редкое событие, а спящие потоки удобно будить через condition_variable.
+// Очередь - кольцо, которое только растёт, поэтому в установившемся режиме постановка
+// задачи не обращается к куче (если лямбда помещается во внутренний буфер std::function).
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+	public:
+	// threads = 0 - по числу ядер, но не меньше одного потока
+	explicit ThreadPool(unsigned threads = 0)
+	{
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		for (unsigned i = 0; i < threads; i++)
+			this->workers.emplace_back([this] { this->workerLoop(); });
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->stopping = true;
+		}
+		this->wake.notify_all();
+		for (std::thread & worker : this->workers)
+			worker.join();
+	}
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool & operator=(const ThreadPool &) = delete;
+
+	unsigned Size() const { return (unsigned)this->workers.size(); }
+
+	void Submit(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			if (this->queued == this->tasks.size())
+				this->growQueue();
+			this->tasks[(this->head + this->queued) % this->tasks.size()] = std::move(task);
+			this->queued++;
+			this->busy++;
+		}
+		this->wake.notify_one();
+	}
+
+	// Дождаться выполнения всех поставленных задач
+	void Wait()
+	{
+		std::unique_lock<std::mutex> lock(this->mutex);
+		this->idle.wait(lock, [this] { return this->busy == 0; });
+	}
+
+	// Диапазон [0, count) делится на parts кусков, body(part, begin, end) выполняется в пуле.
+	// Возвращает управление, когда все куски готовы (как и Wait, ждёт и чужие задачи).
+	template <typename Body>
+	void ParallelFor(size_t count, size_t parts, const Body & body)
+	{
+		parts = std::max<size_t>(1, std::min(parts, count));
+		// Задача хранит только указатель на описание диапазона и номер куска: два слова
+		// помещаются во внутренний буфер std::function, и постановка не выделяет память
+		struct Range
+		{
+			const Body * Function;
+			size_t Count, Parts;
+		};
+		const Range range = { &body, count, parts }, * shared = &range;
+		for (size_t part = 0; part < parts; part++)
+			this->Submit([shared, part] {
+				(*shared->Function)(part, shared->Count * part / shared->Parts, shared->Count * (part + 1) / shared->Parts);
+			});
+		this->Wait();
+	}
+
+	private:
+	std::vector<std::thread> workers;
+	// Кольцо задач: queued штук начиная с head
+	std::vector<std::function<void()>> tasks;
+	size_t head = 0, queued = 0;
+	std::mutex mutex;
+	std::condition_variable wake, idle;
+	// Задачи в очереди и выполняющиеся сейчас
+	size_t busy = 0;
+	bool stopping = false;
+
+	void workerLoop()
+	{
+		for (;;)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(this->mutex);
+				this->wake.wait(lock, [this] { return this->stopping || this->queued > 0; });
+				if (!this->queued)
+					return;
+				task = std::move(this->tasks[this->head]);
+				this->head = (this->head + 1) % this->tasks.size();
+				this->queued--;
+			}
+			task();
+			// Захваченное задачей освобождается до того, как Wait узнает о её завершении
+			task = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(this->mutex);
+				if (--this->busy == 0)
+					this->idle.notify_all();
+			}
+		}
+	}
+
+	// Вызывается под мьютексом, когда кольцо заполнено: задачи переезжают по порядку в начало
+	void growQueue()
+	{
+		std::vector<std::function<void()>> grown(std::max<size_t>(16, this->tasks.size() * 2));
+		for (size_t i = 0; i < this->queued; i++)
+			grown[i] = std::move(this->tasks[(this->head + i) % this->tasks.size()]);
+		this->tasks.swap(grown);
+		this->head = 0;
+	}
+};
+
+#endif
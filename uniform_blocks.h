@@ -0,0 +1,124 @@
+// Uniform-блоки (UBO) с раскладкой std140 вместо отдельных glUniform*.
+//
+// Точки привязки общие для всех программ: блок кадра (FrameBlock: камера, время, общий
+// цвет) привязывается один раз за кадр и виден всем программам сразу, а блок объекта
+// (ObjectBlock) - диапазоном glBindBufferRange перед каждой отрисовкой. Номер точки
+// привязки записывается в каждую программу один раз (bindUniformBlocks) - в GLSL 3.30
+// нет layout(binding).
+//
+// Данные всех блоков кадра лежат в одном большом потоковом буфере (StreamBuffer с
+// GL_UNIFORM_BUFFER): UniformStream раздаёт из него куски с началом, кратным
+// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT (на многих GPU это 256 байт, поэтому даже блок из
+// одного vec4 занимает столько места). Кусок под все объекты кадра выделяется заранее
+// на потоке OpenGL, а потоки записи команд заполняют в нём каждый свою ячейку.
+
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <cstring>
+#include <iostream>
+
+#include <GL/glew.h>
+
+#include "gl_state.h"
+#include "stream_buffer.h"
+
+// Точки привязки блоков
+const GLuint frameUniformBinding = 0;
+const GLuint objectUniformBinding = 1;
+
+// Раскладка std140: только vec4 (и массивы vec4), так что смещения совпадают с C++
+struct FrameConstants
+{
+	// xy - положение камеры, z - время сцены
+	GLfloat Camera[4];
+	// Множитель цвета для всех программ
+	GLfloat Tint[4];
+};
+
+struct ObjectConstants
+{
+	// xy - положение, z - размер, w - угол поворота
+	GLfloat Transform[4];
+};
+
+static_assert(sizeof(FrameConstants) % 16 == 0 && sizeof(ObjectConstants) % 16 == 0, "std140 blocks must be vec4 multiples");
+
+// Объявления блоков для вставки в шейдеры; должны совпадать со структурами выше
+#define FRAME_BLOCK_GLSL "layout (std140) uniform FrameBlock { vec4 camera; vec4 tint; };\n"
+#define OBJECT_BLOCK_GLSL "layout (std140) uniform ObjectBlock { vec4 transform; };\n"
+
+// Записать в программу точки привязки тех блоков, которые в ней есть
+inline void bindUniformBlocks(GLuint program)
+{
+	GLuint index = glGetUniformBlockIndex(program, "FrameBlock");
+	if (index != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, index, frameUniformBinding);
+	index = glGetUniformBlockIndex(program, "ObjectBlock");
+	if (index != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, index, objectUniformBinding);
+}
+
+class UniformStream
+{
+	public:
+	StreamBuffer Buffer;
+	// Выравнивание начала диапазона для glBindBufferRange
+	GLsizeiptr Alignment = 256;
+
+	// Кусок буфера под count блоков по size байт; ячейка i начинается с Data + i * Stride
+	struct Range
+	{
+		unsigned char * Data;
+		GLintptr Offset;
+		GLsizeiptr Stride;
+	};
+
+	// Место на кадр: блок кадра и objectBlocks блоков по objectSize байт
+	bool Create(size_t objectBlocks, GLsizeiptr objectSize, BufferStreaming streaming)
+	{
+		GLint alignment = 0;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		this->Alignment = alignment > 0 ? alignment : 256;
+		// Размер кадра кратен выравниванию: области кадров в Persistent идут подряд
+		GLsizeiptr frameBytes = this->roundUp(sizeof(FrameConstants)) + (GLsizeiptr)objectBlocks * this->roundUp(objectSize);
+		return this->Buffer.Create(GL_UNIFORM_BUFFER, frameBytes, streaming);
+	}
+
+	void BeginFrame() { this->Buffer.BeginFrame(); }
+
+	// Блок кадра: записывается и привязывается к frameUniformBinding для всех программ
+	bool SetFrame(const FrameConstants & constants)
+	{
+		StreamBuffer::Allocation allocation = this->Buffer.Allocate(sizeof(FrameConstants), this->Alignment);
+		if (!allocation.Data)
+			return false;
+		memcpy(allocation.Data, &constants, sizeof(constants));
+		this->frameOffset = allocation.Offset;
+		return true;
+	}
+
+	Range AllocateBlocks(size_t count, GLsizeiptr size)
+	{
+		GLsizeiptr stride = this->roundUp(size);
+		StreamBuffer::Allocation allocation = this->Buffer.Allocate(stride * (GLsizeiptr)count, this->Alignment);
+		return { (unsigned char *)allocation.Data, allocation.Offset, stride };
+	}
+
+	// Перед отрисовкой: данные видны GPU, блок кадра привязан
+	void Commit(GlState & state)
+	{
+		this->Buffer.Commit();
+		state.BindUniformRange(frameUniformBinding, this->Buffer.Buffer, this->frameOffset, sizeof(FrameConstants));
+	}
+
+	void EndFrame() { this->Buffer.EndFrame(); }
+	void Destroy() { this->Buffer.Destroy(); }
+
+	private:
+	GLintptr frameOffset = 0;
+
+	GLsizeiptr roundUp(GLsizeiptr size) const { return (size + this->Alignment - 1) / this->Alignment * this->Alignment; }
+};
+
+#endif
@@ -0,0 +1,571 @@
+// Математика преобразований: векторы, матрицы 4x4 и кватернионы, а также пакетные
+// операции над тысячами матриц за один вызов.
+//
+// Матрицы хранятся по столбцам (M[столбец * 4 + строка]), как их ждёт glUniformMatrix4fv
+// с transpose = GL_FALSE, и умножают вектор-столбец справа: M * v. Кватернион - (X, Y, Z, W),
+// W - скалярная часть.
+//
+// Для пакетов преобразования объектов (TransformArrays) и их матрицы (MatrixArrays)
+// лежат структурой массивов: каждый элемент - отдельный массив, так что сборка матриц из
+// положения, поворота и масштаба и умножение на общую матрицу (вид * проекция) идут по
+// 4 (SSE) или 8 (AVX2) объектов за раз без перестановок данных. Выбор набора инструкций -
+// во время работы, как у мипмапов.
+
+#ifndef VECMATH_H
+#define VECMATH_H
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "mipmap.h"
+
+#ifdef MIPMAP_X86
+#define VECMATH_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+struct Vec3
+{
+	float X, Y, Z;
+};
+
+struct Vec4
+{
+	float X, Y, Z, W;
+};
+
+struct Quat
+{
+	float X, Y, Z, W;
+};
+
+struct Mat4
+{
+	alignas(16) float M[16];
+};
+
+inline Vec3 operator+(Vec3 a, Vec3 b) { return { a.X + b.X, a.Y + b.Y, a.Z + b.Z }; }
+inline Vec3 operator-(Vec3 a, Vec3 b) { return { a.X - b.X, a.Y - b.Y, a.Z - b.Z }; }
+inline Vec3 operator*(Vec3 v, float s) { return { v.X * s, v.Y * s, v.Z * s }; }
+inline float dot(Vec3 a, Vec3 b) { return a.X * b.X + a.Y * b.Y + a.Z * b.Z; }
+inline Vec3 cross(Vec3 a, Vec3 b) { return { a.Y * b.Z - a.Z * b.Y, a.Z * b.X - a.X * b.Z, a.X * b.Y - a.Y * b.X }; }
+inline float length(Vec3 v) { return sqrtf(dot(v, v)); }
+
+// Нулевой вектор остаётся нулевым
+inline Vec3 normalize(Vec3 v)
+{
+	float l = length(v);
+	return l > 0.0f ? v * (1.0f / l) : v;
+}
+
+// ---------------------------------------------------------------------------------------
+// Кватернионы
+
+// Поворот на angle радиан вокруг оси axis (нормализуется здесь)
+inline Quat quatAxisAngle(Vec3 axis, float angle)
+{
+	Vec3 a = normalize(axis) * sinf(angle * 0.5f);
+	return { a.X, a.Y, a.Z, cosf(angle * 0.5f) };
+}
+
+// Сначала поворот b, затем a
+inline Quat operator*(Quat a, Quat b)
+{
+	return { a.W * b.X + a.X * b.W + a.Y * b.Z - a.Z * b.Y,
+			 a.W * b.Y - a.X * b.Z + a.Y * b.W + a.Z * b.X,
+			 a.W * b.Z + a.X * b.Y - a.Y * b.X + a.Z * b.W,
+			 a.W * b.W - a.X * b.X - a.Y * b.Y - a.Z * b.Z };
+}
+
+inline Quat normalize(Quat q)
+{
+	float l = sqrtf(q.X * q.X + q.Y * q.Y + q.Z * q.Z + q.W * q.W);
+	if (!(l > 0.0f))
+		return { 0.0f, 0.0f, 0.0f, 1.0f };
+	float s = 1.0f / l;
+	return { q.X * s, q.Y * s, q.Z * s, q.W * s };
+}
+
+// Поворот вектора: v + 2w(u x v) + 2u x (u x v), u - векторная часть
+inline Vec3 rotate(Quat q, Vec3 v)
+{
+	Vec3 u = { q.X, q.Y, q.Z };
+	Vec3 t = cross(u, v) * 2.0f;
+	return v + t * q.W + cross(u, t);
+}
+
+// Сферическая интерполяция по кратчайшей дуге; при почти совпадающих поворотах - линейная
+inline Quat slerp(Quat a, Quat b, float t)
+{
+	float cosine = a.X * b.X + a.Y * b.Y + a.Z * b.Z + a.W * b.W;
+	if (cosine < 0.0f)
+	{
+		b = { -b.X, -b.Y, -b.Z, -b.W };
+		cosine = -cosine;
+	}
+	float wa = 1.0f - t, wb = t;
+	if (cosine < 0.9995f)
+	{
+		float angle = acosf(cosine), sine = sinf(angle);
+		wa = sinf(wa * angle) / sine;
+		wb = sinf(wb * angle) / sine;
+	}
+	return normalize(Quat{ a.X * wa + b.X * wb, a.Y * wa + b.Y * wb, a.Z * wa + b.Z * wb, a.W * wa + b.W * wb });
+}
+
+// ---------------------------------------------------------------------------------------
+// Матрицы 4x4
+
+inline Mat4 mat4Identity()
+{
+	Mat4 m = { { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f } };
+	return m;
+}
+
+// Сдвиг * поворот * масштаб: матрица модели объекта
+inline Mat4 mat4Compose(Vec3 position, Quat rotation, Vec3 scale)
+{
+	float x = rotation.X, y = rotation.Y, z = rotation.Z, w = rotation.W;
+	Mat4 m;
+	m.M[0] = (1.0f - 2.0f * (y * y + z * z)) * scale.X;
+	m.M[1] = 2.0f * (x * y + w * z) * scale.X;
+	m.M[2] = 2.0f * (x * z - w * y) * scale.X;
+	m.M[3] = 0.0f;
+	m.M[4] = 2.0f * (x * y - w * z) * scale.Y;
+	m.M[5] = (1.0f - 2.0f * (x * x + z * z)) * scale.Y;
+	m.M[6] = 2.0f * (y * z + w * x) * scale.Y;
+	m.M[7] = 0.0f;
+	m.M[8] = 2.0f * (x * z + w * y) * scale.Z;
+	m.M[9] = 2.0f * (y * z - w * x) * scale.Z;
+	m.M[10] = (1.0f - 2.0f * (x * x + y * y)) * scale.Z;
+	m.M[11] = 0.0f;
+	m.M[12] = position.X;
+	m.M[13] = position.Y;
+	m.M[14] = position.Z;
+	m.M[15] = 1.0f;
+	return m;
+}
+
+inline Mat4 mat4Translation(Vec3 offset) { return mat4Compose(offset, { 0.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f }); }
+inline Mat4 mat4Rotation(Quat rotation) { return mat4Compose({ 0.0f, 0.0f, 0.0f }, rotation, { 1.0f, 1.0f, 1.0f }); }
+inline Mat4 mat4Scaling(Vec3 scale) { return mat4Compose({ 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, scale); }
+
+// Перспектива как у gluPerspective: fovY в радианах, глубина отображается в [-1, 1]
+inline Mat4 mat4Perspective(float fovY, float aspect, float nearZ, float farZ)
+{
+	float f = 1.0f / tanf(fovY * 0.5f);
+	Mat4 m = { {} };
+	m.M[0] = f / aspect;
+	m.M[5] = f;
+	m.M[10] = (farZ + nearZ) / (nearZ - farZ);
+	m.M[11] = -1.0f;
+	m.M[14] = 2.0f * farZ * nearZ / (nearZ - farZ);
+	return m;
+}
+
+// Ортографическая проекция как у glOrtho
+inline Mat4 mat4Ortho(float left, float right, float bottom, float top, float nearZ, float farZ)
+{
+	Mat4 m = mat4Identity();
+	m.M[0] = 2.0f / (right - left);
+	m.M[5] = 2.0f / (top - bottom);
+	m.M[10] = -2.0f / (farZ - nearZ);
+	m.M[12] = -(right + left) / (right - left);
+	m.M[13] = -(top + bottom) / (top - bottom);
+	m.M[14] = -(farZ + nearZ) / (farZ - nearZ);
+	return m;
+}
+
+// Матрица вида как у gluLookAt: камера в eye смотрит на target, -Z - направление взгляда
+inline Mat4 mat4LookAt(Vec3 eye, Vec3 target, Vec3 up)
+{
+	Vec3 f = normalize(target - eye);
+	Vec3 s = normalize(cross(f, up));
+	Vec3 u = cross(s, f);
+	Mat4 m = mat4Identity();
+	m.M[0] = s.X;
+	m.M[4] = s.Y;
+	m.M[8] = s.Z;
+	m.M[1] = u.X;
+	m.M[5] = u.Y;
+	m.M[9] = u.Z;
+	m.M[2] = -f.X;
+	m.M[6] = -f.Y;
+	m.M[10] = -f.Z;
+	m.M[12] = -dot(s, eye);
+	m.M[13] = -dot(u, eye);
+	m.M[14] = dot(f, eye);
+	return m;
+}
+
+inline Mat4 mat4Transpose(const Mat4 & m)
+{
+	Mat4 t;
+	for (int column = 0; column < 4; column++)
+		for (int row = 0; row < 4; row++)
+			t.M[row * 4 + column] = m.M[column * 4 + row];
+	return t;
+}
+
+// Столбец результата - линейная комбинация столбцов a с коэффициентами из столбца b
+inline Mat4 operator*(const Mat4 & a, const Mat4 & b)
+{
+	Mat4 m;
+#ifdef MIPMAP_X86
+	__m128 columns[4] = { _mm_load_ps(a.M), _mm_load_ps(a.M + 4), _mm_load_ps(a.M + 8), _mm_load_ps(a.M + 12) };
+	for (int column = 0; column < 4; column++)
+	{
+		const float * c = b.M + column * 4;
+		__m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(columns[0], _mm_set1_ps(c[0])), _mm_mul_ps(columns[1], _mm_set1_ps(c[1]))),
+								_mm_add_ps(_mm_mul_ps(columns[2], _mm_set1_ps(c[2])), _mm_mul_ps(columns[3], _mm_set1_ps(c[3]))));
+		_mm_store_ps(m.M + column * 4, sum);
+	}
+#else
+	for (int column = 0; column < 4; column++)
+		for (int row = 0; row < 4; row++)
+			m.M[column * 4 + row] = a.M[row] * b.M[column * 4] + a.M[4 + row] * b.M[column * 4 + 1] +
+									a.M[8 + row] * b.M[column * 4 + 2] + a.M[12 + row] * b.M[column * 4 + 3];
+#endif
+	return m;
+}
+
+inline Vec4 operator*(const Mat4 & m, Vec4 v)
+{
+	const float * a = m.M;
+	return { a[0] * v.X + a[4] * v.Y + a[8] * v.Z + a[12] * v.W,
+			 a[1] * v.X + a[5] * v.Y + a[9] * v.Z + a[13] * v.W,
+			 a[2] * v.X + a[6] * v.Y + a[10] * v.Z + a[14] * v.W,
+			 a[3] * v.X + a[7] * v.Y + a[11] * v.Z + a[15] * v.W };
+}
+
+// Точка (w = 1) без деления на w
+inline Vec3 transformPoint(const Mat4 & m, Vec3 p)
+{
+	Vec4 r = m * Vec4{ p.X, p.Y, p.Z, 1.0f };
+	return { r.X, r.Y, r.Z };
+}
+
+// ---------------------------------------------------------------------------------------
+// Пакеты. Поворот в TransformArrays должен быть нормализован.
+
+struct TransformArrays
+{
+	std::vector<float> PositionX, PositionY, PositionZ;
+	std::vector<float> RotationX, RotationY, RotationZ, RotationW;
+	std::vector<float> ScaleX, ScaleY, ScaleZ;
+
+	size_t Size() const { return this->PositionX.size(); }
+
+	void Resize(size_t count)
+	{
+		for (std::vector<float> * field : this->fields())
+			field->resize(count);
+	}
+
+	void Set(size_t i, Vec3 position, Quat rotation, Vec3 scale)
+	{
+		this->PositionX[i] = position.X;
+		this->PositionY[i] = position.Y;
+		this->PositionZ[i] = position.Z;
+		this->RotationX[i] = rotation.X;
+		this->RotationY[i] = rotation.Y;
+		this->RotationZ[i] = rotation.Z;
+		this->RotationW[i] = rotation.W;
+		this->ScaleX[i] = scale.X;
+		this->ScaleY[i] = scale.Y;
+		this->ScaleZ[i] = scale.Z;
+	}
+
+	private:
+	std::vector<std::vector<float> *> fields()
+	{
+		return { &this->PositionX, &this->PositionY, &this->PositionZ, &this->RotationX, &this->RotationY,
+				 &this->RotationZ, &this->RotationW, &this->ScaleX, &this->ScaleY, &this->ScaleZ };
+	}
+};
+
+// Матрицы пакета: Element(k)[i] - элемент k (в порядке Mat4::M) матрицы i. Все 16
+// массивов лежат в одном блоке со сдвигом на строку кеша: отдельные большие массивы
+// начинались бы с одного смещения в странице, и 16 потоков записи мешали бы друг другу
+// в одних и тех же наборах кеша L1 (4K aliasing).
+struct MatrixArrays
+{
+	size_t Size() const { return this->count; }
+
+	// Содержимое не сохраняется
+	void Resize(size_t count)
+	{
+		this->count = count;
+		this->stride = (count + 15) / 16 * 16 + 16;
+		this->data.assign(this->stride * 16, 0.0f);
+	}
+
+	float * Element(int k) { return this->data.data() + k * this->stride; }
+	const float * Element(int k) const { return this->data.data() + k * this->stride; }
+
+	Mat4 Get(size_t i) const
+	{
+		Mat4 m;
+		for (int k = 0; k < 16; k++)
+			m.M[k] = this->Element(k)[i];
+		return m;
+	}
+
+	void Set(size_t i, const Mat4 & m)
+	{
+		for (int k = 0; k < 16; k++)
+			this->Element(k)[i] = m.M[k];
+	}
+
+	// Матрицы [begin, end) подряд, по 16 float на матрицу - для буфера или glUniformMatrix4fv
+	void Store(size_t begin, size_t end, Mat4 * out) const
+	{
+		for (size_t i = begin; i < end; i++)
+			for (int k = 0; k < 16; k++)
+				out[i - begin].M[k] = this->Element(k)[i];
+	}
+
+	private:
+	std::vector<float> data;
+	size_t count = 0, stride = 0;
+};
+
+// ---------------------------------------------------------------------------------------
+// Матрицы пакета [begin, end): out[i] = left * mat4Compose(положение, поворот, масштаб),
+// без left - сами матрицы моделей. С left (проекция * вид) матрица модели остаётся в
+// регистрах и не проходит через память, а её последняя строка (0, 0, 0, 1) убирает
+// четверть умножений. out должен быть не меньше end.
+
+inline void composeTransformsScalar(const TransformArrays & in, const Mat4 * left, size_t begin, size_t end, MatrixArrays & out)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		Mat4 model = mat4Compose({ in.PositionX[i], in.PositionY[i], in.PositionZ[i] },
+								 { in.RotationX[i], in.RotationY[i], in.RotationZ[i], in.RotationW[i] },
+								 { in.ScaleX[i], in.ScaleY[i], in.ScaleZ[i] });
+		if (!left)
+		{
+			out.Set(i, model);
+			continue;
+		}
+		const float * l = left->M;
+		const float * m = model.M;
+		for (int column = 0; column < 4; column++)
+			for (int row = 0; row < 4; row++)
+				out.Element(column * 4 + row)[i] = l[row] * m[column * 4] + l[4 + row] * m[column * 4 + 1] + l[8 + row] * m[column * 4 + 2] +
+												   (column == 3 ? l[12 + row] : 0.0f);
+	}
+}
+
+#ifdef MIPMAP_X86
+inline void composeTransformsSse(const TransformArrays & in, const Mat4 * left, size_t begin, size_t end, MatrixArrays & out)
+{
+	const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), zero = _mm_setzero_ps();
+	__m128 l[16];
+	for (int k = 0; k < 16; k++)
+		l[k] = _mm_set1_ps(left ? left->M[k] : 0.0f);
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&in.RotationX[i]), y = _mm_loadu_ps(&in.RotationY[i]);
+		__m128 z = _mm_loadu_ps(&in.RotationZ[i]), w = _mm_loadu_ps(&in.RotationW[i]);
+		__m128 sx = _mm_loadu_ps(&in.ScaleX[i]), sy = _mm_loadu_ps(&in.ScaleY[i]), sz = _mm_loadu_ps(&in.ScaleZ[i]);
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+		__m128 m[16];
+		m[0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+		m[1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+		m[2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+		m[3] = zero;
+		m[4] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+		m[5] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+		m[6] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+		m[7] = zero;
+		m[8] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+		m[9] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+		m[10] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+		m[11] = zero;
+		m[12] = _mm_loadu_ps(&in.PositionX[i]);
+		m[13] = _mm_loadu_ps(&in.PositionY[i]);
+		m[14] = _mm_loadu_ps(&in.PositionZ[i]);
+		m[15] = one;
+		if (!left)
+		{
+			for (int k = 0; k < 16; k++)
+				_mm_storeu_ps(out.Element(k) + i, m[k]);
+			continue;
+		}
+		for (int column = 0; column < 4; column++)
+			for (int row = 0; row < 4; row++)
+			{
+				__m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(l[row], m[column * 4]), _mm_mul_ps(l[4 + row], m[column * 4 + 1])),
+										_mm_mul_ps(l[8 + row], m[column * 4 + 2]));
+				if (column == 3)
+					sum = _mm_add_ps(sum, l[12 + row]);
+				_mm_storeu_ps(out.Element(column * 4 + row) + i, sum);
+			}
+	}
+	composeTransformsScalar(in, left, i, end, out);
+}
+
+VECMATH_TARGET_AVX2 inline void composeTransformsAvx2(const TransformArrays & in, const Mat4 * left, size_t begin, size_t end, MatrixArrays & out)
+{
+	const __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f), zero = _mm256_setzero_ps();
+	__m256 l[16];
+	for (int k = 0; k < 16; k++)
+		l[k] = _mm256_set1_ps(left ? left->M[k] : 0.0f);
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(&in.RotationX[i]), y = _mm256_loadu_ps(&in.RotationY[i]);
+		__m256 z = _mm256_loadu_ps(&in.RotationZ[i]), w = _mm256_loadu_ps(&in.RotationW[i]);
+		__m256 sx = _mm256_loadu_ps(&in.ScaleX[i]), sy = _mm256_loadu_ps(&in.ScaleY[i]), sz = _mm256_loadu_ps(&in.ScaleZ[i]);
+		__m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+		__m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+		__m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+		__m256 m[16];
+		m[0] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), sx);
+		m[1] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx);
+		m[2] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx);
+		m[3] = zero;
+		m[4] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy);
+		m[5] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), sy);
+		m[6] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy);
+		m[7] = zero;
+		m[8] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz);
+		m[9] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz);
+		m[10] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))), sz);
+		m[11] = zero;
+		m[12] = _mm256_loadu_ps(&in.PositionX[i]);
+		m[13] = _mm256_loadu_ps(&in.PositionY[i]);
+		m[14] = _mm256_loadu_ps(&in.PositionZ[i]);
+		m[15] = one;
+		if (!left)
+		{
+			for (int k = 0; k < 16; k++)
+				_mm256_storeu_ps(out.Element(k) + i, m[k]);
+			continue;
+		}
+		for (int column = 0; column < 4; column++)
+			for (int row = 0; row < 4; row++)
+			{
+				__m256 sum = _mm256_fmadd_ps(l[row], m[column * 4], _mm256_fmadd_ps(l[4 + row], m[column * 4 + 1],
+																	 _mm256_mul_ps(l[8 + row], m[column * 4 + 2])));
+				if (column == 3)
+					sum = _mm256_add_ps(sum, l[12 + row]);
+				_mm256_storeu_ps(out.Element(column * 4 + row) + i, sum);
+			}
+	}
+	composeTransformsSse(in, left, i, end, out);
+}
+#endif
+
+inline void composeTransforms(const TransformArrays & in, const Mat4 * left, size_t begin, size_t end, MatrixArrays & out,
+							  SimdLevel simd = detectSimdLevel())
+{
+#ifdef MIPMAP_X86
+	if (simd == SimdLevel::AVX2)
+	{
+		composeTransformsAvx2(in, left, begin, end, out);
+		return;
+	}
+	if (simd == SimdLevel::SSE2)
+	{
+		composeTransformsSse(in, left, begin, end, out);
+		return;
+	}
+#endif
+	composeTransformsScalar(in, left, begin, end, out);
+}
+
+// ---------------------------------------------------------------------------------------
+// Общая матрица слева для матриц пакета [begin, end): out[i] = left * in[i]
+// (например, вид * проекция * модель). out может быть тем же пакетом, что и in.
+
+inline void multiplyTransformsScalar(const Mat4 & left, const MatrixArrays & in, size_t begin, size_t end, MatrixArrays & out)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		float r[16], m[16];
+		for (int k = 0; k < 16; k++)
+			r[k] = in.Element(k)[i];
+		for (int column = 0; column < 4; column++)
+			for (int row = 0; row < 4; row++)
+				m[column * 4 + row] = left.M[row] * r[column * 4] + left.M[4 + row] * r[column * 4 + 1] +
+									  left.M[8 + row] * r[column * 4 + 2] + left.M[12 + row] * r[column * 4 + 3];
+		for (int k = 0; k < 16; k++)
+			out.Element(k)[i] = m[k];
+	}
+}
+
+#ifdef MIPMAP_X86
+inline void multiplyTransformsSse(const Mat4 & left, const MatrixArrays & in, size_t begin, size_t end, MatrixArrays & out)
+{
+	__m128 l[16];
+	for (int k = 0; k < 16; k++)
+		l[k] = _mm_set1_ps(left.M[k]);
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		// Весь столбец читается до записи, поэтому in и out могут совпадать
+		for (int column = 0; column < 4; column++)
+		{
+			__m128 r[4];
+			for (int k = 0; k < 4; k++)
+				r[k] = _mm_loadu_ps(in.Element(column * 4 + k) + i);
+			for (int row = 0; row < 4; row++)
+			{
+				__m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(l[row], r[0]), _mm_mul_ps(l[4 + row], r[1])),
+										_mm_add_ps(_mm_mul_ps(l[8 + row], r[2]), _mm_mul_ps(l[12 + row], r[3])));
+				_mm_storeu_ps(out.Element(column * 4 + row) + i, sum);
+			}
+		}
+	}
+	multiplyTransformsScalar(left, in, i, end, out);
+}
+
+VECMATH_TARGET_AVX2 inline void multiplyTransformsAvx2(const Mat4 & left, const MatrixArrays & in, size_t begin, size_t end, MatrixArrays & out)
+{
+	__m256 l[16];
+	for (int k = 0; k < 16; k++)
+		l[k] = _mm256_set1_ps(left.M[k]);
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			__m256 r[4];
+			for (int k = 0; k < 4; k++)
+				r[k] = _mm256_loadu_ps(in.Element(column * 4 + k) + i);
+			for (int row = 0; row < 4; row++)
+			{
+				__m256 sum = _mm256_fmadd_ps(l[row], r[0], _mm256_fmadd_ps(l[4 + row], r[1],
+														   _mm256_fmadd_ps(l[8 + row], r[2], _mm256_mul_ps(l[12 + row], r[3]))));
+				_mm256_storeu_ps(out.Element(column * 4 + row) + i, sum);
+			}
+		}
+	}
+	multiplyTransformsSse(left, in, i, end, out);
+}
+#endif
+
+inline void multiplyTransforms(const Mat4 & left, const MatrixArrays & in, size_t begin, size_t end, MatrixArrays & out,
+							   SimdLevel simd = detectSimdLevel())
+{
+#ifdef MIPMAP_X86
+	if (simd == SimdLevel::AVX2)
+	{
+		multiplyTransformsAvx2(left, in, begin, end, out);
+		return;
+	}
+	if (simd == SimdLevel::SSE2)
+	{
+		multiplyTransformsSse(left, in, begin, end, out);
+		return;
+	}
+#endif
+	multiplyTransformsScalar(left, in, begin, end, out);
+}
+
+#endif
@@ -0,0 +1,184 @@
+// Описание формата вершин. Формат - это список атрибутов VertexAttrib<location, компоненты,
+// тип, нормализация>, а шаг вершины и смещения атрибутов считаются при компиляции, так что
+// они не могут разойтись с реальной структурой вершины (это проверяется static_assert
+// рядом со структурой). Apply выставляет все glVertexAttribPointer одним вызовом.
+//
+// Кроме привычного формата из 8 float (32 байта) здесь есть упакованный формат в 16 байт:
+// позиция в half float, цвет в GL_UNSIGNED_BYTE и текстурные координаты в GL_UNSIGNED_SHORT
+// с нормализацией. Шейдер не меняется: нормализованные целые и half float приходят в него
+// обычными float. Для геометрии, упирающейся в пропускную способность выборки вершин,
+// это вдвое меньше байт на вершину.
+
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include <GL/glew.h>
+
+// Размер одной компоненты атрибута в байтах
+constexpr GLsizei vertexTypeSize(GLenum type)
+{
+	return type == GL_FLOAT ? 4
+		: type == GL_HALF_FLOAT ? 2
+		: type == GL_UNSIGNED_SHORT || type == GL_SHORT ? 2
+		: type == GL_UNSIGNED_BYTE || type == GL_BYTE ? 1
+		: 0;
+}
+
+template <GLuint Location, GLint Components, GLenum Type, GLboolean Normalized = GL_FALSE>
+struct VertexAttrib
+{
+	static_assert(Components >= 1 && Components <= 4, "vertex attribute must have 1-4 components");
+	static_assert(vertexTypeSize(Type) > 0, "unsupported vertex attribute type");
+
+	static constexpr GLuint location = Location;
+	static constexpr GLint components = Components;
+	static constexpr GLenum type = Type;
+	static constexpr GLboolean normalized = Normalized;
+	static constexpr GLsizei size = Components * vertexTypeSize(Type);
+};
+
+template <typename... Attribs>
+struct VertexLayout
+{
+	static constexpr size_t Count = sizeof...(Attribs);
+	// Атрибуты идут подряд без промежутков
+	static constexpr GLsizei Stride = (Attribs::size + ... + 0);
+
+	// Смещение атрибута с номером index (по порядку в списке, не location)
+	static constexpr GLsizei Offset(size_t index)
+	{
+		const GLsizei sizes[] = { Attribs::size... };
+		GLsizei offset = 0;
+		for (size_t i = 0; i < index; i++)
+			offset += sizes[i];
+		return offset;
+	}
+
+	// Многие реализации выбирают атрибуты медленнее (или вовсе через программный путь),
+	// если смещение или шаг не кратны 4 байтам
+	static constexpr bool aligned()
+	{
+		for (size_t i = 0; i < Count; i++)
+			if (Offset(i) % 4)
+				return false;
+		return Stride % 4 == 0;
+	}
+
+	// Указатели на атрибуты для буфера, привязанного к GL_ARRAY_BUFFER; base - смещение
+	// первой вершины в буфере. Вызывается при привязанном VAO.
+	static void Apply(GLintptr base = 0)
+	{
+		static_assert(aligned(), "vertex attributes must be 4-byte aligned");
+		apply(base, std::make_index_sequence<Count>());
+	}
+
+	private:
+	template <size_t... Index>
+	static void apply(GLintptr base, std::index_sequence<Index...>)
+	{
+		(applyOne<Attribs>(base + Offset(Index)), ...);
+	}
+
+	template <typename Attrib>
+	static void applyOne(GLintptr offset)
+	{
+		glVertexAttribPointer(Attrib::location, Attrib::components, Attrib::type, Attrib::normalized, Stride, (GLvoid*)offset);
+		glEnableVertexAttribArray(Attrib::location);
+	}
+};
+
+// Вершина hello_window.cpp: позиция, цвет, текстурные координаты - 8 float, 32 байта
+struct Fp32Vertex
+{
+	GLfloat Position[3];
+	GLfloat Color[3];
+	GLfloat TexCoord[2];
+};
+
+typedef VertexLayout<VertexAttrib<0, 3, GL_FLOAT>, VertexAttrib<1, 3, GL_FLOAT>, VertexAttrib<2, 2, GL_FLOAT>> Fp32VertexLayout;
+static_assert(sizeof(Fp32Vertex) == Fp32VertexLayout::Stride, "Fp32Vertex does not match its layout");
+static_assert(offsetof(Fp32Vertex, TexCoord) == Fp32VertexLayout::Offset(2), "Fp32Vertex does not match its layout");
+
+// Та же вершина в 16 байтах. Четвёртая компонента позиции (w = 1) выравнивает цвет на 4 байта;
+// шейдер с vec3 position её просто не читает. Альфа цвета тоже не используется шейдером.
+struct PackedVertex
+{
+	GLhalf Position[4];
+	GLubyte Color[4];
+	GLushort TexCoord[2];
+};
+
+typedef VertexLayout<VertexAttrib<0, 4, GL_HALF_FLOAT>, VertexAttrib<1, 4, GL_UNSIGNED_BYTE, GL_TRUE>,
+					 VertexAttrib<2, 2, GL_UNSIGNED_SHORT, GL_TRUE>> PackedVertexLayout;
+static_assert(sizeof(PackedVertex) == PackedVertexLayout::Stride, "PackedVertex does not match its layout");
+static_assert(offsetof(PackedVertex, TexCoord) == PackedVertexLayout::Offset(2), "PackedVertex does not match its layout");
+
+// float -> half float (IEEE 754 binary16) с округлением к ближайшему чётному
+inline GLhalf floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t magnitude = bits & 0x7fffffff;
+	if (magnitude >= 0x7f800000)
+		// Бесконечность или NaN (у NaN сохраняем признак "не число")
+		return (GLhalf)(sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0));
+	if (magnitude >= 0x477ff000)
+		// Больше максимального half (65504 с учётом округления) - бесконечность
+		return (GLhalf)(sign | 0x7c00);
+	if (magnitude < 0x38800000)
+	{
+		// Денормализованный half: сдвигаем мантиссу со скрытой единицей
+		if (magnitude < 0x33000000)
+			return (GLhalf)sign;
+		uint32_t exponent = magnitude >> 23;
+		uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+		uint32_t shift = 126 - exponent;
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1), midpoint = 1u << (shift - 1);
+		if (rest > midpoint || (rest == midpoint && (half & 1)))
+			half++;
+		return (GLhalf)(sign | half);
+	}
+	// Нормализованное число: перенос экспоненты и округление 13 отбрасываемых бит
+	uint32_t half = (magnitude - 0x38000000) >> 13;
+	uint32_t rest = magnitude & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		half++;
+	return (GLhalf)(sign | half);
+}
+
+// Нормализованные целые: [0, 1] -> [0, максимум типа]
+inline GLubyte unorm8(float value)
+{
+	return (GLubyte)lrintf(fminf(fmaxf(value, 0.0f), 1.0f) * 255.0f);
+}
+
+inline GLushort unorm16(float value)
+{
+	return (GLushort)lrintf(fminf(fmaxf(value, 0.0f), 1.0f) * 65535.0f);
+}
+
+// Упаковка вершины. Текстурные координаты вне [0, 1] (повтор текстуры) в unorm16 не помещаются.
+inline PackedVertex packVertex(const Fp32Vertex & vertex)
+{
+	PackedVertex packed;
+	for (int i = 0; i < 3; i++)
+	{
+		packed.Position[i] = floatToHalf(vertex.Position[i]);
+		packed.Color[i] = unorm8(vertex.Color[i]);
+	}
+	packed.Position[3] = floatToHalf(1.0f);
+	packed.Color[3] = 255;
+	packed.TexCoord[0] = unorm16(vertex.TexCoord[0]);
+	packed.TexCoord[1] = unorm16(vertex.TexCoord[1]);
+	return packed;
+}
+
+#endif
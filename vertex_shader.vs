@@ -1,15 +1,29 @@
 #version 330 core
 
-layout (location = 0) in vec3 position;
+// Общий исходник вариантов шейдера (shader_variants.h): после строки #version в него
+// вставляются #define VERTEX_COLOR, UNIFORM_COLOR, TEXTURE, TWO_TEXTURES.
+
+// Позиция - vec4: у вершин из трёх компонент OpenGL сам дописывает w = 1, а пакеты
+// renderer.h передают уже готовую позицию в пространстве отсечения
+layout (location = 0) in vec4 position;
+#ifdef VERTEX_COLOR
 layout (location = 1) in vec3 color;
-layout (location = 2) in vec2 texCoord;
 
 out vec3 ourColor;
+#endif
+#ifdef TEXTURE
+layout (location = 2) in vec2 texCoord;
+
 out vec2 TexCoord;
+#endif
 
 void main()
 {							
-	gl_Position = vec4(position, 1.0f);
+	gl_Position = position;
+#ifdef VERTEX_COLOR
 	ourColor = color;
+#endif
+#ifdef TEXTURE
 	TexCoord = texCoord;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,193 @@
+// Генераторы случайных чисел xoshiro (Blackman, Vigna) вместо rand(): rand() медленный,
+// даёт на многих платформах всего 15 бит и держит общее состояние под блокировкой.
+//
+// Xoshiro256 - одно 64-битное состояние xoshiro256+ для отдельных чисел (fRand).
+// Xoshiro128x8 - восемь независимых потоков xoshiro128+ в дорожках SSE2/AVX2 для
+// заполнения массивов: за шаг получается восемь чисел. Дорожка j всегда даёт числа
+// out[8 * шаг + j], поэтому результат не зависит от набора инструкций.
+//
+// Оба засеваются через splitmix64, как советуют авторы: близкие зёрна дают независимые
+// последовательности.
+
+#ifndef XOSHIRO_H
+#define XOSHIRO_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "mipmap.h"
+
+#ifdef MIPMAP_X86
+#define XOSHIRO_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+inline uint64_t splitMix64(uint64_t & state)
+{
+	uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+class Xoshiro256
+{
+	public:
+	explicit Xoshiro256(uint64_t seed = 1) { this->Seed(seed); }
+
+	void Seed(uint64_t seed)
+	{
+		for (uint64_t & word : this->state)
+			word = splitMix64(seed);
+	}
+
+	uint64_t Next()
+	{
+		uint64_t * s = this->state;
+		uint64_t result = s[0] + s[3];
+		uint64_t t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = (s[3] << 45) | (s[3] >> 19);
+		return result;
+	}
+
+	// [0, 1): старшие 53 бита (младшие биты xoshiro256+ слабее)
+	double NextDouble() { return (double)(this->Next() >> 11) * (1.0 / 9007199254740992.0); }
+	// [0, 1): старшие 24 бита
+	float NextFloat() { return (float)(this->Next() >> 40) * (1.0f / 16777216.0f); }
+
+	private:
+	uint64_t state[4];
+};
+
+class Xoshiro128x8
+{
+	public:
+	static const int Lanes = 8;
+
+	explicit Xoshiro128x8(uint64_t seed = 1) { this->Seed(seed); }
+
+	void Seed(uint64_t seed)
+	{
+		for (int lane = 0; lane < Lanes; lane++)
+			for (int k = 0; k < 4; k += 2)
+			{
+				uint64_t word = splitMix64(seed);
+				this->state[k][lane] = (uint32_t)word;
+				this->state[k + 1][lane] = (uint32_t)(word >> 32);
+			}
+	}
+
+	// count чисел, равномерных в [low, high)
+	void Fill(float * out, size_t count, float low, float high, SimdLevel simd = detectSimdLevel())
+	{
+		size_t whole = count / Lanes * Lanes;
+#ifdef MIPMAP_X86
+		if (simd == SimdLevel::AVX2)
+			this->fillAvx2(out, whole, low, high);
+		else if (simd == SimdLevel::SSE2)
+			this->fillSse(out, whole, low, high);
+		else
+#endif
+			this->fillScalar(out, whole, low, high);
+		// Хвост: ещё один шаг, из которого берётся только часть дорожек
+		if (whole < count)
+		{
+			float tail[Lanes];
+			this->fillScalar(tail, Lanes, low, high);
+			std::copy(tail, tail + (count - whole), out + whole);
+		}
+	}
+
+	private:
+	// state[k][дорожка] - слово k состояния xoshiro128+ каждой дорожки
+	alignas(32) uint32_t state[4][Lanes];
+
+	void fillScalar(float * out, size_t count, float low, float high)
+	{
+		float range = high - low;
+		for (size_t i = 0; i < count; i += Lanes)
+			for (int lane = 0; lane < Lanes; lane++)
+			{
+				uint32_t s0 = this->state[0][lane], s1 = this->state[1][lane], s2 = this->state[2][lane], s3 = this->state[3][lane];
+				uint32_t result = s0 + s3;
+				uint32_t t = s1 << 9;
+				s2 ^= s0;
+				s3 ^= s1;
+				s1 ^= s2;
+				s0 ^= s3;
+				s2 ^= t;
+				s3 = (s3 << 11) | (s3 >> 21);
+				this->state[0][lane] = s0;
+				this->state[1][lane] = s1;
+				this->state[2][lane] = s2;
+				this->state[3][lane] = s3;
+				out[i + lane] = low + (float)(result >> 8) * (1.0f / 16777216.0f) * range;
+			}
+	}
+
+#ifdef MIPMAP_X86
+	// Две половины по четыре дорожки; в SSE2 нет циклического сдвига, он собирается из двух
+	void fillSse(float * out, size_t count, float low, float high)
+	{
+		const __m128 scale = _mm_set1_ps((1.0f / 16777216.0f) * (high - low)), offset = _mm_set1_ps(low);
+		for (int half = 0; half < 2; half++)
+		{
+			int first = half * 4;
+			__m128i s0 = _mm_load_si128((const __m128i *)&this->state[0][first]);
+			__m128i s1 = _mm_load_si128((const __m128i *)&this->state[1][first]);
+			__m128i s2 = _mm_load_si128((const __m128i *)&this->state[2][first]);
+			__m128i s3 = _mm_load_si128((const __m128i *)&this->state[3][first]);
+			for (size_t i = 0; i < count; i += Lanes)
+			{
+				__m128i result = _mm_add_epi32(s0, s3);
+				__m128i t = _mm_slli_epi32(s1, 9);
+				s2 = _mm_xor_si128(s2, s0);
+				s3 = _mm_xor_si128(s3, s1);
+				s1 = _mm_xor_si128(s1, s2);
+				s0 = _mm_xor_si128(s0, s3);
+				s2 = _mm_xor_si128(s2, t);
+				s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+				__m128 value = _mm_cvtepi32_ps(_mm_srli_epi32(result, 8));
+				_mm_storeu_ps(out + i + first, _mm_add_ps(offset, _mm_mul_ps(value, scale)));
+			}
+			_mm_store_si128((__m128i *)&this->state[0][first], s0);
+			_mm_store_si128((__m128i *)&this->state[1][first], s1);
+			_mm_store_si128((__m128i *)&this->state[2][first], s2);
+			_mm_store_si128((__m128i *)&this->state[3][first], s3);
+		}
+	}
+
+	XOSHIRO_TARGET_AVX2 void fillAvx2(float * out, size_t count, float low, float high)
+	{
+		const __m256 scale = _mm256_set1_ps((1.0f / 16777216.0f) * (high - low)), offset = _mm256_set1_ps(low);
+		__m256i s0 = _mm256_load_si256((const __m256i *)this->state[0]);
+		__m256i s1 = _mm256_load_si256((const __m256i *)this->state[1]);
+		__m256i s2 = _mm256_load_si256((const __m256i *)this->state[2]);
+		__m256i s3 = _mm256_load_si256((const __m256i *)this->state[3]);
+		for (size_t i = 0; i < count; i += Lanes)
+		{
+			__m256i result = _mm256_add_epi32(s0, s3);
+			__m256i t = _mm256_slli_epi32(s1, 9);
+			s2 = _mm256_xor_si256(s2, s0);
+			s3 = _mm256_xor_si256(s3, s1);
+			s1 = _mm256_xor_si256(s1, s2);
+			s0 = _mm256_xor_si256(s0, s3);
+			s2 = _mm256_xor_si256(s2, t);
+			s3 = _mm256_or_si256(_mm256_slli_epi32(s3, 11), _mm256_srli_epi32(s3, 21));
+			__m256 value = _mm256_cvtepi32_ps(_mm256_srli_epi32(result, 8));
+			_mm256_storeu_ps(out + i, _mm256_fmadd_ps(value, scale, offset));
+		}
+		_mm256_store_si256((__m256i *)this->state[0], s0);
+		_mm256_store_si256((__m256i *)this->state[1], s1);
+		_mm256_store_si256((__m256i *)this->state[2], s2);
+		_mm256_store_si256((__m256i *)this->state[3], s3);
+	}
+#endif
+};
+
+#endif